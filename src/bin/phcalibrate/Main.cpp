@@ -0,0 +1,258 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+// Calibrate the PostHaste cost model (see XfCostModel) on the host machine,
+// writing the estimates to a file that can be loaded by posthaste (see its
+// --costs option).
+//
+// The cost of a compiled instruction is measured by applying an operation to
+// each point of a grid in a fused loop, with intermediate values in
+// registers.  The cost of an interpreted instruction is measured by
+// emulating a SIMD interpreter: each instruction is dispatched through a
+// function pointer and makes a pass over the grid, loading its operands from
+// memory and storing its result.  The per-argument overhead of a plugin call
+// is the cost of stepping an iterator through an increment list.  The fixed
+// per-call overhead depends on the renderer, so it can be specified on the
+// command line (it's otherwise left at the default).
+
+#include "ops/OpVec3.h"
+#include "util/UtLog.h"
+#include "xf/XfCostModel.h"
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+// Number of points in a grid.
+static const int kGridSize = 256;
+
+// Number of chained instructions per measurement.
+static const int kChainLength = 16;
+
+// Number of repetitions per measurement.
+static const int kNumReps = 2000;
+
+// A binary operation on floats.
+typedef float (*FloatOp)(float a, float b);
+
+// Operations to calibrate.  Unary operations ignore their second operand.
+static float Add(float a, float b) { return a + b; }
+static float Subtract(float a, float b) { return a - b; }
+static float Multiply(float a, float b) { return a * b; }
+static float Divide(float a, float b) { return a / b; }
+static float Abs(float a, float b) { return fabsf(a); }
+static float Floor(float a, float b) { return floorf(a); }
+static float Ceil(float a, float b) { return ceilf(a); }
+static float Min(float a, float b) { return a < b ? a : b; }
+static float Max(float a, float b) { return a > b ? a : b; }
+static float Sqrt(float a, float b) { return sqrtf(fabsf(a)); }
+static float InverseSqrt(float a, float b) { return 1.0f/sqrtf(fabsf(a)+1); }
+static float Pow(float a, float b) { return powf(fabsf(a), b); }
+static float Exp(float a, float b) { return expf(a); }
+static float Log(float a, float b) { return logf(fabsf(a) + 1.0f); }
+static float Sin(float a, float b) { return sinf(a); }
+static float Cos(float a, float b) { return cosf(a); }
+static float Tan(float a, float b) { return tanf(a); }
+static float Asin(float a, float b) { return asinf(fmodf(a, 1.0f)); }
+static float Acos(float a, float b) { return acosf(fmodf(a, 1.0f)); }
+static float Atan(float a, float b) { return atanf(a); }
+static float Dot(float a, float b) { return OpVec3(a) * OpVec3(b); }
+static float Length(float a, float b) { return OpVec3(a, b, a).Length(); }
+static float Normalize(float a, float b) {
+    return OpVec3(a, b, 1.0f).Normalized()[0];
+}
+static float Cross(float a, float b) {
+    return OpVec3(a, b, 1.0f).Cross(OpVec3(b, 1.0f, a))[1];
+}
+
+
+// Prevents the compiler from discarding results.
+volatile float gSink;
+
+// Get the current time in nanoseconds.
+static double
+GetTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+// Measure the per-point cost of an operation in a fused loop.  The operation
+// is a template parameter, so it can be inlined, as in a compiled kernel.
+template<FloatOp op>
+static float
+MeasureCompiled(const float* input)
+{
+    double start = GetTime();
+    float sum = 0.0f;
+    for (int rep = 0; rep < kNumReps; ++rep) {
+        for (int i = 0; i < kGridSize; ++i) {
+            float x = input[i];
+            for (int j = 0; j < kChainLength; ++j)
+                x = op(x, input[i]);
+            sum += x;
+        }
+    }
+    gSink = sum;
+    double elapsed = GetTime() - start;
+    return elapsed / (kNumReps * kGridSize * kChainLength);
+}
+
+// Measure the per-point cost of an interpreted operation.  Each instruction
+// makes a pass over the grid, loading operands from memory and storing
+// results.
+static float
+MeasureInterp(FloatOp op, const float* input, float* temps)
+{
+    double start = GetTime();
+    for (int rep = 0; rep < kNumReps; ++rep) {
+        for (int i = 0; i < kGridSize; ++i)
+            temps[i] = input[i];
+        for (int j = 0; j < kChainLength; ++j) {
+            float* src = temps + (j % 2) * kGridSize;
+            float* dst = temps + ((j+1) % 2) * kGridSize;
+            for (int i = 0; i < kGridSize; ++i)
+                dst[i] = op(src[i], input[i]);
+        }
+    }
+    gSink = temps[0];
+    double elapsed = GetTime() - start;
+    return elapsed / (kNumReps * kGridSize * kChainLength);
+}
+
+// Measure the per-point cost of stepping an iterator through an increment
+// list, as the plugin entry function does for each argument.
+static float
+MeasureArg(const float* input)
+{
+    unsigned int incrList[kGridSize];
+    for (int i = 0; i < kGridSize; ++i)
+        incrList[i] = 1;
+    double start = GetTime();
+    float sum = 0.0f;
+    for (int rep = 0; rep < kNumReps * kChainLength; ++rep) {
+        const float* data = input;
+        const unsigned int* incr = incrList;
+        for (int i = 0; i < kGridSize; ++i) {
+            sum += *data;
+            data += *incr++;
+        }
+    }
+    gSink = sum;
+    double elapsed = GetTime() - start;
+    return elapsed / (kNumReps * kChainLength * kGridSize);
+}
+
+// An operation to calibrate, with a specialized measurement function.
+struct Probe {
+    Opcode mOpcode;
+    FloatOp mOp;
+    float (*mMeasureCompiled)(const float* input);
+};
+
+#define PROBE(op) { kOpcode_##op, op, MeasureCompiled<op> }
+
+static const Probe kProbes[] = {
+    PROBE(Abs),
+    PROBE(Acos),
+    PROBE(Add),
+    PROBE(Asin),
+    PROBE(Atan),
+    PROBE(Ceil),
+    PROBE(Cos),
+    PROBE(Cross),
+    PROBE(Divide),
+    PROBE(Dot),
+    PROBE(Exp),
+    PROBE(Floor),
+    PROBE(InverseSqrt),
+    PROBE(Length),
+    PROBE(Log),
+    PROBE(Max),
+    PROBE(Min),
+    PROBE(Multiply),
+    PROBE(Normalize),
+    PROBE(Pow),
+    PROBE(Sin),
+    PROBE(Sqrt),
+    PROBE(Subtract),
+    PROBE(Tan),
+};
+
+#undef PROBE
+
+static void
+Usage(const char* appName)
+{
+    fprintf(stderr, "Usage: %s [options]\n"
+            "Options:\n"
+            "  -h, --help       Print usage\n"
+            "  -o FILE          Output file (default: posthaste.costs)\n"
+            "  --call N         Plugin call overhead (per point)\n",
+            appName);
+}
+
+int
+main(int argc, const char** argv)
+{
+    UtLog log(stderr);
+    const char* outFile = "posthaste.costs";
+    float callCost = -1.0f;
+
+    enum LongOption { kOptNone = 256, kCallCost };
+    static struct option longOptions[] = {
+        { "help", no_argument, NULL, 'h' },
+        { "call", required_argument, NULL, kCallCost },
+        { NULL, 0, NULL, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, const_cast<char**>(argv),
+                            "ho:", longOptions, NULL)) != -1)
+        switch (c) {
+          case 'o':
+              outFile = optarg;
+              break;
+          case kCallCost:
+              callCost = atof(optarg);
+              break;
+          case 'h':
+          default:
+              Usage(argv[0]);
+              return 1;
+        }
+
+    // Initialize the input data.
+    float input[kGridSize];
+    float temps[2 * kGridSize];
+    for (int i = 0; i < kGridSize; ++i)
+        input[i] = 0.5f + (float) i / kGridSize;
+
+    // Measure the instruction costs.
+    XfCostModel model;
+    size_t numProbes = sizeof(kProbes) / sizeof(Probe);
+    for (size_t i = 0; i < numProbes; ++i) {
+        const Probe& probe = kProbes[i];
+        float compiledCost = probe.mMeasureCompiled(input);
+        float interpCost = MeasureInterp(probe.mOp, input, temps);
+
+        // The compiled loop is latency bound for expensive operations, since
+        // it doesn't overlap points, so it can appear slower than the
+        // interpreter.  Compiled code is never assumed to be slower.
+        if (compiledCost > interpCost)
+            compiledCost = interpCost;
+        model.SetCosts(probe.mOpcode, interpCost, compiledCost);
+        printf("%-16s %8.3f %8.3f\n", OpcodeName(probe.mOpcode),
+               interpCost, compiledCost);
+    }
+
+    // Measure the per-argument overhead.
+    model.SetArgCost(MeasureArg(input));
+    printf("%-16s %8.3f\n", "arg", model.GetArgCost());
+    if (callCost >= 0.0f)
+        model.SetCallCost(callCost);
+
+    return model.Save(outFile, &log) ? 0 : 1;
+}
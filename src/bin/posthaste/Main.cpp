@@ -9,9 +9,12 @@
 #include "slo/SloOutputFile.h"
 #include "slo/SloShader.h"
 #include "util/UtLog.h"
+#include "xf/XfCostModel.h"
 #include "xf/XfInstrument.h"
 #include "xf/XfLower.h"
+#include "xf/XfProfile.h"
 #include "xf/XfRaise.h"
+#include "xf/XfResolveSpaces.h"
 #include <llvm/Bitcode/ReaderWriter.h>
 #include <llvm/LLVMContext.h>
 #include <llvm/Module.h>
@@ -29,8 +32,25 @@
 struct Options {
     std::string mAppName;
     std::string mInput;
+    std::string mCostFile;
+    std::string mProfileFile;
     bool mInstrument;
+    bool mFastMath;
+    bool mBatchTextures;
+    bool mGridDerivs;
+    bool mWholeShader;
+    bool mDirectOps;
+    bool mVectorTypes;
+    bool mResolveSpaces;
+    bool mSSAVars;
+    bool mSchedule;
+    bool mDistributeLoops;
+    bool mUniformPartitions;
+    bool mParamInits;
+    bool mHoistUniforms;
+    bool mStrideLoops;
     int mMinPartitionSize;
+    int mBatchSize;
     unsigned int mOptimizationLevel;
     bool mShowPartitions;
     bool mQuiet;
@@ -38,7 +58,22 @@ struct Options {
     Options() :
         mAppName("sloraise"),
         mInstrument(false),
-        mMinPartitionSize(30),
+        mFastMath(false),
+        mBatchTextures(false),
+        mGridDerivs(false),
+        mWholeShader(false),
+        mDirectOps(false),
+        mVectorTypes(false),
+        mResolveSpaces(false),
+        mSSAVars(false),
+        mSchedule(false),
+        mDistributeLoops(false),
+        mUniformPartitions(true),
+        mParamInits(true),
+        mHoistUniforms(true),
+        mStrideLoops(true),
+        mMinPartitionSize(1),
+        mBatchSize(1),
         mOptimizationLevel(2),
         mShowPartitions(false),
         mQuiet(false)
@@ -52,10 +87,36 @@ Usage(const Options& options, UtLog* log)
     fprintf(stderr, "Usage: %s [options] infile.slo\n"
             "Options:\n"
             "  -h, --help       Print usage\n"
+            "  --batch N        Points per kernel loop iteration (1, 4, 8, 16)\n"
+            "  --batch-textures Compile texture lookups, batched for the grid\n"
+            "  --costs FILE     Load cost model estimates (see phcalibrate)\n"
+            "  --direct-ops     Lower simple instructions directly to LLVM\n"
+            "  --distribute     Split partially compilable loops\n"
+            "  --fast-math      Use faster, less accurate transcendentals\n"
+            "  --grid-derivs    Compile derivatives, applied to the grid\n"
+            "  --instrument     Wrap partitions in timer calls for profiling\n"
             "  --min N          Min. number of IR instructions in partition\n"
+            "  --no-hoist-uniforms\n"
+            "                   Load uniform kernel args for every point\n"
+            "  --no-param-inits Don't compile parameter initializers\n"
+            "  --no-stride-loops\n"
+            "                   Don't specialize loops for strided args\n"
+            "  --no-uniform-partitions\n"
+            "                   Don't compile uniform code outside control\n"
+            "                   flow\n"
             "  -O<N>            Optimization level (0 to 2)\n"
+            "  --profile-use=F  Compile partitions based on profile timings\n"
+            "  --resolve-spaces Compile transforms to named spaces\n"
+            "  --schedule       Reorder code to form larger partitions\n"
             "  --show           Show IR for partitions\n"
-            "  -q, --quiet      Silence most output messages\n",
+            "  --ssa-vars       Keep kernel locals in registers\n"
+            "  --vector-types   Use LLVM vectors for triples and matrices\n"
+            "  --whole-shader   Compile a compilable shader as one kernel\n"
+            "  -q, --quiet      Silence most output messages\n"
+            "Partitioning options (--batch-textures, --distribute,\n"
+            "--grid-derivs, --no-param-inits, --no-uniform-partitions,\n"
+            "--resolve-spaces and --schedule) must match for --instrument\n"
+            "and --profile-use.\n",
             options.mAppName.c_str());
 }
 
@@ -68,9 +129,26 @@ ParseOptions(Options& options, int argc, const char** argv, UtLog* log)
     // represented by individual characters.
     enum LongOption {
         kOptNone = 256,
+        kBatchSize,
+        kBatchTextures,
+        kCostFile,
+        kDirectOps,
+        kDistributeLoops,
+        kFastMath,
+        kGridDerivs,
         kInstrument,
         kMinPartitionSize,
+        kNoHoistUniforms,
+        kNoParamInits,
+        kNoStrideLoops,
+        kNoUniformPartitions,
+        kProfileUse,
+        kResolveSpaces,
+        kSchedule,
         kShowPartitions,
+        kSSAVars,
+        kVectorTypes,
+        kWholeShader,
     };
 
     // Short options.
@@ -78,9 +156,26 @@ ParseOptions(Options& options, int argc, const char** argv, UtLog* log)
 
     static struct option longOptions[] = {
         { "help", no_argument, NULL, 'h' },
+        { "batch", required_argument, NULL, kBatchSize },
+        { "batch-textures", no_argument, NULL, kBatchTextures },
+        { "costs", required_argument, NULL, kCostFile },
+        { "direct-ops", no_argument, NULL, kDirectOps },
+        { "distribute", no_argument, NULL, kDistributeLoops },
+        { "fast-math", no_argument, NULL, kFastMath },
+        { "grid-derivs", no_argument, NULL, kGridDerivs },
         { "instrument", no_argument, NULL, kInstrument },
         { "min", required_argument, NULL, kMinPartitionSize },
+        { "no-hoist-uniforms", no_argument, NULL, kNoHoistUniforms },
+        { "no-param-inits", no_argument, NULL, kNoParamInits },
+        { "no-stride-loops", no_argument, NULL, kNoStrideLoops },
+        { "no-uniform-partitions", no_argument, NULL, kNoUniformPartitions },
+        { "profile-use", required_argument, NULL, kProfileUse },
+        { "resolve-spaces", no_argument, NULL, kResolveSpaces },
+        { "schedule", no_argument, NULL, kSchedule },
         { "show", no_argument, NULL, kShowPartitions },
+        { "ssa-vars", no_argument, NULL, kSSAVars },
+        { "vector-types", no_argument, NULL, kVectorTypes },
+        { "whole-shader", no_argument, NULL, kWholeShader },
         { NULL, 0, NULL, 0}
     };
 
@@ -99,15 +194,70 @@ ParseOptions(Options& options, int argc, const char** argv, UtLog* log)
           case 'q':
               options.mQuiet = true;
               break;
+          case kBatchSize:
+              options.mBatchSize = atoi(optarg);
+              if (!CgOptions::IsValidBatchSize(options.mBatchSize)) {
+                  log->Write(kUtError, "Unsupported batch size: %s", optarg);
+                  error = true;
+              }
+              break;
+          case kCostFile:
+              options.mCostFile = optarg;
+              break;
+          case kFastMath:
+              options.mFastMath = true;
+              break;
+          case kBatchTextures:
+              options.mBatchTextures = true;
+              break;
+          case kDirectOps:
+              options.mDirectOps = true;
+              break;
+          case kDistributeLoops:
+              options.mDistributeLoops = true;
+              break;
+          case kGridDerivs:
+              options.mGridDerivs = true;
+              break;
           case kInstrument:
               options.mInstrument = true;
               break;
           case kMinPartitionSize:
               options.mMinPartitionSize = atoi(optarg);
               break;
+          case kNoHoistUniforms:
+              options.mHoistUniforms = false;
+              break;
+          case kNoParamInits:
+              options.mParamInits = false;
+              break;
+          case kNoStrideLoops:
+              options.mStrideLoops = false;
+              break;
+          case kNoUniformPartitions:
+              options.mUniformPartitions = false;
+              break;
+          case kProfileUse:
+              options.mProfileFile = optarg;
+              break;
+          case kResolveSpaces:
+              options.mResolveSpaces = true;
+              break;
+          case kSchedule:
+              options.mSchedule = true;
+              break;
           case kShowPartitions:
               options.mShowPartitions = true;
               break;
+          case kSSAVars:
+              options.mSSAVars = true;
+              break;
+          case kVectorTypes:
+              options.mVectorTypes = true;
+              break;
+          case kWholeShader:
+              options.mWholeShader = true;
+              break;
           default:
               error = true;
               break;
@@ -145,20 +295,65 @@ main(int argc, const char** argv)
     if (status > 0)
         return status;
 
+    // Load the cost model estimates, if specified.  Otherwise the defaults
+    // are used.
+    XfCostModel costModel;
+    if (!options.mCostFile.empty() && 
+        !costModel.Load(options.mCostFile.c_str(), &log))
+        return 1;
+
+    // Load the partition timings from an instrumented render, if specified.
+    XfProfile profile;
+    if (!options.mProfileFile.empty() &&
+        !profile.Load(options.mProfileFile.c_str(), &log))
+        return 1;
+
     // Raise SLO to IR.
     IRShader* ir = XfRaise(slo, &log);
 
+    // Resolve named coordinate systems to matrices computed once per grid, so
+    // that transforms can be compiled.  This precedes instrumentation, so the
+    // partition identifiers match.
+    if (options.mResolveSpaces)
+        XfResolveSpaces(ir);
+
+    // The partitioning options are shared by instrumentation and codegen, so
+    // the partition identifiers match (see --profile-use).
+    XfPartitionOptions partOptions;
+    partOptions.mAllowUniform = options.mUniformPartitions;
+    partOptions.mParamInits = options.mParamInits;
+    partOptions.mAllowDerivs = options.mGridDerivs;
+    partOptions.mAllowTextures = options.mBatchTextures;
+    partOptions.mSchedule = options.mSchedule;
+    partOptions.mDistribute = options.mDistributeLoops;
+
     // If we're instrumenting, partition the shader and wrap partitions with
-    // timer calls.
+    // timer calls.  All candidate partitions are instrumented (the cost model
+    // is not consulted), and they're partitioned as they are for codegen, so
+    // the timings can be used later (see --profile-use).
     if (options.mInstrument)
-        XfInstrument(ir, &log, options.mMinPartitionSize);
+        XfInstrument(ir, &log, options.mMinPartitionSize, NULL, partOptions);
 
     // Compile parts of shader to LLVM, updating IR with plugin calls.
     llvm::Module* module = NULL;
     if (!options.mInstrument) {
         llvm::LLVMContext context;
-        module = CgShaderCodegen(ir, &log, &context, options.mMinPartitionSize, 
-                                 options.mShowPartitions);
+        CgOptions cgOptions;
+        cgOptions.mMinPartitionSize = options.mMinPartitionSize;
+        cgOptions.mCostModel = &costModel;
+        if (!options.mProfileFile.empty())
+            cgOptions.mProfile = &profile;
+        cgOptions.mDumpIR = options.mShowPartitions;
+        cgOptions.mBatchSize = options.mBatchSize;
+        cgOptions.mPartition = partOptions;
+        cgOptions.mHoistUniforms = options.mHoistUniforms;
+        cgOptions.mSpecializeStrides = options.mStrideLoops;
+        cgOptions.mWholeShader = options.mWholeShader;
+        cgOptions.mDirectOps = options.mDirectOps;
+        cgOptions.mVectorTypes = options.mVectorTypes;
+        cgOptions.mSSAVars = options.mSSAVars;
+        cgOptions.mFastMath = options.mFastMath;
+        module = CgShaderCodegen(ir, &log, &context, cgOptions);
         status = (module == NULL);
         if (status > 0) {
             delete ir;
@@ -16,7 +16,8 @@
 
 // Create the the master state that shared by all codegen components.
 CgComponent
-CgComponent::Create(UtLog* log, llvm::LLVMContext* context)
+CgComponent::Create(UtLog* log, llvm::LLVMContext* context,
+                    const CgOptions& options)
 {
     // We seem to get leaks when we use a new LLVMContext,
     // so for now we use the global one.
@@ -25,11 +26,11 @@ CgComponent::Create(UtLog* log, llvm::LLVMContext* context)
     cg.mContext = context;
     cg.mModule = CgDeserializeShadeops(cg.mContext);
     cg.mBuilder = new CgBuilder(*cg.mContext);
-    cg.mTypes = new CgTypes(cg);
+    cg.mTypes = new CgTypes(cg, options.mVectorTypes);
     cg.mConsts = new CgConst(cg);
     cg.mVars = new CgVars(cg);
     cg.mValues = new CgValue(cg);
-    cg.mInsts = new CgInst(cg);
+    cg.mInsts = new CgInst(cg, options);
     cg.mStmts = new CgStmt(cg);
     return cg;
 }
@@ -65,9 +66,11 @@ CgComponent::InitForTest()
     mBuilder->SetInsertPoint(block);
 }
 
-// Generate an "alloca" instruction with the specified type.
+// Generate an "alloca" instruction with the specified type, optionally
+// initializing it in the function entry block.
 llvm::Value*
-CgComponent::GenAlloca(llvm::Type* type, const llvm::Twine& name) const
+CgComponent::GenAlloca(llvm::Type* type, const llvm::Twine& name,
+                       llvm::Constant* init) const
 {
     // Temporarily set the builder insertion point in the function
     // entry block.
@@ -80,12 +83,95 @@ CgComponent::GenAlloca(llvm::Type* type, const llvm::Twine& name) const
     // Generate the alloca instruction.  Prefix the variable name with
     // an underscore so LLVM doesn't quote it.
     llvm::Value* inst = mBuilder->CreateAlloca(type, 0, name);
+    if (init)
+        mBuilder->CreateStore(init, inst);
 
     // Restore the builder insertion point and return the instruction.
     mBuilder->SetInsertPoint(oldInsertBlock, oldInsertPoint);
     return inst;
 }
 
+/*
+   Generate a loop from i = 0 to N-1 as follows:
+
+        br label %loop_test
+     loop_test:
+        %index = phi i32 [ 0, %entry ], [ %next, %loop_body ]
+        %less = icmp slt i32 %index, %N
+        br i1 %less, label %loop_body, label %done
+     loop_body:
+        %next = add i32 %index, 1
+        br label %loop_test
+     done:
+
+   The loop_body block is returned, along with the loop index (as a result
+   parameter), allowing the caller to add code to the body.
+*/
+llvm::BasicBlock*
+CgComponent::GenLoop(llvm::Value* loopBound, llvm::Value** loopIndex) const
+{
+    // Keep track of the current block for use by the phi note.
+    llvm::BasicBlock* predBlock = mBuilder->GetInsertBlock();
+    llvm::Function* function = predBlock->getParent();
+
+    // Create the basic blocks.
+    llvm::BasicBlock* testBlock = llvm::BasicBlock::Create(*mContext, "test");
+    llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*mContext, "body");
+    llvm::BasicBlock* doneBlock = llvm::BasicBlock::Create(*mContext, "done");
+
+    // Add the test block and generate a jump to it.
+    function->getBasicBlockList().push_back(testBlock);
+    mBuilder->CreateBr(testBlock);
+
+    // Generate the loop test:
+    //    %index = phi i32 [ 0, %entry ], [ %next, %loop_body ]
+    //    %less = icmp slt i32 %index, %N
+    mBuilder->SetInsertPoint(testBlock);
+    llvm::PHINode* indexPhi =
+        mBuilder->CreatePHI(llvm::Type::getInt32Ty(*mContext), 2, "index");
+    indexPhi->addIncoming(GetInt(0), predBlock);
+    llvm::Value* lessThan = 
+        mBuilder->CreateICmp(llvm::CmpInst::ICMP_SLT, indexPhi, loopBound);
+
+    // Generate conditional branch: 
+    //    br i1 %less, label %loop_body, label %done
+    mBuilder->CreateCondBr(lessThan, bodyBlock, doneBlock);
+
+    // Generate the loop body:
+    //    %next = add i32 %index, 1
+    //    br label %loop_test
+    function->getBasicBlockList().push_back(bodyBlock);
+    mBuilder->SetInsertPoint(bodyBlock);
+    llvm::Value* next = mBuilder->CreateAdd(indexPhi, GetInt(1));
+    mBuilder->CreateBr(testBlock);
+
+    // Update the phi node with [%next, %loop_body]
+    indexPhi->addIncoming(next, bodyBlock);
+
+    // Statements following the loop will be generated in the "done" block.
+    function->getBasicBlockList().push_back(doneBlock);
+    mBuilder->SetInsertPoint(doneBlock);
+
+    // Return the loop body and the loop index.
+    *loopIndex = indexPhi;
+    return bodyBlock;
+}
+
+// Prepare to generate arbitrary code (including nested loops) in the body of
+// a loop generated by GenLoop.  The loop increment is split into a new
+// block, which is returned, and the builder is positioned at the end of the
+// (now unterminated) body block.  The caller must generate a branch to the
+// returned block after the body is complete.
+llvm::BasicBlock*
+CgComponent::OpenLoopBody(llvm::BasicBlock* bodyBlock) const
+{
+    // Splitting the block updates the phi node in the loop test.
+    llvm::BasicBlock* nextBlock = 
+        bodyBlock->splitBasicBlock(bodyBlock->begin(), "next");
+    bodyBlock->getTerminator()->eraseFromParent();
+    mBuilder->SetInsertPoint(bodyBlock);
+    return nextBlock;
+}
 
 // Get an integer constant (32-bit, signed).
 llvm::Constant* 
@@ -6,6 +6,7 @@
 #define CG_COMPONENT_H
 
 #include "cg/CgFwd.h"
+#include "cg/CgOptions.h"
 #include "cg/CgTypedefs.h"
 #include <map>
 class CgConst;
@@ -21,7 +22,9 @@ class UtLog;
 class CgComponent {
 public:
     /// Create the the master state that shared by all codegen components.
-    static CgComponent Create(UtLog* log, llvm::LLVMContext* context);
+    /// The options determine how instructions are lowered (see CgInst).
+    static CgComponent Create(UtLog* log, llvm::LLVMContext* context,
+                              const CgOptions& options=CgOptions());
 
     /// Destroy the master state.
     void Destroy();
@@ -45,9 +48,24 @@ public:
     /// Get the variable codegen component (required to set up test bindings)
     CgVars* GetVars() const { return mVars; }
 
-    /// Generate an "alloca" instruction with the specified type.
+    /// Generate an "alloca" instruction with the specified type.  If an
+    /// initial value is given, it is stored in the function entry block.
     llvm::Value* GenAlloca(llvm::Type* type,
-                           const llvm::Twine& name) const;
+                           const llvm::Twine& name,
+                           llvm::Constant* init=NULL) const;
+
+    /// Generate a loop from 0 to N-1.  The loop body is returned, along with
+    /// the loop index (as a result parameter).  Code can be added to the
+    /// start of the body; the builder insertion point is left in the block
+    /// following the loop.
+    llvm::BasicBlock* GenLoop(llvm::Value* loopBound,
+                              llvm::Value** loopIndex) const;
+
+    /// Prepare to generate arbitrary code (including nested loops) in the
+    /// body of a loop generated by GenLoop, positioning the builder at the
+    /// end of the body.  The caller must generate a branch to the returned
+    /// block (which increments the loop index) when the body is complete.
+    llvm::BasicBlock* OpenLoopBody(llvm::BasicBlock* bodyBlock) const;
 
     /// Get an integer constant (32-bit, signed).
     llvm::Constant* GetInt(int i) const;
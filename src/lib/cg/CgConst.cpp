@@ -31,7 +31,8 @@ CgConst::Convert(const IRConst* constant) const
 
 /// Convert numeric constant data
 llvm::Constant* 
-CgConst::ConvertNumData(const float* data, const IRType* ty) const
+CgConst::ConvertNumData(const float* data, const IRType* ty,
+                        bool isExternal) const
 {
     // Float constant?
     if (ty->IsFloat()) {
@@ -39,6 +40,10 @@ CgConst::ConvertNumData(const float* data, const IRType* ty) const
         return llvm::ConstantFP::get(floatTy, data[0]);
     }
 
+    // Triple or matrix represented as an LLVM vector?
+    if (!isExternal && mTypes->HasVectorType(ty))
+        return MakeVectorConst(data, ty);
+
     // Triple?
     if (ty->IsTriple()) 
         return MakeVector(data, 3);
@@ -82,6 +87,21 @@ CgConst::MakeVector(const float* data, unsigned int length) const
     return llvm::ConstantStruct::get(vecTy, llvm::ArrayRef<llvm::Constant*>(members));
 }
 
+// Make a triple or matrix constant that is represented as an LLVM vector.
+// The padding element of a triple is zero.
+llvm::Constant*
+CgConst::MakeVectorConst(const float* data, const IRType* ty) const
+{
+    unsigned int size = ty->IsTriple() ? 3 : 16;
+    llvm::VectorType* vecTy =
+        llvm::cast<llvm::VectorType>(mTypes->Convert(ty));
+    std::vector<llvm::Constant*> elements(vecTy->getNumElements(),
+                                          MakeFloat(0.0f));
+    for (unsigned int i = 0; i < size; ++i)
+        elements[i] = MakeFloat(data[i]);
+    return llvm::ConstantVector::get(elements);
+}
+
 // Make a matrix constant, which is a struct containing an array of 4-vectors.
 // Note: this must agree with the definition of OpMatrix4.
 llvm::Constant*
@@ -116,16 +136,16 @@ CgConst::ConvertNumArray(const IRNumArrayConst* array) const
            "Array constant length mismatch");
     unsigned int stride = elemTy->GetSize();
 
-    // Convert the elements
+    // Convert the elements, which have external types.
     std::vector<llvm::Constant*> elements(length);
     for (unsigned int i = 0; i < length; ++i) {
-        elements[i] = ConvertNumData(data, elemTy);
+        elements[i] = ConvertNumData(data, elemTy, true /*isExternal*/);
         data += stride;
     }
 
     // Construct array type and construct an LLVM array constant.
     llvm::ArrayType* llvmTy = 
-        llvm::ArrayType::get(mTypes->Convert(elemTy), length);
+        llvm::ArrayType::get(mTypes->ConvertExternal(elemTy), length);
     return llvm::ConstantArray::get(llvmTy, elements);
 }
 
@@ -27,8 +27,11 @@ public:
     llvm::Constant* Convert(const IRConst* constant) const;
 
 protected:
-    /// Convert numeric constant data
-    llvm::Constant* ConvertNumData(const float* data, const IRType* ty) const;
+    /// Convert numeric constant data.  Triples and matrices are represented
+    /// as LLVM vectors if enabled (see CgTypes), unless an external constant
+    /// is requested.
+    llvm::Constant* ConvertNumData(const float* data, const IRType* ty,
+                                   bool isExternal=false) const;
 
     /// Make a float constant.
     llvm::Constant* MakeFloat(float f) const;
@@ -40,6 +43,11 @@ protected:
     /// Make a vector constant, which is a struct containing a float array.
     llvm::Constant* MakeVector(const float* data, unsigned int length) const;
 
+    /// Make a triple or matrix constant that is represented as an LLVM
+    /// vector.
+    llvm::Constant* MakeVectorConst(const float* data,
+                                    const IRType* ty) const;
+
     /// Make a matrix constant, which is a struct containing an array of
     /// 4-vectors.
     llvm::Constant* MakeMatrix(const float* data) const;
@@ -10,10 +10,12 @@
 #include "ir/IRArrayType.h"
 #include "ir/IRInst.h"
 #include "ir/IRTypedefs.h"
+#include "ir/IRTypes.h"
 #include "ir/IRVar.h"
 #include "util/UtCast.h"
 #include "util/UtLog.h"
 #include <llvm/Instructions.h>
+#include <llvm/Intrinsics.h>
 #include <llvm/Module.h>
 #include <llvm/Support/IRBuilder.h>
 #include <llvm/Support/raw_ostream.h>
@@ -53,6 +55,39 @@ MangledType(const IRType* ty)
     return "";
 }
 
+// Check whether the ith argument of a shadeop is a resizable array whose
+// length the shadeop might change, in which case it's passed as a pointer to
+// its descriptor, followed by the arena (see Ops.cpp).  The result is
+// indicated by a negative index.  Other resizable arrays are passed like
+// fixed-length arrays.
+static bool
+IsPassedByDescriptor(Opcode opcode, const IRType* ty, int i)
+{
+    if (!CgTypes::IsResizable(ty))
+        return false;
+    switch (opcode) {
+      case kOpcode_Pop:
+      case kOpcode_Push:
+      case kOpcode_Reserve:
+      case kOpcode_Resize:
+          return i == 0;
+      default:
+          return i < 0;
+    }
+}
+
+// Get the mangled type of the ith argument of a shadeop (or the result, if
+// the index is negative).  An array that's passed by descriptor is mangled
+// as "R" followed by its element type (e.g. OpPush_Rff).
+static std::string
+MangledArgType(Opcode opcode, const IRType* ty, int i)
+{
+    if (!IsPassedByDescriptor(opcode, ty, i))
+        return MangledType(ty);
+    const IRArrayType* arrayTy = UtStaticCast<const IRArrayType*>(ty);
+    return std::string("R") + MangledType(arrayTy->GetElementType());
+}
+
 // Given the name of an overloaded shadeop, mangle it to include argument type
 // specifiers (e.g. OpAdd_ft).
 void
@@ -62,28 +97,71 @@ CgInst::MangleArgTypes(Opcode opcode, std::stringstream& opName,
     opName << "_";
     if (OpInfo::IsOverloadedByResult(opcode)) {
         assert(result != NULL && "Expected result in shadeop mangling");
-        opName << MangledType(result->GetType());
+        opName << MangledArgType(opcode, result->GetType(), -1);
     }
-    IRValues::const_iterator it;
-    for (it = args.begin(); it != args.end(); ++it)
-        opName << MangledType((*it)->GetType());
+    for (size_t i = 0; i < args.size(); ++i)
+        opName << MangledArgType(opcode, args[i]->GetType(), int(i));
+}
+
+// Check whether the shadeop call for an instruction requires the per-call
+// arena, i.e. whether it computes a string, caches a compiled regex, or
+// might change the length of a resizable array.
+bool
+CgInst::NeedsArena(const IRInst* inst)
+{
+    Opcode opcode = inst->GetOpcode();
+    if (opcode == kOpcode_Concat || opcode == kOpcode_Format ||
+        opcode == kOpcode_Match)
+        return true;
+    const IRVar* result = inst->GetResult();
+    if (result && IsPassedByDescriptor(opcode, result->GetType(), -1))
+        return true;
+    const IRValues& args = inst->GetArgs();
+    for (size_t i = 0; i < args.size(); ++i)
+        if (IsPassedByDescriptor(opcode, args[i]->GetType(), int(i)))
+            return true;
+    return false;
 }
 
 bool
 CgInst::GenInst(const IRInst& inst) const
 {
-    // Check whether a shadeop is defined for this opcode.
+    // Simple instructions can be lowered directly to LLVM instructions.
+    if (mDirectOps && GenDirect(inst))
+        return true;
+
+    // Check whether a shadeop is defined for this opcode, preferring the
+    // fast variant if fast math is enabled.
     Opcode opcode = inst.GetOpcode();
-    const char* opNamePtr = OpInfo::GetOpName(opcode);
+    const char* opNamePtr = mFastMath ? OpInfo::GetFastOpName(opcode) : NULL;
+    if (opNamePtr == NULL)
+        opNamePtr = OpInfo::GetOpName(opcode);
     if (opNamePtr == NULL)
         return false;
+
+    // The control points of a spline are variadic.  Unless they're given as
+    // an array, they must be packed into one (see GenSpline).
+    const IRValues& args = inst.GetArgs();
+    if (opcode == kOpcode_Spline && !args.empty() &&
+        UtCast<const IRArrayType*>(args.back()->GetType()) == NULL)
+        return GenSpline(opNamePtr, inst);
+
+    // Similarly for the strings to concatenate and the values to format.
+    if (opcode == kOpcode_Concat || opcode == kOpcode_Format)
+        return GenStringOp(opNamePtr, inst);
+
+    // The match shadeop yields a float.
+    const IRVar* result = inst.GetResult();
+    if (opcode == kOpcode_Match && (!result || !result->GetType()->IsFloat()))
+        return false;
+
     std::stringstream opName;
     opName << opNamePtr;
 
     // If the shadeop is overloaded, mangle the name to include argument type
     // specifiers (e.g. OpAdd_ft).  
     if (OpInfo::IsOverloaded(opcode))
-        MangleArgTypes(opcode, opName, inst.GetResult(), inst.GetArgs());
+        MangleArgTypes(opcode, opName, inst.GetResult(), args);
     std::string opNameStr = opName.str();
 
     // Look up the shadeop in the LLVM module.  The caller reports an error if
@@ -129,10 +207,17 @@ CgInst::GenOpCall(llvm::Function* op, const IRInst& inst) const
     // argument.  Note that shadeops can't easily be implemented as C
     // functions that return structs by value, since struct return conventions
     // differ between 32 and 64 bit platforms.
+    Opcode opcode = inst.GetOpcode();
     IRVar* result = inst.GetResult();
-    if (result) {
-        llvm::Value* resultLoc = 
-            mValues->ConvertArrayPtr(mVars->GetLocation(result));
+    if (result && IsPassedByDescriptor(opcode, result->GetType(), -1)) {
+        assert(mVars->GetArena() && "Expected arena for resizable array");
+        argVals.push_back(mVars->GetLocation(result));
+        argVals.push_back(mVars->GetArena());
+    }
+    else if (result) {
+        llvm::Value* resultLoc = mValues->ConvertExternalPtr(
+            mValues->ConvertArrayPtr(mVars->GetLocation(result)),
+            result->GetType());
         argVals.push_back(resultLoc);
         // Pass the array length too if necessary.
         if (const IRArrayType* arrayTy =
@@ -140,12 +225,37 @@ CgInst::GenOpCall(llvm::Function* op, const IRInst& inst) const
             argVals.push_back(GetInt(arrayTy->GetLength()));
     }
 
+    // Match caches its compiled pattern in the arena (see OpMatch).
+    if (opcode == kOpcode_Match) {
+        assert(mVars->GetArena() && "Expected arena for match");
+        argVals.push_back(mVars->GetArena());
+    }
+
     // Convert the arguments to LLVM values.  Any non-scalar values are
-    // converted to locations.
+    // converted to locations, as are output arguments.  Resizable arrays
+    // are passed by descriptor if their length might change; otherwise
+    // their elements and length are loaded from the descriptor.
+    bool hasOutput = OpInfo::HasOutput(opcode);
     IRValues::const_iterator it;
-    for (it = args.begin(); it != args.end(); ++it) {
+    int i = 0;
+    for (it = args.begin(); it != args.end(); ++it, ++i) {
         IRValue* arg = *it;
-        argVals.push_back(mValues->ConvertArg(arg));
+        IRVar* var = UtCast<IRVar*>(arg);
+        if (var && IsPassedByDescriptor(opcode, var->GetType(), i)) {
+            assert(mVars->GetArena() && "Expected arena for resizable array");
+            argVals.push_back(mVars->GetLocation(var));
+            argVals.push_back(mVars->GetArena());
+            continue;
+        }
+        if (var && CgTypes::IsResizable(var->GetType())) {
+            GenDynArrayArgs(var, &argVals);
+            continue;
+        }
+        if (var && hasOutput && OpInfo::IsOutput(opcode, i) &&
+            !CgTypes::IsPassByRef(var->GetType()))
+            argVals.push_back(mVars->GetLocation(var));
+        else
+            argVals.push_back(mValues->ConvertArg(arg));
 
         // Pass the array length too if necessary.
         if (const IRArrayType* arrayTy =
@@ -157,3 +267,614 @@ CgInst::GenOpCall(llvm::Function* op, const IRInst& inst) const
     SanityCheckArgs(op->getArgumentList(), argVals);
     mBuilder->CreateCall(op, argVals);
 }
+
+// Pass the elements and length of a resizable array variable, which are
+// loaded from its descriptor (see OpDynArray).  The element pointer is cast
+// to the external element type.
+void
+CgInst::GenDynArrayArgs(const IRVar* var,
+                        std::vector<llvm::Value*>* argVals) const
+{
+    const IRArrayType* arrayTy = 
+        UtStaticCast<const IRArrayType*>(var->GetType());
+    llvm::Type* elemPtrTy = llvm::PointerType::getUnqual(
+        mTypes->ConvertExternal(arrayTy->GetElementType()));
+    llvm::Value* desc = mVars->GetLocation(var);
+    llvm::Value* data = 
+        mBuilder->CreateLoad(mBuilder->CreateStructGEP(desc, 0), "data");
+    argVals->push_back(mBuilder->CreateBitCast(data, elemPtrTy));
+    argVals->push_back(
+        mBuilder->CreateLoad(mBuilder->CreateStructGEP(desc, 1), "length"));
+}
+
+// Generate a call to a spline shadeop whose control points are given
+// individually.  The shadeops take an array of control points (e.g.
+// OpSpline_sfT), so the control points are stored in a temporary array.
+bool
+CgInst::GenSpline(const char* opName, const IRInst& inst) const
+{
+    const IRValues& args = inst.GetArgs();
+    const IRVar* result = inst.GetResult();
+    assert(result && args.size() >= 2 && "Invalid spline instruction");
+    const IRType* pointTy = result->GetType();
+    bool isTriple = pointTy->IsTriple();
+    unsigned int first = args[0]->GetType()->IsString() ? 2 : 1;
+    unsigned int numPoints = args.size() - first;
+
+    // Look up the shadeop, which is mangled as if the control points were an
+    // array.
+    std::stringstream mangled;
+    mangled << opName << "_" << (first == 2 ? "s" : "") << "f"
+            << (isTriple ? "T" : "F");
+    llvm::Function* op = mModule->getFunction(mangled.str());
+    if (op == NULL)
+        return false;
+
+    // Store the control points in a temporary array.  Triples are passed by
+    // reference, so they must be loaded first.
+    llvm::Type* pointsTy =
+        llvm::ArrayType::get(mTypes->ConvertExternal(pointTy), numPoints);
+    llvm::Value* points =
+        mValues->ConvertArrayPtr(GenAlloca(pointsTy, "points"));
+    for (unsigned int i = 0; i < numPoints; ++i) {
+        const IRValue* arg = args[first + i];
+        assert(arg->GetType()->IsTriple() == isTriple &&
+               "Spline control point type mismatch");
+        llvm::Value* value = mValues->ConvertArg(arg);
+        if (isTriple)
+            value = mBuilder->CreateLoad(value);
+        mBuilder->CreateStore(value,
+                              mBuilder->CreateConstInBoundsGEP1_32(points, i));
+    }
+
+    // Pass the result location, the basis (if any) and the parameter value,
+    // followed by the control points and their number.
+    std::vector<llvm::Value*> argVals;
+    argVals.push_back(mValues->ConvertExternalPtr(mVars->GetLocation(result),
+                                                  pointTy));
+    for (unsigned int i = 0; i < first; ++i)
+        argVals.push_back(mValues->ConvertArg(args[i]));
+    argVals.push_back(points);
+    argVals.push_back(GetInt(numPoints));
+    SanityCheckArgs(op->getArgumentList(), argVals);
+    mBuilder->CreateCall(op, argVals);
+    return true;
+}
+
+// Generate a call to a string shadeop whose arguments are variadic, namely
+// concat and format.  The strings to concatenate (or the values to format)
+// are stored in a temporary array.  Values to format are passed by
+// reference, along with a string of their mangled types (see
+// OpStringFormat).  Returns false if any argument is an array, or a value
+// that can't be formatted, leaving the instruction to the interpreter.
+bool
+CgInst::GenStringOp(const char* opName, const IRInst& inst) const
+{
+    const IRValues& args = inst.GetArgs();
+    const IRVar* result = inst.GetResult();
+    assert(result && result->GetType()->IsString() &&
+           "Invalid string instruction");
+    bool isFormat = inst.GetOpcode() == kOpcode_Format;
+    unsigned int first = isFormat ? 1 : 0;
+    if (args.size() < first || (isFormat && !args[0]->GetType()->IsString()))
+        return false;
+    unsigned int numValues = args.size() - first;
+
+    // Check the argument types, recording them for format.
+    std::string types;
+    for (unsigned int i = first; i < args.size(); ++i) {
+        const IRType* ty = args[i]->GetType();
+        bool isValid = ty->IsString() ||
+            (isFormat && (ty->IsFloat() || ty->IsTriple() || ty->IsMatrix()));
+        if (!isValid)
+            return false;
+        types += MangledType(ty);
+    }
+    llvm::Function* op = mModule->getFunction(opName);
+    if (op == NULL)
+        return false;
+
+    // Store the strings or value pointers in a temporary array, whose
+    // element type is given by the shadeop's next-to-last parameter.
+    // Scalar values to format are stored in temporaries.
+    llvm::FunctionType* opTy = op->getFunctionType();
+    llvm::Type* elemTy = llvm::cast<llvm::PointerType>(
+        opTy->getParamType(opTy->getNumParams() - 2))->getElementType();
+    llvm::Value* values = mValues->ConvertArrayPtr(
+        GenAlloca(llvm::ArrayType::get(elemTy, numValues), "values"));
+    for (unsigned int i = 0; i < numValues; ++i) {
+        const IRValue* arg = args[first + i];
+        llvm::Value* value = mValues->ConvertArg(arg);
+        if (isFormat) {
+            if (!CgTypes::IsPassByRef(arg->GetType())) {
+                llvm::Value* temp = GenAlloca(value->getType(), "value");
+                mBuilder->CreateStore(value, temp);
+                value = temp;
+            }
+            value = mBuilder->CreateBitCast(value, elemTy);
+        }
+        mBuilder->CreateStore(value,
+                              mBuilder->CreateConstInBoundsGEP1_32(values, i));
+    }
+
+    // Pass the result location and the arena, followed by the format string
+    // and value types (if any), the array, and its length.
+    assert(mVars->GetArena() && "Expected arena for string shadeop");
+    std::vector<llvm::Value*> argVals;
+    argVals.push_back(mValues->ConvertExternalPtr(mVars->GetLocation(result),
+                                                  result->GetType()));
+    argVals.push_back(mVars->GetArena());
+    if (isFormat) {
+        argVals.push_back(mValues->ConvertArg(args[0]));
+        argVals.push_back(mBuilder->CreateGlobalStringPtr(types.c_str(),
+                                                          "types"));
+    }
+    argVals.push_back(values);
+    argVals.push_back(GetInt(numValues));
+    SanityCheckArgs(op->getArgumentList(), argVals);
+    mBuilder->CreateCall(op, argVals);
+    return true;
+}
+
+// ---------- Direct lowering ----------
+
+// Kinds of instructions that are lowered directly to LLVM instructions.
+// Unless noted otherwise, the operation is applied to each component of
+// triple arguments, and float arguments are broadcast to triples.  The
+// semantics match the shadeops in Ops.cpp.
+enum CgLoweringKind {
+    kLowerBinary,       // Arithmetic operator (mArg is the LLVM opcode).
+    kLowerDivide,       // Division, yielding the dividend if the divisor is 0.
+    kLowerNegate,       // Negation.
+    kLowerAbs,          // Absolute value.
+    kLowerSqrt,         // Square root, yielding zero if negative.
+    kLowerSign,         // Sign (-1, 0, or 1).
+    kLowerStep,         // step(min, value).
+    kLowerMin,          // Minimum of two or more arguments.
+    kLowerMax,          // Maximum of two or more arguments.
+    kLowerClamp,        // clamp(value, min, max).
+    kLowerMix,          // mix(a, b, t).
+    kLowerAssign,       // Assignment.
+    kLowerCompare,      // Comparison (mArg is the LLVM predicate).
+    kLowerLogical,      // Bool and/or (mArg is the LLVM opcode).
+    kLowerDot,          // Dot product of triples.
+    kLowerGetComp,      // Get a triple component (mArg is the index).
+    kLowerSetComp,      // Set a triple component in place (mArg is the index).
+    kLowerTriple        // Construct a triple from three floats.
+};
+
+// An entry in the direct lowering table.
+struct CgLowering {
+    Opcode mOpcode;
+    CgLoweringKind mKind;
+    int mArg;
+};
+
+// Instructions that are lowered directly.
+static const CgLowering kLowerings[] = {
+    { kOpcode_Abs, kLowerAbs, 0 },
+    { kOpcode_Add, kLowerBinary, llvm::Instruction::FAdd },
+    { kOpcode_And, kLowerLogical, llvm::Instruction::And },
+    { kOpcode_Assign, kLowerAssign, 0 },
+    { kOpcode_Clamp, kLowerClamp, 0 },
+    { kOpcode_Color, kLowerTriple, 0 },
+    { kOpcode_Divide, kLowerDivide, 0 },
+    { kOpcode_Dot, kLowerDot, 0 },
+    { kOpcode_EQ, kLowerCompare, llvm::CmpInst::FCMP_OEQ },
+    { kOpcode_GE, kLowerCompare, llvm::CmpInst::FCMP_OGE },
+    { kOpcode_GT, kLowerCompare, llvm::CmpInst::FCMP_OGT },
+    { kOpcode_LE, kLowerCompare, llvm::CmpInst::FCMP_OLE },
+    { kOpcode_LT, kLowerCompare, llvm::CmpInst::FCMP_OLT },
+    { kOpcode_Max, kLowerMax, 0 },
+    { kOpcode_Min, kLowerMin, 0 },
+    { kOpcode_Mix, kLowerMix, 0 },
+    { kOpcode_Multiply, kLowerBinary, llvm::Instruction::FMul },
+    { kOpcode_NE, kLowerCompare, llvm::CmpInst::FCMP_UNE },
+    { kOpcode_Negate, kLowerNegate, 0 },
+    { kOpcode_Or, kLowerLogical, llvm::Instruction::Or },
+    { kOpcode_Point, kLowerTriple, 0 },
+    { kOpcode_SetXComp, kLowerSetComp, 0 },
+    { kOpcode_SetYComp, kLowerSetComp, 1 },
+    { kOpcode_SetZComp, kLowerSetComp, 2 },
+    { kOpcode_Sign, kLowerSign, 0 },
+    { kOpcode_Sqrt, kLowerSqrt, 0 },
+    { kOpcode_Step, kLowerStep, 0 },
+    { kOpcode_Subtract, kLowerBinary, llvm::Instruction::FSub },
+    { kOpcode_XComp, kLowerGetComp, 0 },
+    { kOpcode_YComp, kLowerGetComp, 1 },
+    { kOpcode_ZComp, kLowerGetComp, 2 },
+};
+
+// Find the direct lowering for the given opcode, if any.
+static const CgLowering*
+FindLowering(Opcode opcode)
+{
+    size_t numLowerings = sizeof(kLowerings) / sizeof(CgLowering);
+    for (size_t i = 0; i < numLowerings; ++i)
+        if (kLowerings[i].mOpcode == opcode)
+            return &kLowerings[i];
+    return NULL;
+}
+
+// Get the number of components of a float or triple (zero for other types).
+static int
+NumComponents(const IRType* ty)
+{
+    if (ty->IsFloat())
+        return 1;
+    return ty->IsTriple() ? 3 : 0;
+}
+
+// Get the number of arguments taken by a kind of direct lowering.  Min and
+// max are variadic (taking at least two arguments), which is indicated by
+// zero.
+static size_t
+GetLoweringArity(CgLoweringKind kind)
+{
+    switch (kind) {
+      case kLowerNegate:
+      case kLowerAbs:
+      case kLowerSqrt:
+      case kLowerSign:
+      case kLowerAssign:
+      case kLowerGetComp:
+          return 1;
+      case kLowerMin:
+      case kLowerMax:
+          return 0;
+      case kLowerClamp:
+      case kLowerMix:
+      case kLowerTriple:
+          return 3;
+      default:
+          return 2;
+    }
+}
+
+// Check whether the argument and result types of an instruction are
+// supported by the given lowering, and determine the number of components
+// it operates on.  Returns zero if the instruction can't be lowered.
+static int
+GetLoweringWidth(const CgLowering& lowering, const IRInst& inst)
+{
+    const IRValues& args = inst.GetArgs();
+    const IRVar* result = inst.GetResult();
+    size_t arity = GetLoweringArity(lowering.mKind);
+    if (arity == 0 ? args.size() < 2 : args.size() != arity)
+        return 0;
+
+    // Bool operations take bool arguments and yield a bool.
+    if (lowering.mKind == kLowerLogical) {
+        if (args.size() != 2 || !result || !result->GetType()->IsBool())
+            return 0;
+        for (size_t i = 0; i < args.size(); ++i)
+            if (!args[i]->GetType()->IsBool())
+                return 0;
+        return 1;
+    }
+
+    // Otherwise all arguments must be floats or triples.  The width is the
+    // maximum number of components.
+    int width = 1;
+    for (size_t i = 0; i < args.size(); ++i) {
+        int numComps = NumComponents(args[i]->GetType());
+        if (numComps == 0)
+            return 0;
+        width = std::max(width, numComps);
+    }
+    switch (lowering.mKind) {
+      case kLowerCompare:
+          return (result && result->GetType()->IsBool()) ? width : 0;
+      case kLowerDot:
+          return (args.size() == 2 && result && result->GetType()->IsFloat())
+              ? 3 : 0;
+      case kLowerGetComp:
+          return (args.size() == 1 && args[0]->GetType()->IsTriple() &&
+                  result && result->GetType()->IsFloat()) ? 3 : 0;
+      case kLowerSetComp:
+          return (args.size() == 2 && args[0]->GetType()->IsTriple() &&
+                  args[0]->IsVar() &&
+                  args[1]->GetType()->IsFloat() && !result) ? 1 : 0;
+      case kLowerTriple:
+          return (args.size() == 3 && width == 1 &&
+                  result && result->GetType()->IsTriple()) ? 3 : 0;
+      default:
+          // The result determines the width (e.g. float arguments are
+          // broadcast to a triple result), and no argument can be wider.
+          if (!result)
+              return 0;
+          int resultWidth = NumComponents(result->GetType());
+          return resultWidth >= width ? resultWidth : 0;
+    }
+}
+
+// Check whether a kind of direct lowering applies an operation to each
+// component independently.
+static bool
+IsElementwise(CgLoweringKind kind)
+{
+    switch (kind) {
+      case kLowerCompare:
+      case kLowerLogical:
+      case kLowerDot:
+      case kLowerGetComp:
+      case kLowerSetComp:
+      case kLowerTriple:
+          return false;
+      default:
+          return true;
+    }
+}
+
+// Generate LLVM instructions for a simple instruction (e.g. arithmetic on
+// floats and triples), rather than a shadeop call.  Returns false if the
+// instruction can't be lowered directly.
+bool
+CgInst::GenDirect(const IRInst& inst) const
+{
+    const CgLowering* lowering = FindLowering(inst.GetOpcode());
+    if (lowering == NULL)
+        return false;
+    int width = GetLoweringWidth(*lowering, inst);
+    if (width == 0)
+        return false;
+
+    // If triples are represented as LLVM vectors, elementwise operations
+    // are applied to all the components at once.
+    const IRValues& args = inst.GetArgs();
+    const IRVar* result = inst.GetResult();
+    std::vector<llvm::Value*> resultComps;
+    if (width == 3 && result && mTypes->HasVectorType(result->GetType()) &&
+        IsElementwise(lowering->mKind)) {
+        std::vector<llvm::Value*> vecArgs(args.size());
+        for (size_t i = 0; i < args.size(); ++i)
+            vecArgs[i] = GetVector(args[i]);
+        resultComps.push_back(GenComponent(*lowering, vecArgs));
+        StoreResult(result, resultComps);
+        return true;
+    }
+
+    // Get the components of the arguments, broadcasting floats if necessary.
+    // Bool arguments are converted to bits.
+    std::vector<std::vector<llvm::Value*> > argComps(args.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i]->GetType()->IsBool())
+            argComps[i].push_back(
+                mValues->BoolToBit(mValues->ConvertVal(args[i])));
+        else if (lowering->mKind != kLowerSetComp || i > 0)
+            GetComponents(args[i], width, &argComps[i]);
+    }
+
+    switch (lowering->mKind) {
+      case kLowerCompare:
+          resultComps.push_back(GenCompare(*lowering, argComps[0],
+                                           argComps[1]));
+          break;
+      case kLowerDot: {
+          llvm::Value* sum = NULL;
+          for (int i = 0; i < 3; ++i) {
+              llvm::Value* product =
+                  mBuilder->CreateFMul(argComps[0][i], argComps[1][i]);
+              sum = sum ? mBuilder->CreateFAdd(sum, product) : product;
+          }
+          resultComps.push_back(sum);
+          break;
+      }
+      case kLowerGetComp:
+          resultComps.push_back(argComps[0][lowering->mArg]);
+          break;
+      case kLowerSetComp: {
+          // Update the component of the triple variable.
+          const IRVar* var = UtStaticCast<const IRVar*>(args[0]);
+          llvm::Value* triple = SetComponent(mVars->GetValue(var),
+                                             lowering->mArg, argComps[1][0]);
+          mVars->SetValue(var, triple);
+          return true;
+      }
+      case kLowerTriple:
+          for (int i = 0; i < 3; ++i)
+              resultComps.push_back(argComps[i][0]);
+          break;
+      default: {
+          // Apply the operation to each component.
+          std::vector<llvm::Value*> compArgs(args.size());
+          for (int i = 0; i < width; ++i) {
+              for (size_t j = 0; j < args.size(); ++j)
+                  compArgs[j] = argComps[j].size() == 1 ?
+                      argComps[j][0] : argComps[j][i];
+              resultComps.push_back(GenComponent(*lowering, compArgs));
+          }
+          break;
+      }
+    }
+    StoreResult(result, resultComps);
+    return true;
+}
+
+// Get a float or triple value as an LLVM vector, broadcasting a float to
+// every element.  Used only if triples are represented as LLVM vectors.
+llvm::Value*
+CgInst::GetVector(const IRValue* value) const
+{
+    llvm::Value* val = mValues->ConvertVal(value);
+    if (value->GetType()->IsTriple())
+        return val;
+    llvm::VectorType* vecTy = llvm::cast<llvm::VectorType>(
+        mTypes->Convert(IRTypes::GetVectorTy()));
+    llvm::Value* vec = mBuilder->CreateInsertElement(
+        llvm::UndefValue::get(vecTy), val, GetInt(0));
+    llvm::Type* maskTy = llvm::VectorType::get(
+        llvm::Type::getInt32Ty(*mContext), vecTy->getNumElements());
+    return mBuilder->CreateShuffleVector(
+        vec, llvm::UndefValue::get(vecTy),
+        llvm::ConstantAggregateZero::get(maskTy));
+}
+
+// Get the ith component of a triple, which is either a struct containing an
+// array of three floats (see OpVec3) or an LLVM vector.
+llvm::Value*
+CgInst::GetComponent(llvm::Value* triple, unsigned int i) const
+{
+    if (triple->getType()->isVectorTy())
+        return mBuilder->CreateExtractElement(triple, GetInt(i));
+    unsigned int indices[] = { 0, i };
+    return mBuilder->CreateExtractValue(triple, indices);
+}
+
+// Set the ith component of a triple, returning the updated triple.
+llvm::Value*
+CgInst::SetComponent(llvm::Value* triple, unsigned int i,
+                     llvm::Value* comp) const
+{
+    if (triple->getType()->isVectorTy())
+        return mBuilder->CreateInsertElement(triple, comp, GetInt(i));
+    unsigned int indices[] = { 0, i };
+    return mBuilder->CreateInsertValue(triple, comp, indices);
+}
+
+// Get the components of a float or triple value, which is broadcast if
+// necessary to the specified number of components.
+void
+CgInst::GetComponents(const IRValue* value, int numComps,
+                      std::vector<llvm::Value*>* comps) const
+{
+    llvm::Value* val = mValues->ConvertVal(value);
+    if (!value->GetType()->IsTriple()) {
+        comps->assign(numComps, val);
+        return;
+    }
+    for (unsigned int i = 0; i < 3; ++i)
+        comps->push_back(GetComponent(val, i));
+}
+
+// Generate code for one component of a directly lowered instruction, or for
+// all the components if the arguments are LLVM vectors.
+llvm::Value*
+CgInst::GenComponent(const CgLowering& lowering,
+                     const std::vector<llvm::Value*>& args) const
+{
+    // Constants are splatted if the arguments are vectors.
+    llvm::Type* floatTy = args[0]->getType();
+    llvm::Value* zero = llvm::ConstantFP::get(floatTy, 0.0);
+    llvm::Value* one = llvm::ConstantFP::get(floatTy, 1.0);
+    switch (lowering.mKind) {
+      case kLowerBinary:
+          return mBuilder->CreateBinOp(
+              static_cast<llvm::Instruction::BinaryOps>(lowering.mArg),
+              args[0], args[1]);
+      case kLowerDivide: {
+          // Division by zero yields the dividend.
+          llvm::Value* isZero = mBuilder->CreateFCmpOEQ(args[1], zero);
+          return mBuilder->CreateSelect(
+              isZero, args[0], mBuilder->CreateFDiv(args[0], args[1]));
+      }
+      case kLowerNegate:
+          return mBuilder->CreateFNeg(args[0]);
+      case kLowerAbs: {
+          // Clear the sign bit, which vectorizes readily.
+          llvm::Type* intTy = llvm::Type::getInt32Ty(*mContext);
+          if (llvm::VectorType* vecTy = 
+              llvm::dyn_cast<llvm::VectorType>(floatTy))
+              intTy = llvm::VectorType::getInteger(vecTy);
+          llvm::Value* bits = mBuilder->CreateBitCast(args[0], intTy);
+          bits = mBuilder->CreateAnd(bits, 0x7fffffff);
+          return mBuilder->CreateBitCast(bits, floatTy);
+      }
+      case kLowerSqrt: {
+          llvm::Function* sqrtFunc =
+              llvm::Intrinsic::getDeclaration(mModule, llvm::Intrinsic::sqrt,
+                                              floatTy);
+          llvm::Value* isNeg = mBuilder->CreateFCmpOLT(args[0], zero);
+          return mBuilder->CreateSelect(
+              isNeg, zero, mBuilder->CreateCall(sqrtFunc, args[0]));
+      }
+      case kLowerSign: {
+          llvm::Value* minusOne = llvm::ConstantFP::get(floatTy, -1.0);
+          llvm::Value* isNeg = mBuilder->CreateFCmpOLT(args[0], zero);
+          llvm::Value* isPos = mBuilder->CreateFCmpOGT(args[0], zero);
+          return mBuilder->CreateSelect(
+              isNeg, minusOne, mBuilder->CreateSelect(isPos, one, zero));
+      }
+      case kLowerStep: {
+          llvm::Value* isBelow = mBuilder->CreateFCmpOLT(args[1], args[0]);
+          return mBuilder->CreateSelect(isBelow, zero, one);
+      }
+      case kLowerMin:
+      case kLowerMax: {
+          // Min and max are variadic, so fold the arguments from the left.
+          llvm::Value* r = args[0];
+          for (size_t i = 1; i < args.size(); ++i) {
+              llvm::Value* isFirst = lowering.mKind == kLowerMin ?
+                  mBuilder->CreateFCmpOLT(r, args[i]) :
+                  mBuilder->CreateFCmpOGT(r, args[i]);
+              r = mBuilder->CreateSelect(isFirst, r, args[i]);
+          }
+          return r;
+      }
+      case kLowerClamp: {
+          llvm::Value* isAbove = mBuilder->CreateFCmpOGT(args[0], args[2]);
+          llvm::Value* isBelow = mBuilder->CreateFCmpOLT(args[0], args[1]);
+          return mBuilder->CreateSelect(
+              isBelow, args[1],
+              mBuilder->CreateSelect(isAbove, args[2], args[0]));
+      }
+      case kLowerMix: {
+          // a * (1-t) + b * t
+          llvm::Value* a = mBuilder->CreateFMul(
+              args[0], mBuilder->CreateFSub(one, args[2]));
+          llvm::Value* b = mBuilder->CreateFMul(args[1], args[2]);
+          return mBuilder->CreateFAdd(a, b);
+      }
+      case kLowerAssign:
+          return args[0];
+      case kLowerLogical:
+          return mBuilder->CreateBinOp(
+              static_cast<llvm::Instruction::BinaryOps>(lowering.mArg),
+              args[0], args[1]);
+      default:
+          assert(false && "Unexpected kind of direct lowering");
+          return NULL;
+    }
+}
+
+// Generate a comparison, combining the component results of triples: all
+// components must be equal for equality, and any component may differ for
+// inequality.
+llvm::Value*
+CgInst::GenCompare(const CgLowering& lowering,
+                   const std::vector<llvm::Value*>& a,
+                   const std::vector<llvm::Value*>& b) const
+{
+    llvm::CmpInst::Predicate pred =
+        static_cast<llvm::CmpInst::Predicate>(lowering.mArg);
+    llvm::Value* result = NULL;
+    for (size_t i = 0; i < a.size(); ++i) {
+        llvm::Value* cmp = mBuilder->CreateFCmp(pred, a[i], b[i]);
+        if (result == NULL)
+            result = cmp;
+        else if (pred == llvm::CmpInst::FCMP_UNE)
+            result = mBuilder->CreateOr(result, cmp);
+        else
+            result = mBuilder->CreateAnd(result, cmp);
+    }
+    return result;
+}
+
+// Store the components of a float, bool, or triple result.  Bools are
+// represented as bits and converted to integers.  A triple that is
+// represented as an LLVM vector might be stored as a single value.
+void
+CgInst::StoreResult(const IRVar* result,
+                    const std::vector<llvm::Value*>& comps) const
+{
+    const IRType* ty = result->GetType();
+    llvm::Value* value = comps[0];
+    if (ty->IsBool())
+        value = mBuilder->CreateZExt(value, llvm::Type::getInt32Ty(*mContext));
+    else if (ty->IsTriple() && comps.size() == 3) {
+        value = llvm::UndefValue::get(mTypes->Convert(ty));
+        for (unsigned int i = 0; i < 3; ++i)
+            value = SetComponent(value, i, comps[i]);
+    }
+    mVars->SetValue(result, value);
+}
@@ -11,15 +11,21 @@
 #include "ir/IRTypedefs.h"
 #include "ops/OpInfo.h"
 #include <iosfwd>
+#include <vector>
 class IRInst;
+class IRValue;
 class UtLog;
+struct CgLowering;
 
 /// Code generation for IR instructions.
 class CgInst : public CgComponent {
 public:
-    /// Constructor
-    CgInst(const CgComponent& state) :
-        CgComponent(state)
+    /// Constructor.  The options determine whether fast shadeops are used
+    /// and whether simple instructions are lowered directly.
+    CgInst(const CgComponent& state, const CgOptions& options=CgOptions()) :
+        CgComponent(state),
+        mFastMath(options.mFastMath),
+        mDirectOps(options.mDirectOps)
     {
     }
 
@@ -28,15 +34,77 @@ public:
     bool GenInst(const IRInst& inst) const;
 
     /// Generate a shadeop call after converting the given arguments to LLVM
-    /// values.
+    /// values.  Output arguments are passed by reference.
     void GenOpCall(llvm::Function* op, const IRInst& inst) const;
 
+    /// Generate a call to a spline shadeop whose control points are given
+    /// individually rather than as an array.  Returns false if there's no
+    /// shadeop for the types of the control points.
+    bool GenSpline(const char* opName, const IRInst& inst) const;
+
+    /// Generate a call to a string shadeop with variadic arguments (concat
+    /// or format).  Returns false if the arguments can't be passed to the
+    /// shadeop (e.g. arrays).
+    bool GenStringOp(const char* opName, const IRInst& inst) const;
+
     /// Given the name of an overloaded shadeop, mangle it to include argument
     /// type specifiers (e.g. OpAdd_FT).  The result type is also included if
     /// the instruction has a result but the shadeop is void, indicating that
     /// takes a result parameter
     void MangleArgTypes(Opcode opcode, std::stringstream& opName,
                         const IRVar* result, const IRValues& args) const;
+
+    /// Check whether the shadeop call for an instruction requires the
+    /// per-call arena, i.e. whether it computes a string (see OpString.h),
+    /// caches a compiled regex (see OpStringMatchCached), or might change
+    /// the length of a resizable array (see OpDynArray).
+    static bool NeedsArena(const IRInst* inst);
+
+    /// Generate LLVM instructions for a simple instruction (e.g. arithmetic
+    /// on floats and triples), rather than a shadeop call.  Returns false if
+    /// the instruction can't be lowered directly.
+    bool GenDirect(const IRInst& inst) const;
+
+private:
+    /// Use faster but less accurate shadeops where available.
+    bool mFastMath;
+
+    /// Lower simple instructions directly (see GenDirect).
+    bool mDirectOps;
+
+    /// Pass the elements and length of a resizable array variable, which are
+    /// loaded from its descriptor.
+    void GenDynArrayArgs(const IRVar* var,
+                         std::vector<llvm::Value*>* argVals) const;
+
+    /// Get a float or triple value as an LLVM vector, broadcasting a float.
+    llvm::Value* GetVector(const IRValue* value) const;
+
+    /// Get the ith component of a triple (a struct or an LLVM vector).
+    llvm::Value* GetComponent(llvm::Value* triple, unsigned int i) const;
+
+    /// Set the ith component of a triple, returning the updated triple.
+    llvm::Value* SetComponent(llvm::Value* triple, unsigned int i,
+                              llvm::Value* comp) const;
+
+    /// Get the components of a float or triple value, which is broadcast if
+    /// necessary to the specified number of components.
+    void GetComponents(const IRValue* value, int numComps,
+                       std::vector<llvm::Value*>* comps) const;
+
+    /// Generate code for one component of a directly lowered instruction, or
+    /// for all the components if the arguments are LLVM vectors.
+    llvm::Value* GenComponent(const CgLowering& lowering,
+                              const std::vector<llvm::Value*>& args) const;
+
+    /// Generate a comparison, combining the component results of triples.
+    llvm::Value* GenCompare(const CgLowering& lowering,
+                            const std::vector<llvm::Value*>& a,
+                            const std::vector<llvm::Value*>& b) const;
+
+    /// Store the components of a float, bool, or triple result.
+    void StoreResult(const IRVar* result,
+                     const std::vector<llvm::Value*>& comps) const;
 };
 
 #endif /// ndef CG_INST_H
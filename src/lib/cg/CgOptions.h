@@ -0,0 +1,113 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CG_OPTIONS_H
+#define CG_OPTIONS_H
+
+#include "xf/XfPartitionOptions.h"
+#include <stddef.h>
+class XfCostModel;
+class XfProfile;
+
+/// Shader code generation options.  The defaults reproduce the simplest
+/// form of code generation, which is what the unit tests expect; the
+/// command-line driver selects more aggressive settings.
+struct CgOptions {
+    /// Partitions with fewer IR instructions are not compiled.
+    int mMinPartitionSize;
+
+    /// If not NULL, partitions are compiled only if the cost model predicts
+    /// a benefit (in addition to the minimum partition size).
+    const XfCostModel* mCostModel;
+
+    /// If not NULL, partitions are compiled only if their measured timings
+    /// predict a benefit (see XfProfile), rather than the cost model's
+    /// static estimates.  Partitions that weren't profiled are not compiled.
+    /// Requires a cost model.
+    const XfProfile* mProfile;
+
+    /// Print the IR for each compiled partition.
+    bool mDumpIR;
+
+    /// Number of points processed per iteration of the plugin entry loop
+    /// (1, 4, 8, or 16).  When greater than one, the varying arguments of
+    /// straight-line kernels are gathered into per-argument lane buffers
+    /// and the kernel is applied to each lane in a fixed-length loop, which
+    /// LLVM can unroll and vectorize.  A scalar loop handles the remainder.
+    int mBatchSize;
+
+    /// Load uniform arguments once, before the plugin entry loop, rather
+    /// than iterating over them.  Uniform scalars that the kernel does not
+    /// modify are passed by value, and other unmodified uniform arguments
+    /// are passed as pointers to hoisted copies.
+    bool mHoistUniforms;
+
+    /// Generate plugin entry functions with specialized kernel loops for
+    /// contiguous and constant-stride arguments, selected at runtime by
+    /// inspecting the argument iterators.  The generic loop, which follows
+    /// the increment lists, is used otherwise.  (Batched entry functions are
+    /// not specialized.)
+    bool mSpecializeStrides;
+
+    /// Partitioning options, which determine what kinds of instructions
+    /// are compiled (e.g. uniform instructions, derivatives and texture
+    /// lookups) and whether parameter initializers are compiled.  They must
+    /// match the ones used for instrumentation (see XfInstrument).
+    XfPartitionOptions mPartition;
+
+    /// If the whole shader body is a partition (and the parameter
+    /// initializers are partitions or empty), compile the body as a single
+    /// kernel regardless of its estimated cost, and remove the local
+    /// variables that are no longer needed (see CgWholeShader).
+    bool mWholeShader;
+
+    /// Implement transcendental instructions (sin, exp, pow, etc.) with
+    /// faster but less accurate shadeops (see OpMath.h for error bounds).
+    bool mFastMath;
+
+    /// Lower simple instructions (arithmetic, comparisons, component access,
+    /// min/max/clamp/mix, etc.) directly to LLVM instructions, rather than
+    /// calls to shadeops that must be inlined (see CgInst::GenDirect).
+    bool mDirectOps;
+
+    /// Represent triples and matrices within kernels as LLVM vectors
+    /// (<4 x float> and <16 x float>) rather than structs, so LLVM can keep
+    /// them in SIMD registers.  They are converted to and from the shadeop
+    /// representation (OpVec3, OpMatrix4) only at the kernel boundary.
+    bool mVectorTypes;
+
+    /// Keep the local variables of kernels in SSA registers rather than
+    /// allocas, generating phi nodes where control flow merges (see
+    /// CgVars), and pass unmodified varying scalars to kernels by value.
+    /// Lane kernels, the phase kernels of grid partitions (see
+    /// CgShader::GenGridEntry), and kernels containing break, continue, or
+    /// return statements still use allocas.
+    bool mSSAVars;
+
+    /// Construct default options.
+    CgOptions() :
+        mMinPartitionSize(1),
+        mCostModel(NULL),
+        mProfile(NULL),
+        mDumpIR(false),
+        mBatchSize(1),
+        mHoistUniforms(false),
+        mSpecializeStrides(false),
+        mWholeShader(false),
+        mFastMath(false),
+        mDirectOps(false),
+        mVectorTypes(false),
+        mSSAVars(false)
+    {
+    }
+
+    /// Check whether the given batch size is supported.
+    static bool IsValidBatchSize(int batchSize)
+    {
+        return batchSize == 1 || batchSize == 4 ||
+            batchSize == 8 || batchSize == 16;
+    }
+};
+
+#endif // ndef CG_OPTIONS_H
@@ -5,17 +5,29 @@
 #include "cg/CgShader.h"
 #include "cg/CgConst.h"
 #include "cg/CgDeserialize.h"
+#include "cg/CgInst.h"
 #include "cg/CgStmt.h"
 #include "cg/CgTypedefs.h"
 #include "cg/CgTypes.h"
 #include "cg/CgVars.h"
+#include "cg/CgWholeShader.h"
+#include "ir/IRArrayType.h"
+#include "ir/IRBlock.h"
+#include "ir/IRInst.h"
+#include "ir/IRNumConst.h"
 #include "ir/IRShader.h"
+#include "ir/IRShaderParam.h"
+#include "ir/IRStmts.h"
+#include "ir/IRStringConst.h"
 #include "ir/IRTypedefs.h"
 #include "ir/IRValues.h"
 #include "ir/IRVarSet.h"
+#include "xf/XfCostModel.h"
 #include "xf/XfFreeVars.h"
 #include "xf/XfPartition.h"
 #include "xf/XfPartitionInfo.h"
+#include "xf/XfProfile.h"
+#include "ops/OpInfo.h"
 #include "util/UtLog.h"
 #include <llvm/Analysis/Verifier.h>
 #include <llvm/BasicBlock.h>
@@ -27,6 +39,7 @@
 #include <llvm/Module.h>
 #include <llvm/Support/IRBuilder.h>
 #include <llvm/Transforms/Utils/Cloning.h>
+#include <map>
 #include <sstream>
 
 llvm::Module* 
@@ -35,17 +48,32 @@ CgShaderCodegen(IRShader* shader,
                 llvm::LLVMContext* context,
                 int minPartitionSize, bool dumpIR)
 {
-    return CgShader(log, context, minPartitionSize, dumpIR).Codegen(shader);
+    CgOptions options;
+    options.mMinPartitionSize = minPartitionSize;
+    options.mDumpIR = dumpIR;
+    return CgShader(log, context, options).Codegen(shader);
+}
+
+llvm::Module* 
+CgShaderCodegen(IRShader* shader, 
+                UtLog* log, 
+                llvm::LLVMContext* context,
+                const CgOptions& options)
+{
+    return CgShader(log, context, options).Codegen(shader);
 }
 
 // Constructor. 
 CgShader::CgShader(UtLog* log, llvm::LLVMContext* context,
-                   int minPartitionSize, bool dumpIR) :
-    CgComponent(CgComponent::Create(log, context)),
+                   const CgOptions& options) :
+    CgComponent(CgComponent::Create(log, context, options)),
     mCurrentFuncName(""),
-    mMinPartitionSize(minPartitionSize),
-    mDumpIR(dumpIR)
+    mOptions(options),
+    mNeedsArena(false),
+    mArena(NULL)
 {
+    assert(CgOptions::IsValidBatchSize(options.mBatchSize) &&
+           "Unsupported batch size");
 }
 
 // Destructor
@@ -57,6 +85,9 @@ CgShader::~CgShader()
     CgComponent::Destroy();
 }
 
+static bool IsUniform(const IRStmt* stmt);
+static bool HasResizableFreeVars(const IRStmt* stmt);
+
 /// Generate code for a shader, which must be partitioned (see XfPartition).
 /// The shader is modified in-place, replacing compiled partitions with plugin
 /// calls.  An LLVM module for the shader plugin is returned, which has an
@@ -68,21 +99,47 @@ CgShader::Codegen(IRShader* shader)
     // identifying partitions and determining their free variables.
     CodegenSetup(shader);
 
-    // Walk the shader body, compiling partitions and replacing them with
-    // plugin calls.  TODO: do the same for the shader parameter initializers.
-    shader->SetBody(Walk(shader->GetBody()));
+    // If the whole shader is compilable, compile the body as a single kernel.
+    // (A body consisting entirely of uniform instructions is left alone.)
+    // Otherwise walk the shader body, compiling partitions and replacing
+    // them with plugin calls.
+    IRStmt* body = shader->GetBody();
+    bool isWhole = mOptions.mWholeShader && CgWholeShader::CanCompile(shader)
+        && !(mOptions.mPartition.mAllowUniform && IsUniform(body))
+        && !HasResizableFreeVars(body);
+    if (isWhole)
+        shader->SetBody(CodegenPartition(body));
+    else
+        shader->SetBody(Walk(body));
+
+    // Optionally do the same for the shader parameter initializers.  Kernels
+    // are named after the parameter.
+    if (mOptions.mPartition.mParamInits) {
+        const IRShaderParams& params = shader->GetParams();
+        IRShaderParams::const_iterator it;
+        for (it = params.begin(); it != params.end(); ++it) {
+            IRShaderParam* param = *it;
+            mCurrentFuncName = param->GetFullName();
+            param->SetInitStmt(Walk(param->TakeInitStmt()));
+        }
+        mCurrentFuncName = shader->GetName();
+    }
+
+    // Remove the locals that were used only by the compiled body.
+    if (isWhole)
+        CgWholeShader::RemoveUnusedLocals(shader);
 
     // TODO: return NULL if no partitions had the requested minimum size.
     // (The destructor will delete the LLVM module.)
     if (mEntryFuncs.empty()) {
         mLog->Write(kUtWarning, "No kernels had %i or more shadeops.", 
-                    mMinPartitionSize);
+                    mOptions.mMinPartitionSize);
         // TODO: For now we simply print a warning
         // return NULL;
     }
 
     // Optionally dump the resulting IR.
-    if (mDumpIR)
+    if (mOptions.mDumpIR)
         std::cout << *shader;
 
     // Generate the plugin function table.
@@ -132,15 +189,289 @@ CgShader::CodegenSetup(IRShader* shader)
 
     // Partition the shader and use a liveness analysis to determine the free
     // variables of each partition.
-    XfPartition(shader);
+    XfPartition(shader, mOptions.mPartition);
+    if (mOptions.mPartition.mParamInits)
+        XfPartitionParamInits(shader, mOptions.mPartition);
     XfFreeVars(shader);
 
     // If a minimum partition size was specified, run partition info analysis
     // to determin partition sizes.
-    if (mMinPartitionSize > 1)
+    if (mOptions.mMinPartitionSize > 1)
         XfPartitionInfo(shader, false);
 }
 
+// Get the arguments of a partition with the given detail that it does not
+// modify.
+static void
+GetInputs(const IRStmt* stmt, const IRVars& args, IRDetail detail,
+          IRVarSet* inputs)
+{
+    IRVarSet assigned;
+    if (!CgStmt::GetAssignedVars(stmt, &assigned))
+        return;
+    IRVars::const_iterator it;
+    for (it = args.begin(); it != args.end(); ++it) {
+        IRVar* var = *it;
+        if (var->GetDetail() == detail && !assigned.Has(var))
+            *inputs += var;
+    }
+}
+
+// Remove the uniform instructions from a partition (see XfPartition), which
+// can only occur in blocks that are not nested in control flow.
+static void
+TakeUniformInsts(IRStmt* stmt, IRInsts* uniformInsts)
+{
+    if (IRBlock* block = UtCast<IRBlock*>(stmt)) {
+        IRInsts* insts = block->TakeInsts();
+        IRInsts* remaining = new IRInsts;
+        IRInsts::const_iterator it;
+        for (it = insts->begin(); it != insts->end(); ++it) {
+            if (XfIsUniformInst(*it))
+                uniformInsts->push_back(*it);
+            else
+                remaining->push_back(*it);
+        }
+        delete insts;
+        block->SetInsts(remaining);
+    }
+    else if (IRSeq* seq = UtCast<IRSeq*>(stmt)) {
+        IRStmts::iterator it;
+        for (it = seq->GetStmts().begin(); it != seq->GetStmts().end(); ++it)
+            TakeUniformInsts(*it, uniformInsts);
+    }
+}
+
+// Remove the uniform instructions from a partition, which are executed once
+// in the entry function (see GenHoistedInsts).  The variables they assign
+// that are referenced by the remaining code, other than the given arguments,
+// are returned as temporaries, and are appended to the kernel arguments.
+static void
+HoistUniformInsts(IRStmt* stmt, const IRVars& args, IRInsts* hoisted,
+                  IRVarSet* temps, IRVars* kernelArgs)
+{
+    TakeUniformInsts(stmt, hoisted);
+    if (hoisted->empty())
+        return;
+
+    // Get the variables assigned by the hoisted instructions.
+    IRVarSet assigned;
+    IRInsts::const_iterator it;
+    for (it = hoisted->begin(); it != hoisted->end(); ++it) {
+        const IRInst* inst = *it;
+        Opcode opcode = inst->GetOpcode();
+        if (inst->GetResult())
+            assigned += inst->GetResult();
+        if (OpInfo::HasOutput(opcode)) {
+            const IRValues& instArgs = inst->GetArgs();
+            for (size_t i = 0; i < instArgs.size(); ++i)
+                if (OpInfo::IsOutput(opcode, i))
+                    assigned += instArgs[i];
+        }
+    }
+    IRVarSet uses;
+    XfGetVaryingUses(stmt, &uses);
+    assigned.Intersect(uses);
+    IRVars::const_iterator arg;
+    for (arg = args.begin(); arg != args.end(); ++arg)
+        assigned -= *arg;
+
+    IRVars tempVars;
+    assigned.GetSorted(&tempVars);
+    *temps += tempVars;
+    kernelArgs->insert(kernelArgs->end(), tempVars.begin(), tempVars.end());
+}
+
+// Check whether a partition consists entirely of uniform instructions.
+static bool
+IsUniform(const IRStmt* stmt)
+{
+    if (const IRBlock* block = UtCast<const IRBlock*>(stmt)) {
+        const IRInsts& insts = block->GetInsts();
+        IRInsts::const_iterator it;
+        for (it = insts.begin(); it != insts.end(); ++it)
+            if (!XfIsUniformInst(*it))
+                return false;
+        return true;
+    }
+    else if (const IRSeq* seq = UtCast<const IRSeq*>(stmt)) {
+        IRStmts::const_iterator it;
+        for (it = seq->GetStmts().begin(); it != seq->GetStmts().end(); ++it)
+            if (!IsUniform(*it))
+                return false;
+        return true;
+    }
+    return false;
+}
+
+// Check whether a partition contains instructions that satisfy the given
+// predicate, which must imply XfIsGridInst.  Such instructions can only
+// occur in blocks that are not nested in control flow (see XfPartition).
+static bool
+HasGridInsts(const IRStmt* stmt, bool (*predicate)(const IRInst*))
+{
+    if (const IRBlock* block = UtCast<const IRBlock*>(stmt)) {
+        const IRInsts& insts = block->GetInsts();
+        IRInsts::const_iterator it;
+        for (it = insts.begin(); it != insts.end(); ++it)
+            if (predicate(*it))
+                return true;
+    }
+    else if (const IRSeq* seq = UtCast<const IRSeq*>(stmt)) {
+        IRStmts::const_iterator it;
+        for (it = seq->GetStmts().begin(); it != seq->GetStmts().end(); ++it)
+            if (HasGridInsts(*it, predicate))
+                return true;
+    }
+    return false;
+}
+
+// Get the initial value of a local variable of the entry function with the
+// given LLVM type, if any.  Resizable arrays are initially empty, which is
+// represented by a zeroed descriptor.
+static llvm::Constant*
+GetInitialValue(const IRVar* var, llvm::Type* ty)
+{
+    if (CgTypes::IsResizable(var->GetType()))
+        return llvm::Constant::getNullValue(ty);
+    return NULL;
+}
+
+// Check whether any free variable of a partition is an array with
+// unspecified length.  Resizable arrays (and array parameters with
+// unspecified length) are not passed to plugin functions, so such partitions
+// are interpreted.  Resizable arrays that are local to a partition are
+// compiled.
+static bool
+HasResizableFreeVars(const IRStmt* stmt)
+{
+    const IRVarSet* freeVars = stmt->GetFreeVars();
+    if (freeVars == NULL)
+        return false;
+    IRVars vars;
+    freeVars->GetSorted(&vars);
+    IRVars::const_iterator it;
+    for (it = vars.begin(); it != vars.end(); ++it)
+        if (CgTypes::IsResizable((*it)->GetType()))
+            return true;
+    return false;
+}
+
+// Check whether a partition contains instructions that require the per-call
+// arena (see CgInst::NeedsArena).  Returns true if the partition contains an
+// unsupported kind of statement.
+static bool
+NeedsArena(const IRStmt* stmt)
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock: {
+          const IRInsts& insts = UtStaticCast<const IRBlock*>(stmt)->GetInsts();
+          IRInsts::const_iterator it;
+          for (it = insts.begin(); it != insts.end(); ++it)
+              if (CgInst::NeedsArena(*it))
+                  return true;
+          return false;
+      }
+      case kIRSeq: {
+          const IRStmts& stmts = UtStaticCast<const IRSeq*>(stmt)->GetStmts();
+          IRStmts::const_iterator it;
+          for (it = stmts.begin(); it != stmts.end(); ++it)
+              if (NeedsArena(*it))
+                  return true;
+          return false;
+      }
+      case kIRIfStmt: {
+          const IRIfStmt* ifStmt = UtStaticCast<const IRIfStmt*>(stmt);
+          return NeedsArena(ifStmt->GetThen()) || NeedsArena(ifStmt->GetElse());
+      }
+      case kIRForLoop: {
+          const IRForLoop* loop = UtStaticCast<const IRForLoop*>(stmt);
+          return NeedsArena(loop->GetCondStmt()) ||
+              NeedsArena(loop->GetIterateStmt()) || NeedsArena(loop->GetBody());
+      }
+      case kIRCatchStmt: {
+          const IRCatchStmt* catchStmt = UtStaticCast<const IRCatchStmt*>(stmt);
+          return NeedsArena(catchStmt->GetBody());
+      }
+      case kIRControlStmt:
+          return false;
+      default:
+          return true;
+    }
+}
+
+typedef std::map<const IRStmt*, IRStmt*> StmtMap;
+
+// Copy a partition, which is executed by the interpreter if the plugin call
+// that replaces it can't be applied (see GenGridEntry).  The copy shares the
+// variables and constants of the original, and is not marked compilable.
+// Loops and catch statements are recorded in the given map, so that the
+// break, continue and return statements they enclose refer to the copies.
+static IRStmt*
+CopyStmt(const IRStmt* stmt, StmtMap* copies)
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock: {
+          const IRInsts& insts = UtStaticCast<const IRBlock*>(stmt)->GetInsts();
+          IRInsts* newInsts = new IRInsts;
+          IRInsts::const_iterator it;
+          for (it = insts.begin(); it != insts.end(); ++it) {
+              // Compilable instructions are basic instructions.
+              const IRInst* inst = UtStaticCast<const IRBasicInst*>(*it);
+              newInsts->push_back(
+                  new IRBasicInst(inst->GetOpcode(), inst->GetResult(),
+                                  inst->GetArgs(), inst->GetPos()));
+          }
+          return new IRBlock(newInsts);
+      }
+      case kIRSeq: {
+          const IRSeq* seq = UtStaticCast<const IRSeq*>(stmt);
+          IRStmts* newStmts = new IRStmts;
+          IRStmts::const_iterator it;
+          for (it = seq->GetStmts().begin(); it != seq->GetStmts().end(); ++it)
+              newStmts->push_back(CopyStmt(*it, copies));
+          return new IRSeq(newStmts, seq->GetFuncName(), seq->GetPos());
+      }
+      case kIRIfStmt: {
+          const IRIfStmt* ifStmt = UtStaticCast<const IRIfStmt*>(stmt);
+          return new IRIfStmt(ifStmt->GetCond(),
+                              CopyStmt(ifStmt->GetThen(), copies),
+                              CopyStmt(ifStmt->GetElse(), copies),
+                              ifStmt->GetPos());
+      }
+      case kIRForLoop: {
+          const IRForLoop* loop = UtStaticCast<const IRForLoop*>(stmt);
+          IRForLoop* newLoop = new IRForLoop(NULL, loop->GetCond(), NULL, NULL,
+                                             loop->GetPos());
+          (*copies)[loop] = newLoop;
+          newLoop->SetCondStmt(CopyStmt(loop->GetCondStmt(), copies));
+          newLoop->SetIterateStmt(CopyStmt(loop->GetIterateStmt(), copies));
+          newLoop->SetBody(CopyStmt(loop->GetBody(), copies));
+          return newLoop;
+      }
+      case kIRCatchStmt: {
+          const IRCatchStmt* catchStmt = UtStaticCast<const IRCatchStmt*>(stmt);
+          IRCatchStmt* newCatch = new IRCatchStmt(NULL, catchStmt->GetPos());
+          (*copies)[catchStmt] = newCatch;
+          newCatch->SetBody(CopyStmt(catchStmt->GetBody(), copies));
+          return newCatch;
+      }
+      case kIRControlStmt: {
+          const IRControlStmt* control =
+              UtStaticCast<const IRControlStmt*>(stmt);
+          StmtMap::const_iterator it =
+              copies->find(control->GetEnclosingStmt());
+          assert(it != copies->end() &&
+                 "Control statement escapes from partition");
+          return new IRControlStmt(control->GetOpcode(), it->second,
+                                   control->GetPos());
+      }
+      default:
+          assert(false && "Unexpected statement in partition");
+          return NULL;
+    }
+}
+
 // Compile a partition into an LLVM function, returing a plugin call.
 IRStmt* 
 CgShader::CodegenPartition(IRStmt* stmt)
@@ -157,11 +488,93 @@ CgShader::CodegenPartition(IRStmt* stmt)
     IRVars argVars;
     freeVars->GetSorted(&argVars);
 
-    // Generate the kernel function.
-    llvm::Function* kernelFunc = GenKernel(stmt, argVars);
+    // A partition containing derivatives or texture lookups is applied to
+    // the whole grid (see GenGridEntry).  Derivatives require the surface
+    // parameters of the points, so they're passed as additional arguments.
+    bool isGrid = HasGridInsts(stmt, XfIsGridInst);
+    bool hasDerivs = HasGridInsts(stmt, XfIsDerivInst);
+    if (hasDerivs) {
+        const IRType* floatTy = mTypeFactory->GetFloatTy();
+        IRVar* u = mShader->GetGlobalVar("u", floatTy, kIRVarying);
+        IRVar* v = mShader->GetGlobalVar("v", floatTy, kIRVarying);
+        if (!freeVars->Has(u))
+            argVars.push_back(u);
+        if (!freeVars->Has(v))
+            argVars.push_back(v);
+    }
+
+    // Grid instructions also require the grid topology, and texture lookups
+    // require a texture system, which might not be available at run time.
+    // If they aren't, the plugin call stores zero in an extra uniform
+    // argument (which isn't passed to the kernels), and a copy of the
+    // partition is interpreted instead.  The copy is made before uniform
+    // instructions are hoisted.
+    IRStmt* fallback = NULL;
+    IRVar* status = NULL;
+    IRVars kernelVars(argVars);
+    if (isGrid) {
+        StmtMap copies;
+        fallback = CopyStmt(stmt, &copies);
+        status = mShader->NewTempVar(mTypeFactory->GetFloatTy(), kIRUniform);
+        argVars.push_back(status);
+    }
 
-    // Generate the plugin entry function.
-    llvm::Function* entryFunc = GenEntry(kernelFunc, argVars);
+    // Remove any uniform instructions from the partition, since they're
+    // executed in the entry function.  Temporaries they assign that are
+    // referenced by the remaining code are passed as extra kernel arguments.
+    if (mOptions.mPartition.mAllowUniform)
+        HoistUniformInsts(stmt, argVars, &mHoistedInsts, &mHoistedTemps,
+                          &kernelVars);
+
+    // If uniform arguments are hoisted, determine which ones are inputs,
+    // i.e. not modified by the kernel.
+    mUniformInputs = IRVarSet();
+    if (IsHoisting())
+        GetInputs(stmt, kernelVars, kIRUniform, &mUniformInputs);
+
+    // If kernel locals are kept in registers, the varying inputs are also
+    // loaded by the kernel loop and passed by value (except in grid
+    // partitions, whose kernels access the grid data directly).
+    mVaryingInputs = IRVarSet();
+    if (mOptions.mSSAVars && !isGrid)
+        GetInputs(stmt, kernelVars, kIRVarying, &mVaryingInputs);
+
+    // The elements of resizable arrays are allocated from a per-call arena,
+    // which the entry function passes to the kernels as an extra argument.
+    mNeedsArena = NeedsArena(stmt);
+    for (size_t i = 0; i < mHoistedInsts.size() && !mNeedsArena; ++i)
+        mNeedsArena = CgInst::NeedsArena(mHoistedInsts[i]);
+
+    // Generate the kernel function and the plugin entry function.  A grid
+    // partition is compiled into several kernels,
+    // which the entry function applies to the whole grid in turn.
+    llvm::Function* entryFunc;
+    if (isGrid)
+        entryFunc = GenGridEntry(stmt, kernelVars, int(argVars.size()));
+    else {
+        llvm::Function* kernelFunc = GenKernel(stmt, kernelVars);
+
+        // If the points should be processed in batches, also generate a lane
+        // kernel, which processes a batch of points in each call.
+        int batchSize = ShouldBatch(stmt) ? mOptions.mBatchSize : 1;
+        llvm::Function* laneFunc = NULL;
+        mBatchInputs = IRVarSet();
+        if (batchSize > 1) {
+            mVars->Reset();
+            laneFunc = GenKernel(stmt, kernelVars, batchSize);
+            GetInputs(stmt, kernelVars, kIRVarying, &mBatchInputs);
+        }
+        entryFunc = GenEntry(kernelFunc, kernelVars, laneFunc, batchSize);
+    }
+
+    // Discard the hoisted instructions.
+    IRInsts::iterator inst;
+    for (inst = mHoistedInsts.begin(); inst != mHoistedInsts.end(); ++inst)
+        delete *inst;
+    mHoistedInsts.clear();
+    mHoistedTemps = IRVarSet();
+    mNeedsArena = false;
+    mArena = NULL;
     mEntryFuncs.push_back(entryFunc);
     const std::string& funcName = entryFunc->getNameStr();
 
@@ -171,30 +584,80 @@ CgShader::CodegenPartition(IRStmt* stmt)
     mEntryPrototypes.push_back(prototype);
         
     // Optionally dump the IR for the partition
-    if (mDumpIR) {
+    if (mOptions.mDumpIR) {
         std::cout << protoStr << "\n{\n" ;
         stmt->Write(std::cout, 4, true);
         std::cout << "}\n\n";
     }
 
-    // Delete the statement and return a plugin call to replace it.
+    // Delete the statement and return a plugin call to replace it, which
+    // is followed by the fallback, if any: "if (status == 0) fallback".
     IRPos pos = stmt->GetPos();
     delete stmt;
-    return GenPluginCall(funcName.c_str(), argVars, prototype, pos);
+    IRStmt* call = GenPluginCall(funcName.c_str(), argVars, prototype, pos);
+    if (fallback == NULL)
+        return call;
+    float zero = 0.0f;
+    IRValues args(1, status);
+    args.push_back(mShader->NewNumConst(&zero, mTypeFactory->GetFloatTy()));
+    IRVar* failed = mShader->NewTempVar(mTypeFactory->GetBoolTy(), kIRUniform);
+    IRStmts* stmts = new IRStmts;
+    stmts->push_back(call);
+    stmts->push_back(new IRBlock(
+        new IRInsts(1, new IRBasicInst(kOpcode_EQ, failed, args, pos))));
+    stmts->push_back(new IRIfStmt(failed, fallback, new IRSeq, pos));
+    return new IRSeq(stmts);
 }
 
-// Generate a kernel for the given partition.
+// Generate a kernel for the given partition.  If the number of lanes is
+// greater than one, a lane kernel is generated (see CgStmt::CodegenLanes).
+// The phase kernels of grid partitions are generated with isGridPhase set,
+// since they access the grid data directly (see GenGridEntry).
 llvm::Function*
-CgShader::GenKernel(IRStmt* stmt, const IRVars& argVars)
+CgShader::GenKernel(IRStmt* stmt, const IRVars& argVars, int numLanes,
+                    bool isGridPhase)
 {
     // Define a function that takes the free variables as its parameters.
     // Sets the insertion point of the IR builder in the function.
     // LLVM makes the function name unique if necessary.
     
-    llvm::Function* function = GenKernelFunc(mCurrentFuncName, argVars);
+    llvm::Function* function = 
+        GenKernelFunc(mCurrentFuncName, argVars, numLanes);
+
+    // Keep the local variables in registers if possible (see CgVars).  Lane
+    // kernels and grid phase kernels use allocas.
+    mVars->UseRegisters(mOptions.mSSAVars && numLanes == 1 && !isGridPhase &&
+                        CgStmt::IsStructured(stmt));
 
     // Generate code for the body of the shader and append a return.
-    mStmts->Codegen(stmt);
+    if (numLanes > 1)
+        mStmts->CodegenLanes(stmt, numLanes);
+    else
+        mStmts->Codegen(stmt);
+
+    // Copy the arguments that are represented as LLVM vectors back to their
+    // parameters, unless they're unmodified.
+    IRVarSet assigned;
+    bool assignsAny = !CgStmt::GetAssignedVars(stmt, &assigned);
+    for (size_t i = 0; i < mVectorArgs.size(); ++i)
+        if (assignsAny || assigned.Has(mVectorArgs[i].mVar))
+            GenCopyArg(mVectorArgs[i], numLanes, true /*toExternal*/);
+    mVectorArgs.clear();
+
+    // Strings interned in the per-call arena don't outlive the call, so any
+    // that are stored in modified arguments are replaced by permanent copies.
+    // The arena is the last parameter.
+    if (mNeedsArena) {
+        llvm::Function::arg_iterator param = function->arg_begin();
+        llvm::Function::arg_iterator arena = function->arg_end();
+        --arena;
+        for (size_t i = 0; i < argVars.size(); ++i, ++param) {
+            IRVar* var = argVars[i];
+            if ((assignsAny || assigned.Has(var)) && !IsPassedByValue(var) &&
+                !mHoistedTemps.Has(var))
+                GenPersistStrings(var, &*param, &*arena, numLanes);
+        }
+    }
     mBuilder->CreateRetVoid();
 
 #ifndef NDEBUG
@@ -223,10 +686,13 @@ CgShader::GenKernel(IRStmt* stmt, const IRVars& argVars)
         }
         return 0;
     }
-  The helper functions are defined in CgSkeleton.cpp
+  The helper functions are defined in CgSkeleton.cpp.  If the batch size is
+  greater than one, most of the points are processed in batches by the lane
+  kernel (see GenBatchLoop), and the loop above handles the remaining points.
 */
 llvm::Function*
-CgShader::GenEntry(llvm::Function* kernelFunc, const IRVars& args)
+CgShader::GenEntry(llvm::Function* kernelFunc, const IRVars& args,
+                   llvm::Function* laneFunc, int batchSize)
 {
     // Generate an empty plugin entry function and set the builder insert
     // point in its entry block.  The name is based on the kernel function,
@@ -236,6 +702,7 @@ CgShader::GenEntry(llvm::Function* kernelFunc, const IRVars& args)
     size_t suffixIndex = name.find("_kernel");
     name.erase(suffixIndex, 7);
     llvm::Function* entryFunc = GenEntryStub(name);
+    GenEntryArena();
 
     // Get the "argv" argument.
     llvm::Function::arg_iterator it = entryFunc->arg_begin();
@@ -243,13 +710,471 @@ CgShader::GenEntry(llvm::Function* kernelFunc, const IRVars& args)
     assert(it != entryFunc->arg_end() && "Error fetching argv from entry func");
     llvm::Value* argv = &*it;
 
-    // Generate code to allocate and initialize an iterator for each argument.
+    // Generate code to allocate and initialize an iterator for each argument,
+    // except for hoisted uniform arguments, which are loaded once.
     std::vector<llvm::Value*> iterators;
     GenIterators(entryFunc, args, argv, &iterators);
+    std::vector<llvm::Value*> uniformArgs;
+    GenUniformArgs(args, argv, &uniformArgs);
 
     // Generate a loop that iterates over the active points, calling the
     // kernel function for each and incrementing the iterators.
-    GenKernelLoop(entryFunc, kernelFunc, args, argv, iterators);
+    GenKernelLoop(entryFunc, kernelFunc, args, argv, iterators, uniformArgs,
+                  laneFunc, batchSize);
+    return entryFunc;
+}
+
+// A phase of a grid partition (see GenGridEntry), which is either a sequence
+// of statements or an instruction that's applied to the whole grid.
+struct CgGridPhase {
+    IRSeq* mSeq;                // Statements, or NULL
+    const IRInst* mGridInst;    // Derivative or texture lookup, or NULL
+    IRVarSet mRefs;             // Variables referenced by the phase
+    IRVars mArgs;               // Kernel arguments
+    llvm::Function* mKernel;    // Kernel for the statements
+};
+
+// Splits a partition into phases.  The phases borrow the statements and
+// instructions of the partition, which remains intact; the sequences and
+// blocks that contain them are released by Release().
+class CgGridSplitter {
+public:
+    CgGridSplitter(std::vector<CgGridPhase>* phases) :
+        mPhases(phases),
+        mStmts(new IRStmts),
+        mInsts(new IRInsts)
+    {
+    }
+
+    ~CgGridSplitter()
+    {
+        delete mStmts;
+        delete mInsts;
+    }
+
+    // Split the given statement.  Grid instructions occur only in blocks
+    // that are not nested in control flow, so other statements are kept
+    // whole.
+    void Split(IRStmt* stmt)
+    {
+        if (IRBlock* block = UtCast<IRBlock*>(stmt)) {
+            const IRInsts& insts = block->GetInsts();
+            IRInsts::const_iterator it;
+            for (it = insts.begin(); it != insts.end(); ++it) {
+                if (XfIsGridInst(*it)) {
+                    EndPhase();
+                    CgGridPhase phase = { NULL, *it, IRVarSet(), IRVars(), 
+                                          NULL };
+                    mPhases->push_back(phase);
+                }
+                else
+                    mInsts->push_back(*it);
+            }
+        }
+        else if (IRSeq* seq = UtCast<IRSeq*>(stmt)) {
+            IRStmts::const_iterator it;
+            for (it = seq->GetStmts().begin(); it != seq->GetStmts().end(); 
+                 ++it)
+                Split(*it);
+        }
+        else {
+            EndBlock();
+            mStmts->push_back(stmt);
+        }
+    }
+
+    // Wrap up the current statement phase, if any.
+    void EndPhase()
+    {
+        EndBlock();
+        if (mStmts->empty())
+            return;
+        CgGridPhase phase = { new IRSeq(mStmts), NULL, IRVarSet(), IRVars(),
+                              NULL };
+        mPhases->push_back(phase);
+        mStmts = new IRStmts;
+    }
+
+    // Release the sequences and blocks created for the phases, without
+    // destroying the borrowed statements and instructions.
+    void Release()
+    {
+        std::vector<IRBlock*>::iterator block;
+        for (block = mBlocks.begin(); block != mBlocks.end(); ++block) {
+            delete (*block)->TakeInsts();
+            delete *block;
+        }
+        mBlocks.clear();
+        std::vector<CgGridPhase>::iterator phase;
+        for (phase = mPhases->begin(); phase != mPhases->end(); ++phase) {
+            if (phase->mSeq) {
+                delete phase->mSeq->TakeStmts();
+                delete phase->mSeq;
+                phase->mSeq = NULL;
+            }
+        }
+    }
+
+private:
+    std::vector<CgGridPhase>* mPhases;
+    std::vector<IRBlock*> mBlocks; // Blocks created by EndBlock
+    IRStmts* mStmts;               // Statements of the current phase
+    IRInsts* mInsts;               // Instructions of the current block
+
+    // Wrap up the current block of instructions, if any.
+    void EndBlock()
+    {
+        if (mInsts->empty())
+            return;
+        IRBlock* block = new IRBlock(mInsts);
+        mBlocks.push_back(block);
+        mStmts->push_back(block);
+        mInsts = new IRInsts;
+    }
+};
+
+// Get the name of the skeleton helper function that implements a grid
+// instruction (see CgSkeleton.cpp).
+static const char*
+GetGridHelperName(Opcode opcode)
+{
+    switch (opcode) {
+      case kOpcode_Du: return "CgGridDu";
+      case kOpcode_Dv: return "CgGridDv";
+      case kOpcode_Deriv: return "CgGridDeriv";
+      case kOpcode_Area: return "CgGridArea";
+      case kOpcode_CalculateNormal: return "CgGridCalculateNormal";
+      case kOpcode_Texture: return "CgGridTexture";
+      case kOpcode_Environment: return "CgGridEnvironment";
+      default:
+          assert(false && "Expected grid instruction");
+          return NULL;
+    }
+}
+
+/*
+  Generate an RslPlugin entry function for a partition containing grid
+  instructions, i.e. derivatives or texture lookups.  Derivatives require the
+  values of neighboring points, and texture lookups are most efficient when
+  the whole grid is requested at once, so the partition is split into phases
+  at each grid instruction, and each phase is applied to every point of the
+  grid before the next one begins.  The statements between grid instructions
+  are compiled into kernels.  For example:
+
+      CgIter P_iter, u_iter, v_iter;  ...
+      int n = CgNumValues(argv, 0);
+      OpVec3* P = (OpVec3*) CgGridAlloc(n, sizeof(OpVec3));
+      float** P_ptrs = (float**) CgGridAlloc(n, sizeof(float*));
+      CgGatherIter(&P_iter, P, P_ptrs, n, sizeof(OpVec3));
+      ... likewise for u, v, and the other varying arguments ...
+      OpGrid grid;
+      if (!CgGridInit(&grid, rslContext, n) || !CgHasTextureSystem()) {
+          *status = 0;
+          return 0;
+      }
+      *status = 1;
+      ...
+      OpVec3* t = (OpVec3*) CgGridAlloc(n, sizeof(OpVec3));
+      CgGridSetParams(&grid, u, v);
+      for (int i = 0; i < n; ++i)
+          Phase1Kernel(&P[i], &t[i]);
+      CgGridDu(&grid, N, t, 3, 3);
+      CgGridTexture(&grid, "bump.tex", 0, 1, n, s, t, b);
+      ...
+      CgScatter(N, N_ptrs, n, sizeof(OpVec3));
+      CgGridFree(P); CgGridFree(P_ptrs); ...
+      return 0;
+
+  The varying arguments are gathered into grid buffers, and variables that
+  are referenced by more than one phase (or by a grid instruction) are
+  allocated grid buffers.  Grid instructions are compiled only outside of
+  control flow, but the renderer might still deactivate points, and the
+  plugin interface doesn't describe the grid, so derivatives and texture
+  filter widths rely on the topology reported by the grid info installed in
+  the plugin (see OpGridInfo).  Texture lookups are performed by the texture
+  system installed in the plugin (see OpTextureSystem).  If either is
+  unavailable (the texture system is checked only when there are lookups),
+  or some points are missing, nothing is shaded: the status argument, whose
+  index in argv is given, is set to zero, and the shader interprets a copy
+  of the partition instead (see CodegenPartition).  The helper functions
+  are defined in CgSkeleton.cpp.
+*/
+llvm::Function*
+CgShader::GenGridEntry(IRStmt* stmt, const IRVars& args, int statusArg)
+{
+    // Split the partition into phases and determine the variables referenced
+    // by each.  Variables that are shared by phases, other than arguments,
+    // are grid temporaries.
+    std::vector<CgGridPhase> phases;
+    CgGridSplitter splitter(&phases);
+    splitter.Split(stmt);
+    splitter.EndPhase();
+    IRVarSet seen, shared;
+    std::vector<CgGridPhase>::iterator phase;
+    for (phase = phases.begin(); phase != phases.end(); ++phase) {
+        if (phase->mSeq)
+            XfGetVaryingUses(phase->mSeq, &phase->mRefs);
+        else {
+            phase->mRefs += phase->mGridInst->GetResult();
+            phase->mRefs += phase->mGridInst->GetArgs();
+            shared += phase->mRefs;
+        }
+        IRVarSet both(phase->mRefs);
+        both.Intersect(seen);
+        shared += both;
+        seen += phase->mRefs;
+    }
+    IRVars::const_iterator arg;
+    for (arg = args.begin(); arg != args.end(); ++arg)
+        shared -= *arg;
+    IRVars temps;
+    shared.GetSorted(&temps);
+
+    // Compile a kernel for each statement phase, which takes the arguments
+    // and temporaries that it references.
+    for (phase = phases.begin(); phase != phases.end(); ++phase) {
+        if (phase->mSeq == NULL)
+            continue;
+        for (arg = args.begin(); arg != args.end(); ++arg)
+            if (phase->mRefs.Has(*arg))
+                phase->mArgs.push_back(*arg);
+        for (arg = temps.begin(); arg != temps.end(); ++arg)
+            if (phase->mRefs.Has(*arg))
+                phase->mArgs.push_back(*arg);
+        mVars->Reset();
+        phase->mKernel = GenKernel(phase->mSeq, phase->mArgs, 1,
+                                   true /*isGridPhase*/);
+    }
+    mVars->Reset();
+
+    // Generate an empty plugin entry function and get its "rslContext" and
+    // "argv" arguments.
+    llvm::Function* entryFunc = GenEntryStub(mCurrentFuncName);
+    GenEntryArena();
+    llvm::Function::arg_iterator it = entryFunc->arg_begin();
+    llvm::Value* rslContext = &*it;
+    ++it; ++it;
+    assert(it != entryFunc->arg_end() && "Error fetching argv from entry func");
+    llvm::Value* argv = &*it;
+
+    // Get the helper functions.
+    llvm::Function* getNumValues = mModule->getFunction("CgNumValues");
+    llvm::Function* derefIter = mModule->getFunction("CgDerefIter");
+    llvm::Function* gatherIter = mModule->getFunction("CgGatherIter");
+    llvm::Function* scatter = mModule->getFunction("CgScatter");
+    llvm::Function* getData = mModule->getFunction("CgGetData");
+    llvm::Function* gridInit = mModule->getFunction("CgGridInit");
+    llvm::Function* gridSetParams = mModule->getFunction("CgGridSetParams");
+    llvm::Function* gridAlloc = mModule->getFunction("CgGridAlloc");
+    llvm::Function* gridFree = mModule->getFunction("CgGridFree");
+    llvm::Function* hasTextures = mModule->getFunction("CgHasTextureSystem");
+    assert(getNumValues && derefIter && gatherIter && scatter && getData &&
+           gridInit && gridSetParams && gridAlloc && gridFree && hasTextures &&
+           "Grid helpers not found in skeleton");
+    llvm::Type* intTy = llvm::Type::getInt32Ty(*mContext);
+    llvm::Type* ptrsPtrTy = gatherIter->getFunctionType()->getParamType(2);
+    llvm::Type* dataPtrTy = 
+        llvm::cast<llvm::PointerType>(ptrsPtrTy)->getElementType();
+    llvm::Type* dataTy = 
+        llvm::cast<llvm::PointerType>(dataPtrTy)->getElementType();
+    llvm::Type* bytePtrTy = gridFree->getFunctionType()->getParamType(0);
+
+    // Get the number of points and the grid topology, and check for a
+    // texture system if there are texture lookups.  If either is
+    // unavailable, return a zero status before anything is executed.
+    // Otherwise the status is one.
+    llvm::Value* numValues =
+        mBuilder->CreateCall2(getNumValues, argv, GetInt(0));
+    llvm::Type* gridPtrTy = gridInit->getFunctionType()->getParamType(0);
+    llvm::Type* contextTy = gridInit->getFunctionType()->getParamType(1);
+    llvm::Value* grid = GenAlloca(
+        llvm::cast<llvm::PointerType>(gridPtrTy)->getElementType(), "grid");
+    llvm::Value* found = mBuilder->CreateICmpNE(
+        mBuilder->CreateCall3(gridInit, grid,
+                              mBuilder->CreateBitCast(rslContext, contextTy),
+                              numValues),
+        GetInt(0));
+    if (HasGridInsts(stmt, XfIsBatchTextureInst))
+        found = mBuilder->CreateAnd(
+            found, mBuilder->CreateICmpNE(mBuilder->CreateCall(hasTextures),
+                                          GetInt(0)));
+    llvm::Type* floatTy = llvm::Type::getFloatTy(*mContext);
+    llvm::Value* status = mBuilder->CreateBitCast(
+        mBuilder->CreateCall2(getData, argv, GetInt(statusArg)),
+        llvm::PointerType::getUnqual(floatTy), "status");
+    llvm::BasicBlock* apply =
+        llvm::BasicBlock::Create(*mContext, "apply", entryFunc);
+    llvm::BasicBlock* fail =
+        llvm::BasicBlock::Create(*mContext, "fail", entryFunc);
+    mBuilder->CreateCondBr(found, apply, fail);
+    mBuilder->SetInsertPoint(fail);
+    mBuilder->CreateStore(llvm::ConstantFP::get(floatTy, 0.0), status);
+    GenEntryReturn();
+    mBuilder->SetInsertPoint(apply);
+    mBuilder->CreateStore(llvm::ConstantFP::get(floatTy, 1.0), status);
+
+    // Generate iterators for the arguments and load the hoisted uniform
+    // arguments.
+    std::vector<llvm::Value*> iterators;
+    GenIterators(entryFunc, args, argv, &iterators);
+    std::vector<llvm::Value*> uniformArgs;
+    GenUniformArgs(args, argv, &uniformArgs);
+
+    // Get the location of each variable: a grid buffer for varying arguments
+    // and temporaries (along with data pointers for scattering arguments),
+    // and a single value for uniform ones.
+    std::map<const IRVar*, llvm::Value*> buffers, values, dataPtrs;
+    std::map<const IRVar*, llvm::Constant*> sizes;
+    std::vector<llvm::Value*> allocated;
+    IRVars vars(args);
+    vars.insert(vars.end(), temps.begin(), temps.end());
+    for (size_t i = 0; i < vars.size(); ++i) {
+        IRVar* var = vars[i];
+        bool isArg = i < args.size();
+        std::string name = std::string("_") + var->GetShortName();
+        llvm::Type* ty = mTypes->ConvertExternal(var->GetType());
+        if (var->GetDetail() == kIRUniform) {
+            if (!isArg)
+                values[var] = GenAlloca(ty, name, GetInitialValue(var, ty));
+            else if (uniformArgs[i])
+                values[var] = uniformArgs[i];
+            else {
+                llvm::Value* data = 
+                    mBuilder->CreateCall(derefIter, iterators[i]);
+                values[var] = mBuilder->CreateBitCast(
+                    data, llvm::PointerType::getUnqual(ty), name + "_ptr");
+            }
+            continue;
+        }
+        llvm::Constant* size = llvm::ConstantExpr::getTruncOrBitCast(
+            llvm::ConstantExpr::getSizeOf(ty), intTy);
+        llvm::Value* buffer = 
+            mBuilder->CreateCall2(gridAlloc, numValues, size, name + "_grid");
+        allocated.push_back(buffer);
+        buffers[var] = mBuilder->CreateBitCast(
+            buffer, llvm::PointerType::getUnqual(ty));
+        sizes[var] = size;
+        if (isArg) {
+            llvm::Constant* ptrSize = llvm::ConstantExpr::getTruncOrBitCast(
+                llvm::ConstantExpr::getSizeOf(dataPtrTy), intTy);
+            llvm::Value* ptrs = 
+                mBuilder->CreateCall2(gridAlloc, numValues, ptrSize);
+            allocated.push_back(ptrs);
+            dataPtrs[var] = mBuilder->CreateBitCast(ptrs, ptrsPtrTy,
+                                                    name + "_ptrs");
+            llvm::Value* gatherArgs[] = 
+                { iterators[i], buffer, dataPtrs[var], numValues, size };
+            mBuilder->CreateCall(gatherIter, gatherArgs);
+        }
+    }
+
+    // If there are derivatives, supply the surface parameters of the grid.
+    if (HasGridInsts(stmt, XfIsDerivInst)) {
+        const IRType* floatTy = mTypeFactory->GetFloatTy();
+        IRVar* u = mShader->GetGlobalVar("u", floatTy, kIRVarying);
+        IRVar* v = mShader->GetGlobalVar("v", floatTy, kIRVarying);
+        assert(buffers[u] && buffers[v] && 
+               "Expected varying u and v arguments");
+        mBuilder->CreateCall3(gridSetParams, grid, buffers[u], buffers[v]);
+    }
+
+    // Apply each phase to the whole grid.
+    llvm::Type* floatPtrTy = llvm::PointerType::getUnqual(dataTy);
+    for (phase = phases.begin(); phase != phases.end(); ++phase) {
+        if (phase->mSeq) {
+            // Generate a loop that calls the kernel for each point.
+            llvm::Value* index;
+            llvm::BasicBlock* body = GenLoop(numValues, &index);
+            llvm::BasicBlock* done = mBuilder->GetInsertBlock();
+            llvm::BasicBlock* next = OpenLoopBody(body);
+            llvm::FunctionType* kernelTy = phase->mKernel->getFunctionType();
+            std::vector<llvm::Value*> kernelArgs;
+            for (size_t i = 0; i < phase->mArgs.size(); ++i) {
+                IRVar* var = phase->mArgs[i];
+                llvm::Value* arg = buffers[var]
+                    ? mBuilder->CreateInBoundsGEP(buffers[var], index)
+                    : values[var];
+                kernelArgs.push_back(
+                    mBuilder->CreateBitCast(arg, kernelTy->getParamType(i)));
+            }
+            if (mArena)
+                kernelArgs.push_back(mArena);
+            mBuilder->CreateCall(phase->mKernel, kernelArgs);
+            mBuilder->CreateBr(next);
+            mBuilder->SetInsertPoint(done);
+            continue;
+        }
+
+        // Call the helper for the grid instruction.
+        const IRInst* inst = phase->mGridInst;
+        Opcode opcode = inst->GetOpcode();
+        llvm::Function* helper = 
+            mModule->getFunction(GetGridHelperName(opcode));
+        assert(helper && "Grid instruction helper not found in skeleton");
+        IRVar* result = inst->GetResult();
+        const IRValues& operands = inst->GetArgs();
+        llvm::Value* resultPtr = 
+            mBuilder->CreateBitCast(buffers[result], floatPtrTy);
+        std::vector<llvm::Value*> helperArgs;
+        if (opcode == kOpcode_Texture || opcode == kOpcode_Environment) {
+            // A texture lookup has a constant name and channel, followed by
+            // the coordinates (see XfIsBatchTextureInst), and the number of
+            // channels is determined by the result type.  The helper also
+            // takes the grid, from which it computes the filter widths.
+            const IRStringConst* name = 
+                UtStaticCast<const IRStringConst*>(operands[0]);
+            const IRNumConst* channel = 
+                UtStaticCast<const IRNumConst*>(operands[1]);
+            helperArgs.push_back(grid);
+            helperArgs.push_back(mBuilder->CreateGlobalStringPtr(name->Get()));
+            helperArgs.push_back(GetInt(int(channel->GetFloat())));
+            helperArgs.push_back(GetInt(result->GetType()->IsFloat() ? 1 : 3));
+            helperArgs.push_back(numValues);
+            for (size_t i = 2; i < operands.size(); ++i) {
+                IRVar* var = UtStaticCast<IRVar*>(operands[i]);
+                helperArgs.push_back(
+                    mBuilder->CreateBitCast(buffers[var], floatPtrTy));
+            }
+            helperArgs.push_back(resultPtr);
+            mBuilder->CreateCall(helper, helperArgs);
+            continue;
+        }
+
+        // A derivative helper takes the grid and the result, followed by
+        // the operands.  The size of each value in floats is also the stride
+        // of each operand.
+        helperArgs.push_back(grid);
+        helperArgs.push_back(resultPtr);
+        for (size_t i = 0; i < operands.size(); ++i) {
+            IRVar* var = UtStaticCast<IRVar*>(operands[i]);
+            int numFloats = var->GetType()->IsFloat() ? 1 : 3;
+            helperArgs.push_back(
+                mBuilder->CreateBitCast(buffers[var], floatPtrTy));
+            helperArgs.push_back(GetInt(numFloats));
+            if (i == 0 && opcode != kOpcode_Area &&
+                opcode != kOpcode_CalculateNormal)
+                helperArgs.push_back(GetInt(numFloats));
+        }
+        mBuilder->CreateCall(helper, helperArgs);
+    }
+
+    // Scatter the values of the varying arguments that the partition
+    // assigns, then free the grid buffers.
+    IRVarSet assigned;
+    bool assignsAny = !CgStmt::GetAssignedVars(stmt, &assigned);
+    for (arg = args.begin(); arg != args.end(); ++arg) {
+        IRVar* var = *arg;
+        if (dataPtrs[var] && (assignsAny || assigned.Has(var))) {
+            llvm::Value* buffer = 
+                mBuilder->CreateBitCast(buffers[var], bytePtrTy);
+            mBuilder->CreateCall4(scatter, buffer, dataPtrs[var], numValues,
+                                  sizes[var]);
+        }
+    }
+    for (size_t i = 0; i < allocated.size(); ++i)
+        mBuilder->CreateCall(gridFree, allocated[i]);
+    GenEntryReturn();
+    splitter.Release();
     return entryFunc;
 }
 
@@ -276,7 +1201,60 @@ CgShader::GenEntryStub(const std::string& name)
     return entryFunc;
 }
 
+// If the current partition requires a per-call arena, allocate one in the
+// entry function (see OpArena).  A zeroed arena is empty.
+void
+CgShader::GenEntryArena()
+{
+    mArena = NULL;
+    if (!mNeedsArena)
+        return;
+    llvm::Type* arenaTy = GetClassType("OpArena");
+    mArena = GenAlloca(arenaTy, "arena", llvm::Constant::getNullValue(arenaTy));
+}
+
+// If a variable holds strings (i.e. it's a string or a fixed-length string
+// array), generate a call that replaces any of them that were interned in the
+// given arena by permanent copies (see OpStringPersist).  The location has the
+// external type, and holds the values of several points if the variable is
+// varying and the number of lanes is greater than one.
+void
+CgShader::GenPersistStrings(const IRVar* var, llvm::Value* location,
+                            llvm::Value* arena, int numLanes)
+{
+    const IRType* ty = var->GetType();
+    int numStrings = 1;
+    if (const IRArrayType* arrayTy = UtCast<const IRArrayType*>(ty)) {
+        numStrings = arrayTy->GetLength();
+        ty = arrayTy->GetElementType();
+    }
+    if (!ty->IsString() || numStrings <= 0)
+        return;
+    if (numLanes > 1 && var->GetDetail() == kIRVarying)
+        numStrings *= numLanes;
+    llvm::Function* persist = mModule->getFunction("CgPersistStrings");
+    assert(persist && "CgPersistStrings() function not found in skeleton");
+    llvm::Type* stringsTy = persist->getFunctionType()->getParamType(1);
+    mBuilder->CreateCall3(persist, arena,
+                          mBuilder->CreateBitCast(location, stringsTy),
+                          GetInt(numStrings));
+}
+
+// Generate a return from the entry function, first freeing the per-call
+// arena, if any.
+void
+CgShader::GenEntryReturn()
+{
+    if (mArena) {
+        llvm::Function* arenaFree = mModule->getFunction("CgArenaFree");
+        assert(arenaFree && "CgArenaFree() function not found in skeleton");
+        mBuilder->CreateCall(arenaFree, mArena);
+    }
+    mBuilder->CreateRet(GetInt(0));
+}
+
 // Generate code to allocate and initialize an iterator for each argument.
+// Hoisted uniform arguments are not iterated (their iterators are NULL).
 void
 CgShader::GenIterators(llvm::Function* entryFunc, const IRVars& args,
                        llvm::Value* argv,
@@ -296,8 +1274,12 @@ CgShader::GenIterators(llvm::Function* entryFunc, const IRVars& args,
     IRVars::const_iterator argIt;
     for (argIt = args.begin(); argIt != args.end(); ++argIt, ++argNum) {
         IRVar* var = *argIt;
+        if (IsHoisted(var)) {
+            iterators->push_back(NULL);
+            continue;
+        }
         // Generate alloca.
-        llvm::Twine iterName = llvm::Twine("_") + var->GetShortName() + "_iter";
+        std::string iterName = std::string("_") + var->GetShortName() + "_iter";
         llvm::Value* iter = GenAlloca(iterTy, iterName);
         iterators->push_back(iter);
         // Generate "CgGetIter(argv, $i, $iter)", which returns void.
@@ -305,12 +1287,111 @@ CgShader::GenIterators(llvm::Function* entryFunc, const IRVars& args,
     }
 }
 
+// Generate code to load the hoisted uniform arguments before the kernel
+// loop, obtaining the kernel argument for each (NULL for other arguments).
+// Any hoisted uniform instructions are executed first.  Unmodified scalars
+// are passed by value, and other unmodified arguments are copied into local
+// variables, which the optimizer can keep in registers.  Modified arguments
+// are passed by reference, as usual.
+void
+CgShader::GenUniformArgs(const IRVars& args, llvm::Value* argv,
+                         std::vector<llvm::Value*>* uniformArgs)
+{
+    llvm::Function* getData = mModule->getFunction("CgGetData");
+    assert(getData && "CgGetData() function not found in skeleton");
+
+    // Get the location of each hoisted argument.  Temporaries assigned by
+    // hoisted instructions are local variables.
+    size_t numArgs = args.size();
+    std::vector<llvm::Value*> locations(numArgs, NULL);
+    for (size_t i = 0; i < numArgs; ++i) {
+        IRVar* var = args[i];
+        if (!IsHoisted(var))
+            continue;
+        std::string argName = std::string("_") + var->GetShortName();
+        llvm::Type* ty = mTypes->ConvertExternal(var->GetType());
+        if (mHoistedTemps.Has(var)) {
+            locations[i] = GenAlloca(ty, argName, GetInitialValue(var, ty));
+            continue;
+        }
+        // Generate "CgGetData(argv, $i)" and cast the data pointer.  Note
+        // that argv[0] is the result, which is void.
+        llvm::Value* data = 
+            mBuilder->CreateCall2(getData, argv, GetInt(i+1));
+        locations[i] = 
+            mBuilder->CreateBitCast(data, llvm::PointerType::getUnqual(ty), 
+                                    argName + "_ptr");
+    }
+
+    // Execute the hoisted instructions.
+    if (!mHoistedInsts.empty())
+        GenHoistedInsts(args, locations);
+
+    // Get the kernel arguments.
+    uniformArgs->reserve(numArgs);
+    for (size_t i = 0; i < numArgs; ++i) {
+        IRVar* var = args[i];
+        llvm::Value* ptr = locations[i];
+        std::string argName = std::string("_") + var->GetShortName();
+        if (ptr == NULL)
+            uniformArgs->push_back(NULL);
+        else if (IsPassedByValue(var))
+            uniformArgs->push_back(mBuilder->CreateLoad(ptr, argName));
+        else if (mUniformInputs.Has(var) && !mHoistedTemps.Has(var)) {
+            llvm::Value* copy = GenAlloca(
+                mTypes->ConvertExternal(var->GetType()), argName + "_copy");
+            mBuilder->CreateStore(mBuilder->CreateLoad(ptr), copy);
+            uniformArgs->push_back(copy);
+        }
+        else
+            uniformArgs->push_back(ptr);
+    }
+}
+
+// Generate code for the hoisted uniform instructions, given the locations of
+// the hoisted arguments.  Uniform results that are live after the partition
+// are arguments, so they are stored directly into the argument data.
+void
+CgShader::GenHoistedInsts(const IRVars& args, 
+                          const std::vector<llvm::Value*>& locations)
+{
+    mVars->Reset();
+    mVars->SetArena(mArena);
+    for (size_t i = 0; i < args.size(); ++i)
+        if (locations[i])
+            mVars->Bind(args[i], locations[i]);
+    IRInsts::const_iterator it;
+    for (it = mHoistedInsts.begin(); it != mHoistedInsts.end(); ++it) {
+        const IRInst* inst = *it;
+        bool ok = mInsts->GenInst(*inst);
+        if (!ok)
+            mLog->Write(kUtError, "Codegen unimplemented for instruction '%s'",
+                        inst->GetName());
+    }
+
+    // Uniform strings that are stored in plugin arguments must outlive the
+    // call (see GenPersistStrings).
+    if (mArena) {
+        IRVarSet results;
+        for (it = mHoistedInsts.begin(); it != mHoistedInsts.end(); ++it)
+            if (IRVar* result = (*it)->GetResult())
+                results += result;
+        for (size_t i = 0; i < args.size(); ++i)
+            if (locations[i] && results.Has(args[i]) &&
+                !mHoistedTemps.Has(args[i]))
+                GenPersistStrings(args[i], locations[i], mArena);
+    }
+    mVars->Reset();
+}
+
 // Generate a loop that iterates over the active points, calling the
 // kernel function for each and incrementing the iterators.
 void
 CgShader::GenKernelLoop(llvm::Function* entryFunc, llvm::Function* kernelFunc,
                         const IRVars& args, llvm::Value* argv,
-                        const std::vector<llvm::Value*>& iterators)
+                        const std::vector<llvm::Value*>& iterators,
+                        const std::vector<llvm::Value*>& uniformArgs,
+                        llvm::Function* laneFunc, int batchSize)
 {
     // Get the number of values, "int n = CgNumValues(argv, 0)"
     llvm::Function* getNumValues = mModule->getFunction("CgNumValues");
@@ -318,21 +1399,38 @@ CgShader::GenKernelLoop(llvm::Function* entryFunc, llvm::Function* kernelFunc,
     llvm::Value* numValues =
         mBuilder->CreateCall2(getNumValues, argv, GetInt(0));
 
+    // If requested, process batches of points first, leaving the remainder
+    // for the scalar loop below.
+    if (batchSize > 1) {
+        assert(laneFunc && "Expected lane kernel for batch loop");
+        numValues = GenBatchLoop(laneFunc, args, iterators, uniformArgs,
+                                 numValues, batchSize);
+    }
+
+    // If requested, generate loops specialized for contiguous and
+    // constant-stride arguments, which are selected at runtime.  The generic
+    // loop below is used if neither applies.
+    else if (mOptions.mSpecializeStrides)
+        GenStrideLoops(kernelFunc, args, iterators, uniformArgs, numValues);
+
     // Generate a loop from i = 0 to N-1.
     llvm::Value* loopIndex;
     llvm::BasicBlock* loopBody = GenLoop(numValues, &loopIndex);
 
     // The block after the loop will be the end of the function
     // All remaining code goes in the loop body.
-    mBuilder->CreateRet(GetInt(0));
+    GenEntryReturn();
     mBuilder->SetInsertPoint(loopBody, loopBody->begin());
 
     // Generate code to dereference the iterators, obtaining a data pointer
     // for each.
     std::vector<llvm::Value*> kernelArgs;
-    GenDerefIterators(args, iterators, &kernelArgs);
+    GenDerefIterators(args, iterators, uniformArgs, &kernelArgs);
 
-    // Generate call to kernel function, passing the data pointers.
+    // Generate call to kernel function, passing the data pointers (and the
+    // arena, if any).
+    if (mArena)
+        kernelArgs.push_back(mArena);
     mBuilder->CreateCall(kernelFunc, kernelArgs);
 
     // Increment the iterators.
@@ -340,80 +1438,289 @@ CgShader::GenKernelLoop(llvm::Function* entryFunc, llvm::Function* kernelFunc,
     assert(incIter && "CgIncIter() function not found in skeleton");
     std::vector<llvm::Value*>::const_iterator iter;
     for (iter = iterators.begin(); iter != iterators.end(); ++iter)
-        mBuilder->CreateCall(incIter, *iter);
+        if (*iter)
+            mBuilder->CreateCall(incIter, *iter);
 }
 
 /*
-   Generate a loop from i = 0 to N-1 as follows:
-
-        br label %loop_test
-     loop_test:
-        %index = phi i32 [ 0, %entry ], [ %next, %loop_body ]
-        %less = icmp slt i32 %index, %N
-        br i1 %less, label %loop_body, label %done
-     loop_body:
-        %next = add i32 %index, 1
-        br label %loop_test
-     done:
-
-   The loop_body block is returned, along with the loop index (as a result
-   parameter), allowing the caller to add code to the body.
+  Generate kernel loops specialized for the strides of the argument
+  iterators, preceded by a runtime check that selects one of them.  The
+  builder is left positioned in the block that handles the generic case.
+  For example:
+
+      int fs = CgIterStride(&f_iter, n), cs = CgIterStride(&c_iter, n);
+      float* f = CgDerefIter(&f_iter), *c = CgDerefIter(&c_iter);
+      if (fs == 1 && cs == 3) {
+          for (int i = 0; i < n; ++i)
+              KernelFunc(&((float*) f)[i], &((OpVec3*) c)[i]);
+          return 0;
+      }
+      if (fs >= 0 && cs >= 0) {
+          for (int i = 0; i < n; ++i)
+              KernelFunc((float*) &f[i*fs], (OpVec3*) &c[i*cs]);
+          return 0;
+      }
+      ... generic loop ...
+
+  A uniform argument is contiguous if its stride is zero.  In the contiguous
+  loop the argument addresses are simple pointer arithmetic on typed
+  pointers, which allows LLVM to unroll and vectorize the loop.
 */
-llvm::BasicBlock*
-CgShader::GenLoop(llvm::Value* loopBound, llvm::Value** loopIndex)
-{
-    // Keep track of the current block for use by the phi note.
-    llvm::BasicBlock* predBlock = mBuilder->GetInsertBlock();
-    llvm::Function* function = predBlock->getParent();
-
-    // Create the basic blocks.
-    llvm::BasicBlock* testBlock = llvm::BasicBlock::Create(*mContext, "test");
-    llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*mContext, "body");
-    llvm::BasicBlock* doneBlock = llvm::BasicBlock::Create(*mContext, "done");
-
-    // Add the test block and generate a jump to it.
-    function->getBasicBlockList().push_back(testBlock);
-    mBuilder->CreateBr(testBlock);
-
-    // Generate the loop test:
-    //    %index = phi i32 [ 0, %entry ], [ %next, %loop_body ]
-    //    %less = icmp slt i32 %index, %N
-    mBuilder->SetInsertPoint(testBlock);
-    llvm::PHINode* indexPhi =
-        mBuilder->CreatePHI(llvm::Type::getInt32Ty(*mContext), 2, "index");
-    indexPhi->addIncoming(GetInt(0), predBlock);
-    llvm::Value* lessThan = 
-        mBuilder->CreateICmp(llvm::CmpInst::ICMP_SLT, indexPhi, loopBound);
-
-    // Generate conditional branch: 
-    //    br i1 %less, label %loop_body, label %done
-    mBuilder->CreateCondBr(lessThan, bodyBlock, doneBlock);
-
-    // Generate the loop body:
-    //    %next = add i32 %index, 1
-    //    br label %loop_test
-    function->getBasicBlockList().push_back(bodyBlock);
-    mBuilder->SetInsertPoint(bodyBlock);
-    llvm::Value* next = mBuilder->CreateAdd(indexPhi, GetInt(1));
-    mBuilder->CreateBr(testBlock);
-
-    // Update the phi node with [%next, %loop_body]
-    indexPhi->addIncoming(next, bodyBlock);
-
-    // Statements following the loop will be generated in the "done" block.
-    function->getBasicBlockList().push_back(doneBlock);
-    mBuilder->SetInsertPoint(doneBlock);
-
-    // Return the loop body and the loop index.
-    *loopIndex = indexPhi;
-    return bodyBlock;
+void
+CgShader::GenStrideLoops(llvm::Function* kernelFunc, const IRVars& args,
+                         const std::vector<llvm::Value*>& iterators,
+                         const std::vector<llvm::Value*>& uniformArgs,
+                         llvm::Value* numValues)
+{
+    llvm::Function* iterStride = mModule->getFunction("CgIterStride");
+    assert(iterStride && "CgIterStride() function not found in skeleton");
+    llvm::Function* derefIter = mModule->getFunction("CgDerefIter");
+    assert(derefIter && "CgDerefIter() function not found in skeleton");
+    llvm::Type* intTy = llvm::Type::getInt32Ty(*mContext);
+
+    // Get the stride and base pointer of each iterator, checking whether
+    // all the strides are constant and whether all the arguments are
+    // contiguous.
+    size_t numArgs = args.size();
+    std::vector<llvm::Value*> strides(numArgs, NULL);
+    std::vector<llvm::Value*> bases(numArgs, NULL);
+    llvm::Value* isConstant = mBuilder->getTrue();
+    llvm::Value* isContiguous = mBuilder->getTrue();
+    for (size_t i = 0; i < numArgs; ++i) {
+        if (iterators[i] == NULL)
+            continue;
+        IRVar* var = args[i];
+        std::string argName = std::string("_") + var->GetShortName();
+        strides[i] = mBuilder->CreateCall2(iterStride, iterators[i], numValues,
+                                           argName + "_stride");
+        bases[i] = mBuilder->CreateCall(derefIter, iterators[i],
+                                        argName + "_base");
+
+        // The stride of contiguous values is the size of a value in floats.
+        llvm::Constant* unitStride = GetInt(0);
+        if (var->GetDetail() == kIRVarying) {
+            llvm::Type* ty = mTypes->ConvertExternal(var->GetType());
+            llvm::Constant* size = llvm::ConstantExpr::getTruncOrBitCast(
+                llvm::ConstantExpr::getSizeOf(ty), intTy);
+            unitStride = llvm::ConstantExpr::getUDiv(size, GetInt(4));
+        }
+        isConstant = mBuilder->CreateAnd(
+            isConstant, mBuilder->CreateICmpSGE(strides[i], GetInt(0)));
+        isContiguous = mBuilder->CreateAnd(
+            isContiguous, mBuilder->CreateICmpEQ(strides[i], unitStride));
+    }
+
+    // Dispatch to the contiguous, constant-stride, or generic loop.
+    llvm::Function* function = mBuilder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* contiguousBlock = 
+        llvm::BasicBlock::Create(*mContext, "contiguous", function);
+    llvm::BasicBlock* checkBlock = 
+        llvm::BasicBlock::Create(*mContext, "checkstride", function);
+    llvm::BasicBlock* strideBlock = 
+        llvm::BasicBlock::Create(*mContext, "stride", function);
+    llvm::BasicBlock* genericBlock = 
+        llvm::BasicBlock::Create(*mContext, "generic", function);
+    mBuilder->CreateCondBr(isContiguous, contiguousBlock, checkBlock);
+    mBuilder->SetInsertPoint(checkBlock);
+    mBuilder->CreateCondBr(isConstant, strideBlock, genericBlock);
+
+    mBuilder->SetInsertPoint(contiguousBlock);
+    GenStrideLoop(kernelFunc, args, uniformArgs, bases, strides, 
+                  numValues, true);
+    mBuilder->SetInsertPoint(strideBlock);
+    GenStrideLoop(kernelFunc, args, uniformArgs, bases, strides, 
+                  numValues, false);
+    mBuilder->SetInsertPoint(genericBlock);
+}
+
+// Generate a kernel loop for iterators with constant strides, followed by a
+// return.  If the arguments are contiguous, each argument address is
+// computed by indexing a typed pointer; otherwise the stride is scaled by
+// the loop index.
+void
+CgShader::GenStrideLoop(llvm::Function* kernelFunc, const IRVars& args,
+                        const std::vector<llvm::Value*>& uniformArgs,
+                        const std::vector<llvm::Value*>& bases,
+                        const std::vector<llvm::Value*>& strides,
+                        llvm::Value* numValues, bool isContiguous)
+{
+    // Generate a loop from i = 0 to N-1, followed by a return.
+    llvm::Value* loopIndex;
+    llvm::BasicBlock* loopBody = GenLoop(numValues, &loopIndex);
+    GenEntryReturn();
+    mBuilder->SetInsertPoint(loopBody, loopBody->begin());
+
+    // Compute the argument addresses and call the kernel.
+    size_t numArgs = args.size();
+    std::vector<llvm::Value*> kernelArgs;
+    kernelArgs.reserve(numArgs);
+    for (size_t i = 0; i < numArgs; ++i) {
+        if (uniformArgs[i]) {
+            kernelArgs.push_back(uniformArgs[i]);
+            continue;
+        }
+        IRVar* var = args[i];
+        std::string argName = std::string("_") + var->GetShortName();
+        llvm::Type* argType = 
+            mTypes->ConvertParamType(var->GetType(), true /*isOutput*/);
+        llvm::Value* ptr;
+        if (!isContiguous) {
+            llvm::Value* offset = mBuilder->CreateMul(loopIndex, strides[i]);
+            ptr = mBuilder->CreateBitCast(
+                mBuilder->CreateInBoundsGEP(bases[i], offset), argType);
+        }
+        else if (var->GetDetail() == kIRVarying) {
+            llvm::Value* typedBase = mBuilder->CreateBitCast(bases[i], argType);
+            ptr = mBuilder->CreateInBoundsGEP(typedBase, loopIndex);
+        }
+        else
+            ptr = mBuilder->CreateBitCast(bases[i], argType);
+        ptr->setName(argName + "_ptr");
+        if (IsPassedByValue(var))
+            ptr = mBuilder->CreateLoad(ptr, argName);
+        kernelArgs.push_back(ptr);
+    }
+    if (mArena)
+        kernelArgs.push_back(mArena);
+    mBuilder->CreateCall(kernelFunc, kernelArgs);
+}
+
+/*
+  Generate a loop that processes the points in batches, returning the number
+  of remaining points (which are handled by the caller).  For example:
+
+      OpVec3 c_lanes[4];  float* c_ptrs[4];  float s_lanes[4];
+      float* f = CgDerefIter(&f_iter);            // uniform
+      for (int b = 0; b < n/4; ++b) {
+          CgGatherIter(&c_iter, c_lanes, c_ptrs, 4, sizeof(OpVec3));
+          CgGatherIter(&s_iter, s_lanes, NULL, 4, sizeof(float));  // input
+          LaneFunc(f, &c_lanes, &s_lanes);
+          CgScatter(c_lanes, c_ptrs, 4, sizeof(OpVec3));
+      }
+      return n % 4;
+
+  The values of each varying argument are copied into a contiguous lane
+  buffer, which the lane kernel accesses with a constant stride.  Only the
+  arguments that the kernel might modify are scattered back, so the data
+  pointers of inputs are not recorded.  The lane
+  loops in the lane kernel have a fixed length, which allows LLVM to unroll
+  and vectorize them, and varying control flow is handled with lane masks
+  (see CgStmt).  Uniform arguments are dereferenced only once, since their
+  iterators never advance.
+*/
+llvm::Value*
+CgShader::GenBatchLoop(llvm::Function* laneFunc, const IRVars& args,
+                       const std::vector<llvm::Value*>& iterators,
+                       const std::vector<llvm::Value*>& uniformArgs,
+                       llvm::Value* numValues, int batchSize)
+{
+    llvm::Function* gatherIter = mModule->getFunction("CgGatherIter");
+    assert(gatherIter && "CgGatherIter() function not found in skeleton");
+    llvm::Function* scatter = mModule->getFunction("CgScatter");
+    assert(scatter && "CgScatter() function not found in skeleton");
+    llvm::Function* derefIter = mModule->getFunction("CgDerefIter");
+    assert(derefIter && "CgDerefIter() function not found in skeleton");
+
+    // The lane buffers and pointer arrays are passed to the helpers as
+    // untyped byte pointers and float** pointers, respectively.
+    llvm::FunctionType* gatherTy = gatherIter->getFunctionType();
+    llvm::Type* bufferPtrTy = gatherTy->getParamType(1);
+    llvm::Type* ptrsPtrTy = gatherTy->getParamType(2);
+    llvm::Type* dataPtrTy = llvm::cast<llvm::PointerType>(ptrsPtrTy)
+        ->getElementType();
+    llvm::Type* intTy = llvm::Type::getInt32Ty(*mContext);
+
+    // Allocate a lane buffer for each varying argument, and a data pointer
+    // array if the kernel might modify it.  Dereference the iterators of the
+    // uniform arguments (unless they were hoisted).
+    size_t numArgs = args.size();
+    std::vector<llvm::Value*> buffers(numArgs, NULL);
+    std::vector<llvm::Value*> dataPtrs(numArgs, NULL);
+    std::vector<llvm::Constant*> sizes(numArgs, NULL);
+    std::vector<llvm::Value*> kernelArgs(numArgs, NULL);
+    for (size_t i = 0; i < numArgs; ++i) {
+        IRVar* var = args[i];
+        std::string argName = std::string("_") + var->GetShortName();
+        llvm::Type* argType = 
+            mTypes->ConvertParamType(var->GetType(), true /*isOutput*/);
+        if (uniformArgs[i]) {
+            kernelArgs[i] = uniformArgs[i];
+            continue;
+        }
+        if (var->GetDetail() == kIRUniform) {
+            llvm::Value* data = mBuilder->CreateCall(derefIter, iterators[i]);
+            kernelArgs[i] = 
+                mBuilder->CreateBitCast(data, argType, argName + "_ptr");
+            continue;
+        }
+        llvm::Type* ty = mTypes->ConvertExternal(var->GetType());
+        buffers[i] = GenAlloca(llvm::ArrayType::get(ty, batchSize), 
+                               argName + "_lanes");
+        if (!mBatchInputs.Has(var))
+            dataPtrs[i] = 
+                GenAlloca(llvm::ArrayType::get(dataPtrTy, batchSize), 
+                          argName + "_ptrs");
+        sizes[i] = llvm::ConstantExpr::getTruncOrBitCast(
+            llvm::ConstantExpr::getSizeOf(ty), intTy);
+    }
+
+    // Generate a loop over the batches.  The remainder is computed in the
+    // block following the loop.
+    llvm::Value* numBatches = 
+        mBuilder->CreateSDiv(numValues, GetInt(batchSize), "numBatches");
+    llvm::Value* batchIndex;
+    llvm::BasicBlock* batchBody = GenLoop(numBatches, &batchIndex);
+    llvm::BasicBlock* batchDone = mBuilder->GetInsertBlock();
+    llvm::BasicBlock* batchNext = OpenLoopBody(batchBody);
+
+    // Gather the values of the varying arguments, advancing their iterators.
+    for (size_t i = 0; i < numArgs; ++i) {
+        if (buffers[i] == NULL)
+            continue;
+        llvm::Value* buffer = 
+            mBuilder->CreateBitCast(buffers[i], bufferPtrTy);
+        llvm::Value* ptrs = dataPtrs[i] ?
+            mBuilder->CreateBitCast(dataPtrs[i], ptrsPtrTy) :
+            llvm::ConstantPointerNull::get(
+                llvm::cast<llvm::PointerType>(ptrsPtrTy));
+        llvm::Value* gatherArgs[] = 
+            { iterators[i], buffer, ptrs, GetInt(batchSize), sizes[i] };
+        mBuilder->CreateCall(gatherIter, gatherArgs);
+    }
+
+    // Call the lane kernel, passing the lane buffers of the varying
+    // arguments.
+    for (size_t i = 0; i < numArgs; ++i)
+        if (buffers[i])
+            kernelArgs[i] = buffers[i];
+    if (mArena)
+        kernelArgs.push_back(mArena);
+    mBuilder->CreateCall(laneFunc, kernelArgs);
+
+    // Scatter the lane values of the modified arguments back to the
+    // argument data and continue with the next batch.
+    for (size_t i = 0; i < numArgs; ++i) {
+        if (dataPtrs[i] == NULL)
+            continue;
+        llvm::Value* buffer = 
+            mBuilder->CreateBitCast(buffers[i], bufferPtrTy);
+        llvm::Value* ptrs = mBuilder->CreateBitCast(dataPtrs[i], ptrsPtrTy);
+        mBuilder->CreateCall4(scatter, buffer, ptrs, 
+                              GetInt(batchSize), sizes[i]);
+    }
+    mBuilder->CreateBr(batchNext);
+
+    // The remaining points are processed after the batch loop.
+    mBuilder->SetInsertPoint(batchDone);
+    return mBuilder->CreateSRem(numValues, GetInt(batchSize), "numRemaining");
 }
 
 // Generate code to dereference the iterators, obtaining a data pointer
-// for each.
+// for each.  Hoisted uniform arguments are passed along unchanged.
 void
 CgShader::GenDerefIterators(const IRVars& args,
                             const std::vector<llvm::Value*>& iterators,
+                            const std::vector<llvm::Value*>& uniformArgs,
                             std::vector<llvm::Value*>* kernelArgs)
 {
     // Load the data pointer for each iterator and cast it if necessary:
@@ -424,18 +1731,26 @@ CgShader::GenDerefIterators(const IRVars& args,
 
     IRVars::const_iterator argIt = args.begin();
     std::vector<llvm::Value*>::const_iterator iter = iterators.begin();
-    for (; argIt != args.end() && iter != iterators.end(); ++argIt, ++iter) {
+    std::vector<llvm::Value*>::const_iterator uniformArg = uniformArgs.begin();
+    for (; argIt != args.end() && iter != iterators.end(); 
+         ++argIt, ++iter, ++uniformArg) {
+        if (*uniformArg) {
+            kernelArgs->push_back(*uniformArg);
+            continue;
+        }
         IRVar* argVar = *argIt;
-        llvm::Twine argName = llvm::Twine("_") + argVar->GetShortName();
+        std::string argName = std::string("_") + argVar->GetShortName();
         // Load the data pointer.
         llvm::Value* iterVal = *iter;
         llvm::Value* data = mBuilder->CreateCall(derefIter, iterVal);
-        // Cast to the argument type.  For now all parameters are passed by
-        // reference.
+        // Cast to the argument type, loading the value if it's passed by
+        // value.
         llvm::Type* argType = 
             mTypes->ConvertParamType(argVar->GetType(), true /*isOutput*/);
         llvm::Value* argVal =
             mBuilder->CreateBitCast(data, argType, argName+"_ptr");
+        if (IsPassedByValue(argVar))
+            argVal = mBuilder->CreateLoad(argVal, argName);
         kernelArgs->push_back(argVal);
     }
 }
@@ -478,26 +1793,42 @@ CgShader::GenPluginCall(const char* name, const IRVars& argVars,
 }
 
 // Define an LLVM function that takes the specified IR variables as arguments.
-// A unique function name based on the given hint is employed.
+// A unique function name based on the given hint is employed.  If the number
+// of lanes is greater than one, varying arguments are passed as pointers to
+// lane arrays.  Unmodified scalar inputs are passed by value (see
+// IsPassedByValue).
 llvm::Function*
-CgShader::GenKernelFunc(const char* nameHint, const IRVars& args)
+CgShader::GenKernelFunc(const char* nameHint, const IRVars& args,
+                        int numLanes)
 {
     // Combine the shader parameters and globals, which will be the
     // entry point parameters.
     size_t numArgs = args.size();
 
-    // Gather parameter types.  For now, all parameters are passed by
-    // reference, since we don't know which ones are outputs.
+    // Gather parameter types.  Other than unmodified scalar inputs, all
+    // parameters are passed by reference.
     std::vector<llvm::Type*> argTypes;
     argTypes.reserve(numArgs);
     IRVars::const_iterator v;
     for (v = args.begin(); v != args.end(); ++v) {
         IRVar* var = *v;
-        llvm::Type* ty = 
-            mTypes->ConvertParamType(var->GetType(), true /*isOutput*/);
+        llvm::Type* ty;
+        if (numLanes > 1 && var->GetDetail() == kIRVarying) {
+            llvm::Type* elemTy = mTypes->ConvertExternal(var->GetType());
+            ty = llvm::PointerType::getUnqual(
+                llvm::ArrayType::get(elemTy, numLanes));
+        }
+        else
+            ty = mTypes->ConvertParamType(var->GetType(), 
+                                          !IsPassedByValue(var));
         argTypes.push_back(ty);
     }
 
+    // The per-call arena, if any, is passed as an extra parameter.
+    if (mNeedsArena)
+        argTypes.push_back(
+            llvm::PointerType::getUnqual(GetClassType("OpArena")));
+
     // Create LLVM function type.
     llvm::Type* voidTy = llvm::Type::getVoidTy(*mContext);
     llvm::FunctionType* funcTy =
@@ -505,32 +1836,123 @@ CgShader::GenKernelFunc(const char* nameHint, const IRVars& args)
 
     // Create function definition.  Note that LLVM will create a unique
     // name if necessary.
-    llvm::Twine name = llvm::Twine(nameHint) + "_kernel";
+    std::string name = std::string(nameHint) + 
+        (numLanes > 1 ? "_lanes" : "_kernel");
     llvm::Function::LinkageTypes linkage = llvm::Function::ExternalLinkage;
     llvm::CallingConv::ID callingConv = llvm::CallingConv::C;
     llvm::Function* function =
         llvm::Function::Create(funcTy, linkage, name, mModule);
     function->setCallingConv(callingConv);
 
-    // Add "noalias" and "nocapture" attributes to each parameter.
-    // Set the parameter names and record their locations.
+    // Create an entry block and use it as the IRBuilder's insertion point.
+    llvm::BasicBlock* block = 
+        llvm::BasicBlock::Create(*mContext, "entry", function);
+    mBuilder->SetInsertPoint(block);
+
+    // Add "noalias" and "nocapture" attributes to each pointer parameter.
+    // Set the parameter names and record their locations.  Parameters that
+    // are passed by value are bound to their values if the kernel keeps
+    // locals in registers, and are otherwise stored in local variables, as
+    // are triples and matrices that are represented as LLVM vectors.
+    mVectorArgs.clear();
     llvm::Function::arg_iterator it;
     size_t i = 0;
     for (it = function->arg_begin(); it != function->arg_end(); ++it, ++i) {
-        IRVar* var = args[i];
         llvm::Argument* param = &(*it);
-        param->addAttr(llvm::Attribute::NoAlias | llvm::Attribute::NoCapture);
+        if (i == numArgs) {
+            assert(mNeedsArena && "Unexpected kernel parameter");
+            param->setName("arena");
+            param->addAttr(llvm::Attribute::NoAlias | 
+                           llvm::Attribute::NoCapture);
+            mVars->SetArena(param);
+            continue;
+        }
+        IRVar* var = args[i];
         param->setName(llvm::Twine("_") + var->GetShortName());
-        mVars->Bind(var, param);
+        bool isLanes = numLanes > 1 && var->GetDetail() == kIRVarying;
+        if (IsPassedByValue(var) && !isLanes) {
+            if (mOptions.mSSAVars && numLanes == 1) {
+                mVars->BindValue(var, param);
+                continue;
+            }
+            llvm::Value* location = 
+                GenAlloca(param->getType(), param->getName() + "_addr");
+            mBuilder->CreateStore(param, location);
+            mVars->Bind(var, location);
+            continue;
+        }
+        param->addAttr(llvm::Attribute::NoAlias | llvm::Attribute::NoCapture);
+        llvm::Value* location = param;
+        if (mTypes->HasVectorType(var->GetType())) {
+            llvm::Type* ty = mTypes->Convert(var->GetType());
+            if (isLanes)
+                ty = llvm::ArrayType::get(ty, numLanes);
+            VectorArg arg = 
+                { var, param, GenAlloca(ty, param->getName() + "_vec") };
+            GenCopyArg(arg, numLanes, false /*toExternal*/);
+            mVectorArgs.push_back(arg);
+            location = arg.mLocation;
+        }
+        if (isLanes)
+            mVars->BindLanes(var, location);
+        else
+            mVars->Bind(var, location);
     }
-
-    // Create an entry block and use it as the IRBuilder's insertion point.
-    llvm::BasicBlock* block = 
-        llvm::BasicBlock::Create(*mContext, "entry", function);
-    mBuilder->SetInsertPoint(block);
     return function;
 }
 
+// Copy a kernel argument that is represented as an LLVM vector between its
+// parameter, which has the external type (e.g. OpVec3), and its local
+// variable.  This is the only place such arguments are converted, so the
+// kernel body can keep them in SIMD registers.  Lane arrays are copied one
+// element at a time.
+void
+CgShader::GenCopyArg(const VectorArg& arg, int numLanes, bool toExternal)
+{
+    const IRType* ty = arg.mVar->GetType();
+    bool isLanes = numLanes > 1 && arg.mVar->GetDetail() == kIRVarying;
+    for (int lane = 0; lane < (isLanes ? numLanes : 1); ++lane) {
+        llvm::Value* param = arg.mParam;
+        llvm::Value* location = arg.mLocation;
+        if (isLanes) {
+            llvm::Value* indices[] = { GetInt(0), GetInt(lane) };
+            param = mBuilder->CreateInBoundsGEP(param, indices);
+            location = mBuilder->CreateInBoundsGEP(location, indices);
+        }
+        if (toExternal)
+            mVars->StoreExternal(mBuilder->CreateLoad(location), param, ty);
+        else
+            mBuilder->CreateStore(mVars->LoadExternal(param, ty), location);
+    }
+}
+
+// Check whether uniform arguments are loaded before the kernel loop, which is
+// required when uniform instructions are hoisted.
+bool
+CgShader::IsHoisting() const
+{
+    return mOptions.mHoistUniforms || mOptions.mPartition.mAllowUniform;
+}
+
+// Check whether an argument of the current partition is a uniform argument
+// that is loaded before the kernel loop (see GenUniformArgs).
+bool
+CgShader::IsHoisted(const IRVar* var) const
+{
+    return IsHoisting() && var->GetDetail() == kIRUniform;
+}
+
+// Check whether an argument of the current partition is passed to the kernel
+// by value, which is the case for unmodified uniform scalars (and varying
+// scalars if kernel locals are kept in registers).  Varying arguments of lane
+// kernels are always passed as lane arrays.
+bool
+CgShader::IsPassedByValue(const IRVar* var) const
+{
+    return (mUniformInputs.Has(var) || mVaryingInputs.Has(var)) &&
+        !CgTypes::IsPassByRef(var->GetType());
+}
+
 // Generate RSL prototype for a void plugin entry function with the specified
 // name and arguments.
 std::string
@@ -580,7 +2002,8 @@ CgShader::GenRslFuncTable()
 
     // Construct a new struct constant containing a pointer to the RslFunction
     // array, along with the values from the original initializer (the version
-    // number and null init/cleanup function pointers).
+    // number, a null init function pointer, and the cleanup function, which
+    // frees the string pool).
     std::vector<llvm::Constant*> elements(4);
     elements[0] = funcArrayPtr;
     elements[1] = initStruct->getOperand(1);
@@ -708,13 +2131,41 @@ CgShader::ShouldCompile(IRStmt* stmt)
     if (numInsts == 0)
         return false;
 
+    // Resizable arrays can't be passed to plugin functions.
+    if (HasResizableFreeVars(stmt))
+        return false;
+
+    // Nothing is gained by compiling a partition that consists entirely of
+    // uniform instructions, which would be executed only once.
+    if (mOptions.mPartition.mAllowUniform && IsUniform(stmt))
+        return false;
+
+    // If a profile was given, compile only if the measured timings predict
+    // a benefit.  Otherwise consult the cost model, if any.
+    if (mOptions.mProfile) {
+        assert(mOptions.mCostModel && "Profile requires a cost model");
+        if (!mOptions.mProfile->ShouldCompile(stmt, *mOptions.mCostModel))
+            return false;
+    }
+    else if (mOptions.mCostModel &&
+             !mOptions.mCostModel->ShouldCompile(stmt))
+        return false;
+
     // If XfPartitionInfo hasn't been run (e.g. in a unit test),
     // compile the partition unconditionally.
     if (numInsts < 0)
         return true;
 
-    // For now use an optional minimum instruction count threshold.
-    return numInsts >= mMinPartitionSize;
+    // Otherwise use an optional minimum instruction count threshold.
+    return numInsts >= mOptions.mMinPartitionSize;
+}
+
+// Check whether the points of the given partition should be processed in
+// batches, which requires a lane kernel (see CgStmt::CanGenLanes).
+bool
+CgShader::ShouldBatch(const IRStmt* stmt) const
+{
+    return mOptions.mBatchSize > 1 && CgStmt::CanGenLanes(stmt);
 }
 
 IRStmt*
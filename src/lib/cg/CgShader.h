@@ -6,7 +6,9 @@
 #define CG_SHADER_H
 
 #include "cg/CgComponent.h"
+#include "cg/CgOptions.h"
 #include "ir/IRTypedefs.h"
+#include "ir/IRVarSet.h"
 #include "ir/IRVisitor.h"
 #include <list>
 #include <vector>
@@ -23,6 +25,11 @@ llvm::Module* CgShaderCodegen(IRShader* shader, UtLog* log,
                               int minPartitionSize=1,
                               bool dumpIR=false);
 
+/// Generate code for a shader with the specified options.
+llvm::Module* CgShaderCodegen(IRShader* shader, UtLog* log, 
+                              llvm::LLVMContext* context,
+                              const CgOptions& options);
+
 /// Implementation of shader codegen.  The methods are all public for unit
 /// testing.
 class CgShader : public CgComponent, public IRVisitor<CgShader> {
@@ -32,31 +39,84 @@ private:
     const char* mCurrentFuncName;
     std::list<llvm::Function*> mEntryFuncs;
     std::list<const IRStringConst*> mEntryPrototypes;
-    int mMinPartitionSize;
-    bool mDumpIR;
+    CgOptions mOptions;
+    IRVarSet mUniformInputs;
+    IRVarSet mVaryingInputs;
+
+    // The varying arguments that a batched kernel does not modify, which
+    // need not be scattered back to the argument data (see GenBatchLoop).
+    IRVarSet mBatchInputs;
+    IRInsts mHoistedInsts;
+    IRVarSet mHoistedTemps;
+
+    // Whether the current partition requires a per-call arena (see OpArena),
+    // and its location in the entry function (NULL if there is none).
+    bool mNeedsArena;
+    llvm::Value* mArena;
+
+    // A kernel argument represented as an LLVM vector, which is copied
+    // between its parameter and a local variable (see GenCopyArg).
+    struct VectorArg {
+        IRVar* mVar;
+        llvm::Value* mParam;
+        llvm::Value* mLocation;
+    };
+    std::vector<VectorArg> mVectorArgs;
 
 public:
     CgShader(UtLog* log, llvm::LLVMContext* context,
-             int minPartitionSize=1, bool dumpIR=false);
+             const CgOptions& options=CgOptions());
     ~CgShader();
 
     llvm::Module* Codegen(IRShader* shader);
     void CodegenSetup(IRShader* shader);
     IRStmt* CodegenPartition(IRStmt* stmt);
-    llvm::Function* GenKernel(IRStmt* stmt, const IRVars& args);
-    llvm::Function* GenKernelFunc(const char* nameHint, const IRVars& args);
-    llvm::Function* GenEntry(llvm::Function* kernelFunc, const IRVars& args);
+    llvm::Function* GenKernel(IRStmt* stmt, const IRVars& args,
+                              int numLanes=1, bool isGridPhase=false);
+    llvm::Function* GenKernelFunc(const char* nameHint, const IRVars& args,
+                                  int numLanes=1);
+    void GenCopyArg(const VectorArg& arg, int numLanes, bool toExternal);
+    llvm::Function* GenEntry(llvm::Function* kernelFunc, const IRVars& args,
+                             llvm::Function* laneFunc=NULL, int batchSize=1);
+    llvm::Function* GenGridEntry(IRStmt* stmt, const IRVars& args,
+                                 int statusArg);
     llvm::Function* GenEntryStub(const std::string& name);
+    void GenEntryArena();
+    void GenEntryReturn();
+    void GenPersistStrings(const IRVar* var, llvm::Value* location,
+                           llvm::Value* arena, int numLanes=1);
     void GenIterators(llvm::Function* entryFunc, const IRVars& args,
                       llvm::Value* argv,
                       std::vector<llvm::Value*>* iterators);
+    void GenUniformArgs(const IRVars& args, llvm::Value* argv,
+                        std::vector<llvm::Value*>* uniformArgs);
+    void GenHoistedInsts(const IRVars& args, 
+                         const std::vector<llvm::Value*>& locations);
     void GenKernelLoop(llvm::Function* entryFunc, llvm::Function* kernelFunc,
                        const IRVars& args, llvm::Value* argv,
-                       const std::vector<llvm::Value*>& iterators);
-    llvm::BasicBlock* GenLoop(llvm::Value* loopBound, llvm::Value** loopIndex);
+                       const std::vector<llvm::Value*>& iterators,
+                       const std::vector<llvm::Value*>& uniformArgs,
+                       llvm::Function* laneFunc=NULL, int batchSize=1);
+    void GenStrideLoops(llvm::Function* kernelFunc, const IRVars& args,
+                        const std::vector<llvm::Value*>& iterators,
+                        const std::vector<llvm::Value*>& uniformArgs,
+                        llvm::Value* numValues);
+    void GenStrideLoop(llvm::Function* kernelFunc, const IRVars& args,
+                       const std::vector<llvm::Value*>& uniformArgs,
+                       const std::vector<llvm::Value*>& bases,
+                       const std::vector<llvm::Value*>& strides,
+                       llvm::Value* numValues, bool isContiguous);
+    llvm::Value* GenBatchLoop(llvm::Function* laneFunc, const IRVars& args,
+                              const std::vector<llvm::Value*>& iterators,
+                              const std::vector<llvm::Value*>& uniformArgs,
+                              llvm::Value* numValues, int batchSize);
     void GenDerefIterators(const IRVars& args,
                            const std::vector<llvm::Value*>& iterators,
+                           const std::vector<llvm::Value*>& uniformArgs,
                            std::vector<llvm::Value*>* kernelArgs);
+    bool IsHoisting() const;
+    bool IsHoisted(const IRVar* var) const;
+    bool IsPassedByValue(const IRVar* var) const;
     std::string GenPrototype(const char* funcName, const IRVars& args);
     IRStmt* GenPluginCall(const char* name, const IRVars& argVars, 
                           const IRStringConst* prototype, const IRPos& pos);
@@ -69,6 +129,7 @@ public:
 
     IRStmt* Walk(IRStmt* stmt);
     bool ShouldCompile(IRStmt* stmt);
+    bool ShouldBatch(const IRStmt* stmt) const;
     IRStmt* Visit(IRBlock* stmt, int ignored);
     IRStmt* Visit(IRSeq* stmt, int ignored);
     IRStmt* Visit(IRIfStmt* stmt, int ignored);
@@ -2,8 +2,14 @@
 // Licensed under the terms of the MIT License.
 // See http://www.opensource.org/licenses/mit-license.php.
 
+#include "ops/OpArena.h"
+#include "ops/OpDeriv.h"
+#include "ops/OpString.h"
+#include "ops/OpTexture.h"
 #include "ops/OpTypes.h"
 #include <RslPlugin.h>
+#include <stdlib.h>
+#include <string.h>
 
 extern "C" {
 
@@ -26,6 +32,15 @@ float* CgDerefIter(CgIter* it)
     return it->mData;
 }
 
+// Get a pointer to the data of the specified argument.  Used for uniform
+// arguments, which need not be iterated.
+float* CgGetData(const RslArg** argv, int argNum)
+{
+    CgIter it;
+    CgGetIter(argv, argNum, &it);
+    return it.mData;
+}
+
 // Increment an interator.
 void CgIncIter(CgIter* it)
 {
@@ -33,12 +48,200 @@ void CgIncIter(CgIter* it)
     ++it->mIncrList;
 }
 
+// Get the stride (in floats) of an iterator over the next n values, or -1 if
+// the increments vary.  The increments of a uniform argument are zero.  A
+// varying argument's increments skip inactive points (e.g. in varying
+// conditionals), so they must all be checked.
+int CgIterStride(const CgIter* it, int n)
+{
+    if (n <= 0 || !it->mIsVarying)
+        return 0;
+    unsigned int stride = it->mIncrList[0];
+    for (int i = 1; i < n; ++i)
+        if (it->mIncrList[i] != stride)
+            return -1;
+    return static_cast<int>(stride);
+}
+
+// Gather the values of a varying argument for a batch of points into a
+// contiguous buffer, advancing the iterator.  Unless ptrs is NULL (e.g. for
+// inputs), the data pointers are recorded so the values can be scattered
+// back after the batch is processed.  The size is the number of bytes per
+// value.
+void CgGatherIter(CgIter* it, char* buffer, float** ptrs, 
+                  int batchSize, int size)
+{
+    for (int i = 0; i < batchSize; ++i) {
+        if (ptrs)
+            ptrs[i] = it->mData;
+        memcpy(buffer + i*size, it->mData, size);
+        it->mData += *it->mIncrList;
+        ++it->mIncrList;
+    }
+}
+
+// Scatter a batch of values back to the argument data recorded by
+// CgGatherIter.
+void CgScatter(const char* buffer, float** ptrs, int batchSize, int size)
+{
+    for (int i = 0; i < batchSize; ++i)
+        memcpy(ptrs[i], buffer + i*size, size);
+}
+
 // Get the number of values for the specified argument.
 int CgNumValues(const RslArg** argv, int argNum)
 {
     return argv[argNum]->NumValues();
 }
 
+// The renderer's description of the grid, which compiled derivatives
+// require.  The plugin interface provides no access to it, so the host
+// installs one by calling CgSetGridInfo before rendering.
+static OpGridInfo* gCgGridInfo = NULL;
+
+// Install the grid info used by compiled derivatives.
+PRMANEXPORT void CgSetGridInfo(OpGridInfo* info)
+{
+    gCgGridInfo = info;
+}
+
+// Determine the topology of the grid of n points shaded by a plugin call
+// from the renderer's grid info (see OpGridInit).  Returns zero if it's not
+// available, or if some points are inactive, in which case the entry
+// function returns without shading any points and the interpreted code is
+// executed instead (see CgShader::GenGridEntry).  The surface parameters are
+// supplied later by CgGridSetParams.
+int CgGridInit(OpGrid* grid, RslContext* context, int n)
+{
+    int numU, numV;
+    return gCgGridInfo && gCgGridInfo->GetGridSize(context, &numU, &numV) &&
+        OpGridInit(grid, numU, numV, NULL, NULL, n);
+}
+
+// Set the surface parameters of the points of a grid.
+void CgGridSetParams(OpGrid* grid, const float* u, const float* v)
+{
+    grid->mU = u;
+    grid->mV = v;
+}
+
+// Allocate a buffer for n values of the given size (in bytes), which holds
+// a variable for every point of the grid.  The buffer is zeroed, so
+// resizable arrays are initially empty (see OpDynArray).
+char* CgGridAlloc(int n, int size)
+{
+    return static_cast<char*>(calloc(n > 0 ? n : 1, size > 0 ? size : 1));
+}
+
+// Free a buffer allocated by CgGridAlloc.
+void CgGridFree(char* buffer)
+{
+    free(buffer);
+}
+
+// Free the memory allocated from the per-call arena (see OpArena), which
+// holds the elements of resizable arrays.
+void CgArenaFree(OpArena* arena)
+{
+    OpArenaFree(arena);
+}
+
+// Strings that outlive a call are interned in a global pool, which is shared
+// by all plugin functions, and freed when the plugin is unloaded.
+static OpStringPool gCgStringPool = {
+    { NULL, 0, 0 }, PTHREAD_MUTEX_INITIALIZER
+};
+
+// Replace any of the given strings that were interned in the per-call arena
+// by permanent copies (see OpStringPersist).  Called before a kernel returns
+// for strings stored in plugin arguments.
+void CgPersistStrings(OpArena* arena, const char** strings, int n)
+{
+    OpStringPersist(&gCgStringPool, arena, strings, n);
+}
+
+// Cleanup function of the plugin's function table, which the renderer calls
+// when the plugin is unloaded.
+void CgCleanup(RixContext* context)
+{
+    OpStringPoolFree(&gCgStringPool);
+}
+
+// Derivatives over the whole grid (see OpDeriv.h).  Strides and sizes are
+// in floats.
+void CgGridDu(const OpGrid* grid, float* r, const float* x, int xStride,
+              int size)
+{
+    OpGridDu(*grid, r, x, xStride, size);
+}
+
+void CgGridDv(const OpGrid* grid, float* r, const float* x, int xStride,
+              int size)
+{
+    OpGridDv(*grid, r, x, xStride, size);
+}
+
+void CgGridDeriv(const OpGrid* grid, float* r, const float* x, int xStride,
+                 int size, const float* y, int yStride)
+{
+    OpGridDeriv(*grid, r, x, xStride, size, y, yStride);
+}
+
+void CgGridArea(const OpGrid* grid, float* r, const float* p, int pStride)
+{
+    OpGridArea(*grid, r, p, pStride);
+}
+
+void CgGridCalculateNormal(const OpGrid* grid, float* r, const float* p,
+                           int pStride)
+{
+    OpGridCalculateNormal(*grid, r, p, pStride);
+}
+
+// The texture system that performs batched texture lookups.  The plugin
+// interface provides no access to the renderer's texture system, so the
+// host installs one by calling CgSetTextureSystem before rendering.
+// Without one, partitions containing texture lookups are interpreted.
+static OpTextureSystem* gCgTextureSystem = NULL;
+
+// Install the texture system used by compiled texture lookups.
+PRMANEXPORT void CgSetTextureSystem(OpTextureSystem* textures)
+{
+    gCgTextureSystem = textures;
+}
+
+// Check whether a texture system has been installed.
+int CgHasTextureSystem()
+{
+    return gCgTextureSystem != NULL;
+}
+
+// Look up a texture for the whole grid (see OpTextureSystem), filtering
+// over the differences in s and t between neighboring points.
+void CgGridTexture(const OpGrid* grid, const char* name, int channel,
+                   int numChannels, int n, const float* s, const float* t,
+                   float* r)
+{
+    float* widths = (float*) CgGridAlloc(2*n, sizeof(float));
+    OpGridFilterWidth(*grid, widths, s, 1);
+    OpGridFilterWidth(*grid, widths + n, t, 1);
+    gCgTextureSystem->Texture(name, channel, numChannels, n, s, t,
+                              widths, widths + n, r);
+    CgGridFree((char*) widths);
+}
+
+// Look up an environment map for the whole grid (see OpTextureSystem),
+// filtering over the angles between neighboring directions.
+void CgGridEnvironment(const OpGrid* grid, const char* name, int channel,
+                       int numChannels, int n, const float* dirs, float* r)
+{
+    float* widths = (float*) CgGridAlloc(n, sizeof(float));
+    OpGridAngularWidth(*grid, widths, dirs, 3);
+    gCgTextureSystem->Environment(name, channel, numChannels, n, dirs,
+                                  widths, r);
+    CgGridFree((char*) widths);
+}
+
 // Skeletal declaration of plugin entry point.
 PRMANEXPORT int
 CgEntryFunc(RslContext* rslContext, int argc, const RslArg** argv)
@@ -62,8 +265,9 @@ CgEntryFunc(RslContext* rslContext, int argc, const RslArg** argv)
     return 0;
 }
 
-// Skeletal function table.
-PRMANEXPORT RslFunctionTable RslPublicFunctions(NULL, NULL, NULL);
+// Skeletal function table.  The function array is filled in by
+// CgShader::GenRslFuncTable.
+PRMANEXPORT RslFunctionTable RslPublicFunctions(NULL, NULL, CgCleanup);
 
 // These NULL function pointers are used when instantiating the function table.
 RslEntryFunc gCgNullEntryFunc = NULL;
@@ -4,10 +4,15 @@
 
 #include "cg/CgStmt.h"
 #include "cg/CgInst.h"
+#include "cg/CgTypes.h"
 #include "cg/CgValue.h"
+#include "cg/CgVars.h"
 #include "ir/IRInst.h"
+#include "ir/IRVarSet.h"
+#include "ops/OpInfo.h"
 #include "ops/Opcode.h"
 #include "util/UtLog.h"
+#include "xf/XfDefUse.h"
 #include <llvm/DerivedTypes.h>
 #include <llvm/Function.h>
 #include <llvm/Support/IRBuilder.h>
@@ -20,8 +25,145 @@ CgStmt::Codegen(IRStmt* stmt) const
     const_cast<CgStmt*>(this)->Dispatch<void>(stmt, 0);
 }
 
+// Generate lane code for an IR statement, which must satisfy CanGenLanes.
+// The varying free variables must be bound to lane arrays.
+void
+CgStmt::CodegenLanes(IRStmt* stmt, int numLanes) const
+{
+    assert(CanGenLanes(stmt) && "Unsupported statement in lane code");
+    CgStmt* self = const_cast<CgStmt*>(this);
+    self->mNumLanes = numLanes;
+    mVars->SetNumLanes(numLanes);
+
+    // Initially all lanes are active.
+    self->mMask = self->NewMask("mask");
+    LaneLoop loop = self->BeginLanes();
+    mBuilder->CreateStore(mBuilder->getTrue(),
+                          self->GetMaskElement(mMask, loop.mLane));
+    self->EndLanes(loop);
+
+    Codegen(stmt);
+
+    self->mNumLanes = 1;
+    self->mMask = NULL;
+    mVars->SetNumLanes(1);
+}
+
+// Check whether lane code can be generated for a statement.  Break,
+// continue, and return statements are not supported.
+bool
+CgStmt::CanGenLanes(const IRStmt* stmt)
+{
+    return IsStructured(stmt);
+}
+
+// Check whether a statement is structured, i.e. contains no break, continue,
+// or return statements.
+bool
+CgStmt::IsStructured(const IRStmt* stmt)
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock:
+          return true;
+      case kIRSeq: {
+          const IRStmts& stmts = UtStaticCast<const IRSeq*>(stmt)->GetStmts();
+          IRStmts::const_iterator it;
+          for (it = stmts.begin(); it != stmts.end(); ++it)
+              if (!IsStructured(*it))
+                  return false;
+          return true;
+      }
+      case kIRIfStmt: {
+          const IRIfStmt* ifStmt = UtStaticCast<const IRIfStmt*>(stmt);
+          return IsStructured(ifStmt->GetThen()) && 
+              IsStructured(ifStmt->GetElse());
+      }
+      case kIRForLoop: {
+          const IRForLoop* loop = UtStaticCast<const IRForLoop*>(stmt);
+          return IsStructured(loop->GetCondStmt()) &&
+              IsStructured(loop->GetIterateStmt()) &&
+              IsStructured(loop->GetBody());
+      }
+      case kIRCatchStmt: {
+          const IRCatchStmt* catchStmt = UtStaticCast<const IRCatchStmt*>(stmt);
+          return IsStructured(catchStmt->GetBody());
+      }
+      default:
+          return false;
+    }
+}
+
+// Collect the variables that are assigned by the given statement, returning
+// false if the statement contains statements that assign variables
+// implicitly (see XfDefUse), in which case any variable might be assigned.
+bool
+CgStmt::GetAssignedVars(const IRStmt* stmt, IRVarSet* assigned)
+{
+    XfDefUse summary;
+    summary.Add(stmt);
+    *assigned += summary.GetDefs();
+    return !summary.HasOpaque();
+}
+
+// Check whether the given value is a varying variable.
+static bool
+IsVarying(const IRValue* value)
+{
+    const IRVar* var = UtCast<const IRVar*>(value);
+    return var != NULL && var->GetDetail() == kIRVarying;
+}
+
+// Check whether an instruction operates on a resizable array.
+static bool
+HasResizableOperand(const IRInst* inst)
+{
+    const IRVar* result = inst->GetResult();
+    if (result && CgTypes::IsResizable(result->GetType()))
+        return true;
+    const IRValues& args = inst->GetArgs();
+    for (size_t i = 0; i < args.size(); ++i)
+        if (CgTypes::IsResizable(args[i]->GetType()))
+            return true;
+    return false;
+}
+
+// Check whether all the instructions in a block are speculatable, and collect
+// the varying variables they assign.  Instructions on resizable arrays are
+// not speculated: restoring a descriptor in inactive lanes would not restore
+// elements that were overwritten, and array lengths might differ between
+// lanes.
+static bool
+CanSpeculate(const IRBlock* block, IRVarSet* assigned)
+{
+    const IRInsts& insts = block->GetInsts();
+    IRVarSet defs;
+    IRInsts::const_iterator it;
+    for (it = insts.begin(); it != insts.end(); ++it) {
+        const IRInst* inst = *it;
+        Opcode opcode = inst->GetOpcode();
+        if (!OpInfo::IsSpeculatable(opcode) || HasResizableOperand(inst))
+            return false;
+        XfDefUse::GetInstDefs(inst, &defs);
+    }
+    for (IRVarSet::const_iterator var = defs.begin(); var != defs.end();
+         ++var)
+        if (IsVarying(*var))
+            *assigned += *var;
+    return true;
+}
+
 void 
 CgStmt::Visit(IRBlock* block, int ignored)
+{
+    if (mNumLanes > 1)
+        GenLaneBlock(block);
+    else
+        GenInsts(block);
+}
+
+// Generate code for the instructions in a block.
+void
+CgStmt::GenInsts(const IRBlock* block)
 {
     const IRInsts& insts = block->GetInsts();
     IRInsts::const_iterator it;
@@ -31,6 +173,7 @@ CgStmt::Visit(IRBlock* block, int ignored)
         if (!ok)
             mLog->Write(kUtError, "Codegen unimplemented for instruction '%s'",
                         inst->GetName());
+        mVars->ReloadSpills();
     }
 }
 
@@ -45,6 +188,18 @@ CgStmt::Visit(IRSeq* seq, int ignored)
 
 void 
 CgStmt::Visit(IRIfStmt* ifStmt, int ignored)
+{
+    // In lane code, a uniform condition is the same in every lane, so the
+    // usual branches suffice.
+    if (mNumLanes > 1 && IsVarying(ifStmt->GetCond()))
+        GenLaneIf(ifStmt);
+    else
+        GenIf(ifStmt);
+}
+
+// Generate an "if" statement using conditional branches.
+void
+CgStmt::GenIf(IRIfStmt* ifStmt)
 {
     // Convert the condition to an LLVM value, and then convert the resulting
     // bool (i32) to a bit for LLVM's conditional branch instruction.
@@ -64,25 +219,45 @@ CgStmt::Visit(IRIfStmt* ifStmt, int ignored)
     // Generate conditional branch instruction.
     mBuilder->CreateCondBr(condVal, thenBlock, elseBlock);
 
-    // Generate code for 'then' branch.
+    // Both branches start with the current values of the register variables.
+    CgVars::Bindings registers(mVars->GetRegisters());
+
+    // Generate code for 'then' branch.  Note that it might end in a
+    // different basic block than it started.
     mBuilder->SetInsertPoint(thenBlock);
     Codegen(ifStmt->GetThen());
+    llvm::BasicBlock* thenEnd = mBuilder->GetInsertBlock();
+    CgVars::Bindings thenRegisters(mVars->GetRegisters());
     mBuilder->CreateBr(mergeBlock);
 
     // Add the else block to the function and generate code for 'else' branch.
     function->getBasicBlockList().push_back(elseBlock);
     mBuilder->SetInsertPoint(elseBlock);
+    mVars->SetRegisters(registers);
     Codegen(ifStmt->GetElse());
+    llvm::BasicBlock* elseEnd = mBuilder->GetInsertBlock();
     mBuilder->CreateBr(mergeBlock);
 
     // Add the merge block to the function and set the builder insertion point
-    // before returning.
+    // before returning.  Register variables assigned by either branch are
+    // merged by phi nodes.
     function->getBasicBlockList().push_back(mergeBlock);
     mBuilder->SetInsertPoint(mergeBlock);
+    mVars->GenMerge(thenRegisters, thenEnd, mVars->GetRegisters(), elseEnd);
 }
 
 void 
 CgStmt::Visit(IRForLoop* loop, int ignored)
+{
+    if (mNumLanes > 1 && IsVarying(loop->GetCond()))
+        GenLaneFor(loop);
+    else
+        GenFor(loop);
+}
+
+// Generate a "for" loop using conditional branches.
+void
+CgStmt::GenFor(IRForLoop* loop)
 {
     // Create basic blocks.
     llvm::BasicBlock* condBlock = llvm::BasicBlock::Create(*mContext, "cond");
@@ -96,12 +271,20 @@ CgStmt::Visit(IRForLoop* loop, int ignored)
     loop->mContinueTarget = iterBlock;
 
     // Add condition block and generate a jump to it.
-    llvm::Function* function = mBuilder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* preheader = mBuilder->GetInsertBlock();
+    llvm::Function* function = preheader->getParent();
     function->getBasicBlockList().push_back(condBlock);
     mBuilder->CreateBr(condBlock);
 
-    // Generate code for the loop condition.
+    // The condition block merges the loop entry and the back edge, so
+    // register variables assigned in the loop require phi nodes.
     mBuilder->SetInsertPoint(condBlock);
+    IRVarSet assigned;
+    GetAssignedVars(loop, &assigned);
+    CgVars::Bindings phis;
+    mVars->GenLoopPhis(assigned, preheader, &phis);
+
+    // Generate code for the loop condition.
     Codegen(loop->GetCondStmt());
 
     // Convert the condition to an LLVM value, and then convert the resulting
@@ -109,8 +292,10 @@ CgStmt::Visit(IRForLoop* loop, int ignored)
     llvm::Value* condVal = mValues->ConvertArg(loop->GetCond());
     condVal = mValues->BoolToBit(condVal);
 
-    // Generate conditional branch to the loop body vs. the loop exit.
+    // Generate conditional branch to the loop body vs. the loop exit, which
+    // sees the register values from the end of the condition block.
     mBuilder->CreateCondBr(condVal, bodyBlock, exitBlock);
+    CgVars::Bindings exitRegisters(mVars->GetRegisters());
 
     // Generate code for the loop body.
     function->getBasicBlockList().push_back(bodyBlock);
@@ -126,11 +311,13 @@ CgStmt::Visit(IRForLoop* loop, int ignored)
     function->getBasicBlockList().push_back(iterBlock);
     mBuilder->SetInsertPoint(iterBlock);
     Codegen(loop->GetIterateStmt());
+    mVars->GenLoopEnd(phis, mBuilder->GetInsertBlock());
     mBuilder->CreateBr(condBlock);
 
     // Statements following the loop will be generated in the exit block.
     function->getBasicBlockList().push_back(exitBlock);
     mBuilder->SetInsertPoint(exitBlock);
+    mVars->SetRegisters(exitRegisters);
 }
 
 void 
@@ -183,3 +370,209 @@ CgStmt::Visit(IRStmt* stmt, int ignored)
 {
     assert(false && "Codegen unimplemented for this kind of statement");
 }
+
+// Generate lane code for a block of instructions.  If the instructions are
+// speculatable, they're executed in every lane, and the assigned variables
+// are updated only in active lanes, using select instructions (which LLVM
+// turns into vector blends).  Otherwise inactive lanes branch around the
+// instructions.
+void
+CgStmt::GenLaneBlock(IRBlock* block)
+{
+    if (block->GetInsts().empty())
+        return;
+    IRVarSet assignedSet;
+    bool speculate = CanSpeculate(block, &assignedSet);
+    IRVars assigned;
+    assignedSet.GetSorted(&assigned);
+
+    LaneLoop loop = BeginLanes();
+    llvm::Value* active = 
+        mBuilder->CreateLoad(GetMaskElement(mMask, loop.mLane), "active");
+    if (speculate) {
+        // Save the old values of the assigned variables, execute the
+        // instructions, and restore the old values in inactive lanes.
+        std::vector<llvm::Value*> oldVals;
+        oldVals.reserve(assigned.size());
+        for (size_t i = 0; i < assigned.size(); ++i)
+            oldVals.push_back(mVars->GetValue(assigned[i]));
+        GenInsts(block);
+        for (size_t i = 0; i < assigned.size(); ++i) {
+            llvm::Value* location = mVars->GetLocation(assigned[i]);
+            llvm::Value* newVal = mBuilder->CreateLoad(location);
+            mBuilder->CreateStore(
+                mBuilder->CreateSelect(active, newVal, oldVals[i]), location);
+        }
+    }
+    else {
+        llvm::Function* function = mBuilder->GetInsertBlock()->getParent();
+        llvm::BasicBlock* activeBlock =
+            llvm::BasicBlock::Create(*mContext, "lane", function);
+        llvm::BasicBlock* contBlock =
+            llvm::BasicBlock::Create(*mContext, "lanecont", function);
+        mBuilder->CreateCondBr(active, activeBlock, contBlock);
+        mBuilder->SetInsertPoint(activeBlock);
+        GenInsts(block);
+        mBuilder->CreateBr(contBlock);
+        mBuilder->SetInsertPoint(contBlock);
+    }
+    EndLanes(loop);
+}
+
+// Generate lane code for an "if" statement with a varying condition.  The
+// lanes in which the condition is true execute the "then" branch, and the
+// others execute the "else" branch.
+void
+CgStmt::GenLaneIf(IRIfStmt* ifStmt)
+{
+    // Compute masks for the "then" and "else" branches, noting whether any
+    // lanes are active in each.
+    llvm::Value* thenMask = NewMask("then_mask");
+    llvm::Value* elseMask = NewMask("else_mask");
+    llvm::Type* bitTy = llvm::Type::getInt1Ty(*mContext);
+    llvm::Value* anyThen = GenAlloca(bitTy, "any_then");
+    llvm::Value* anyElse = GenAlloca(bitTy, "any_else");
+    mBuilder->CreateStore(mBuilder->getFalse(), anyThen);
+    mBuilder->CreateStore(mBuilder->getFalse(), anyElse);
+
+    LaneLoop loop = BeginLanes();
+    llvm::Value* active = 
+        mBuilder->CreateLoad(GetMaskElement(mMask, loop.mLane), "active");
+    llvm::Value* cond = 
+        mValues->BoolToBit(mValues->ConvertArg(ifStmt->GetCond()));
+    llvm::Value* thenActive = mBuilder->CreateAnd(active, cond);
+    llvm::Value* elseActive = 
+        mBuilder->CreateAnd(active, mBuilder->CreateNot(cond));
+    mBuilder->CreateStore(thenActive, GetMaskElement(thenMask, loop.mLane));
+    mBuilder->CreateStore(elseActive, GetMaskElement(elseMask, loop.mLane));
+    mBuilder->CreateStore(
+        mBuilder->CreateOr(mBuilder->CreateLoad(anyThen), thenActive), anyThen);
+    mBuilder->CreateStore(
+        mBuilder->CreateOr(mBuilder->CreateLoad(anyElse), elseActive), anyElse);
+    EndLanes(loop);
+
+    // Generate each branch with its mask, skipping it if no lanes are active.
+    llvm::Value* oldMask = mMask;
+    GenMasked(ifStmt->GetThen(), thenMask, anyThen);
+    GenMasked(ifStmt->GetElse(), elseMask, anyElse);
+    mMask = oldMask;
+}
+
+// Generate lane code for a "for" loop with a varying condition.  A lane
+// remains active in the loop until its condition is false, and the loop
+// terminates when no lanes are active.
+void
+CgStmt::GenLaneFor(IRForLoop* loop)
+{
+    // Copy the current mask, which is updated as lanes exit the loop.
+    llvm::Value* loopMask = NewMask("loop_mask");
+    llvm::Type* bitTy = llvm::Type::getInt1Ty(*mContext);
+    llvm::Value* anyActive = GenAlloca(bitTy, "any_active");
+    LaneLoop init = BeginLanes();
+    mBuilder->CreateStore(
+        mBuilder->CreateLoad(GetMaskElement(mMask, init.mLane)), 
+        GetMaskElement(loopMask, init.mLane));
+    EndLanes(init);
+    llvm::Value* oldMask = mMask;
+    mMask = loopMask;
+
+    // Create basic blocks and generate a jump to the condition block.
+    llvm::Function* function = mBuilder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* condBlock = llvm::BasicBlock::Create(*mContext, "cond");
+    llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*mContext, "body");
+    llvm::BasicBlock* exitBlock = llvm::BasicBlock::Create(*mContext, "exit");
+    function->getBasicBlockList().push_back(condBlock);
+    mBuilder->CreateBr(condBlock);
+
+    // Generate code for the condition statement, then deactivate the lanes
+    // in which the condition is false.
+    mBuilder->SetInsertPoint(condBlock);
+    Codegen(loop->GetCondStmt());
+    mBuilder->CreateStore(mBuilder->getFalse(), anyActive);
+    LaneLoop lanes = BeginLanes();
+    llvm::Value* maskElement = GetMaskElement(loopMask, lanes.mLane);
+    llvm::Value* cond = 
+        mValues->BoolToBit(mValues->ConvertArg(loop->GetCond()));
+    llvm::Value* active = 
+        mBuilder->CreateAnd(mBuilder->CreateLoad(maskElement), cond, "active");
+    mBuilder->CreateStore(active, maskElement);
+    mBuilder->CreateStore(
+        mBuilder->CreateOr(mBuilder->CreateLoad(anyActive), active), anyActive);
+    EndLanes(lanes);
+    mBuilder->CreateCondBr(mBuilder->CreateLoad(anyActive),
+                           bodyBlock, exitBlock);
+
+    // Generate the loop body and the iterate statement, followed by a jump to
+    // the condition block.
+    function->getBasicBlockList().push_back(bodyBlock);
+    mBuilder->SetInsertPoint(bodyBlock);
+    Codegen(loop->GetBody());
+    Codegen(loop->GetIterateStmt());
+    mBuilder->CreateBr(condBlock);
+
+    // Statements following the loop will be generated in the exit block.
+    function->getBasicBlockList().push_back(exitBlock);
+    mBuilder->SetInsertPoint(exitBlock);
+    mMask = oldMask;
+}
+
+// Generate lane code for a statement using the given mask, skipping it if
+// the given flag (a pointer to a bit) indicates that no lanes are active.
+void
+CgStmt::GenMasked(IRStmt* stmt, llvm::Value* mask, llvm::Value* anyActive)
+{
+    if (stmt->IsEmpty())
+        return;
+    llvm::Function* function = mBuilder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* activeBlock =
+        llvm::BasicBlock::Create(*mContext, "masked", function);
+    llvm::BasicBlock* contBlock =
+        llvm::BasicBlock::Create(*mContext, "maskedcont");
+    mBuilder->CreateCondBr(mBuilder->CreateLoad(anyActive),
+                           activeBlock, contBlock);
+    mBuilder->SetInsertPoint(activeBlock);
+    mMask = mask;
+    Codegen(stmt);
+    mBuilder->CreateBr(contBlock);
+    function->getBasicBlockList().push_back(contBlock);
+    mBuilder->SetInsertPoint(contBlock);
+}
+
+// Begin a loop over the lanes of a batch, positioning the builder in the
+// loop body and setting the current lane of the variable bindings.
+CgStmt::LaneLoop
+CgStmt::BeginLanes()
+{
+    LaneLoop loop;
+    llvm::BasicBlock* body = GenLoop(GetInt(mNumLanes), &loop.mLane);
+    loop.mDone = mBuilder->GetInsertBlock();
+    loop.mNext = OpenLoopBody(body);
+    mVars->SetLane(loop.mLane);
+    return loop;
+}
+
+// End a loop over the lanes of a batch, positioning the builder after the
+// loop.
+void
+CgStmt::EndLanes(const LaneLoop& loop)
+{
+    mVars->SetLane(NULL);
+    mBuilder->CreateBr(loop.mNext);
+    mBuilder->SetInsertPoint(loop.mDone);
+}
+
+// Allocate a lane mask, which is an array of bits.
+llvm::Value*
+CgStmt::NewMask(const char* name)
+{
+    llvm::Type* bitTy = llvm::Type::getInt1Ty(*mContext);
+    return GenAlloca(llvm::ArrayType::get(bitTy, mNumLanes), name);
+}
+
+// Get a pointer to the specified element of a lane mask.
+llvm::Value*
+CgStmt::GetMaskElement(llvm::Value* mask, llvm::Value* lane)
+{
+    llvm::Value* indices[] = { GetInt(0), lane };
+    return mBuilder->CreateInBoundsGEP(mask, indices);
+}
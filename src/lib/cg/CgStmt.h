@@ -9,19 +9,49 @@
 #include "cg/CgFwd.h"
 #include "ir/IRVisitor.h"
 #include <map>
+class IRVarSet;
 
-/// Code generation for IR statements.
+/// Code generation for IR statements.  
+///
+/// Lane code processes a batch of points in each call.  Varying variables
+/// are lane arrays (see CgVars), and each block of instructions is wrapped in
+/// a loop over the lanes.  Varying conditions are converted to lane masks:
+/// both branches of an "if" statement are executed (skipping a branch when no
+/// lanes are active in it), and a loop runs until every lane has exited.
+/// Speculatable instructions are executed in all lanes, with results
+/// committed to active lanes via select instructions.
 class CgStmt : public CgComponent, public IRVisitor<CgStmt> {
 public:
     /// Constructor
     CgStmt(const CgComponent& state) : 
-        CgComponent(state)
+        CgComponent(state),
+        mNumLanes(1),
+        mMask(NULL)
     {
     }
 
     /// Generate code for an IR statement.
     void Codegen(IRStmt* stmt) const;
 
+    /// Generate lane code for an IR statement, which must satisfy
+    /// CanGenLanes.  The varying free variables must be bound to lane arrays.
+    void CodegenLanes(IRStmt* stmt, int numLanes) const;
+
+    /// Check whether lane code can be generated for a statement.  Break,
+    /// continue, and return statements are not supported.
+    static bool CanGenLanes(const IRStmt* stmt);
+
+    /// Check whether a statement is structured, i.e. contains no break,
+    /// continue, or return statements.  Register variables (see CgVars) are
+    /// only supported in structured code.
+    static bool IsStructured(const IRStmt* stmt);
+
+    /// Collect the variables that are assigned by the given statement (see
+    /// XfDefUse), returning false if the statement contains statements that
+    /// assign variables implicitly (in which case any variable might be
+    /// assigned).
+    static bool GetAssignedVars(const IRStmt* stmt, IRVarSet* assigned);
+
     void Visit(IRBlock* stmt, int ignored);
     void Visit(IRSeq* stmt, int ignored);
     void Visit(IRIfStmt* stmt, int ignored);
@@ -31,6 +61,32 @@ public:
     // void Visit(IRSpecialForm* stmt, int ignored);
     // void Visit(IRPluginCall* stmt, int ignored);
     void Visit(IRStmt* stmt, int ignored);
+
+private:
+    /// Number of lanes (one unless generating lane code).
+    int mNumLanes;
+
+    /// The current lane mask, a pointer to an array of bits.
+    llvm::Value* mMask;
+
+    /// A loop over the lanes of a batch.
+    struct LaneLoop {
+        llvm::Value* mLane;             // The lane index
+        llvm::BasicBlock* mNext;        // Increments the lane index
+        llvm::BasicBlock* mDone;        // Follows the loop.
+    };
+
+    void GenInsts(const IRBlock* block);
+    void GenIf(IRIfStmt* stmt);
+    void GenFor(IRForLoop* loop);
+    void GenLaneBlock(IRBlock* block);
+    void GenLaneIf(IRIfStmt* stmt);
+    void GenLaneFor(IRForLoop* loop);
+    void GenMasked(IRStmt* stmt, llvm::Value* mask, llvm::Value* anyActive);
+    LaneLoop BeginLanes();
+    void EndLanes(const LaneLoop& loop);
+    llvm::Value* NewMask(const char* name);
+    llvm::Value* GetMaskElement(llvm::Value* mask, llvm::Value* lane);
 };
 
 #endif // ndef CG_STMT_H
@@ -0,0 +1,180 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+// The "timers" plugin, which is called by shaders instrumented by
+// XfInstrument.  Each partition is bracketed by StartTimer and StopTimer
+// calls that pass a partition identifier (see XfGetPartitionId).  StopTimer
+// has a varying result, so the number of values it is called with is the
+// number of active points.
+//
+// Timings are accumulated in per-thread slots, so renderer threads don't
+// contend.  Each thread registers its slots (under a lock) the first time it
+// calls the plugin.  When the plugin is unloaded the slots are merged and a
+// report is written to the file named by the POSTHASTE_PROFILE environment
+// variable (default: posthaste.prof).  The report can be given to posthaste
+// with the --profile-use option (see XfProfile).
+
+#include "util/UtTimer.h"
+#include <RslPlugin.h>
+#include <algorithm>
+#include <map>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Accumulated timing of a partition.
+struct Timing {
+    uint64_t mStart;
+    uint64_t mTicks;
+    unsigned int mNumCalls;
+    double mNumPoints;
+
+    Timing() : mStart(0), mTicks(0), mNumCalls(0), mNumPoints(0) { }
+};
+
+// Timings are keyed by partition identifier.
+typedef std::map<std::string, Timing> TimingMap;
+
+// Per-thread timing slots.
+struct ThreadSlots {
+    TimingMap mTimings;
+};
+
+// All per-thread slots, which are merged when the plugin is unloaded.
+std::vector<ThreadSlots*> gAllSlots;
+pthread_mutex_t gAllSlotsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Get the timing slots for the current thread, registering them if necessary.
+ThreadSlots*
+GetSlots(RslContext* ctx)
+{
+    ThreadSlots* slots = static_cast<ThreadSlots*>(ctx->GetThreadData());
+    if (slots == NULL) {
+        slots = new ThreadSlots;
+        ctx->SetThreadData(slots);
+        pthread_mutex_lock(&gAllSlotsLock);
+        gAllSlots.push_back(slots);
+        pthread_mutex_unlock(&gAllSlotsLock);
+    }
+    return slots;
+}
+
+// Get the partition identifier argument.
+const char*
+GetId(const RslArg** argv)
+{
+    RslStringIter id(argv[1]);
+    return *id;
+}
+
+// Sort report entries by decreasing time.
+bool
+CompareTicks(const std::pair<std::string, Timing>& a,
+             const std::pair<std::string, Timing>& b)
+{
+    return a.second.mTicks > b.second.mTicks;
+}
+
+// Merge the per-thread timings and write a report, sorted by decreasing
+// time.  Each line has the partition identifier, number of calls, number of
+// points, seconds, nanoseconds per point, and share of the total instrumented
+// time.  (The time spent in uninstrumented code is unknown.)
+void
+WriteReport(const TimingMap& timings)
+{
+    const char* filename = getenv("POSTHASTE_PROFILE");
+    if (filename == NULL)
+        filename = "posthaste.prof";
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "timers: unable to write profile '%s'\n", filename);
+        return;
+    }
+
+    std::vector<std::pair<std::string, Timing> > entries(timings.begin(),
+                                                         timings.end());
+    std::sort(entries.begin(), entries.end(), CompareTicks);
+    uint64_t totalTicks = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+        totalTicks += entries[i].second.mTicks;
+
+    double freq = UtTimer::GetFreq();
+    fprintf(file, "# id calls points seconds ns/point share\n");
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Timing& timing = entries[i].second;
+        double seconds = timing.mTicks / freq;
+        double nsPerPoint = timing.mNumPoints > 0 ?
+            seconds * 1e9 / timing.mNumPoints : 0.0;
+        double share = totalTicks > 0 ?
+            100.0 * timing.mTicks / totalTicks : 0.0;
+        fprintf(file, "%s %u %.0f %.9f %.3f %.2f%%\n",
+                entries[i].first.c_str(), timing.mNumCalls,
+                timing.mNumPoints, seconds, nsPerPoint, share);
+    }
+    fclose(file);
+}
+
+} // anonymous namespace
+
+extern "C" {
+
+// Start the timer for the specified partition.
+static int
+StartTimer(RslContext* ctx, int argc, const RslArg** argv)
+{
+    Timing* timing = &GetSlots(ctx)->mTimings[GetId(argv)];
+    timing->mStart = UtTimer::GetTicks();
+    return 0;
+}
+
+// Stop the timer for the specified partition, accumulating the elapsed time
+// and the number of active points.
+static int
+StopTimer(RslContext* ctx, int argc, const RslArg** argv)
+{
+    uint64_t stop = UtTimer::GetTicks();
+    Timing* timing = &GetSlots(ctx)->mTimings[GetId(argv)];
+    timing->mTicks += stop - timing->mStart;
+    timing->mNumCalls += 1;
+    timing->mNumPoints += argv[0]->NumValues();
+    return 0;
+}
+
+// Merge the per-thread timings and write the report.
+static void
+CleanupTimers(RixContext* ctx)
+{
+    TimingMap timings;
+    pthread_mutex_lock(&gAllSlotsLock);
+    for (size_t i = 0; i < gAllSlots.size(); ++i) {
+        const TimingMap& slots = gAllSlots[i]->mTimings;
+        TimingMap::const_iterator it;
+        for (it = slots.begin(); it != slots.end(); ++it) {
+            Timing& timing = timings[it->first];
+            timing.mTicks += it->second.mTicks;
+            timing.mNumCalls += it->second.mNumCalls;
+            timing.mNumPoints += it->second.mNumPoints;
+        }
+        delete gAllSlots[i];
+    }
+    gAllSlots.clear();
+    pthread_mutex_unlock(&gAllSlotsLock);
+    if (!timings.empty())
+        WriteReport(timings);
+}
+
+static RslFunction gTimerFunctions[] = {
+    { "void StartTimer(string)", StartTimer, NULL, NULL },
+    { "float StopTimer(string)", StopTimer, NULL, NULL },
+    NULL
+};
+
+PRMANEXPORT RslFunctionTable RslPublicFunctions(gTimerFunctions, NULL,
+                                                CleanupTimers);
+
+} // extern "C"
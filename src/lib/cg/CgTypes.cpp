@@ -9,9 +9,11 @@
 #include <llvm/Type.h>
 #include <llvm/DerivedTypes.h>
 
-CgTypes::CgTypes(const CgComponent& state) :
+CgTypes::CgTypes(const CgComponent& state, bool useVectorTypes) :
     CgComponent(state),
-    mBasicTypes(kIRNumTypeKinds, NULL)
+    mBasicTypes(kIRNumTypeKinds, NULL),
+    mVectorTripleTy(NULL),
+    mVectorMatrixTy(NULL)
 {
     // These types must agree with the shadeops in lib/ops/Ops.cpp.
     llvm::Type* floatTy = llvm::Type::getFloatTy(*GetContext());
@@ -36,6 +38,14 @@ CgTypes::CgTypes(const CgComponent& state) :
         // LLVM requires the use of i8* instead of void*.
         llvm::PointerType::get(llvm::Type::getInt8Ty(*GetContext()),
                                kDefaultAddressSpace);
+
+    // Triples are padded to four elements, which makes them a natural fit
+    // for SIMD registers.  The first three elements have the same layout as
+    // OpVec3, so a pointer to a vector can be passed to a shadeop.
+    if (useVectorTypes) {
+        mVectorTripleTy = llvm::VectorType::get(floatTy, 4);
+        mVectorMatrixTy = llvm::VectorType::get(floatTy, 16);
+    }
 }
 
 
@@ -56,9 +66,28 @@ CgTypes::GetMatrixTy() const
 }
 
 
-// Get the LLVM type for an IR type.
+// Get the LLVM type of values and local variables of the given IR type.
 llvm::Type* 
 CgTypes::Convert(const IRType* ty) const
+{
+    if (mVectorTripleTy && ty->IsTriple())
+        return mVectorTripleTy;
+    if (mVectorMatrixTy && ty->IsMatrix())
+        return mVectorMatrixTy;
+    return ConvertExternal(ty);
+}
+
+// Check whether values of the given type are represented by LLVM vectors,
+// which differ from their external representation.
+bool
+CgTypes::HasVectorType(const IRType* ty) const
+{
+    return mVectorTripleTy && (ty->IsTriple() || ty->IsMatrix());
+}
+
+// Get the external LLVM type for an IR type, which agrees with the shadeops.
+llvm::Type* 
+CgTypes::ConvertExternal(const IRType* ty) const
 {
     IRTypeKind kind = ty->GetKind();
     switch (kind) {
@@ -74,11 +103,10 @@ CgTypes::Convert(const IRType* ty) const
       case kIRShaderTy:
           return mBasicTypes[kind];
       case kIRArrayTy: {
-          // TODO: codegen support resizable arrays.
           const IRArrayType* arrayTy = UtStaticCast<const IRArrayType*>(ty);
-          assert(arrayTy->GetLength() >= 0 &&
-                 "No codegen support for resizable arrays");
-          llvm::Type* elemTy = Convert(arrayTy->GetElementType());
+          if (arrayTy->GetLength() < 0)
+              return GetClassType("OpDynArray");
+          llvm::Type* elemTy = ConvertExternal(arrayTy->GetElementType());
           return llvm::ArrayType::get(elemTy, arrayTy->GetLength());
       }
       case kIRStructTy: {
@@ -86,7 +114,7 @@ CgTypes::Convert(const IRType* ty) const
           unsigned int numMembers = structTy->GetNumMembers();
           std::vector<llvm::Type*> memberTypes(numMembers);
           for (unsigned int i = 0; i < numMembers; ++i)
-              memberTypes[i] = Convert(structTy->GetMemberType(i));
+              memberTypes[i] = ConvertExternal(structTy->GetMemberType(i));
           return llvm::StructType::get(*GetContext(), llvm::ArrayRef<llvm::Type*>(memberTypes));
       }
       case kIRNumTypeKinds:
@@ -106,13 +134,22 @@ CgTypes::IsPassByRef(const IRType* ty)
     return !(ty->IsFloat() || ty->IsBool() || ty->IsString() || ty->IsShader());
 }
 
+// Check whether the specified IR type is an array type with unspecified
+// length, i.e. a resizable array if it's the type of a local variable.
+bool
+CgTypes::IsResizable(const IRType* ty)
+{
+    const IRArrayType* arrayTy = UtCast<const IRArrayType*>(ty);
+    return arrayTy && arrayTy->GetLength() < 0;
+}
+
 // Convert the type of a shader or shadeop parameter.  Input scalars
 // (float, bools, strings, and shader objects) are passed by value, while
 // other types and output parameters are passed by reference.
 llvm::Type* 
 CgTypes::ConvertParamType(const IRType* type, bool isOutput) const
 {
-    llvm::Type* llvmTy = Convert(type);
+    llvm::Type* llvmTy = ConvertExternal(type);
     if (isOutput || IsPassByRef(type))
         llvmTy = llvm::PointerType::get(llvmTy, kDefaultAddressSpace);
     return llvmTy;
@@ -11,18 +11,34 @@
 class IRType;
 
 
-/// Code generation for IR types.
+/// Code generation for IR types.  Values have an external representation,
+/// which agrees with the shadeops (e.g. OpVec3) and with plugin arguments.
+/// Optionally, triples and matrices are represented as LLVM vectors within
+/// kernels, so they can be kept in SIMD registers; they are converted at the
+/// kernel boundary (see CgVars::LoadExternal).
 class CgTypes : public CgComponent {
 public:
-    /// Constructor.
-    CgTypes(const CgComponent& state);
+    /// Constructor.  If useVectorTypes is true, triples are represented as
+    /// <4 x float> vectors (the last element is padding) and matrices as
+    /// <16 x float> vectors.
+    CgTypes(const CgComponent& state, bool useVectorTypes=false);
 
-    /// Convert IR type to LLVM type.
+    /// Convert IR type to the LLVM type of values and local variables.
     llvm::Type* Convert(const IRType* ty) const;
 
+    /// Convert IR type to its external LLVM type, which is used for shadeop
+    /// and kernel arguments.  Array elements always have external types.  A
+    /// resizable array is represented by a descriptor (see OpDynArray).
+    llvm::Type* ConvertExternal(const IRType* ty) const;
+
+    /// Check whether values of the given type are represented by LLVM
+    /// vectors, which differ from their external representation.
+    bool HasVectorType(const IRType* ty) const;
+
     /// Convert the type of a shader or shadeop parameter.  Input scalars
     /// (float, bools, strings, and shader objects) are passed by value, while
-    /// other types and output parameters are passed by reference.
+    /// other types and output parameters are passed by reference.  The
+    /// external type is used.
     llvm::Type* ConvertParamType(const IRType* type, bool isOutput) const;
 
     /// Check whether the specified IR type should be passed/returned by
@@ -30,6 +46,10 @@ public:
     /// bool string, and ashader object).
     static bool IsPassByRef(const IRType* ty);
 
+    /// Check whether the specified IR type is an array type with unspecified
+    /// length.  Local variables of such types are resizable arrays.
+    static bool IsResizable(const IRType* ty);
+
     /// Get the type of a vector, which is a struct containing an array of three
     /// floats (see OpVec3).
     llvm::Type* GetVecTy() const;
@@ -43,6 +63,8 @@ public:
 
 private:
     UtVector<llvm::Type*> mBasicTypes;
+    llvm::Type* mVectorTripleTy;        // NULL unless using vector types.
+    llvm::Type* mVectorMatrixTy;        // NULL unless using vector types.
 };
 
 #endif // ndef CG_TYPES_H
@@ -45,8 +45,10 @@ CgValue::ConvertArg(const IRValue* value) const
     // reference; otherwise get its value (generating a load instruction if
     // necessary).
     const IRVar* var = UtStaticCast<const IRVar*>(value);
-    return mTypes->IsPassByRef(var->GetType()) ? 
-        ConvertArrayPtr(mVars->GetLocation(var)) : mVars->GetValue(var);
+    if (!mTypes->IsPassByRef(var->GetType()))
+        return mVars->GetValue(var);
+    return ConvertExternalPtr(ConvertArrayPtr(mVars->GetLocation(var)),
+                              var->GetType());
 }
 
 // Convert an IR constant to a function argument.  Floats and strings convert
@@ -70,7 +72,22 @@ CgValue::ConvertConstArg(const IRConst* constant) const
                                  value, "");
     // If it's an array, convert the type from pointer-to-array to
     // pointer-to-element, which is the shadeop calling convention.
-    return ConvertArrayPtr(arg);
+    return ConvertExternalPtr(ConvertArrayPtr(arg), constant->GetType());
+}
+
+// Convert the location of a value of the given type to a pointer to its
+// external type.  The layout of an LLVM vector begins with the layout of the
+// corresponding OpVec3 or OpMatrix4, so a bitcast suffices.
+llvm::Value*
+CgValue::ConvertExternalPtr(llvm::Value* location, const IRType* ty) const
+{
+    if (!mTypes->HasVectorType(ty))
+        return location;
+    llvm::Type* ptrTy = 
+        llvm::PointerType::getUnqual(mTypes->ConvertExternal(ty));
+    if (location->getType() == ptrTy)
+        return location;
+    return mBuilder->CreateBitCast(location, ptrTy);
 }
 
 // If the given value is a pointer to an array, convert it to a pointer
@@ -8,6 +8,7 @@
 #include "cg/CgComponent.h"
 class IRValue;
 class IRConst;
+class IRType;
 
 /// Code generation for IR values (variables and constants).
 class CgValue : public CgComponent {
@@ -35,6 +36,13 @@ public:
     /// to the first array element, which is the shadeop calling convention.
     llvm::Value* ConvertArrayPtr(llvm::Value* value) const;
 
+    /// Convert the location of a value of the given type to a pointer to its
+    /// external type (see CgTypes::ConvertExternal), which is the shadeop
+    /// calling convention.  This is a no-op unless the value is represented
+    /// by an LLVM vector.
+    llvm::Value* ConvertExternalPtr(llvm::Value* location,
+                                    const IRType* ty) const;
+
     /// Convert bool (i32) to bit for LLVM branch/select instruction.
     llvm::Value* BoolToBit(llvm::Value* condVal) const;
 };
@@ -6,8 +6,13 @@
 #include "cg/CgTypes.h"
 #include "ir/IRShaderParam.h"
 #include "ir/IRLocalVar.h"
+#include "ir/IRType.h"
+#include "ir/IRVarSet.h"
 #include "util/UtCast.h"
 #include "util/UtLog.h"
+#include <llvm/Constants.h>
+#include <llvm/DerivedTypes.h>
+#include <llvm/Instructions.h>
 #include <llvm/Support/IRBuilder.h>
 #include <llvm/Value.h>
 
@@ -26,6 +31,139 @@ CgVars::Bind(const IRVar* var, llvm::Value* value)
     mBindings[var] = value;
 }
 
+// Bind an IR variable to a pointer to a lane array.
+void 
+CgVars::BindLanes(const IRVar* var, llvm::Value* lanes)
+{
+    assert(llvm::isa<llvm::PointerType>(lanes->getType()) &&
+           "Expected pointer to lane array");
+    Bind(var, lanes);
+    mLaneVars.insert(var);
+}
+
+// Bind an IR variable to an SSA value, which makes it a register variable.
+void
+CgVars::BindValue(const IRVar* var, llvm::Value* value)
+{
+    assert(mBindings.find(var) == mBindings.end() &&
+           mValueVars.find(var) == mValueVars.end() &&
+           "Variable already has a location");
+    mValueVars.insert(var);
+    mRegisters[var] = value;
+}
+
+// Check whether a variable is kept in a register.  If registers are in use,
+// local variables are register variables unless they're bound (e.g. kernel
+// arguments) or aggregates, which are always accessed by location.
+bool
+CgVars::IsRegister(const IRVar* var) const
+{
+    if (mValueVars.find(var) != mValueVars.end())
+        return true;
+    IRTypeKind kind = var->GetType()->GetKind();
+    return mUseRegisters && mNumLanes == 1 &&
+        UtCast<const IRLocalVar*>(var) != NULL &&
+        kind != kIRArrayTy && kind != kIRStructTy &&
+        mBindings.find(var) == mBindings.end();
+}
+
+// Get the current value of a register variable.  A variable that has not
+// been assigned is initially zero.
+llvm::Value*
+CgVars::GetRegister(const IRVar* var)
+{
+    Bindings::const_iterator it = mRegisters.find(var);
+    if (it != mRegisters.end())
+        return it->second;
+    llvm::Value* zero =
+        llvm::Constant::getNullValue(mTypes->Convert(var->GetType()));
+    mRegisters[var] = zero;
+    return zero;
+}
+
+// Get the current value of a register variable in the given set of values,
+// or zero if it's omitted.
+llvm::Value*
+CgVars::GetRegister(const IRVar* var, const Bindings& registers) const
+{
+    Bindings::const_iterator it = registers.find(var);
+    if (it != registers.end())
+        return it->second;
+    return llvm::Constant::getNullValue(mTypes->Convert(var->GetType()));
+}
+
+// Generate phi nodes at the start of the current block, which merges two
+// predecessors, for register variables whose values differ.
+void
+CgVars::GenMerge(const Bindings& registers1, llvm::BasicBlock* pred1,
+                 const Bindings& registers2, llvm::BasicBlock* pred2)
+{
+    // Visit the variables in either set.  Note that the second set might be
+    // the current values, which are not replaced until the end.
+    Bindings merged(registers1);
+    merged.insert(registers2.begin(), registers2.end());
+    Bindings::iterator it;
+    for (it = merged.begin(); it != merged.end(); ++it) {
+        const IRVar* var = it->first;
+        llvm::Value* value1 = GetRegister(var, registers1);
+        llvm::Value* value2 = GetRegister(var, registers2);
+        if (value1 == value2) {
+            it->second = value1;
+            continue;
+        }
+        llvm::PHINode* phi = mBuilder->CreatePHI(
+            value1->getType(), 2, llvm::Twine("_") + var->GetShortName());
+        phi->addIncoming(value1, pred1);
+        phi->addIncoming(value2, pred2);
+        it->second = phi;
+    }
+    mRegisters = merged;
+}
+
+// Generate phi nodes at the start of a loop header for the given register
+// variables, with incoming values from the preheader.
+void
+CgVars::GenLoopPhis(const IRVarSet& vars, llvm::BasicBlock* preheader,
+                    Bindings* phis)
+{
+    for (IRVarSet::const_iterator it = vars.begin(); it != vars.end(); ++it) {
+        const IRVar* var = *it;
+        if (!IsRegister(var))
+            continue;
+        llvm::Value* initial = GetRegister(var);
+        llvm::PHINode* phi = mBuilder->CreatePHI(
+            initial->getType(), 2, llvm::Twine("_") + var->GetShortName());
+        phi->addIncoming(initial, preheader);
+        mRegisters[var] = phi;
+        (*phis)[var] = phi;
+    }
+}
+
+// Add the current values of the register variables as the incoming values
+// of the loop phi nodes from the given latch block.
+void
+CgVars::GenLoopEnd(const Bindings& phis, llvm::BasicBlock* latch)
+{
+    Bindings::const_iterator it;
+    for (it = phis.begin(); it != phis.end(); ++it)
+        llvm::cast<llvm::PHINode>(it->second)->addIncoming(
+            GetRegister(it->first), latch);
+}
+
+// Reload register variables that were spilled during the preceding
+// instruction, which might have modified them.
+void
+CgVars::ReloadSpills()
+{
+    std::set<const IRVar*>::const_iterator it;
+    for (it = mSpilled.begin(); it != mSpilled.end(); ++it) {
+        const IRVar* var = *it;
+        mRegisters[var] = mBuilder->CreateLoad(
+            mSpillSlots[var], llvm::Twine("_") + var->GetShortName());
+    }
+    mSpilled.clear();
+}
+
 // Get a variable's binding.  A new location is created if it's a
     /// previously unencountered local variable.
 llvm::Value*
@@ -33,7 +171,7 @@ CgVars::GetBinding(const IRVar* var, bool shouldExist)
 {
     Bindings::const_iterator it = mBindings.find(var);
     if (it != mBindings.end())
-        return it->second;
+        return GetLaneElement(var, it->second);
 
     // If it's unbound, it had better be a local variable.
     if (UtCast<const IRLocalVar*>(var) == NULL) {
@@ -42,25 +180,59 @@ CgVars::GetBinding(const IRVar* var, bool shouldExist)
         assert(false && "Codegen: Unknown variable");
     }
 
-    // Generate an "alloca" instruction and create a new binding.
-    llvm::Value* location = MakeAlloca(var);
+    // Generate an "alloca" instruction and create a new binding.  Varying
+    // variables have a value per lane when generating code for a batch.
+    if (mNumLanes > 1 && var->GetDetail() == kIRVarying) {
+        BindLanes(var, MakeAlloca(var, true));
+        return GetLaneElement(var, mBindings[var]);
+    }
+    llvm::Value* location = MakeAlloca(var, false);
     Bind(var, location);
     return location;
 }
 
-// Generate an "alloca" instruction for the specified variable
+// Generate an "alloca" instruction for the specified variable, which is
+// optionally a lane array.  Resizable arrays are initially empty, which is
+// represented by a zeroed descriptor.
 llvm::Value*
-CgVars::MakeAlloca(const IRVar* var) const
+CgVars::MakeAlloca(const IRVar* var, bool isLaneArray) const
 {
-    llvm::Twine name = llvm::Twine("_") + var->GetShortName();
+    std::string name = std::string("_") + var->GetShortName();
     llvm::Type* ty = mTypes->Convert(var->GetType());
-    return GenAlloca(ty, name);
+    if (isLaneArray)
+        ty = llvm::ArrayType::get(ty, mNumLanes);
+    llvm::Constant* init = NULL;
+    if (CgTypes::IsResizable(var->GetType()))
+        init = llvm::Constant::getNullValue(ty);
+    return GenAlloca(ty, name, init);
+}
+
+// If the given variable is bound to a lane array, get a pointer to the
+// element for the current lane.  Otherwise the binding is returned.
+llvm::Value*
+CgVars::GetLaneElement(const IRVar* var, llvm::Value* binding)
+{
+    if (mLaneVars.find(var) == mLaneVars.end())
+        return binding;
+    assert(mLane && "Lane array referenced outside of a lane loop");
+    llvm::Value* indices[] = { GetInt(0), mLane };
+    return mBuilder->CreateInBoundsGEP(binding, indices);
 }
 
-// Get the location of a variable.
+// Get the location of a variable.  The value of a register variable is
+// spilled to a temporary location (one per variable, allocated on first
+// use), which is reloaded by ReloadSpills.
 llvm::Value* 
 CgVars::GetLocation(const IRVar* var)
 {
+    if (IsRegister(var)) {
+        llvm::Value*& slot = mSpillSlots[var];
+        if (slot == NULL)
+            slot = MakeAlloca(var, false);
+        mBuilder->CreateStore(GetRegister(var), slot);
+        mSpilled.insert(var);
+        return slot;
+    }
     llvm::Value* binding = GetBinding(var);
     assert(llvm::isa<llvm::PointerType>(binding->getType()) &&
            "Expected a location in variable codegen");
@@ -71,12 +243,89 @@ CgVars::GetLocation(const IRVar* var)
 llvm::Value*
 CgVars::GetValue(const IRVar* var)
 {
-    // Currently all variables are bound to locations.  Eventually we might
-    // pass scalar input arguments of plugin entry functions by value, in
-    // which case the parameters would be bound to the LLVM function args
-    // (llvm::Arg).
+    // Other than register variables, all variables are bound to locations.
+    if (IsRegister(var))
+        return GetRegister(var);
     llvm::Value* binding = GetBinding(var);
     assert(llvm::isa<llvm::PointerType>(binding->getType()) &&
            "Pointer type expected for variable binding");
+    if (IsExternal(var, binding))
+        return LoadExternal(binding, var->GetType());
     return mBuilder->CreateLoad(binding);
 }
+
+// Store the value of a variable, converting it if the variable is bound to a
+// location with an external type.
+void
+CgVars::SetValue(const IRVar* var, llvm::Value* value)
+{
+    // Assigning a register variable supersedes any spilled value.
+    if (IsRegister(var)) {
+        mRegisters[var] = value;
+        mSpilled.erase(var);
+        return;
+    }
+    llvm::Value* location = GetLocation(var);
+    if (IsExternal(var, location))
+        StoreExternal(value, location, var->GetType());
+    else
+        mBuilder->CreateStore(value, location);
+}
+
+// Check whether a variable's location has its external type, which differs
+// from the type of its value.
+bool
+CgVars::IsExternal(const IRVar* var, llvm::Value* location) const
+{
+    if (!mTypes->HasVectorType(var->GetType()))
+        return false;
+    llvm::Type* ty = 
+        llvm::cast<llvm::PointerType>(location->getType())->getElementType();
+    return ty != mTypes->Convert(var->GetType());
+}
+
+// Get a pointer to the ith float of a triple or matrix with its external
+// type.  OpVec3 and OpMatrix4 are laid out as contiguous floats.
+llvm::Value*
+CgVars::GetExternalElement(llvm::Value* location, unsigned int i) const
+{
+    llvm::Type* floatPtrTy = 
+        llvm::PointerType::getUnqual(llvm::Type::getFloatTy(*mContext));
+    llvm::Value* floats = mBuilder->CreateBitCast(location, floatPtrTy);
+    return mBuilder->CreateConstInBoundsGEP1_32(floats, i);
+}
+
+// Load a value of the given type from a location with its external type,
+// converting triples and matrices to LLVM vectors if necessary.  The floats
+// are loaded individually, since an OpVec3 is smaller than a <4 x float>.
+llvm::Value*
+CgVars::LoadExternal(llvm::Value* location, const IRType* ty) const
+{
+    if (!mTypes->HasVectorType(ty))
+        return mBuilder->CreateLoad(location);
+    unsigned int size = ty->IsTriple() ? 3 : 16;
+    llvm::Value* value = llvm::UndefValue::get(mTypes->Convert(ty));
+    for (unsigned int i = 0; i < size; ++i) {
+        llvm::Value* elem = 
+            mBuilder->CreateLoad(GetExternalElement(location, i));
+        value = mBuilder->CreateInsertElement(value, elem, GetInt(i));
+    }
+    return value;
+}
+
+// Store a value of the given type to a location with its external type,
+// converting LLVM vectors to triples or matrices if necessary.
+void
+CgVars::StoreExternal(llvm::Value* value, llvm::Value* location,
+                      const IRType* ty) const
+{
+    if (!mTypes->HasVectorType(ty)) {
+        mBuilder->CreateStore(value, location);
+        return;
+    }
+    unsigned int size = ty->IsTriple() ? 3 : 16;
+    for (unsigned int i = 0; i < size; ++i) {
+        llvm::Value* elem = mBuilder->CreateExtractElement(value, GetInt(i));
+        mBuilder->CreateStore(elem, GetExternalElement(location, i));
+    }
+}
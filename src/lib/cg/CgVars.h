@@ -8,49 +8,202 @@
 #include "cg/CgComponent.h"
 #include "cg/CgFwd.h"
 #include <map>
+#include <set>
+class IRType;
 class IRVar;
+class IRVarSet;
 
 /// Code generation for IR variables.  Variables are bound to values or
 /// locations.  Local variables are bound to pointers from alloca
 /// instructions.  Shader parameters are bound to function arguments, which
 /// might be scalars (if pass by value) or pointers (if pass by reference).
+/// When generating code for a batch of points (see CgStmt::CodegenLanes),
+/// varying variables are bound to lane arrays, which hold one value per
+/// lane, and references select the element for the current lane.
+///
+/// Alternatively, local variables can be kept in registers, i.e. bound to
+/// LLVM SSA values rather than allocas (see UseRegisters).  Assignments then
+/// simply update the current value of the variable, and CgStmt generates phi
+/// nodes where control flow merges.  If an instruction needs the location of
+/// a register variable (e.g. to pass it to a shadeop by reference), its value
+/// is spilled to a temporary location, from which it is reloaded after the
+/// instruction (see ReloadSpills).
 class CgVars : public CgComponent {
 public:
+    /// Map from IR variable to LLVM value.
+    typedef std::map<const IRVar*, llvm::Value*> Bindings;
+
     /// Constructor.
     CgVars(const CgComponent& state) :
-        CgComponent(state)
+        CgComponent(state),
+        mUseRegisters(false),
+        mNumLanes(1),
+        mLane(NULL),
+        mArena(NULL)
     {
     }
 
     /// Reset this component, clear the variable bindings.
-    void Reset() { mBindings.clear(); }
+    void Reset() { 
+        mBindings.clear(); 
+        mLaneVars.clear();
+        mRegisters.clear();
+        mValueVars.clear();
+        mSpillSlots.clear();
+        mSpilled.clear();
+        mUseRegisters = false;
+        mNumLanes = 1;
+        mLane = NULL;
+        mArena = NULL;
+    }
+
+    /// Keep unbound local variables (other than arrays) in registers.  Only
+    /// supported outside of lane code, in statements without break, continue,
+    /// or return statements (see CgStmt::IsStructured).
+    void UseRegisters(bool useRegisters) { mUseRegisters = useRegisters; }
+
+    /// Set the number of lanes.  If greater than one, varying local
+    /// variables are allocated as lane arrays.
+    void SetNumLanes(int numLanes) { mNumLanes = numLanes; }
+
+    /// Set the current lane index, which selects an element of each lane
+    /// array (NULL outside of lane loops).
+    void SetLane(llvm::Value* lane) { mLane = lane; }
+
+    /// Set the pointer to the per-call arena, from which the elements of
+    /// resizable arrays are allocated (see OpArena).
+    void SetArena(llvm::Value* arena) { mArena = arena; }
+
+    /// Get the pointer to the per-call arena (NULL if there is none).
+    llvm::Value* GetArena() const { return mArena; }
 
     /// Bind an IR variable to an LLVM value (typically a location, unless
     /// it's a scalar input shader parameter).  Must be called only once for a
     /// given variable.
     void Bind(const IRVar* var, llvm::Value* value);
 
+    /// Bind an IR variable to a pointer to a lane array.
+    void BindLanes(const IRVar* var, llvm::Value* lanes);
+
+    /// Bind an IR variable to an SSA value (e.g. a parameter that is passed
+    /// by value), which makes it a register variable.
+    void BindValue(const IRVar* var, llvm::Value* value);
+
+    /// Check whether a variable is kept in a register.
+    bool IsRegister(const IRVar* var) const;
+
+    /// Get the current values of the register variables.  Variables that
+    /// have not been referenced yet are omitted.
+    const Bindings& GetRegisters() const { return mRegisters; }
+
+    /// Set the current values of the register variables, e.g. to restore
+    /// them before generating the other branch of an "if" statement.
+    void SetRegisters(const Bindings& registers) { mRegisters = registers; }
+
+    /// Generate phi nodes at the start of the current block, which merges
+    /// two predecessors, for register variables whose values differ.  The
+    /// phi nodes become the current values.
+    void GenMerge(const Bindings& registers1, llvm::BasicBlock* pred1,
+                  const Bindings& registers2, llvm::BasicBlock* pred2);
+
+    /// Generate phi nodes at the start of the current block, which is a loop
+    /// header, for the given variables that are register variables.  The
+    /// phi nodes become the current values, and are returned so the incoming
+    /// values of the back edge can be added later (see GenLoopEnd).
+    void GenLoopPhis(const IRVarSet& vars, llvm::BasicBlock* preheader,
+                     Bindings* phis);
+
+    /// Add the current values of the register variables as the incoming
+    /// values of the loop phi nodes from the given latch block.
+    void GenLoopEnd(const Bindings& phis, llvm::BasicBlock* latch);
+
+    /// Reload register variables that were spilled during the preceding
+    /// instruction (see GetLocation).
+    void ReloadSpills();
+
     /// Get the location of a variable.  A new location is created if it's a
-    /// previously unencountered local variable.
+    /// previously unencountered local variable.  The value of a register
+    /// variable is spilled to a temporary location, which is valid only
+    /// until ReloadSpills is called.
     llvm::Value* GetLocation(const IRVar* var);
 
     /// Get the value of a variable, generating a load instruction if
-    /// necessary.
+    /// necessary.  If the variable is bound to a location with an external
+    /// type (e.g. a plugin argument), the value is converted.
     llvm::Value* GetValue(const IRVar* var);
 
-private:
-    /// Map from IR variable to LLVM value.
-    typedef std::map<const IRVar*, llvm::Value*> Bindings;
+    /// Store the value of a variable, converting it if the variable is bound
+    /// to a location with an external type.
+    void SetValue(const IRVar* var, llvm::Value* value);
+
+    /// Load a value of the given type from a location with its external type
+    /// (see CgTypes::ConvertExternal), converting triples and matrices to
+    /// LLVM vectors if necessary.
+    llvm::Value* LoadExternal(llvm::Value* location, const IRType* ty) const;
 
+    /// Store a value of the given type to a location with its external type,
+    /// converting LLVM vectors to triples or matrices if necessary.
+    void StoreExternal(llvm::Value* value, llvm::Value* location,
+                       const IRType* ty) const;
+
+private:
     /// Map from IR variable to location.
     Bindings mBindings;
 
+    /// Variables that are bound to lane arrays.
+    std::set<const IRVar*> mLaneVars;
+
+    /// Whether unbound local variables are kept in registers.
+    bool mUseRegisters;
+
+    /// Current values of register variables.
+    Bindings mRegisters;
+
+    /// Variables that were bound to SSA values by BindValue.
+    std::set<const IRVar*> mValueVars;
+
+    /// Temporary locations of register variables that have been spilled.
+    Bindings mSpillSlots;
+
+    /// Register variables spilled since the last call to ReloadSpills.
+    std::set<const IRVar*> mSpilled;
+
+    /// Number of lanes (one unless generating code for a batch of points).
+    int mNumLanes;
+
+    /// Current lane index (NULL outside of lane loops).
+    llvm::Value* mLane;
+
+    /// Pointer to the per-call arena (NULL if there is none).
+    llvm::Value* mArena;
+
     /// Get a variable's binding.  A new location is created if it's a
     /// previously unencountered local variable.
     llvm::Value* GetBinding(const IRVar* var, bool shouldExist=false);
 
     /// Generate an "alloca" instruction for the specified variable
-    llvm::Value* MakeAlloca(const IRVar* var) const;
+    llvm::Value* MakeAlloca(const IRVar* var, bool isLaneArray) const;
+
+    /// Get the current value of a register variable.  A variable that has
+    /// not been assigned is initially zero.
+    llvm::Value* GetRegister(const IRVar* var);
+
+    /// Get the current value of a register variable in the given set of
+    /// values, or zero if it's omitted.
+    llvm::Value* GetRegister(const IRVar* var, const Bindings& registers) const;
+
+    /// If the given variable is bound to a lane array, get a pointer to the
+    /// element for the current lane.  Otherwise the binding is returned.
+    llvm::Value* GetLaneElement(const IRVar* var, llvm::Value* binding);
+
+    /// Check whether a variable's location has its external type, which
+    /// differs from the type of its value.
+    bool IsExternal(const IRVar* var, llvm::Value* location) const;
+
+    /// Get a pointer to the ith float of a triple or matrix with its external
+    /// type.
+    llvm::Value* GetExternalElement(llvm::Value* location,
+                                    unsigned int i) const;
 };
 
 #endif // ndef CG_VARS_H
@@ -0,0 +1,94 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "cg/CgWholeShader.h"
+#include "ir/IRLocalVar.h"
+#include "ir/IRShader.h"
+#include "ir/IRShaderParam.h"
+#include "ir/IRStmts.h"
+#include "ir/IRVarSet.h"
+#include "util/UtCast.h"
+#include "xf/XfDefUse.h"
+
+// Check whether a statement contains no instructions.
+static bool
+IsEmpty(const IRStmt* stmt)
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock:
+          return UtStaticCast<const IRBlock*>(stmt)->GetInsts().empty();
+      case kIRSeq: {
+          const IRStmts& stmts = UtStaticCast<const IRSeq*>(stmt)->GetStmts();
+          IRStmts::const_iterator it;
+          for (it = stmts.begin(); it != stmts.end(); ++it)
+              if (!IsEmpty(*it))
+                  return false;
+          return true;
+      }
+      default:
+          return false;
+    }
+}
+
+// Check whether the given partitioned shader can be compiled as a whole.
+bool
+CgWholeShader::CanCompile(const IRShader* shader)
+{
+    if (!shader->GetBody()->CanCompile() || IsEmpty(shader->GetBody()))
+        return false;
+    const IRShaderParams& params = shader->GetParams();
+    IRShaderParams::const_iterator it;
+    for (it = params.begin(); it != params.end(); ++it) {
+        const IRStmt* init = (*it)->GetInitStmt();
+        if (!init->CanCompile() && !IsEmpty(init))
+            return false;
+    }
+    return true;
+}
+
+// Collect the variables referenced by the given statement.
+static void
+GetReferencedVars(const IRStmt* stmt, IRVarSet* vars)
+{
+    XfDefUse summary;
+    summary.Add(stmt);
+    *vars += summary.GetDefs();
+    *vars += summary.GetUses();
+}
+
+// Remove the local variables that are no longer referenced.
+void
+CgWholeShader::RemoveUnusedLocals(IRShader* shader)
+{
+    IRVarSet used;
+    GetReferencedVars(shader->GetBody(), &used);
+    const IRShaderParams& params = shader->GetParams();
+    IRShaderParams::const_iterator param;
+    for (param = params.begin(); param != params.end(); ++param)
+        GetReferencedVars((*param)->GetInitStmt(), &used);
+
+    // Rebuild the symbol list (which preserves the original symbol order)
+    // and the list of locals, deleting the unused ones.
+    IRValues* symbols = new IRValues;
+    IRValues::const_iterator sym;
+    for (sym = shader->mSymbols->begin(); sym != shader->mSymbols->end(); 
+         ++sym) {
+        const IRLocalVar* local = UtCast<const IRLocalVar*>(*sym);
+        if (local == NULL || used.Has(local))
+            symbols->push_back(*sym);
+    }
+    delete shader->mSymbols;
+    shader->mSymbols = symbols;
+
+    IRLocalVars* locals = new IRLocalVars;
+    IRLocalVars::const_iterator it;
+    for (it = shader->mLocals->begin(); it != shader->mLocals->end(); ++it) {
+        if (used.Has(*it))
+            locals->push_back(*it);
+        else
+            delete *it;
+    }
+    delete shader->mLocals;
+    shader->mLocals = locals;
+}
@@ -0,0 +1,28 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CG_WHOLE_SHADER_H
+#define CG_WHOLE_SHADER_H
+
+class IRShader;
+
+/// Support for whole-shader compilation (see CgOptions::mWholeShader).  When
+/// the entire shader body is compilable, along with the parameter
+/// initializers, CgShader compiles the body as a single kernel, regardless
+/// of its estimated cost.  The residual shader is then a single plugin call,
+/// plus the parameter initializers (which are compiled separately).
+class CgWholeShader {
+public:
+    /// Check whether the given partitioned shader can be compiled as a
+    /// whole, i.e. its body is a non-empty partition, and every parameter
+    /// initializer is either empty or a partition.
+    static bool CanCompile(const IRShader* shader);
+
+    /// After the shader has been compiled, remove the local variables that
+    /// are no longer referenced by the residual code, which would otherwise
+    /// be allocated and initialized by the renderer on every invocation.
+    static void RemoveUnusedLocals(IRShader* shader);
+};
+
+#endif // ndef CG_WHOLE_SHADER_H
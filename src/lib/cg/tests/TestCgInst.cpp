@@ -5,6 +5,7 @@
 #include "util/UtLog.h"
 #include <gtest/gtest.h>
 #include <iostream>
+#include <string>
 #include <llvm/BasicBlock.h>
 #include <llvm/LLVMContext.h>
 #include <llvm/Module.h>
@@ -56,6 +57,35 @@ TEST_F(TestCgInst, TestGenAssign)
     
 }
 
+TEST_F(TestCgInst, TestGenDirectMinMax)
+{
+    // Min and max are variadic, so every argument must be compared.
+    IRLocalVar var3("z", mTypes.GetFloatTy(), kIRUniform, "");
+    mInsts.GetVars()->Bind(&var3, mBuilder->CreateAlloca(mFloatTy));
+    CgOptions options;
+    options.mDirectOps = true;
+    CgInst direct(mInsts, options);
+    IRValues args;
+    args.push_back(&mVar1);
+    args.push_back(&mVar2);
+    args.push_back(&var3);
+    IRBasicInst min(kOpcode_Min, &mVar1, args);
+    IRBasicInst max(kOpcode_Max, &mVar2, args);
+    direct.GenInst(min);
+    direct.GenInst(max);
+
+    std::string code;
+    llvm::raw_string_ostream out(code);
+    out << *mBuilder->GetInsertBlock();
+    out.flush();
+    int numSelects = 0;
+    for (size_t i = code.find("select"); i != std::string::npos;
+         i = code.find("select", i + 1))
+        ++numSelects;
+    EXPECT_EQ(4, numSelects);
+    EXPECT_EQ(std::string::npos, code.find("call"));
+}
+
 int main(int argc, char **argv) 
 {
   testing::InitGoogleTest(&argc, argv);
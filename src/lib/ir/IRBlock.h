@@ -23,6 +23,15 @@ public:
         return insts;
     }
 
+    /// Replace the instructions, taking ownership of the given ones.  The
+    /// current instructions are discarded without being destroyed, so they
+    /// should be taken first (see TakeInsts).
+    void SetInsts(IRInsts* insts)
+    {
+        delete mInsts;
+        mInsts = insts;
+    }
+
     /// Get a non-const reference to the sequence of instructions
     /// Currently unused.
     // IRInsts& GetInsts() { return *mInsts; }
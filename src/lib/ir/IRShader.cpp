@@ -3,6 +3,9 @@
 // See http://www.opensource.org/licenses/mit-license.php.
 
 #include "ir/IRShader.h"
+#include "ir/IRGlobalVar.h"
+#include "ir/IRLocalVar.h"
+#include "ir/IRShaderParam.h"
 #include "ir/IRValues.h"
 #include "ir/IRStmt.h"
 #include "slo/SloEnums.h"
@@ -10,6 +13,7 @@
 #include "util/UtTokenFactory.h"
 #include <iostream>
 #include <sstream>
+#include <string.h>
 
 IRShader::~IRShader() 
 {
@@ -24,6 +28,19 @@ IRShader::~IRShader()
     delete mTypes;
 }
 
+// Add the shader's variables to its variable table, so they can be members
+// of variable sets (see IRVarSet).
+void
+IRShader::IndexVars()
+{
+    if (mParams)
+        mVarTable.Add(*mParams);
+    if (mLocals)
+        mVarTable.Add(*mLocals);
+    if (mGlobals)
+        mVarTable.Add(*mGlobals);
+}
+
 std::ostream& 
 operator<<(std::ostream& out, const IRShader& shader)
 {
@@ -70,6 +87,7 @@ IRShader::NewTempVar(const IRType* type, IRDetail detail)
     std::stringstream name;
     name << "$TT_" << mNewTempVarCount++;
     IRLocalVar* var = new IRLocalVar(name.str().c_str(), type, detail, "");
+    mVarTable.Add(var);
     mLocals->push_back(var);
     mSymbols->push_back(var);
     return var;
@@ -85,3 +103,29 @@ IRShader::NewStringConst(const char* str)
     mSymbols->push_back(constant);
     return constant;
 }
+
+// Create a new numeric constant.
+IRNumConst* 
+IRShader::NewNumConst(const float* data, const IRType* type)
+{
+    // As with string constants, a unique name is assigned in XfLower.
+    IRNumConst* constant = new IRNumConst(data, type);
+    mConstants->push_back(constant);
+    mSymbols->push_back(constant);
+    return constant;
+}
+
+// Get a global variable, adding it if necessary.
+IRGlobalVar*
+IRShader::GetGlobalVar(const char* name, const IRType* type, IRDetail detail)
+{
+    IRGlobalVars::const_iterator it;
+    for (it = mGlobals->begin(); it != mGlobals->end(); ++it)
+        if (strcmp((*it)->GetFullName(), name) == 0)
+            return *it;
+    IRGlobalVar* var = new IRGlobalVar(name, type, detail, "", false);
+    mVarTable.Add(var);
+    mGlobals->push_back(var);
+    mSymbols->push_back(var);
+    return var;
+}
@@ -7,12 +7,14 @@
 
 #include "ir/IRTypedefs.h"
 #include "ir/IRTypes.h"
+#include "ir/IRVarTable.h"
 #include "slo/SloEnums.h"       // for SloShaderType
 #include <list>
 #include <string>
 class IRConst;
 class IRGlobalVar;
 class IRLocalVar;
+class IRNumConst;
 class IRStmt;
 class IRStringConst;
 
@@ -39,13 +41,25 @@ public:
     /// Get this shader's type factory.
     IRTypes* GetTypeFactory() const { return mTypes; }
 
+    /// Get the table that indexes this shader's variables.
+    const IRVarTable& GetVarTable() const { return mVarTable; }
+
     /// Create a new temporary variable.
     IRLocalVar* NewTempVar(const IRType* type, IRDetail detail);
 
     /// Create a new string constant.
     IRStringConst* NewStringConst(const char* str);
 
-    /// Construct IR shader, taking ownership of the given IR.
+    /// Create a new numeric constant, copying the given data.
+    IRNumConst* NewNumConst(const float* data, const IRType* type);
+
+    /// Get the global variable with the given name, adding it to the shader
+    /// if it isn't used yet.
+    IRGlobalVar* GetGlobalVar(const char* name, const IRType* type,
+                              IRDetail detail);
+
+    /// Construct IR shader, taking ownership of the given IR.  The
+    /// variables are added to the shader's variable table.
     IRShader(const char* name,
              SloShaderType type,
              IRTypes* types,
@@ -66,6 +80,7 @@ public:
         mNewTempVarCount(0),
         mNewStringConstCount(0)
     {
+        IndexVars();
     }
 
     /// The destructor recursively deletes the children.
@@ -88,6 +103,9 @@ private:
     IRStmt* mBody;
     unsigned int mNewTempVarCount;
     unsigned int mNewStringConstCount;
+    IRVarTable mVarTable;       // Indexes params, locals, and globals.
+
+    void IndexVars();
 };
 
 /// Print an IR shader.
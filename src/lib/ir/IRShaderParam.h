@@ -27,6 +27,15 @@ public:
         mInit = init;
     }
 
+    /// Take the initialization statement, leaving it NULL (e.g. so that a
+    /// transformed statement can be installed via SetInitStmt).
+    IRStmt* TakeInitStmt()
+    {
+        IRStmt* init = mInit;
+        mInit = NULL;
+        return init;
+    }
+
     /// Returns true if this is an output parameter.
     bool IsOutput() const { return mIsOutput; }
 
@@ -4,10 +4,15 @@
 
 #include "ir/IRVar.h"
 #include "ir/IRType.h"
+#include "ir/IRVarTable.h"
 #include <iostream>
 #include <iomanip>              // for std::setw()
 
-IRVar::~IRVar() { }
+IRVar::~IRVar()
+{
+    if (mTable)
+        mTable->Remove(this);
+}
 
 std::ostream& 
 operator<<(std::ostream& out, const IRVar& var)
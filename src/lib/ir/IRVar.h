@@ -8,6 +8,7 @@
 #include "ir/IRValue.h"
 #include <assert.h>
 #include <string>
+class IRVarTable;
 
 /**
    Abstract base class of IR variables, with the following derived classes:
@@ -33,19 +34,33 @@ public:
     /// Get the space name, if any (empty if none);
     const char* GetSpace() const { return mSpace.c_str(); }
 
+    /// Get the table that indexes this variable (NULL if none).  The
+    /// variables of a shader are indexed by its table (see IRVarTable).
+    const IRVarTable* GetTable() const { return mTable; }
+
+    /// Get the index of this variable in its table.
+    unsigned int GetIndex() const
+    {
+        assert(mTable && "Variable isn't indexed");
+        return mIndex;
+    }
+
     /// Construct an IR variable of the specified kind with the given
     /// name, type, and detail.  The space name can be NULL or empty.
     IRVar(IRValueKind kind, const char* name, const IRType* type,
           IRDetail detail, const char* space) :
         IRValue(kind, type, detail),
         mName(name),
-        mSpace(space ? space : "")
+        mSpace(space ? space : ""),
+        mTable(NULL),
+        mIndex(0)
     {
         assert(kIRVar_Begin < kind && kind < kIRVar_End &&
                "Invalid kind of variable");
     }
 
-    /// Destructor.  Not sure why this can't be pure virtual.
+    /// Destructor, which removes the variable from its table.  Not sure why
+    /// this can't be pure virtual.
     virtual ~IRVar();
 
     /// Check if a value is an instance of this class. Required by UtCast().
@@ -60,8 +75,11 @@ public:
 private:
     friend class XfRaiseImpl;
     friend class XfLowerImpl;
+    friend class IRVarTable;
     std::string mName;
     std::string mSpace;
+    IRVarTable* mTable;
+    unsigned int mIndex;
 };
 
 /// Print a variable
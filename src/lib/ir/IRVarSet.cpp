@@ -8,43 +8,143 @@
 #include <algorithm>
 #include <string.h>
 
+// Check whether the set is empty.  Bits of deleted variables are ignored.
+bool
+IRVarSet::IsEmpty() const
+{
+    return FindNext(0) == GetEndIndex();
+}
+
+// Add a variable to this set, growing the bit vector to fit the size of its
+// table, so that later additions from the same table don't reallocate.
+void
+IRVarSet::Add(IRVar* var)
+{
+    const IRVarTable* table = var->GetTable();
+    assert(table && "Variable must be indexed to be added to a set");
+    SetTable(table);
+    unsigned int i = var->GetIndex();
+    if (i / kWordBits >= mWords.size())
+        mWords.resize((table->GetSize() + kWordBits - 1) / kWordBits, 0);
+    mWords[i / kWordBits] |= Word(1) << (i % kWordBits);
+}
+
 // Union the given set into this one.
-void 
+void
 IRVarSet::operator+=(const IRVarSet& src)
 {
-    std::set<IRVar*> dest;
-    std::set_union(mVars.begin(), mVars.end(),
-                   src.mVars.begin(), src.mVars.end(),
-                   std::inserter(dest, dest.begin()));
-    mVars.swap(dest);
+    SetTable(src.mTable);
+    if (mWords.size() < src.mWords.size())
+        mWords.resize(src.mWords.size(), 0);
+    for (size_t i = 0; i < src.mWords.size(); ++i)
+        mWords[i] |= src.mWords[i];
+}
+
+// Remove the members of the given set from this one.
+void
+IRVarSet::operator-=(const IRVarSet& src)
+{
+    SetTable(src.mTable);
+    size_t n = std::min(mWords.size(), src.mWords.size());
+    for (size_t i = 0; i < n; ++i)
+        mWords[i] &= ~src.mWords[i];
 }
 
 // Intersect this set with the given one.
-void 
+void
 IRVarSet::Intersect(const IRVarSet& src)
 {
-    std::set<IRVar*> dest;
-    std::set_intersection(mVars.begin(), mVars.end(),
-                          src.mVars.begin(), src.mVars.end(),
-                          std::inserter(dest, dest.begin()));
-    mVars.swap(dest);
+    SetTable(src.mTable);
+    if (mWords.size() > src.mWords.size())
+        mWords.resize(src.mWords.size());
+    for (size_t i = 0; i < mWords.size(); ++i)
+        mWords[i] &= src.mWords[i];
+}
+
+// Check whether this set has any members in common with the given one,
+// without constructing the intersection.
+bool
+IRVarSet::Intersects(const IRVarSet& other) const
+{
+    size_t n = std::min(mWords.size(), other.mWords.size());
+    for (size_t i = 0; i < n; ++i)
+        if ((mWords[i] & other.mWords[i]) != 0)
+            return true;
+    return false;
 }
 
-bool 
+// Check whether two sets have the same members.  The bit vectors might have
+// different lengths, in which case the extra words must be empty.
+bool
+IRVarSet::operator==(const IRVarSet& other) const
+{
+    const std::vector<Word>& shorter =
+        mWords.size() < other.mWords.size() ? mWords : other.mWords;
+    const std::vector<Word>& longer =
+        mWords.size() < other.mWords.size() ? other.mWords : mWords;
+    for (size_t i = 0; i < shorter.size(); ++i)
+        if (shorter[i] != longer[i])
+            return false;
+    for (size_t i = shorter.size(); i < longer.size(); ++i)
+        if (longer[i] != 0)
+            return false;
+    return true;
+}
+
+// Find the index of the first member at or after the given index, skipping
+// the bits of deleted variables, whose table slots are NULL.  Returns the
+// end index if there is none.
+unsigned int
+IRVarSet::FindNext(unsigned int index) const
+{
+    index = FindNextBit(index);
+    while (index != GetEndIndex() && mTable->GetVar(index) == NULL)
+        index = FindNextBit(index + 1);
+    return index;
+}
+
+// Find the index of the first set bit at or after the given index, skipping
+// empty words.  Returns the end index if there is none.
+unsigned int
+IRVarSet::FindNextBit(unsigned int index) const
+{
+    size_t w = index / kWordBits;
+    if (w >= mWords.size())
+        return GetEndIndex();
+    Word word = mWords[w] >> (index % kWordBits);
+    if (word == 0) {
+        do {
+            if (++w == mWords.size())
+                return GetEndIndex();
+        } while (mWords[w] == 0);
+        word = mWords[w];
+        index = w * kWordBits;
+    }
+    while ((word & 1) == 0) {
+        word >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+// Order variables by name, ignoring case.
+static bool
 OrderByName(IRVar* v1, IRVar* v2)
 {
     return strcasecmp(v1->GetShortName(), v2->GetShortName()) < 0;
 }
 
 // Copy the variable set to a vector, in sorted order for reproducibility.
-void 
+// Variables with the same name remain in index order.
+void
 IRVarSet::GetSorted(IRVars* vars) const
 {
-    vars->insert(vars->end(), mVars.begin(), mVars.end());
-    std::sort(vars->begin(), vars->end(), OrderByName);
+    for (const_iterator it = begin(); it != end(); ++it)
+        vars->push_back(*it);
+    std::stable_sort(vars->begin(), vars->end(), OrderByName);
 }
 
-std::ostream& 
+std::ostream&
 operator<<(std::ostream& out, const IRVarSet& set)
 {
     // We print them in sorted order for unit test baseline stability.
@@ -61,4 +161,3 @@ operator<<(std::ostream& out, const IRVarSet& set)
     out << "}";
     return out;
 }
-
@@ -7,31 +7,52 @@
 
 #include "ir/IRTypedefs.h"
 #include "ir/IRVar.h"
+#include "ir/IRVarTable.h"
 #include "util/UtCast.h"
 #include "util/UtVector.h"
 #include <iosfwd>
-#include <set>
+#include <vector>
 class IRValue;
 
-/// A set of IR variables.
+/**
+   A set of IR variables, represented as a bit vector indexed by the
+   variables' indices (see IRVarTable).  Union, intersection and difference
+   are performed in place, a word at a time.  The members of a set must
+   belong to the same table, which the set records when the first member is
+   added.
+
+   Deleting a variable removes it from its table but leaves its bit set in
+   any sets that contain it.  Such a variable is no longer a member: the
+   iterators and IsEmpty skip it.  Comparisons (==, Intersects) still see
+   its bit, which errs on the side of sets being different or overlapping.
+*/
 class IRVarSet {
+    typedef unsigned long Word;
+    static const unsigned int kWordBits = 8 * sizeof(Word);
+
 public:
     /// Construct an empty set.
-    IRVarSet() { }
+    IRVarSet() : mTable(NULL) { }
 
     /// Check whether the set is empty.
-    bool IsEmpty() const { return mVars.empty(); }
+    bool IsEmpty() const;
 
-    /// Check whether the specified variable is a member of this set
-    /// (based on pointer equality).
+    /// Check whether the specified variable is a member of this set.
     bool Has(const IRVar* var) const {
-        return mVars.find(const_cast<IRVar*>(var)) != mVars.end();
+        assert((mTable == NULL || var->GetTable() == NULL ||
+                var->GetTable() == mTable) &&
+               "Variable from a different table");
+        if (var->GetTable() != mTable || mTable == NULL)
+            return false;
+        unsigned int i = var->GetIndex();
+        return i / kWordBits < mWords.size() &&
+            (mWords[i / kWordBits] & (Word(1) << (i % kWordBits))) != 0;
     }
 
     /// If the given value is a variable, add it to this set.
     void operator+=(IRValue* value) {
         if (IRVar* var = UtCast<IRVar*>(value))
-            mVars.insert(var); 
+            Add(var);
     }
 
     /// Union the given set into this one.
@@ -46,13 +67,64 @@ public:
     }
 
     /// Remove a variable from this set.
-    void operator-=(const IRVar* var) { 
-        mVars.erase(const_cast<IRVar*>(var)); 
+    void operator-=(const IRVar* var) {
+        assert((mTable == NULL || var->GetTable() == NULL ||
+                var->GetTable() == mTable) &&
+               "Variable from a different table");
+        if (var->GetTable() != mTable || mTable == NULL)
+            return;
+        unsigned int i = var->GetIndex();
+        if (i / kWordBits < mWords.size())
+            mWords[i / kWordBits] &= ~(Word(1) << (i % kWordBits));
     }
 
+    /// Remove the members of the given set from this one.
+    void operator-=(const IRVarSet& src);
+
     /// Intersect this set with the given one.
     void Intersect(const IRVarSet& src);
 
+    /// Check whether this set has any members in common with the given one.
+    bool Intersects(const IRVarSet& other) const;
+
+    /// Check whether two sets have the same members.
+    bool operator==(const IRVarSet& other) const;
+
+    /// Check whether two sets have different members.
+    bool operator!=(const IRVarSet& other) const { return !(*this == other); }
+
+    /// An iterator over the members of a set, in index order.
+    class const_iterator {
+    public:
+        IRVar* operator*() const { return mSet->mTable->GetVar(mIndex); }
+
+        const_iterator& operator++() {
+            mIndex = mSet->FindNext(mIndex + 1);
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return mIndex == other.mIndex;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return mIndex != other.mIndex;
+        }
+
+    private:
+        friend class IRVarSet;
+        const_iterator(const IRVarSet* set, unsigned int index) :
+            mSet(set), mIndex(index) { }
+        const IRVarSet* mSet;
+        unsigned int mIndex;
+    };
+
+    /// Get an iterator positioned at the first member.
+    const_iterator begin() const { return const_iterator(this, FindNext(0)); }
+
+    /// Get an iterator positioned past the last member.
+    const_iterator end() const { return const_iterator(this, GetEndIndex()); }
+
     /// Copy the variable set to a vector, in sorted order for
     /// reproducibility.
     void GetSorted(IRVars* vars) const;
@@ -61,8 +133,30 @@ public:
     friend std::ostream& operator<<(std::ostream& out, const IRVarSet& set);
 
 private:
-    typedef std::set<IRVar*> Vars;
-    Vars mVars;
+    const IRVarTable* mTable;   // Table that indexes the members (if any)
+    std::vector<Word> mWords;   // Membership bits
+
+    // Add a variable to this set.
+    void Add(IRVar* var);
+
+    // Record the table of a set's members, checking that it matches.
+    void SetTable(const IRVarTable* table) {
+        assert((mTable == NULL || table == NULL || mTable == table) &&
+               "Variable sets from different tables");
+        if (mTable == NULL)
+            mTable = table;
+    }
+
+    // Get the index past the last possible member.
+    unsigned int GetEndIndex() const { return mWords.size() * kWordBits; }
+
+    // Find the index of the first member at or after the given index,
+    // returning the end index if there is none.  Deleted variables are
+    // skipped.
+    unsigned int FindNext(unsigned int index) const;
+
+    // Find the index of the first set bit at or after the given index.
+    unsigned int FindNextBit(unsigned int index) const;
 };
 
 #endif // ndef IR_VAR_SET_H
@@ -0,0 +1,33 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "ir/IRVarTable.h"
+#include "ir/IRVar.h"
+
+IRVarTable::~IRVarTable()
+{
+    IRVars::const_iterator it;
+    for (it = mVars.begin(); it != mVars.end(); ++it)
+        if (IRVar* var = *it)
+            var->mTable = NULL;
+}
+
+// Add a variable to the table, assigning it the next index.
+void
+IRVarTable::Add(IRVar* var)
+{
+    assert(var->mTable == NULL && "Variable already belongs to a table");
+    var->mTable = this;
+    var->mIndex = mVars.size();
+    mVars.push_back(var);
+}
+
+// Remove a variable from the table, leaving its index unused.
+void
+IRVarTable::Remove(IRVar* var)
+{
+    assert(var->mTable == this && "Variable doesn't belong to this table");
+    mVars[var->mIndex] = NULL;
+    var->mTable = NULL;
+}
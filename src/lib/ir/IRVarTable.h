@@ -0,0 +1,58 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef IR_VAR_TABLE_H
+#define IR_VAR_TABLE_H
+
+#include "ir/IRTypedefs.h"
+#include <assert.h>
+
+/**
+   A table that assigns dense indices to variables, which allows sets of
+   variables to be represented as bit vectors (see IRVarSet).  Each shader
+   has a table, to which its variables are added when it's constructed
+   (i.e. when it's raised from SLO), and to which new variables are added
+   as they're created.
+
+   The table doesn't own the variables.  A variable removes itself from its
+   table when it's deleted, leaving an unused index.
+*/
+class IRVarTable {
+public:
+    /// Construct an empty table.
+    IRVarTable() { }
+
+    /// The destructor detaches any remaining variables.
+    ~IRVarTable();
+
+    /// Add a variable to the table, assigning it the next index.  The
+    /// variable must not belong to a table already.
+    void Add(IRVar* var);
+
+    /// Add a vector of variables to the table.
+    template<typename T>
+    void Add(const UtVector<T>& vars) {
+        typename UtVector<T>::const_iterator it;
+        for (it = vars.begin(); it != vars.end(); ++it)
+            Add(*it);
+    }
+
+    /// Remove a variable from the table.  Its index is not reused.
+    void Remove(IRVar* var);
+
+    /// Get the number of indices assigned so far.
+    unsigned int GetSize() const { return mVars.size(); }
+
+    /// Get the variable with the given index (NULL if it was removed).
+    IRVar* GetVar(unsigned int index) const { return mVars[index]; }
+
+private:
+    IRVars mVars;               // Variables indexed by their indices
+
+    // Tables are not copyable.
+    IRVarTable(const IRVarTable&);
+    IRVarTable& operator=(const IRVarTable&);
+};
+
+#endif // ndef IR_VAR_TABLE_H
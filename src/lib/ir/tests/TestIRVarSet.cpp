@@ -8,6 +8,7 @@ class TestIRVarSet : public testing::Test {
 public:
     IRTypes mTypes;
     const IRType* mFloat;
+    IRVarTable mTable;
     IRLocalVar x1, x2, x3;
 
     TestIRVarSet() :
@@ -16,6 +17,9 @@ public:
         x2("x2", mFloat, kIRUniform, ""),
         x3("x3", mFloat, kIRUniform, "")
     {
+        mTable.Add(&x1);
+        mTable.Add(&x2);
+        mTable.Add(&x3);
     }
 };
 
@@ -124,6 +128,7 @@ TEST_F(TestIRVarSet, TestIntersect1)
     set1 += &x1;
     set2 += &x2;
     set2 += &x1;
+    EXPECT_TRUE(set1.Intersects(set2));
     set1.Intersect(set2);
     EXPECT_TRUE(set1.Has(&x1));
     std::cout << set1 << std::endl;
@@ -134,6 +139,8 @@ TEST_F(TestIRVarSet, TestIntersect2)
     IRVarSet set1, set2;
     set1 += &x1;
     set2 += &x2;
+    EXPECT_FALSE(set1.Intersects(set2));
+    EXPECT_FALSE(set1.Intersects(IRVarSet()));
     set1.Intersect(set2);
     EXPECT_FALSE(set1.Has(&x1));
     std::cout << set1 << std::endl;
@@ -225,6 +232,88 @@ TEST_F(TestIRVarSet, TestIntersect10)
     std::cout << set1 << std::endl;
 }
 
+TEST_F(TestIRVarSet, TestDifference)
+{
+    IRVarSet set1, set2;
+    set1 += &x1;
+    set1 += &x2;
+    set2 += &x2;
+    set2 += &x3;
+    set1 -= set2;
+    EXPECT_TRUE(set1.Has(&x1));
+    EXPECT_FALSE(set1.Has(&x2));
+    EXPECT_FALSE(set1.Has(&x3));
+    std::cout << set1 << std::endl;
+    IRVarSet set3;
+    set3 += &x1;
+    EXPECT_TRUE(set1 == set3);
+    EXPECT_TRUE(set1 != set2);
+    set1 -= set1;
+    EXPECT_TRUE(set1.IsEmpty());
+    EXPECT_TRUE(set1 == IRVarSet());
+    std::cout << set1 << std::endl;
+}
+
+TEST_F(TestIRVarSet, TestIterate)
+{
+    // Members are visited in index order, across word boundaries.
+    IRVarSet set;
+    EXPECT_TRUE(set.begin() == set.end());
+    UtVector<IRLocalVar*> vars;
+    for (int i = 0; i < 200; ++i) {
+        vars.push_back(new IRLocalVar("y", mFloat, kIRUniform, ""));
+        mTable.Add(vars.back());
+    }
+    set += vars[199];
+    set += &x3;
+    set += vars[64];
+    set += vars[63];
+    IRVars members;
+    for (IRVarSet::const_iterator it = set.begin(); it != set.end(); ++it)
+        members.push_back(*it);
+    ASSERT_EQ(4U, members.size());
+    EXPECT_EQ(&x3, members[0]);
+    EXPECT_EQ(vars[63], members[1]);
+    EXPECT_EQ(vars[64], members[2]);
+    EXPECT_EQ(vars[199], members[3]);
+
+    // Sorting by name keeps variables with the same name in index order.
+    members.clear();
+    set.GetSorted(&members);
+    ASSERT_EQ(4U, members.size());
+    EXPECT_EQ(&x3, members[0]);
+    EXPECT_EQ(vars[63], members[1]);
+    EXPECT_EQ(vars[199], members[3]);
+    for (int i = 0; i < 200; ++i)
+        delete vars[i];
+    EXPECT_TRUE(mTable.GetVar(x3.GetIndex() + 1) == NULL);
+}
+
+TEST_F(TestIRVarSet, TestDeleted)
+{
+    // A deleted variable is no longer a member, although its bit remains.
+    IRVarSet set;
+    IRLocalVar* y = new IRLocalVar("y", mFloat, kIRUniform, "");
+    mTable.Add(y);
+    set += y;
+    EXPECT_FALSE(set.IsEmpty());
+    delete y;
+    EXPECT_TRUE(set.IsEmpty());
+    EXPECT_TRUE(set.begin() == set.end());
+
+    set += &x2;
+    IRLocalVar* z = new IRLocalVar("z", mFloat, kIRUniform, "");
+    mTable.Add(z);
+    set += z;
+    delete z;
+    IRVars members;
+    for (IRVarSet::const_iterator it = set.begin(); it != set.end(); ++it)
+        members.push_back(*it);
+    ASSERT_EQ(1U, members.size());
+    EXPECT_EQ(&x2, members[0]);
+    std::cout << set << std::endl;
+}
+
 int main(int argc, char **argv) 
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,115 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_ARENA_H
+#define OP_ARENA_H
+
+#include <regex.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/**
+   A per-call memory arena, from which shadeops allocate storage that lives
+   until the plugin entry function returns (e.g. the elements of resizable
+   arrays).  The entry function allocates an arena on its stack (a zeroed
+   arena is empty), passes it to its kernels as a hidden argument, and frees
+   it before returning (see CgShader::GenEntryReturn).  Allocation is a
+   pointer bump; individual allocations are never freed.
+
+   The functions are inline so that they are included in the shadeop
+   bitcode, where they can be inlined into kernels.  An arena is used by a
+   single thread.
+
+   Strings computed by shadeops are interned in the arena (see OpString.h),
+   and the arena caches the regular expressions compiled by match.
+*/
+class OpStringTable;
+
+/// A regular expression compiled by match, cached in an arena (see
+/// OpStringMatchCached).  The compiled form is freed with the arena.
+class OpArenaRegex {
+public:
+    OpArenaRegex* mNext;        // Next cached regex
+    const char* mPattern;       // Pattern, which outlives the call
+    regex_t mRegex;             // Compiled pattern
+    bool mIsValid;              // False if the pattern failed to compile
+};
+
+/// The header of a block of arena memory.  The allocations follow the
+/// header, which is padded to the alignment of allocations.
+class OpArenaBlock {
+public:
+    OpArenaBlock* mPrev;        // Previously allocated block
+};
+
+/// A memory arena, which is a list of blocks.
+class OpArena {
+public:
+    OpArenaBlock* mBlocks;      // Most recently allocated block
+    char* mNext;                // Next free byte in the current block
+    char* mEnd;                 // End of the current block
+    OpStringTable* mStrings;    // Interned strings (NULL if none)
+    OpArenaRegex* mRegexes;     // Cached regexes (NULL if none)
+    int mNumRegexes;            // Number of cached regexes
+};
+
+/// Minimum size of an arena block (in bytes), excluding its header.
+static const size_t kOpArenaBlockSize = 4096;
+
+/// Alignment of arena allocations.
+static const size_t kOpArenaAlign = 16;
+
+/// Initialize an empty arena.
+inline void
+OpArenaInit(OpArena* arena)
+{
+    arena->mBlocks = NULL;
+    arena->mNext = NULL;
+    arena->mEnd = NULL;
+    arena->mStrings = NULL;
+    arena->mRegexes = NULL;
+    arena->mNumRegexes = 0;
+}
+
+/// Allocate the given number of bytes from an arena.  Returns NULL if
+/// memory is exhausted.
+inline void*
+OpArenaAlloc(OpArena* arena, size_t size)
+{
+    size = (size + kOpArenaAlign - 1) & ~(kOpArenaAlign - 1);
+    if (arena->mNext == NULL || size_t(arena->mEnd - arena->mNext) < size) {
+        size_t blockSize = size > kOpArenaBlockSize ? size : kOpArenaBlockSize;
+        size_t headerSize =
+            (sizeof(OpArenaBlock) + kOpArenaAlign - 1) & ~(kOpArenaAlign - 1);
+        char* memory = static_cast<char*>(malloc(headerSize + blockSize));
+        if (memory == NULL)
+            return NULL;
+        OpArenaBlock* block = reinterpret_cast<OpArenaBlock*>(memory);
+        block->mPrev = arena->mBlocks;
+        arena->mBlocks = block;
+        arena->mNext = memory + headerSize;
+        arena->mEnd = arena->mNext + blockSize;
+    }
+    void* result = arena->mNext;
+    arena->mNext += size;
+    return result;
+}
+
+/// Free all the memory allocated from an arena, leaving it empty.
+inline void
+OpArenaFree(OpArena* arena)
+{
+    for (OpArenaRegex* r = arena->mRegexes; r; r = r->mNext)
+        if (r->mIsValid)
+            regfree(&r->mRegex);
+    OpArenaBlock* block = arena->mBlocks;
+    while (block) {
+        OpArenaBlock* prev = block->mPrev;
+        free(block);
+        block = prev;
+    }
+    OpArenaInit(arena);
+}
+
+#endif // ndef OP_ARENA_H
@@ -0,0 +1,226 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_COLOR_H
+#define OP_COLOR_H
+
+#include "ops/OpVec3.h"
+#include <math.h>
+#include <strings.h>
+
+/**
+   Color space conversions for the color transform shadeops (see Ops.cpp).
+   The color spaces are those of RSL:
+
+   - "rgb": linear RGB with ITU-R BT.709 primaries and a D65 white point.
+   - "hsv" and "hsl": hue, saturation, and value or lightness, with hue in
+     [0,1) rather than degrees.
+   - "xyz": CIE XYZ.
+   - "xyY": CIE chromaticity and luminance.
+   - "YIQ": NTSC luma and chrominance.
+
+   Conversions between two spaces go through RGB.
+*/
+
+/// Color spaces.
+enum OpColorSpace {
+    kOpColorRGB,
+    kOpColorHSV,
+    kOpColorHSL,
+    kOpColorXYZ,
+    kOpColorxyY,
+    kOpColorYIQ
+};
+
+/// Get the color space with the given name (ignoring case).  Unrecognized
+/// names yield RGB, so the conversion is the identity.
+inline OpColorSpace
+OpColorGetSpace(const char* name)
+{
+    if (strcasecmp(name, "hsv") == 0)
+        return kOpColorHSV;
+    if (strcasecmp(name, "hsl") == 0)
+        return kOpColorHSL;
+    if (strcasecmp(name, "xyz") == 0)
+        return kOpColorXYZ;
+    if (strcasecmp(name, "xyy") == 0)
+        return kOpColorxyY;
+    if (strcasecmp(name, "yiq") == 0)
+        return kOpColorYIQ;
+    return kOpColorRGB;
+}
+
+/// Convert an RGB color to HSV.
+inline OpVec3
+OpColorRGBToHSV(const OpVec3& c)
+{
+    float max = fmaxf(c[0], fmaxf(c[1], c[2]));
+    float min = fminf(c[0], fminf(c[1], c[2]));
+    float delta = max - min;
+    if (delta <= 0.0f || max <= 0.0f)
+        return OpVec3(0.0f, 0.0f, max);
+    float h;
+    if (c[0] == max)
+        h = (c[1] - c[2]) / delta;
+    else if (c[1] == max)
+        h = 2.0f + (c[2] - c[0]) / delta;
+    else
+        h = 4.0f + (c[0] - c[1]) / delta;
+    h /= 6.0f;
+    if (h < 0.0f)
+        h += 1.0f;
+    return OpVec3(h, delta / max, max);
+}
+
+// Get an RGB component given the hue (in sixths) and the minimum and maximum
+// components.  Used for both HSV and HSL.
+inline float
+OpColorHueComp(float h, float min, float max)
+{
+    h = h - 6.0f * floorf(h / 6.0f);
+    if (h < 1.0f)
+        return min + (max - min) * h;
+    if (h < 3.0f)
+        return max;
+    if (h < 4.0f)
+        return min + (max - min) * (4.0f - h);
+    return min;
+}
+
+/// Convert an HSV color to RGB.
+inline OpVec3
+OpColorHSVToRGB(const OpVec3& c)
+{
+    float h = c[0] * 6.0f, max = c[2], min = max * (1.0f - c[1]);
+    return OpVec3(OpColorHueComp(h + 2.0f, min, max),
+                  OpColorHueComp(h, min, max),
+                  OpColorHueComp(h - 2.0f, min, max));
+}
+
+/// Convert an RGB color to HSL.
+inline OpVec3
+OpColorRGBToHSL(const OpVec3& c)
+{
+    float max = fmaxf(c[0], fmaxf(c[1], c[2]));
+    float min = fminf(c[0], fminf(c[1], c[2]));
+    float l = 0.5f * (max + min);
+    float delta = max - min;
+    if (delta <= 0.0f)
+        return OpVec3(0.0f, 0.0f, l);
+    float s = l <= 0.5f ? delta / (max + min) : delta / (2.0f - max - min);
+    float h = OpColorRGBToHSV(c)[0];
+    return OpVec3(h, s, l);
+}
+
+/// Convert an HSL color to RGB.
+inline OpVec3
+OpColorHSLToRGB(const OpVec3& c)
+{
+    float h = c[0] * 6.0f, s = c[1], l = c[2];
+    float max = l <= 0.5f ? l * (1.0f + s) : l + s - l * s;
+    float min = 2.0f * l - max;
+    return OpVec3(OpColorHueComp(h + 2.0f, min, max),
+                  OpColorHueComp(h, min, max),
+                  OpColorHueComp(h - 2.0f, min, max));
+}
+
+/// Convert an RGB color to CIE XYZ.
+inline OpVec3
+OpColorRGBToXYZ(const OpVec3& c)
+{
+    return OpVec3(0.412453f*c[0] + 0.357580f*c[1] + 0.180423f*c[2],
+                  0.212671f*c[0] + 0.715160f*c[1] + 0.072169f*c[2],
+                  0.019334f*c[0] + 0.119193f*c[1] + 0.950227f*c[2]);
+}
+
+/// Convert a CIE XYZ color to RGB.
+inline OpVec3
+OpColorXYZToRGB(const OpVec3& c)
+{
+    return OpVec3( 3.240481f*c[0] - 1.537152f*c[1] - 0.498536f*c[2],
+                  -0.969255f*c[0] + 1.875990f*c[1] + 0.041556f*c[2],
+                   0.055647f*c[0] - 0.204041f*c[1] + 1.057311f*c[2]);
+}
+
+/// Convert an RGB color to CIE xyY.  Black has zero chromaticity.
+inline OpVec3
+OpColorRGBToxyY(const OpVec3& c)
+{
+    OpVec3 xyz = OpColorRGBToXYZ(c);
+    float sum = xyz[0] + xyz[1] + xyz[2];
+    if (sum == 0.0f)
+        return OpVec3(0.0f, 0.0f, xyz[1]);
+    return OpVec3(xyz[0] / sum, xyz[1] / sum, xyz[1]);
+}
+
+/// Convert a CIE xyY color to RGB.  Zero y yields black.
+inline OpVec3
+OpColorxyYToRGB(const OpVec3& c)
+{
+    float x = c[0], y = c[1], Y = c[2];
+    if (y == 0.0f)
+        return OpVec3(0.0f);
+    return OpColorXYZToRGB(OpVec3(x * Y / y, Y, (1.0f - x - y) * Y / y));
+}
+
+/// Convert an RGB color to YIQ.
+inline OpVec3
+OpColorRGBToYIQ(const OpVec3& c)
+{
+    return OpVec3(0.299f*c[0] + 0.587f*c[1] + 0.114f*c[2],
+                  0.596f*c[0] - 0.275f*c[1] - 0.321f*c[2],
+                  0.212f*c[0] - 0.523f*c[1] + 0.311f*c[2]);
+}
+
+/// Convert a YIQ color to RGB.
+inline OpVec3
+OpColorYIQToRGB(const OpVec3& c)
+{
+    return OpVec3(c[0] + 0.955688f*c[1] + 0.619858f*c[2],
+                  c[0] - 0.271582f*c[1] - 0.646874f*c[2],
+                  c[0] - 1.108177f*c[1] + 1.705065f*c[2]);
+}
+
+/// Convert an RGB color to the given space.
+inline OpVec3
+OpColorFromRGB(OpColorSpace space, const OpVec3& c)
+{
+    switch (space) {
+      case kOpColorRGB: return c;
+      case kOpColorHSV: return OpColorRGBToHSV(c);
+      case kOpColorHSL: return OpColorRGBToHSL(c);
+      case kOpColorXYZ: return OpColorRGBToXYZ(c);
+      case kOpColorxyY: return OpColorRGBToxyY(c);
+      case kOpColorYIQ: return OpColorRGBToYIQ(c);
+    }
+    return c;
+}
+
+/// Convert a color in the given space to RGB.
+inline OpVec3
+OpColorToRGB(OpColorSpace space, const OpVec3& c)
+{
+    switch (space) {
+      case kOpColorRGB: return c;
+      case kOpColorHSV: return OpColorHSVToRGB(c);
+      case kOpColorHSL: return OpColorHSLToRGB(c);
+      case kOpColorXYZ: return OpColorXYZToRGB(c);
+      case kOpColorxyY: return OpColorxyYToRGB(c);
+      case kOpColorYIQ: return OpColorYIQToRGB(c);
+    }
+    return c;
+}
+
+/// Convert a color from one named space to another.
+inline OpVec3
+OpColorConvert(const char* fromSpace, const char* toSpace, const OpVec3& c)
+{
+    OpColorSpace from = OpColorGetSpace(fromSpace);
+    OpColorSpace to = OpColorGetSpace(toSpace);
+    if (from == to)
+        return c;
+    return OpColorFromRGB(to, OpColorToRGB(from, c));
+}
+
+#endif // ndef OP_COLOR_H
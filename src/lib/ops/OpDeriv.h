@@ -0,0 +1,236 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_DERIV_H
+#define OP_DERIV_H
+
+#include <math.h>
+class RslContext;
+
+/**
+   Derivative operations (Du, Dv, Deriv, area, and calculatenormal) on a
+   shading grid.  Unlike the other shadeops, these require the values of
+   neighboring points, so they are applied to all the points of a grid at
+   once, after the operand has been computed for every point (see
+   CgShader::GenGridEntry).  Derivatives are approximated by finite
+   differences with the next point in the same row (for u) or column (for
+   v), or with the previous point at the end of a row or column.
+
+   The values are arrays of floats.  Each value occupies the given number of
+   floats (one for a float and three for a triple).  Operands have a stride
+   (in floats), which is zero for a uniform value, whose derivatives are
+   zero.  Results are contiguous.
+*/
+
+/// The topology of a shading grid, whose points are stored in rows: u
+/// varies along each row, and v varies from row to row.  The surface
+/// parameters of the points are the denominators of the differences.
+struct OpGrid {
+    int mNumU;                  // Number of points per row
+    int mNumV;                  // Number of rows
+    const float* mU;            // Surface parameters of the points
+    const float* mV;
+};
+
+/// The renderer's description of the grid that a plugin call shades.  The
+/// plugin interface doesn't provide it, so the host installs an
+/// implementation that forwards to the renderer (see CgSetGridInfo in
+/// CgSkeleton.cpp).  Without one, partitions containing derivatives or
+/// texture lookups are interpreted.  Implementations must be thread safe.
+class OpGridInfo {
+public:
+    /// Destructor is virtual.
+    virtual ~OpGridInfo() { }
+
+    /// Get the number of points per row and the number of rows of the grid
+    /// shaded by a plugin call.  Returns false if the points don't form a
+    /// rectangular grid.
+    virtual bool GetGridSize(RslContext* context, int* numU, int* numV) = 0;
+};
+
+/// Initialize the topology of a grid with the given dimensions, whose n
+/// points are passed to a plugin call.  Returns false if some points are
+/// missing, i.e. they're inactive, since the neighbors of the remaining
+/// points can't be determined.
+inline bool
+OpGridInit(OpGrid* grid, int numU, int numV, const float* u, const float* v,
+           int n)
+{
+    if (numU <= 0 || numV <= 0 || numU * numV != n)
+        return false;
+    grid->mNumU = numU;
+    grid->mNumV = numV;
+    grid->mU = u;
+    grid->mV = v;
+    return true;
+}
+
+/// Get the number of points in a grid.
+inline int
+OpGridSize(const OpGrid& grid)
+{
+    return grid.mNumU * grid.mNumV;
+}
+
+/// Get the index of the point with which point i is differenced in u: the
+/// next point in its row, or the previous one at the end of the row.
+/// Returns i if the rows have a single point.
+inline int
+OpGridNeighborU(const OpGrid& grid, int i)
+{
+    if (grid.mNumU < 2)
+        return i;
+    return (i % grid.mNumU == grid.mNumU - 1) ? i - 1 : i + 1;
+}
+
+/// Get the index of the point with which point i is differenced in v: the
+/// next point in its column, or the previous one in the last row.  Returns
+/// i if there is a single row.
+inline int
+OpGridNeighborV(const OpGrid& grid, int i)
+{
+    if (grid.mNumV < 2)
+        return i;
+    return (i / grid.mNumU == grid.mNumV - 1) ? i - grid.mNumU
+                                              : i + grid.mNumU;
+}
+
+/// Get the reciprocal of a difference, or zero if the difference is zero.
+inline float
+OpGridRecip(float d)
+{
+    return d != 0.0f ? 1.0f / d : 0.0f;
+}
+
+/// Compute the derivative with respect to u of each value.
+inline void
+OpGridDu(const OpGrid& grid, float* r, const float* x, int xStride, int size)
+{
+    int n = OpGridSize(grid);
+    for (int i = 0; i < n; ++i) {
+        int j = OpGridNeighborU(grid, i);
+        float scale = OpGridRecip(grid.mU[j] - grid.mU[i]);
+        for (int k = 0; k < size; ++k)
+            r[i*size + k] = (x[j*xStride + k] - x[i*xStride + k]) * scale;
+    }
+}
+
+/// Compute the derivative with respect to v of each value.
+inline void
+OpGridDv(const OpGrid& grid, float* r, const float* x, int xStride, int size)
+{
+    int n = OpGridSize(grid);
+    for (int i = 0; i < n; ++i) {
+        int j = OpGridNeighborV(grid, i);
+        float scale = OpGridRecip(grid.mV[j] - grid.mV[i]);
+        for (int k = 0; k < size; ++k)
+            r[i*size + k] = (x[j*xStride + k] - x[i*xStride + k]) * scale;
+    }
+}
+
+/// Compute the derivative of each value with respect to a float, which is
+/// Du(x)/Du(y) + Dv(x)/Dv(y).  A term is omitted if the float doesn't vary
+/// in that direction.
+inline void
+OpGridDeriv(const OpGrid& grid, float* r, const float* x, int xStride,
+            int size, const float* y, int yStride)
+{
+    int n = OpGridSize(grid);
+    for (int i = 0; i < n; ++i) {
+        int ju = OpGridNeighborU(grid, i), jv = OpGridNeighborV(grid, i);
+        float su = OpGridRecip(y[ju*yStride] - y[i*yStride]);
+        float sv = OpGridRecip(y[jv*yStride] - y[i*yStride]);
+        for (int k = 0; k < size; ++k) {
+            float xi = x[i*xStride + k];
+            r[i*size + k] = (x[ju*xStride + k] - xi) * su +
+                (x[jv*xStride + k] - xi) * sv;
+        }
+    }
+}
+
+/// Compute the area of the micropolygon at each point, which is the length
+/// of the cross product of the differences in u and v.
+inline void
+OpGridArea(const OpGrid& grid, float* r, const float* p, int pStride)
+{
+    int n = OpGridSize(grid);
+    for (int i = 0; i < n; ++i) {
+        const float* pi = &p[i*pStride];
+        const float* pu = &p[OpGridNeighborU(grid, i)*pStride];
+        const float* pv = &p[OpGridNeighborV(grid, i)*pStride];
+        float a[3] = { pu[0] - pi[0], pu[1] - pi[1], pu[2] - pi[2] };
+        float b[3] = { pv[0] - pi[0], pv[1] - pi[1], pv[2] - pi[2] };
+        float c[3] = { a[1]*b[2] - a[2]*b[1],
+                       a[2]*b[0] - a[0]*b[2],
+                       a[0]*b[1] - a[1]*b[0] };
+        r[i] = sqrtf(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]);
+    }
+}
+
+/// Compute the surface normal at each point, which is Du(P) ^ Dv(P).
+inline void
+OpGridCalculateNormal(const OpGrid& grid, float* r, const float* p,
+                      int pStride)
+{
+    int n = OpGridSize(grid);
+    for (int i = 0; i < n; ++i) {
+        int ju = OpGridNeighborU(grid, i), jv = OpGridNeighborV(grid, i);
+        float su = OpGridRecip(grid.mU[ju] - grid.mU[i]);
+        float sv = OpGridRecip(grid.mV[jv] - grid.mV[i]);
+        const float* pi = &p[i*pStride];
+        const float* pu = &p[ju*pStride];
+        const float* pv = &p[jv*pStride];
+        float a[3] = { (pu[0] - pi[0]) * su, (pu[1] - pi[1]) * su,
+                       (pu[2] - pi[2]) * su };
+        float b[3] = { (pv[0] - pi[0]) * sv, (pv[1] - pi[1]) * sv,
+                       (pv[2] - pi[2]) * sv };
+        r[i*3 + 0] = a[1]*b[2] - a[2]*b[1];
+        r[i*3 + 1] = a[2]*b[0] - a[0]*b[2];
+        r[i*3 + 2] = a[0]*b[1] - a[1]*b[0];
+    }
+}
+
+/// Compute the filter width of a float at each point, for texture lookups,
+/// which is the larger of its differences with the neighbors in u and v.
+inline void
+OpGridFilterWidth(const OpGrid& grid, float* r, const float* x, int xStride)
+{
+    int n = OpGridSize(grid);
+    for (int i = 0; i < n; ++i) {
+        float xi = x[i*xStride];
+        float du = fabsf(x[OpGridNeighborU(grid, i)*xStride] - xi);
+        float dv = fabsf(x[OpGridNeighborV(grid, i)*xStride] - xi);
+        r[i] = du > dv ? du : dv;
+    }
+}
+
+/// Get the angle (in radians) between two directions, which needn't be
+/// normalized.  Returns zero if either is degenerate.
+inline float
+OpGridAngle(const float* a, const float* b)
+{
+    float lens = sqrtf((a[0]*a[0] + a[1]*a[1] + a[2]*a[2]) *
+                       (b[0]*b[0] + b[1]*b[1] + b[2]*b[2]));
+    if (lens == 0.0f)
+        return 0.0f;
+    float c = (a[0]*b[0] + a[1]*b[1] + a[2]*b[2]) / lens;
+    return acosf(c < -1.0f ? -1.0f : (c > 1.0f ? 1.0f : c));
+}
+
+/// Compute the angular filter width of a direction at each point, for
+/// environment lookups, which is the larger of its angles with the
+/// directions of the neighbors in u and v.
+inline void
+OpGridAngularWidth(const OpGrid& grid, float* r, const float* d, int dStride)
+{
+    int n = OpGridSize(grid);
+    for (int i = 0; i < n; ++i) {
+        const float* di = &d[i*dStride];
+        float au = OpGridAngle(di, &d[OpGridNeighborU(grid, i)*dStride]);
+        float av = OpGridAngle(di, &d[OpGridNeighborV(grid, i)*dStride]);
+        r[i] = au > av ? au : av;
+    }
+}
+
+#endif // ndef OP_DERIV_H
@@ -0,0 +1,105 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_DYN_ARRAY_H
+#define OP_DYN_ARRAY_H
+
+#include "ops/OpArena.h"
+#include <string.h>
+
+/**
+   Resizable arrays in compiled code are represented by a descriptor, which
+   holds the length, the capacity, and a pointer to the elements.  The
+   elements are allocated from the per-call arena (see OpArena.h), so growing
+   an array simply allocates a larger buffer; the old one is reclaimed when
+   the arena is freed.  A zeroed descriptor is an empty array, which is how
+   local variables and grid temporaries are initialized.
+
+   The shadeops that change the length of a resizable array take a pointer
+   to its descriptor, followed by the arena.  Other shadeops receive the
+   element pointer and length, like a fixed-length array (see
+   CgInst::GenOpCall).
+*/
+class OpDynArray {
+public:
+    void* mData;                // Elements (NULL if the capacity is zero)
+    int mLength;                // Number of elements
+    int mCapacity;              // Number of elements allocated
+};
+
+/// Ensure that a resizable array has room for the given number of elements
+/// of the given size (in bytes), reallocating it if necessary.  The
+/// capacity at least doubles, to amortize the cost of pushing elements.
+inline void
+OpDynArrayReserve(OpDynArray* array, OpArena* arena, int capacity,
+                  size_t elementSize)
+{
+    if (capacity <= array->mCapacity)
+        return;
+    int newCapacity = 2 * array->mCapacity;
+    if (newCapacity < capacity)
+        newCapacity = capacity;
+    if (newCapacity < 4)
+        newCapacity = 4;
+    void* data = OpArenaAlloc(arena, newCapacity * elementSize);
+    if (data == NULL)
+        return;
+    if (array->mLength > 0)
+        memcpy(data, array->mData, array->mLength * elementSize);
+    array->mData = data;
+    array->mCapacity = newCapacity;
+}
+
+/// Set the length of a resizable array.  New elements are zeroed.  A
+/// negative length is treated as zero.
+inline void
+OpDynArrayResize(OpDynArray* array, OpArena* arena, int length,
+                 size_t elementSize)
+{
+    if (length < 0)
+        length = 0;
+    OpDynArrayReserve(array, arena, length, elementSize);
+    if (length > array->mCapacity)
+        return;                 // Out of memory
+    if (length > array->mLength) {
+        char* data = static_cast<char*>(array->mData);
+        memset(data + array->mLength * elementSize, 0,
+               (length - array->mLength) * elementSize);
+    }
+    array->mLength = length;
+}
+
+/// Append an element to a resizable array.
+template<typename T>
+inline void
+OpDynArrayPush(OpDynArray* array, OpArena* arena, const T& value)
+{
+    OpDynArrayReserve(array, arena, array->mLength + 1, sizeof(T));
+    if (array->mLength < array->mCapacity)
+        static_cast<T*>(array->mData)[array->mLength++] = value;
+}
+
+/// Remove the last element of a resizable array, returning it.  Popping an
+/// empty array yields the given default value.
+template<typename T>
+inline T
+OpDynArrayPop(OpDynArray* array, const T& defaultValue)
+{
+    if (array->mLength == 0)
+        return defaultValue;
+    return static_cast<T*>(array->mData)[--array->mLength];
+}
+
+/// Assign the elements of an array to a resizable array, resizing it to
+/// match.
+template<typename T>
+inline void
+OpDynArrayAssign(OpDynArray* array, OpArena* arena, const T* src, int length)
+{
+    OpDynArrayResize(array, arena, length, sizeof(T));
+    if (array->mLength == length && length > 0)
+        memmove(array->mData, src, length * sizeof(T));
+}
+
+#endif // ndef OP_DYN_ARRAY_H
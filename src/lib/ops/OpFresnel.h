@@ -0,0 +1,52 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_FRESNEL_H
+#define OP_FRESNEL_H
+
+#include "ops/OpVec3.h"
+#include <math.h>
+
+/// Compute the Fresnel reflection and transmission coefficients (Kr and Kt)
+/// for a dielectric, along with the reflected and refracted directions (R
+/// and T), for the fresnel shadeops (see Ops.cpp).  The incident direction
+/// I and normal N need not be normalized.  The relative index of refraction
+/// eta is as for refract: the ratio of the index on the incident side to the
+/// index on the other side.  The reflection coefficient is the average for
+/// unpolarized light, and Kt = 1 - Kr.  Under total internal reflection, Kr
+/// is one and T is zero.
+inline void
+OpFresnel(const OpVec3& I, const OpVec3& N, float eta,
+          float* Kr, float* Kt, OpVec3* R, OpVec3* T)
+{
+    OpVec3 In = I.Normalized();
+    OpVec3 Nn = N.Normalized();
+    float IdotN = In * Nn;
+    *R = In - 2.0f * IdotN * Nn;
+
+    float k = 1.0f - eta*eta*(1.0f - IdotN*IdotN);
+    if (k < 0.0f) {
+        *Kr = 1.0f;
+        *Kt = 0.0f;
+        *T = OpVec3(0.0f);
+        return;
+    }
+    float cosT = sqrtf(k);
+    *T = eta * In - (eta*IdotN + cosT) * Nn;
+
+    // Reflectance for light polarized perpendicular and parallel to the
+    // plane of incidence.  Everything is reflected at grazing incidence.
+    float cosI = fabsf(IdotN);
+    if (cosI == 0.0f) {
+        *Kr = 1.0f;
+        *Kt = 0.0f;
+        return;
+    }
+    float rs = (eta*cosI - cosT) / (eta*cosI + cosT);
+    float rp = (cosI - eta*cosT) / (cosI + eta*cosT);
+    *Kr = 0.5f * (rs*rs + rp*rp);
+    *Kt = 1.0f - *Kr;
+}
+
+#endif // ndef OP_FRESNEL_H
@@ -19,6 +19,7 @@ OpInfo::GetOpName(Opcode opcode)
       case kOpcode_ArrayAssign: return "OpArrayAssign";
       case kOpcode_ArrayAssignComp: return "OpArrayAssignComp";
       case kOpcode_ArrayAssignMxComp: return "OpArrayAssignMxComp";
+      case kOpcode_ArrayLength: return "OpArrayLength";
       case kOpcode_ArrayRef: return "OpArrayRef";
       case kOpcode_Asin: return "OpAsin";
       case kOpcode_Assign: return "OpAssign";
@@ -29,9 +30,12 @@ OpInfo::GetOpName(Opcode opcode)
       // case kOpcode_CellNoise: return "OpCellNoise";
       case kOpcode_Clamp: return "OpClamp";
       case kOpcode_Comp: return "OpComp";
+      case kOpcode_Concat: return "OpConcat";
       case kOpcode_Color: return "OpColor";
+      case kOpcode_ColorTransform: return "OpColorTransform";
       case kOpcode_Cos: return "OpCos";
       case kOpcode_Cross: return "OpCross";
+      case kOpcode_CTransform: return "OpCTransform";
       case kOpcode_Degrees: return "OpDegrees";
       case kOpcode_Determinant: return "OpDeterminant";
       case kOpcode_Distance: return "OpDistance";
@@ -43,6 +47,8 @@ OpInfo::GetOpName(Opcode opcode)
       case kOpcode_Exp: return "OpExp";
       case kOpcode_FaceForward: return "OpFaceForward";
       case kOpcode_Floor: return "OpFloor";
+      case kOpcode_Format: return "OpFormat";
+      case kOpcode_Fresnel: return "OpFresnel";
       case kOpcode_GE: return "OpGE";
       case kOpcode_GT: return "OpGT";
       case kOpcode_GeoNormals: return "OpGeoNormals";
@@ -51,14 +57,14 @@ OpInfo::GetOpName(Opcode opcode)
       case kOpcode_LT: return "OpLT";
       case kOpcode_Length: return "OpLength";
       case kOpcode_Log: return "OpLog";
+      case kOpcode_Match: return "OpMatch";
       case kOpcode_Matrix: return "OpMatrix";
       case kOpcode_Max: return "OpMax";
       case kOpcode_Min: return "OpMin";
       case kOpcode_Mix: return "OpMix";
       case kOpcode_Mod: return "OpMod";
-      // The variant with named spaces can't be compiled, so this is disabled.
-      // case kOpcode_MTransformMx: return "OpMTransformMx";
       case kOpcode_Multiply: return "OpMultiply";
+      case kOpcode_NTransformMx: return "OpNTransformMx";
       case kOpcode_MxComp: return "OpMxComp";
       case kOpcode_MxRotate: return "OpMxRotate";
       case kOpcode_MxScale: return "OpMxScale";
@@ -73,11 +79,15 @@ OpInfo::GetOpName(Opcode opcode)
       // Noise is disabled because it hurts performance
       // case kOpcode_PNoise: return "OpPNoise";
       case kOpcode_Point: return "OpPoint";
+      case kOpcode_Pop: return "OpPop";
       case kOpcode_Pow: return "OpPow";
       case kOpcode_Print: return "OpPrint";
+      case kOpcode_Push: return "OpPush";
       case kOpcode_Radians: return "OpRadians";
       case kOpcode_Reflect: return "OpReflect";
       case kOpcode_Refract: return "OpRefract";
+      case kOpcode_Reserve: return "OpReserve";
+      case kOpcode_Resize: return "OpResize";
       case kOpcode_Rotate: return "OpRotate";
       case kOpcode_Round: return "OpRound";
       case kOpcode_Scale: return "OpScale";
@@ -88,13 +98,16 @@ OpInfo::GetOpName(Opcode opcode)
       case kOpcode_Sign: return "OpSign";
       case kOpcode_Sin: return "OpSin";
       case kOpcode_SmoothStep: return "OpSmoothStep";
+      case kOpcode_Spline: return "OpSpline";
       case kOpcode_Sqrt: return "OpSqrt";
       case kOpcode_Step: return "OpStep";
       case kOpcode_Subtract: return "OpSubtract";
       case kOpcode_Tan: return "OpTan";
-      // The variant with named spaces can't be compiled, so these are disabled.
-      // case kOpcode_TransformMx: return "OpTransformMx";
-      // case kOpcode_VTransformMx: return "OpVTransformMx";
+      // The variants with a named "from" space can't be compiled (see
+      // XfIsNamedSpaceInst).  Named spaces are usually resolved to matrices
+      // beforehand (see XfResolveSpaces).
+      case kOpcode_TransformMx: return "OpTransformMx";
+      case kOpcode_VTransformMx: return "OpVTransformMx";
       case kOpcode_XComp: return "OpXComp";
       case kOpcode_YComp: return "OpYComp";
       case kOpcode_ZComp: return "OpZComp";
@@ -102,6 +115,24 @@ OpInfo::GetOpName(Opcode opcode)
     }
 }
 
+// Get the name of a less accurate but faster shadeop that implements the
+// specified instruction, if any (see OpMath.h).  Returns NULL if there is no
+// fast variant.  The name is mangled like that of the ordinary shadeop.
+const char*
+OpInfo::GetFastOpName(Opcode opcode)
+{
+    switch (opcode) {
+      case kOpcode_Atan: return "OpFastAtan";
+      case kOpcode_Cos: return "OpFastCos";
+      case kOpcode_Exp: return "OpFastExp";
+      case kOpcode_InverseSqrt: return "OpFastInverseSqrt";
+      case kOpcode_Log: return "OpFastLog";
+      case kOpcode_Pow: return "OpFastPow";
+      case kOpcode_Sin: return "OpFastSin";
+      default: return NULL;
+    }
+}
+
 // An overloaded shadeop name is mangled with suffix denoting the
 // argument types, ("f" for float, "t" for triple, "F" for a float array,
 // etc).  For example, OpAdd_tt adds two triples.
@@ -111,14 +142,17 @@ OpInfo::IsOverloaded(Opcode opcode)
     switch (opcode) {
       case kOpcode_Add:
       case kOpcode_ArrayAssign:
+      case kOpcode_ArrayLength:
       case kOpcode_ArrayRef:
       case kOpcode_Assign:
       case kOpcode_AssignMatrix:
       case kOpcode_Atan:
       case kOpcode_CellNoise:
       case kOpcode_Clamp:
+      case kOpcode_CTransform:
       case kOpcode_Divide:
       case kOpcode_EQ:
+      case kOpcode_Fresnel:
       case kOpcode_Log:
       case kOpcode_Max:
       case kOpcode_Min:
@@ -129,9 +163,16 @@ OpInfo::IsOverloaded(Opcode opcode)
       case kOpcode_NE:
       case kOpcode_Negate:
       case kOpcode_Noise:
+      case kOpcode_NTransform:
+      case kOpcode_NTransformMx:
       case kOpcode_PNoise:
+      case kOpcode_Pop:
       case kOpcode_Print:
+      case kOpcode_Push:
+      case kOpcode_Reserve:
+      case kOpcode_Resize:
       case kOpcode_Scale:
+      case kOpcode_Spline:
       case kOpcode_Subtract:
       case kOpcode_Transform:
       case kOpcode_TransformMx:
@@ -217,6 +258,7 @@ OpInfo::HasOutput(Opcode opcode)
       case kOpcode_CallDSO:
       case kOpcode_Displacement:
       case kOpcode_Environment:
+      case kOpcode_Fresnel:
       case kOpcode_GetVar:
       case kOpcode_Incident:
       case kOpcode_IndirectDiffuse:
@@ -285,6 +327,10 @@ OpInfo::IsOutput(Opcode opcode, int i)
           // Note that these routines aren't guaranteed to write the output!
           return i == 1;
 
+      case kOpcode_Fresnel:
+          // fresnel(I, N, eta, Kr, Kt [, R, T])
+          return i >= 3;
+
       // ----- The following have overly conservative answers. -----
       case kOpcode_CallDSO:
           // Any parameter could be written.  Could load DSO and check entry
@@ -316,10 +362,37 @@ OpInfo::IsOutput(Opcode opcode, int i)
 bool
 OpInfo::KillsArg(Opcode opcode, int i)
 {
-    // I don't know of any shadeops that unconditionally write their output
-    // arguments!  Array assignment and component setters obviously overwrite
+    // Fresnel is the only shadeop that unconditionally writes its output
+    // arguments.  Array assignment and component setters obviously overwrite
     // only part of the output argument value.  Message passing, attribute,
     // option, and info shadeops all conditionally write their outputs.
-    return false;
+    return opcode == kOpcode_Fresnel && i >= 3;
 }
 
+// Check whether a compiled instruction can be executed speculatively, i.e. it
+// has no side effects other than writing its result and output arguments, and
+// it is safe for any argument values.
+bool
+OpInfo::IsSpeculatable(Opcode opcode)
+{
+    switch (opcode) {
+      // Array and component indexing might be out of range.
+      case kOpcode_ArrayAssign:
+      case kOpcode_ArrayAssignComp:
+      case kOpcode_ArrayAssignMxComp:
+      case kOpcode_ArrayRef:
+      case kOpcode_Comp:
+      case kOpcode_MxComp:
+      case kOpcode_MxSetComp:
+      case kOpcode_SetComp:
+          return false;
+
+      // Printing has visible side effects.
+      case kOpcode_Print:
+      case kOpcode_Printf:
+          return false;
+
+      default:
+          return GetOpName(opcode) != NULL;
+    }
+}
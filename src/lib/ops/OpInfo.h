@@ -21,6 +21,12 @@ public:
     /// require mangling to resove overloading (see OpIsOverloaded).
     static const char* GetOpName(Opcode opcode);
 
+    /// Get the name of a faster but less accurate shadeop that implements
+    /// the specified instruction, if any, for use when fast math is enabled
+    /// (see OpMath.h).  Returns NULL if there is no fast variant.  The name
+    /// is mangled like the name returned by GetOpName.
+    static const char* GetFastOpName(Opcode opcode);
+
     /// An overloaded shadeop name is mangled with suffix denoting the
     /// argument types, ("f" for float, "t" for triple, "F" for a float array,
     /// etc).  For example, OpAdd_tt adds two triples.
@@ -43,6 +49,13 @@ public:
     /// Check whether the ith argument of the specified instruction is killed
     /// (i.e. value ignored on input; completely overwritten on output).
     static bool KillsArg(Opcode opcode, int i);
+
+    /// Check whether a compiled instruction can be executed speculatively,
+    /// i.e. it has no side effects other than writing its result and output
+    /// arguments, and it is safe for any argument values.  For example,
+    /// array indexing is not speculatable, since an index might be out of
+    /// range when the instruction isn't supposed to execute.
+    static bool IsSpeculatable(Opcode opcode);
 };
 
 #endif // OP_NAMES_H
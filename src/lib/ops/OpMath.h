@@ -0,0 +1,434 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_MATH_H
+#define OP_MATH_H
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+   Polynomial implementations of the transcendental functions used by the
+   shadeops (see Ops.cpp).  Unlike calls to libm, they can be inlined into
+   kernels and vectorized by LLVM: apart from range reduction they are
+   straight-line code, and special cases are handled by selects rather than
+   branches.
+
+   There are two accuracy tiers:
+
+   - The "exact" functions (e.g. OpMathSin) are within a few ULPs of the
+     correctly rounded result.  The shadeops use them by default.
+
+   - The "fast" functions (e.g. OpMathFastSin) use cheaper range reduction
+     and lower-degree polynomials.  They are used by the OpFast shadeops,
+     which the code generator selects when fast math is enabled (see
+     CgOptions::mFastMath).
+
+   The error bounds below are verified by TestOpMath, which sweeps each
+   function over the stated domain and compares it with libm (evaluated in
+   double precision).
+
+     Function       Domain           Exact          Fast
+     sin, cos       |x| <= 10000     2 ulp          2e-6 absolute
+     exp            [-87, 88]        1 ulp          1e-5 relative
+     log            (0, inf)         1 ulp          2e-7 (see below)
+     pow            (see below)      1 ulp          2e-5 relative
+     atan, atan2    all              3 ulp          3e-6 absolute
+     inversesqrt    [FLT_MIN, inf)   2 ulp          5e-6 relative
+
+   The error of the fast log is absolute for results less than one in
+   magnitude, and relative otherwise.  The pow bounds apply when |b*log(a)|
+   is at most 76 (so the result neither overflows nor underflows).  Signed
+   zeros are not distinguished, and the result of sin or cos is unspecified
+   for infinite arguments.
+*/
+
+/// Reinterpret the bits of a float as an integer.
+inline int32_t
+OpMathFloatBits(float x)
+{
+    union { float f; int32_t i; } u;
+    u.f = x;
+    return u.i;
+}
+
+/// Reinterpret the bits of an integer as a float.
+inline float
+OpMathBitsFloat(int32_t i)
+{
+    union { float f; int32_t i; } u;
+    u.i = i;
+    return u.f;
+}
+
+/// Multiply by 2^n, for n in [-252,254].  The scaling is split in two steps
+/// so that overflow and gradual underflow happen in the multiply.
+inline float
+OpMathScale(float x, int n)
+{
+    int n1 = n >> 1;
+    int n2 = n - n1;
+    return x * OpMathBitsFloat((n1 + 127) << 23) *
+        OpMathBitsFloat((n2 + 127) << 23);
+}
+
+/// Split a positive, finite float into an exponent and a mantissa in
+/// [sqrt(1/2), sqrt(2)).  Denormals are normalized.
+inline float
+OpMathFrexp(float x, int* exponent)
+{
+    bool isDenormal = x < 1.17549435e-38f;
+    x = isDenormal ? x * 8388608.0f : x;
+    int32_t bits = OpMathFloatBits(x);
+    int e = ((bits >> 23) & 0xff) - 126 - (isDenormal ? 23 : 0);
+    float m = OpMathBitsFloat((bits & 0x007fffff) | 0x3f000000);
+    bool isSmall = m < 0.707106781f;
+    *exponent = isSmall ? e - 1 : e;
+    return isSmall ? m + m : m;
+}
+
+// ---------- Sine and cosine ----------
+
+/// Evaluate the sine polynomial on [-pi/4,pi/4].
+inline float
+OpMathSinPoly(float r, float z)
+{
+    return r + r * z * (-1.6666654611e-1f +
+                        z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+}
+
+/// Evaluate the cosine polynomial on [-pi/4,pi/4].
+inline float
+OpMathCosPoly(float z)
+{
+    return 1.0f - 0.5f * z +
+        z * z * (4.166664568298827e-2f +
+                 z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+}
+
+/// Select the sine or cosine of the reduced argument according to the
+/// quadrant.  An odd quadrant swaps sine and cosine, and quadrants 2 and 3
+/// negate the result.
+inline float
+OpMathQuadrant(int quadrant, float s, float c)
+{
+    float v = (quadrant & 1) ? c : s;
+    return (quadrant & 2) ? -v : v;
+}
+
+/// Compute the sine (offset 0) or cosine (offset 1).  The argument is
+/// reduced modulo pi/2 in double precision.
+inline float
+OpMathSinCos(float x, int offset)
+{
+    double j = floor(x * 0.63661977236758134 + 0.5);
+    float r = static_cast<float>(x - j * 1.5707963267948966);
+    float z = r * r;
+    int quadrant = static_cast<int>(j) + offset;
+    return OpMathQuadrant(quadrant, OpMathSinPoly(r, z), OpMathCosPoly(z));
+}
+
+/// Compute the sine or cosine with single precision argument reduction and
+/// shorter polynomials.
+inline float
+OpMathFastSinCos(float x, int offset)
+{
+    float j = floorf(x * 0.636619772f + 0.5f);
+    float r = (x - j * 1.5703125f) - j * 4.83826792e-4f;
+    float z = r * r;
+    float s = r + r * z * (-0.166633904f + z * 0.00816328246f);
+    float c = 1.0f + z * (-0.499998847f +
+                          z * (0.0416557772f + z * -0.00135918557f));
+    return OpMathQuadrant(static_cast<int>(j) + offset, s, c);
+}
+
+/// Compute sin(x).
+inline float
+OpMathSin(float x)
+{
+    return OpMathSinCos(x, 0);
+}
+
+/// Compute cos(x).
+inline float
+OpMathCos(float x)
+{
+    return OpMathSinCos(x, 1);
+}
+
+/// Compute sin(x) (fast tier).
+inline float
+OpMathFastSin(float x)
+{
+    return OpMathFastSinCos(x, 0);
+}
+
+/// Compute cos(x) (fast tier).
+inline float
+OpMathFastCos(float x)
+{
+    return OpMathFastSinCos(x, 1);
+}
+
+// ---------- Exponential and logarithm ----------
+
+/// Compute exp(x).  The argument is split into n*ln(2) + r, with |r| <=
+/// ln(2)/2, and the result is 2^n * exp(r).
+inline float
+OpMathExp(float x)
+{
+    float c = x < -104.0f ? -104.0f : (x > 89.0f ? 89.0f : x);
+    float n = floorf(c * 1.44269504f + 0.5f);
+    float r = (c - n * 0.693359375f) + n * 2.12194440e-4f;
+    float z = r * r;
+    float p = ((((( 1.9875691500e-4f * r + 1.3981999507e-3f) * r +
+                  8.3334519073e-3f) * r + 4.1665795894e-2f) * r +
+                1.6666665459e-1f) * r + 5.0000001201e-1f) * z + r + 1.0f;
+    float result = OpMathScale(p, static_cast<int>(n));
+    return x != x ? x : result;
+}
+
+/// Compute exp(x) (fast tier).
+inline float
+OpMathFastExp(float x)
+{
+    float c = x < -104.0f ? -104.0f : (x > 89.0f ? 89.0f : x);
+    float n = floorf(c * 1.44269504f + 0.5f);
+    float r = c - n * 0.693147181f;
+    float p = 1.0f + r + r * r * (0.500051166f +
+                                  r * (0.167535157f + r * 0.0412776985f));
+    float result = OpMathScale(p, static_cast<int>(n));
+    return x != x ? x : result;
+}
+
+/// Handle the special cases of log(x): NaN for negative arguments, -inf for
+/// zero, and +inf for +inf.
+inline float
+OpMathLogSpecial(float x, float result)
+{
+    result = x == 0.0f ? -HUGE_VALF : result;
+    result = x == HUGE_VALF ? x : result;
+    return (x < 0.0f || x != x) ? (x - x) / (x - x) : result;
+}
+
+/// Compute log(x).
+inline float
+OpMathLog(float x)
+{
+    int e;
+    float m = OpMathFrexp(x, &e) - 1.0f;
+    float fe = static_cast<float>(e);
+    float z = m * m;
+    float y = ((((((((7.0376836292e-2f * m - 1.1514610310e-1f) * m +
+                     1.1676998740e-1f) * m - 1.2420140846e-1f) * m +
+                   1.4249322787e-1f) * m - 1.6668057665e-1f) * m +
+                 2.0000714765e-1f) * m - 2.4999993993e-1f) * m +
+               3.3333331174e-1f) * m * z;
+    y += fe * -2.12194440e-4f;
+    y += -0.5f * z;
+    float result = (m + y) + fe * 0.693359375f;
+    return OpMathLogSpecial(x, result);
+}
+
+/// Compute log(x) (fast tier), using log(m) = log((1+s)/(1-s)) with
+/// s = (m-1)/(m+1).
+inline float
+OpMathFastLog(float x)
+{
+    int e;
+    float m = OpMathFrexp(x, &e);
+    float s = (m - 1.0f) / (m + 1.0f);
+    float z = s * s;
+    float result = 2.0f * s + s * z * (0.666534274f + z * 0.412874804f) +
+        e * 0.693147181f;
+    return OpMathLogSpecial(x, result);
+}
+
+// ---------- Power ----------
+
+/// Compute the natural logarithm of a positive, finite double.
+inline double
+OpMathLogDouble(double x)
+{
+    union { double d; uint64_t i; } u;
+    u.d = x;
+    int e = static_cast<int>((u.i >> 52) & 0x7ff) - 1022;
+    u.i = (u.i & 0x000fffffffffffffULL) | 0x3fe0000000000000ULL;
+    bool isSmall = u.d < 0.70710678118654752;
+    double m = isSmall ? u.d + u.d : u.d;
+    e = isSmall ? e - 1 : e;
+    double s = (m - 1.0) / (m + 1.0);
+    double z = s * s;
+    double p = 1.0/15.0;
+    p = p * z + 1.0/13.0;
+    p = p * z + 1.0/11.0;
+    p = p * z + 1.0/9.0;
+    p = p * z + 1.0/7.0;
+    p = p * z + 1.0/5.0;
+    p = p * z + 1.0/3.0;
+    p = p * z + 1.0;
+    return 2.0 * s * p + e * 0.69314718055994531;
+}
+
+/// Compute exp(x) in double precision, for x in [-200,200].
+inline double
+OpMathExpDouble(double x)
+{
+    double n = floor(x * 1.4426950408889634 + 0.5);
+    double r = x - n * 0.69314718055994531;
+    double p = 1.0/39916800.0;
+    p = p * r + 1.0/3628800.0;
+    p = p * r + 1.0/362880.0;
+    p = p * r + 1.0/40320.0;
+    p = p * r + 1.0/5040.0;
+    p = p * r + 1.0/720.0;
+    p = p * r + 1.0/120.0;
+    p = p * r + 1.0/24.0;
+    p = p * r + 1.0/6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+    union { double d; uint64_t i; } u;
+    u.i = static_cast<uint64_t>(static_cast<int>(n) + 1023) << 52;
+    return p * u.d;
+}
+
+/// Handle the special cases of pow(a,b), given |a|^b: negative bases with
+/// integer exponents, zero bases, and NaN arguments.
+inline float
+OpMathPowSpecial(float a, float b, float result)
+{
+    float half = 0.5f * b;
+    bool isInt = floorf(b) == b;
+    bool isOdd = isInt && floorf(half) != half;
+    result = (a < 0.0f && isOdd) ? -result : result;
+    result = (a < 0.0f && !isInt) ? (b - b) / (b - b) : result;
+    result = a == 0.0f ? (b < 0.0f ? HUGE_VALF : 0.0f) : result;
+    result = (b == 0.0f || a == 1.0f) ? 1.0f : result;
+    return (a != a || b != b) ? a + b : result;
+}
+
+/// Compute pow(a,b).  The product b*log(a) is computed in double precision,
+/// since its error is magnified by the exponential.
+inline float
+OpMathPow(float a, float b)
+{
+    float ax = fabsf(a);
+    double y = b * OpMathLogDouble(ax == 0.0f ? 1.0f : ax);
+    y = y < -200.0 ? -200.0 : (y > 200.0 ? 200.0 : y);
+    float result = static_cast<float>(OpMathExpDouble(y));
+    return OpMathPowSpecial(a, b, result);
+}
+
+/// Compute pow(a,b) (fast tier).
+inline float
+OpMathFastPow(float a, float b)
+{
+    float ax = fabsf(a);
+    float result = OpMathFastExp(b * OpMathFastLog(ax == 0.0f ? 1.0f : ax));
+    return OpMathPowSpecial(a, b, result);
+}
+
+// ---------- Arctangent ----------
+
+/// Compute atan(n/d) for 0 <= n <= d, reducing to [0,tan(pi/8)] with
+/// atan(x) = pi/4 + atan((x-1)/(x+1)).  The reduced argument is computed
+/// from n and d directly, avoiding the rounding error of n/d.
+inline float
+OpMathAtanUnit(float n, float d)
+{
+    bool isLarge = n > 0.414213562f * d;
+    float t = isLarge ? (n - d) / (n + d) : n / d;
+    float z = t * t;
+    float p = (((8.05374449538e-2f * z - 1.38776856032e-1f) * z +
+                1.99777106478e-1f) * z - 3.33329491539e-1f) * z * t + t;
+    return isLarge ? 0.785398163f + p : p;
+}
+
+/// Compute atan(n/d) for 0 <= n <= d (fast tier).
+inline float
+OpMathFastAtanUnit(float n, float d)
+{
+    float x = n / d;
+    float z = x * x;
+    return x + x * z * (-0.332965928f +
+                        z * (0.195182532f +
+                             z * (-0.119817967f +
+                                  z * (0.0558051542f +
+                                       z * -0.0128079848f))));
+}
+
+/// Compute atan2(y,x) given an arctangent function on [0,1].  The ratio of
+/// the smaller and larger magnitudes is in [0,1], and the result is
+/// reflected into the proper octant.
+template<float (*AtanUnit)(float, float)>
+inline float
+OpMathAtan2Impl(float y, float x)
+{
+    float ax = fabsf(x), ay = fabsf(y);
+    bool swap = ay > ax;
+    float mn = swap ? ax : ay;
+    float mx = swap ? ay : ax;
+    // Both zero yields zero, and both infinite yields pi/4.
+    bool isZero = mx == 0.0f, isInf = mn == HUGE_VALF;
+    float r = AtanUnit(isZero ? 0.0f : (isInf ? 1.0f : mn),
+                       isZero || isInf ? 1.0f : mx);
+    r = swap ? (1.57079625f - r) + 7.54978995e-8f : r;
+    r = x < 0.0f ? (3.14159250f - r) + 1.50995799e-7f : r;
+    r = y < 0.0f ? -r : r;
+    return (x != x || y != y) ? x + y : r;
+}
+
+/// Compute atan2(y,x).
+inline float
+OpMathAtan2(float y, float x)
+{
+    return OpMathAtan2Impl<OpMathAtanUnit>(y, x);
+}
+
+/// Compute atan2(y,x) (fast tier).
+inline float
+OpMathFastAtan2(float y, float x)
+{
+    return OpMathAtan2Impl<OpMathFastAtanUnit>(y, x);
+}
+
+/// Compute atan(x).
+inline float
+OpMathAtan(float x)
+{
+    return OpMathAtan2(x, 1.0f);
+}
+
+/// Compute atan(x) (fast tier).
+inline float
+OpMathFastAtan(float x)
+{
+    return OpMathFastAtan2(x, 1.0f);
+}
+
+// ---------- Inverse square root ----------
+
+/// Compute 1/sqrt(x).  Unlike libm calls, sqrtf is an LLVM intrinsic, which
+/// is vectorized.
+inline float
+OpMathInverseSqrt(float x)
+{
+    return 1.0f / sqrtf(x);
+}
+
+/// Compute 1/sqrt(x) (fast tier), refining an initial estimate obtained by
+/// integer arithmetic on the exponent with two Newton-Raphson steps.  Zero
+/// and denormal arguments are not supported.
+inline float
+OpMathFastInverseSqrt(float x)
+{
+    float y = OpMathBitsFloat(0x5f375a86 - (OpMathFloatBits(x) >> 1));
+    float h = 0.5f * x;
+    y = y * (1.5f - h * y * y);
+    y = y * (1.5f - h * y * y);
+    return y;
+}
+
+#endif // ndef OP_MATH_H
@@ -0,0 +1,113 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_SPLINE_H
+#define OP_SPLINE_H
+
+#include <strings.h>
+
+/**
+   Cubic spline evaluation for the spline shadeops (see Ops.cpp).  A spline
+   with n control points consists of segments, each of which is a cubic
+   polynomial determined by four consecutive control points and the basis
+   matrix.  Consecutive segments are offset by the step size of the basis
+   (one for Catmull-Rom, B-spline and linear; two for Hermite; three for
+   Bezier).  The parameter value, which is clamped to [0,1], is divided
+   uniformly among the segments.
+
+   Like RSL, the linear basis interpolates the interior control points, so
+   the first and last control points are ignored (as they would be by a
+   Catmull-Rom spline with the same control points).
+*/
+
+/// Spline bases.
+enum OpSplineBasis {
+    kOpSplineCatmullRom,
+    kOpSplineBezier,
+    kOpSplineBSpline,
+    kOpSplineHermite,
+    kOpSplineLinear,
+    kOpNumSplineBases
+};
+
+/// Basis matrices, indexed by OpSplineBasis.  Row i holds the coefficients
+/// of t^(3-i) for each of the four control points.
+static const float kOpSplineBases[kOpNumSplineBases][4][4] = {
+    // Catmull-Rom
+    { { -0.5f,  1.5f, -1.5f,  0.5f },
+      {  1.0f, -2.5f,  2.0f, -0.5f },
+      { -0.5f,  0.0f,  0.5f,  0.0f },
+      {  0.0f,  1.0f,  0.0f,  0.0f } },
+    // Bezier
+    { { -1.0f,  3.0f, -3.0f,  1.0f },
+      {  3.0f, -6.0f,  3.0f,  0.0f },
+      { -3.0f,  3.0f,  0.0f,  0.0f },
+      {  1.0f,  0.0f,  0.0f,  0.0f } },
+    // B-spline
+    { { -1/6.0f,  3/6.0f, -3/6.0f,  1/6.0f },
+      {  3/6.0f, -6/6.0f,  3/6.0f,  0.0f   },
+      { -3/6.0f,  0.0f,    3/6.0f,  0.0f   },
+      {  1/6.0f,  4/6.0f,  1/6.0f,  0.0f   } },
+    // Hermite (point, tangent, point, tangent)
+    { {  2.0f,  1.0f, -2.0f,  1.0f },
+      { -3.0f, -2.0f,  3.0f, -1.0f },
+      {  0.0f,  1.0f,  0.0f,  0.0f },
+      {  1.0f,  0.0f,  0.0f,  0.0f } },
+    // Linear
+    { {  0.0f,  0.0f,  0.0f,  0.0f },
+      {  0.0f,  0.0f,  0.0f,  0.0f },
+      {  0.0f, -1.0f,  1.0f,  0.0f },
+      {  0.0f,  1.0f,  0.0f,  0.0f } }
+};
+
+/// Step sizes, indexed by OpSplineBasis.
+static const int kOpSplineSteps[kOpNumSplineBases] = { 1, 3, 1, 2, 1 };
+
+/// Get the spline basis with the given name (ignoring case).  Unrecognized
+/// names yield the default basis, Catmull-Rom.
+inline OpSplineBasis
+OpSplineGetBasis(const char* name)
+{
+    if (strcasecmp(name, "bezier") == 0)
+        return kOpSplineBezier;
+    if (strcasecmp(name, "b-spline") == 0 || strcasecmp(name, "bspline") == 0)
+        return kOpSplineBSpline;
+    if (strcasecmp(name, "hermite") == 0)
+        return kOpSplineHermite;
+    if (strcasecmp(name, "linear") == 0)
+        return kOpSplineLinear;
+    return kOpSplineCatmullRom;
+}
+
+/// Evaluate a spline with n control points, which are floats or triples
+/// (any type with addition and scaling by a float).  At least four control
+/// points are required; otherwise the first control point is returned.
+template<typename T>
+inline T
+OpSplineEval(OpSplineBasis basis, float value, const T* points, int n)
+{
+    if (n < 4)
+        return points[0];
+    int step = kOpSplineSteps[basis];
+    int numSegments = (n - 4) / step + 1;
+
+    // Find the segment and the parameter value within it.
+    float x = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    x *= numSegments;
+    int segment = static_cast<int>(x);
+    if (segment >= numSegments)
+        segment = numSegments - 1;
+    float t = x - segment;
+
+    // Weight the control points by the polynomials of the basis matrix.
+    const float (*m)[4] = kOpSplineBases[basis];
+    const T* p = points + segment * step;
+    T result = p[0] * (((m[0][0] * t + m[1][0]) * t + m[2][0]) * t + m[3][0]);
+    for (int i = 1; i < 4; ++i)
+        result = result +
+            p[i] * (((m[0][i] * t + m[1][i]) * t + m[2][i]) * t + m[3][i]);
+    return result;
+}
+
+#endif // ndef OP_SPLINE_H
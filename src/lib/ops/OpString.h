@@ -0,0 +1,384 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_STRING_H
+#define OP_STRING_H
+
+#include "ops/OpArena.h"
+#include <pthread.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+   String operations for the concat, format, and match shadeops (see
+   Ops.cpp).  Strings computed by compiled code are interned in the per-call
+   arena (see OpArena), so computing the same string at every point of the
+   grid allocates it only once.
+
+   Strings that are stored in plugin arguments outlive the call, so before
+   the kernel returns they are replaced by copies interned in a global pool
+   (see OpStringPersist).  The pool is freed only when the plugin is
+   unloaded, since the renderer might retain the strings, but each distinct
+   string is allocated only once.
+*/
+
+/// A hash set of strings, using open addressing.  The capacity is zero or a
+/// power of two.  The table owns neither the entries nor the strings.
+class OpStringTable {
+public:
+    const char** mEntries;      // Strings, or NULL for empty slots
+    unsigned int mCapacity;     // Number of slots
+    unsigned int mCount;        // Number of strings
+};
+
+/// Hash the first len characters of a string (FNV-1a).
+inline unsigned int
+OpStringHash(const char* s, size_t len)
+{
+    unsigned int hash = 2166136261U;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= static_cast<unsigned char>(s[i]);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/// Find the slot that holds the given string (the first len characters of
+/// s), or the empty slot where it belongs.  The capacity must be nonzero.
+inline const char**
+OpStringTableFind(const OpStringTable* table, const char* s, size_t len,
+                  unsigned int hash)
+{
+    unsigned int mask = table->mCapacity - 1;
+    for (unsigned int i = hash & mask; ; i = (i + 1) & mask) {
+        const char** slot = &table->mEntries[i];
+        if (*slot == NULL ||
+            (strncmp(*slot, s, len) == 0 && (*slot)[len] == '\0'))
+            return slot;
+    }
+}
+
+/// Check whether a table must grow before another string is added.  The
+/// table is kept at most half full.
+inline bool
+OpStringTableIsFull(const OpStringTable* table)
+{
+    return 2 * (table->mCount + 1) > table->mCapacity;
+}
+
+/// Move the strings of a table to the given zeroed array of slots, whose
+/// capacity must be a power of two.  Returns the old array of slots.
+inline const char**
+OpStringTableRehash(OpStringTable* table, const char** entries,
+                    unsigned int capacity)
+{
+    const char** oldEntries = table->mEntries;
+    unsigned int oldCapacity = table->mCapacity;
+    table->mEntries = entries;
+    table->mCapacity = capacity;
+    for (unsigned int i = 0; i < oldCapacity; ++i) {
+        const char* s = oldEntries[i];
+        if (s) {
+            size_t len = strlen(s);
+            *OpStringTableFind(table, s, len, OpStringHash(s, len)) = s;
+        }
+    }
+    return oldEntries;
+}
+
+/// A string interned in an arena is preceded by this header, which records
+/// its copy in the global pool, if any.
+class OpArenaString {
+public:
+    const char* mPersistent;    // Copy in the global pool, or NULL
+};
+
+/// Intern the first len characters of a string in an arena, returning the
+/// arena's copy.  Returns NULL if memory is exhausted.
+inline const char*
+OpStringIntern(OpArena* arena, const char* s, size_t len)
+{
+    OpStringTable* table = arena->mStrings;
+    if (table == NULL) {
+        void* memory = OpArenaAlloc(arena, sizeof(OpStringTable));
+        if (memory == NULL)
+            return NULL;
+        table = static_cast<OpStringTable*>(memory);
+        memset(table, 0, sizeof(OpStringTable));
+        arena->mStrings = table;
+    }
+
+    // Return the existing copy, if any.
+    unsigned int hash = OpStringHash(s, len);
+    if (table->mCapacity > 0) {
+        const char** slot = OpStringTableFind(table, s, len, hash);
+        if (*slot)
+            return *slot;
+    }
+
+    // Grow the table if necessary.  The old slots are reclaimed with the
+    // arena.
+    if (OpStringTableIsFull(table)) {
+        unsigned int capacity = table->mCapacity ? 2 * table->mCapacity : 64;
+        size_t size = capacity * sizeof(const char*);
+        void* entries = OpArenaAlloc(arena, size);
+        if (entries == NULL)
+            return NULL;
+        memset(entries, 0, size);
+        OpStringTableRehash(table, static_cast<const char**>(entries),
+                            capacity);
+    }
+
+    // Copy the string, preceded by its header.
+    char* memory = static_cast<char*>(
+        OpArenaAlloc(arena, sizeof(OpArenaString) + len + 1));
+    if (memory == NULL)
+        return NULL;
+    reinterpret_cast<OpArenaString*>(memory)->mPersistent = NULL;
+    char* copy = memory + sizeof(OpArenaString);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    *OpStringTableFind(table, copy, len, hash) = copy;
+    ++table->mCount;
+    return copy;
+}
+
+/// A global pool of interned strings, which are freed by OpStringPoolFree.
+/// Its lock guards the table, since plugins are called by multiple threads.
+class OpStringPool {
+public:
+    OpStringTable mTable;
+    pthread_mutex_t mLock;
+};
+
+/// Intern the first len characters of a string in a global pool, returning
+/// the pool's copy.  Returns NULL if memory is exhausted.
+inline const char*
+OpStringPoolIntern(OpStringPool* pool, const char* s, size_t len)
+{
+    pthread_mutex_lock(&pool->mLock);
+    OpStringTable* table = &pool->mTable;
+    unsigned int hash = OpStringHash(s, len);
+    const char* result = NULL;
+    if (table->mCapacity > 0)
+        result = *OpStringTableFind(table, s, len, hash);
+    if (result == NULL && OpStringTableIsFull(table)) {
+        unsigned int capacity = table->mCapacity ? 2 * table->mCapacity : 64;
+        void* entries = calloc(capacity, sizeof(const char*));
+        if (entries)
+            free(OpStringTableRehash(table, static_cast<const char**>(entries),
+                                     capacity));
+    }
+    if (result == NULL && !OpStringTableIsFull(table)) {
+        char* copy = static_cast<char*>(malloc(len + 1));
+        if (copy) {
+            memcpy(copy, s, len);
+            copy[len] = '\0';
+            *OpStringTableFind(table, copy, len, hash) = copy;
+            ++table->mCount;
+            result = copy;
+        }
+    }
+    pthread_mutex_unlock(&pool->mLock);
+    return result;
+}
+
+/// Free the strings of a global pool, leaving it empty.  Called when the
+/// plugin is unloaded, after which none of its strings are referenced.
+inline void
+OpStringPoolFree(OpStringPool* pool)
+{
+    pthread_mutex_lock(&pool->mLock);
+    OpStringTable* table = &pool->mTable;
+    for (unsigned int i = 0; i < table->mCapacity; ++i)
+        free(const_cast<char*>(table->mEntries[i]));
+    free(table->mEntries);
+    memset(table, 0, sizeof(OpStringTable));
+    pthread_mutex_unlock(&pool->mLock);
+}
+
+/// Replace any of the given strings that were interned in the arena by
+/// their copies in the global pool.  Other strings (e.g. string constants
+/// and strings from the renderer) are left alone.
+inline void
+OpStringPersist(OpStringPool* pool, OpArena* arena, const char** strings,
+                int n)
+{
+    const OpStringTable* table = arena->mStrings;
+    if (table == NULL || table->mCount == 0)
+        return;
+    for (int i = 0; i < n; ++i) {
+        const char* s = strings[i];
+        if (s == NULL)
+            continue;
+        size_t len = strlen(s);
+        if (*OpStringTableFind(table, s, len, OpStringHash(s, len)) != s)
+            continue;
+        OpArenaString* header = reinterpret_cast<OpArenaString*>(
+            const_cast<char*>(s) - sizeof(OpArenaString));
+        if (header->mPersistent == NULL)
+            header->mPersistent = OpStringPoolIntern(pool, s, len);
+        if (header->mPersistent)
+            strings[i] = header->mPersistent;
+    }
+}
+
+/// Append formatted output to a buffer of the given size, like snprintf,
+/// advancing the length by the number of characters that would have been
+/// written.  Output beyond the end of the buffer is dropped.
+inline void
+OpStringAppend(char* buffer, size_t size, size_t* length, const char* spec,
+               double value)
+{
+    char* end = *length < size ? buffer + *length : NULL;
+    int n = snprintf(end, end ? size - *length : 0, spec, value);
+    if (n > 0)
+        *length += n;
+}
+
+/// Append a string to a buffer, as above.
+inline void
+OpStringAppendString(char* buffer, size_t size, size_t* length,
+                     const char* spec, const char* s)
+{
+    char* end = *length < size ? buffer + *length : NULL;
+    int n = snprintf(end, end ? size - *length : 0, spec, s);
+    if (n > 0)
+        *length += n;
+}
+
+/**
+   Format values according to an RSL format string, writing at most size
+   characters (including a terminating null) to the buffer.  Returns the
+   length of the complete output, like snprintf.  The types of the values
+   are given by mangled type letters: 'f' for float, 't' for triple, 'm'
+   for matrix, and 's' for string.  Values are passed by reference.
+
+   The conversions are %f, %e and %g (floats), %d and %i (floats converted
+   to integers), %c, %p, %v and %n (triples), %m (matrices), and %s
+   (strings), with the usual flags, width and precision.  The components of
+   triples and matrices are separated by spaces, and a float conversion of
+   a triple or matrix formats each component.  Missing values are omitted.
+*/
+inline int
+OpStringFormat(char* buffer, size_t size, const char* format,
+               const char* types, const void* const* values, int numValues)
+{
+    size_t length = 0;
+    int next = 0;
+    for (const char* f = format; *f; ++f) {
+        if (*f != '%' || f[1] == '%') {
+            char c[2] = { *f, '\0' };
+            OpStringAppendString(buffer, size, &length, "%s", c);
+            if (*f == '%')
+                ++f;
+            continue;
+        }
+
+        // Copy the flags, width and precision of the conversion.
+        char spec[32] = "%";
+        size_t specLen = 1;
+        for (++f; *f && strchr("-+ #0123456789.", *f); ++f)
+            if (specLen < sizeof(spec) - 3)
+                spec[specLen++] = *f;
+        char conv = *f;
+        if (conv == '\0')
+            break;
+        if (next >= numValues)
+            continue;
+        char type = types[next];
+        const void* value = values[next++];
+
+        // Strings are formatted as is; other values are formatted one float
+        // component at a time.
+        if (conv == 's' && type == 's') {
+            spec[specLen] = 's';
+            spec[specLen + 1] = '\0';
+            OpStringAppendString(buffer, size, &length, spec,
+                                 *static_cast<const char* const*>(value));
+            continue;
+        }
+        if (type == 's')
+            continue;
+        bool isInt = conv == 'd' || conv == 'i';
+        spec[specLen] = strchr("eEfFgG", conv) ? conv : (isInt ? 'd' : 'f');
+        spec[specLen + 1] = '\0';
+        int numComps = type == 't' ? 3 : (type == 'm' ? 16 : 1);
+        const float* comps = static_cast<const float*>(value);
+        for (int i = 0; i < numComps; ++i) {
+            if (i > 0)
+                OpStringAppendString(buffer, size, &length, "%s", " ");
+            if (isInt) {
+                char* end = length < size ? buffer + length : NULL;
+                int n = snprintf(end, end ? size - length : 0, spec,
+                                 static_cast<int>(comps[i]));
+                if (n > 0)
+                    length += n;
+            }
+            else
+                OpStringAppend(buffer, size, &length, spec, comps[i]);
+        }
+    }
+    if (size > 0)
+        buffer[length < size ? length : size - 1] = '\0';
+    return static_cast<int>(length);
+}
+
+/// Check whether a string contains a match for a POSIX extended regular
+/// expression.  An invalid pattern matches nothing.
+inline bool
+OpStringMatch(const char* pattern, const char* subject)
+{
+    regex_t regex;
+    if (regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB) != 0)
+        return false;
+    bool matches = regexec(&regex, subject, 0, NULL, 0) == 0;
+    regfree(&regex);
+    return matches;
+}
+
+/// Maximum number of regexes cached in an arena.  Patterns beyond this
+/// (e.g. a varying pattern with many distinct values) are compiled on every
+/// call.
+static const int kOpArenaMaxRegexes = 16;
+
+/// Check whether a string contains a match for a pattern, like
+/// OpStringMatch, caching the compiled pattern in the arena.  The pattern is
+/// usually a constant or uniform, so it's compiled once per plugin call
+/// rather than at every point.  Returns false if memory is exhausted.
+inline bool
+OpStringMatchCached(OpArena* arena, const char* pattern, const char* subject)
+{
+    // Look for the pattern, comparing pointers first since the same string
+    // is usually passed at every point.
+    OpArenaRegex* cached = NULL;
+    for (OpArenaRegex* r = arena->mRegexes; r && !cached; r = r->mNext)
+        if (r->mPattern == pattern)
+            cached = r;
+    for (OpArenaRegex* r = arena->mRegexes; r && !cached; r = r->mNext)
+        if (strcmp(r->mPattern, pattern) == 0)
+            cached = r;
+
+    // Compile the pattern and cache it, if there's room.
+    if (cached == NULL) {
+        if (arena->mNumRegexes >= kOpArenaMaxRegexes)
+            return OpStringMatch(pattern, subject);
+        void* memory = OpArenaAlloc(arena, sizeof(OpArenaRegex));
+        if (memory == NULL)
+            return false;
+        cached = static_cast<OpArenaRegex*>(memory);
+        cached->mPattern = pattern;
+        cached->mIsValid = regcomp(&cached->mRegex, pattern,
+                                   REG_EXTENDED | REG_NOSUB) == 0;
+        cached->mNext = arena->mRegexes;
+        arena->mRegexes = cached;
+        ++arena->mNumRegexes;
+    }
+    return cached->mIsValid &&
+        regexec(&cached->mRegex, subject, 0, NULL, 0) == 0;
+}
+
+#endif // ndef OP_STRING_H
@@ -0,0 +1,205 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "ops/OpTexture.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Constructor.
+OpFileTextureSystem::OpFileTextureSystem(const char* directory) :
+    mDirectory(directory)
+{
+    pthread_mutex_init(&mLock, NULL);
+}
+
+// Destructor.
+OpFileTextureSystem::~OpFileTextureSystem()
+{
+    ImageMap::iterator it;
+    for (it = mImages.begin(); it != mImages.end(); ++it)
+        delete it->second;
+    pthread_mutex_destroy(&mLock);
+}
+
+bool
+OpFileTextureSystem::Texture(const char* name, int channel, int numChannels,
+                             int n, const float* s, const float* t,
+                             const float* sWidths, const float* tWidths,
+                             float* result)
+{
+    const Image* image = GetImage(name);
+    if (image == NULL) {
+        memset(result, 0, n * numChannels * sizeof(float));
+        return false;
+    }
+    for (int i = 0; i < n; ++i)
+        Filter(*image, channel, numChannels, s[i], t[i],
+               sWidths ? sWidths[i] : 0.0f, tWidths ? tWidths[i] : 0.0f,
+               &result[i * numChannels]);
+    return true;
+}
+
+bool
+OpFileTextureSystem::Environment(const char* name, int channel,
+                                 int numChannels, int n, const float* dirs,
+                                 const float* widths, float* result)
+{
+    const Image* image = GetImage(name);
+    if (image == NULL) {
+        memset(result, 0, n * numChannels * sizeof(float));
+        return false;
+    }
+    for (int i = 0; i < n; ++i) {
+        // Convert the direction to latitude and longitude.
+        const float* d = &dirs[i*3];
+        float len = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        float z = len > 0.0f ? d[2] / len : 1.0f;
+        z = z < -1.0f ? -1.0f : (z > 1.0f ? 1.0f : z);
+        float s = 0.5f + atan2f(d[1], d[0]) / (2.0f * float(M_PI));
+        float t = acosf(z) / float(M_PI);
+
+        // Longitude spans 2 pi radians in s, and latitude spans pi in t.
+        float width = widths ? widths[i] : 0.0f;
+        Filter(*image, channel, numChannels, s, t,
+               width / (2.0f * float(M_PI)), width / float(M_PI),
+               &result[i * numChannels]);
+    }
+    return true;
+}
+
+// Get the image for the named texture, reading it if necessary.  Returns NULL
+// if it can't be read.
+const OpFileTextureSystem::Image*
+OpFileTextureSystem::GetImage(const char* name)
+{
+    pthread_mutex_lock(&mLock);
+    ImageMap::const_iterator it = mImages.find(name);
+    const Image* image;
+    if (it != mImages.end())
+        image = it->second;
+    else {
+        std::string filename(name);
+        if (!mDirectory.empty() && name[0] != '/')
+            filename = mDirectory + "/" + filename;
+        image = mImages[name] = ReadImage(filename.c_str());
+    }
+    pthread_mutex_unlock(&mLock);
+    return image;
+}
+
+// Read a PPM image, either binary (P6) or ASCII (P3).  Returns NULL if the
+// file can't be read.
+OpFileTextureSystem::Image*
+OpFileTextureSystem::ReadImage(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+        return NULL;
+    char magic[3] = { 0 };
+    int width, height, maxVal;
+    if (fscanf(file, "%2s %d %d %d", magic, &width, &height, &maxVal) != 4 ||
+        (strcmp(magic, "P6") != 0 && strcmp(magic, "P3") != 0) ||
+        width <= 0 || height <= 0 || maxVal <= 0 || maxVal > 255) {
+        fclose(file);
+        return NULL;
+    }
+    bool isBinary = magic[1] == '6';
+    if (isBinary)
+        fgetc(file);            // Single whitespace precedes the data.
+
+    Image* image = new Image;
+    image->mWidth = width;
+    image->mHeight = height;
+    image->mTexels.resize(width * height * 3);
+    float scale = 1.0f / maxVal;
+    for (size_t i = 0; i < image->mTexels.size(); ++i) {
+        int value;
+        if (isBinary)
+            value = fgetc(file);
+        else if (fscanf(file, "%d", &value) != 1)
+            value = EOF;
+        if (value == EOF) {
+            delete image;
+            fclose(file);
+            return NULL;
+        }
+        image->mTexels[i] = value * scale;
+    }
+    fclose(file);
+    return image;
+}
+
+// Look up the given channels of an image, with bilinear filtering.  Texel
+// centers are at half-integer coordinates, and lookups are clamped at the
+// edges of the image.
+void
+OpFileTextureSystem::Lookup(const Image& image, int channel, int numChannels,
+                            float s, float t, float* result)
+{
+    float x = s * image.mWidth - 0.5f;
+    float y = t * image.mHeight - 0.5f;
+    float fx = floorf(x), fy = floorf(y);
+    float wx = x - fx, wy = y - fy;
+    int x0 = int(fx), y0 = int(fy);
+    int xs[2] = { x0, x0 + 1 }, ys[2] = { y0, y0 + 1 };
+    for (int k = 0; k < 2; ++k) {
+        xs[k] = xs[k] < 0 ? 0 : (xs[k] >= image.mWidth ? image.mWidth - 1
+                                                        : xs[k]);
+        ys[k] = ys[k] < 0 ? 0 : (ys[k] >= image.mHeight ? image.mHeight - 1
+                                                         : ys[k]);
+    }
+    for (int c = 0; c < numChannels; ++c) {
+        int ch = channel + c;
+        if (ch < 0 || ch >= 3) {
+            result[c] = 0.0f;
+            continue;
+        }
+        const float* texels = &image.mTexels[0];
+        int w = image.mWidth;
+        float v00 = texels[(ys[0]*w + xs[0])*3 + ch];
+        float v10 = texels[(ys[0]*w + xs[1])*3 + ch];
+        float v01 = texels[(ys[1]*w + xs[0])*3 + ch];
+        float v11 = texels[(ys[1]*w + xs[1])*3 + ch];
+        result[c] = (v00 * (1 - wx) + v10 * wx) * (1 - wy) +
+            (v01 * (1 - wx) + v11 * wx) * wy;
+    }
+}
+
+// Look up the given channels of an image, averaging bilinear lookups over a
+// box with the given widths, centered at (s, t).  The number of lookups in
+// each direction is the number of texels the box spans, up to a limit.
+void
+OpFileTextureSystem::Filter(const Image& image, int channel, int numChannels,
+                            float s, float t, float sWidth, float tWidth,
+                            float* result)
+{
+    const int kMaxTaps = 16;
+    int ns = int(ceilf(fabsf(sWidth) * image.mWidth));
+    int nt = int(ceilf(fabsf(tWidth) * image.mHeight));
+    ns = ns < 1 ? 1 : (ns > kMaxTaps ? kMaxTaps : ns);
+    nt = nt < 1 ? 1 : (nt > kMaxTaps ? kMaxTaps : nt);
+    if (ns == 1 && nt == 1) {
+        Lookup(image, channel, numChannels, s, t, result);
+        return;
+    }
+    float tap[3];
+    for (int c = 0; c < numChannels; ++c)
+        result[c] = 0.0f;
+    for (int j = 0; j < nt; ++j) {
+        float tj = t + tWidth * ((j + 0.5f) / nt - 0.5f);
+        for (int i = 0; i < ns; ++i) {
+            float si = s + sWidth * ((i + 0.5f) / ns - 0.5f);
+            for (int c = 0; c < numChannels; c += 3) {
+                int count = numChannels - c < 3 ? numChannels - c : 3;
+                Lookup(image, channel + c, count, si, tj, tap);
+                for (int k = 0; k < count; ++k)
+                    result[c + k] += tap[k];
+            }
+        }
+    }
+    float scale = 1.0f / (ns * nt);
+    for (int c = 0; c < numChannels; ++c)
+        result[c] *= scale;
+}
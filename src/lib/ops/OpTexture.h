@@ -0,0 +1,91 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OP_TEXTURE_H
+#define OP_TEXTURE_H
+
+#include <map>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/// Interface to a texture system, which performs a batch of lookups for all
+/// the points of a grid.  Compiled shaders call it through the plugin
+/// skeleton (see CgGridTexture in CgSkeleton.cpp), which is given an
+/// implementation that forwards to the renderer.  It's an abstract class so
+/// that tests can substitute a stand-in (see OpFileTextureSystem).
+/// Implementations must be thread safe.
+class OpTextureSystem {
+public:
+    /// Destructor is virtual.
+    virtual ~OpTextureSystem() { }
+
+    /// Look up a texture at n points.  For each point, numChannels channels
+    /// (starting with the given channel) are filtered at (s[i], t[i]) and
+    /// stored contiguously in the result.  The filter widths in s and t
+    /// (e.g. computed by OpGridFilterWidth) are given for each point; if
+    /// they're NULL the texture is point sampled.  Channels that the texture
+    /// lacks are zero.  Returns false (storing zeros) if the texture can't
+    /// be read.
+    virtual bool Texture(const char* name, int channel, int numChannels,
+                         int n, const float* s, const float* t,
+                         const float* sWidths, const float* tWidths,
+                         float* result) = 0;
+
+    /// Look up an environment map in n directions, which are stored as
+    /// triples.  The angular filter widths (in radians, e.g. computed by
+    /// OpGridAngularWidth) are given for each direction, or NULL for point
+    /// sampling.  The result is stored as for Texture.
+    virtual bool Environment(const char* name, int channel, int numChannels,
+                             int n, const float* dirs, const float* widths,
+                             float* result) = 0;
+};
+
+/// A texture system that reads images from local files, for use in tests and
+/// when no renderer is available.  Textures are PPM images (binary or ASCII),
+/// which are read on first use and cached.  Lookups are bilinearly
+/// interpolated with clamping at the edges, and averaged over a box the
+/// size of the filter widths.  Environment maps are latitude-longitude
+/// images, with +z at the top.
+class OpFileTextureSystem : public OpTextureSystem {
+public:
+    /// Construct a texture system.  Relative texture names are resolved in
+    /// the given directory, if any.
+    OpFileTextureSystem(const char* directory="");
+
+    /// The destructor frees the cached textures.
+    virtual ~OpFileTextureSystem();
+
+    virtual bool Texture(const char* name, int channel, int numChannels,
+                         int n, const float* s, const float* t,
+                         const float* sWidths, const float* tWidths,
+                         float* result);
+
+    virtual bool Environment(const char* name, int channel, int numChannels,
+                             int n, const float* dirs, const float* widths,
+                             float* result);
+
+private:
+    // An image with three channels per texel, in rows from top to bottom.
+    struct Image {
+        int mWidth;
+        int mHeight;
+        std::vector<float> mTexels;
+    };
+    typedef std::map<std::string, Image*> ImageMap;
+
+    std::string mDirectory;
+    ImageMap mImages;           // NULL for textures that can't be read.
+    pthread_mutex_t mLock;      // Guards mImages.
+
+    const Image* GetImage(const char* name);
+    static Image* ReadImage(const char* filename);
+    static void Lookup(const Image& image, int channel, int numChannels,
+                       float s, float t, float* result);
+    static void Filter(const Image& image, int channel, int numChannels,
+                       float s, float t, float sWidth, float tWidth,
+                       float* result);
+};
+
+#endif // ndef OP_TEXTURE_H
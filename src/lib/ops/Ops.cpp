@@ -2,6 +2,12 @@
 // Licensed under the terms of the MIT License.
 // See http://www.opensource.org/licenses/mit-license.php.
 
+#include "ops/OpColor.h"
+#include "ops/OpDynArray.h"
+#include "ops/OpFresnel.h"
+#include "ops/OpMath.h"
+#include "ops/OpSpline.h"
+#include "ops/OpString.h"
 #include "ops/OpTypes.h"
 #include <ri.h>                 // for RI_CURRNT, etc.
 #include <rx.h>
@@ -21,6 +27,15 @@
    - Results are return via an output parameter.
      - We can't rely on returning structs by value that makes the calling
        convention of the generated LLVM code platform dependent.
+   - An array is passed as a pointer to its first element, followed by its
+     length.  The length of a resizable array is determined at runtime.
+   - A resizable array whose length might change (e.g. the array argument of
+     push) is instead passed as a pointer to its descriptor, followed by the
+     per-call arena from which its elements are allocated (see
+     OpDynArray.h).  The mangled type of such an argument is "R" followed by
+     the element type (e.g. OpPush_Rff).
+   - Shadeops that compute strings (e.g. concat) also take the per-call
+     arena, in which the results are interned (see OpString.h).
 */
 
 // We need a dummy symbols that use RSL types to ensure that they appear
@@ -34,17 +49,19 @@ RslFunctionTable* g_dummyRslFunctionTable;
 template<typename T>
 static void
 ArrayAssign(T* dest, int destLen, const T* src, int srcLen) {
-    assert(destLen >= 0 && srcLen >= 0 && "No resizable arrays yet");
+    assert(destLen >= 0 && srcLen >= 0 && "Invalid array length");
     assert(destLen == srcLen && "Length mismatch in array assignment");
     memcpy(dest, src, destLen * sizeof(T));
 }
 
-// Templated array equalityfunction
+// Templated array equality function.  The length of a resizable array is
+// known only at runtime, so arrays of differing lengths are simply unequal.
 template<typename T>
 static OpBoolTy
 ArrayEQ(T* a, int aLen, T* b, int bLen) {
-    assert(aLen >= 0 && bLen >= 0 && "No resizable arrays yet");
-    assert(aLen == bLen && "Length mismatch in array assignment");
+    assert(aLen >= 0 && bLen >= 0 && "Invalid array length");
+    if (aLen != bLen)
+        return false;
     for (int i = 0; i < aLen; ++i)
         if (a[i] != b[i])
             return false;
@@ -129,6 +146,14 @@ void OpArrayAssignMxComp(OpMatrix4* a, int aLen, float b,
     a[(int) b][(int) c][(int) d] = e;
 }
 
+void OpArrayLength_F(float* r, const float* a, int aLen) { *r = aLen; }
+
+void OpArrayLength_T(float* r, const OpVec3* a, int aLen) { *r = aLen; }
+
+void OpArrayLength_M(float* r, const OpMatrix4* a, int aLen) { *r = aLen; }
+
+void OpArrayLength_S(float* r, const OpStringTy* a, int aLen) { *r = aLen; }
+
 void OpArrayRef_Ff(float* r, float* a, int aLen, float b) {
     *r = a[(int) b];
 }
@@ -171,13 +196,32 @@ void OpAssign_SS(OpStringTy* a, int aLen, OpStringTy* b, int bLen) {
     ArrayAssign(a, aLen, b, bLen);
 }
 
+// Assignment to a resizable array changes its length to match.
+void OpAssign_RfF(OpDynArray* a, OpArena* arena, const float* b, int bLen) {
+    OpDynArrayAssign(a, arena, b, bLen);
+}
+
+void OpAssign_RtT(OpDynArray* a, OpArena* arena, const OpVec3* b, int bLen) {
+    OpDynArrayAssign(a, arena, b, bLen);
+}
+
+void OpAssign_RmM(OpDynArray* a, OpArena* arena, const OpMatrix4* b,
+                  int bLen) {
+    OpDynArrayAssign(a, arena, b, bLen);
+}
+
+void OpAssign_RsS(OpDynArray* a, OpArena* arena, const OpStringTy* b,
+                  int bLen) {
+    OpDynArrayAssign(a, arena, b, bLen);
+}
+
 void OpAssignMatrix_f(OpMatrix4* a, float b) { *a = OpMatrix4(b); }
 
 void OpAssignMatrix_m(OpMatrix4* a, const OpMatrix4& b) { *a = b; }
 
-void OpAtan_f(float* r, float a) { *r = atanf(a); }
+void OpAtan_f(float* r, float a) { *r = OpMathAtan(a); }
 
-void OpAtan_ff(float* r, float a, float b) { *r = atan2f(a, b); }
+void OpAtan_ff(float* r, float a, float b) { *r = OpMathAtan2(a, b); }
 
 void OpCeil(float* r, float a) { *r = ceilf(a); }
 
@@ -233,17 +277,59 @@ void OpClamp_ttt(OpVec3* r, const OpVec3& a,
 void OpColor(OpVec3* r, float a, float b, float c) {
     *r = OpVec3(a, b, c); 
 }
+
+// Convert a color in the named space to RGB, e.g. color "hsv" (h, s, v).
+void OpColorTransform(OpVec3* r, OpStringTy space, const OpVec3& c) {
+    *r = OpColorToRGB(OpColorGetSpace(space), c);
+}
     
 void OpComp(float* r, OpVec3* a, float b) {
     *r = (*a)[(int) b];
 }
 
-void OpCos(float* r, float a) { *r = cosf(a); }
+// Concatenate strings.  The result is interned in the arena (or empty if
+// memory is exhausted).  Short results are built on the stack, so nothing is
+// allocated if the result was already interned.
+void OpConcat(OpStringTy* r, OpArena* arena, const OpStringTy* strings,
+              int n) {
+    size_t len = 0;
+    for (int i = 0; i < n; ++i)
+        len += strlen(strings[i]);
+    char local[256];
+    char* buffer = local;
+    if (len >= sizeof(local)) {
+        buffer = static_cast<char*>(OpArenaAlloc(arena, len + 1));
+        if (buffer == NULL) {
+            *r = "";
+            return;
+        }
+    }
+    char* end = buffer;
+    for (int i = 0; i < n; ++i) {
+        size_t sLen = strlen(strings[i]);
+        memcpy(end, strings[i], sLen);
+        end += sLen;
+    }
+    *end = '\0';
+    const char* s = OpStringIntern(arena, buffer, len);
+    *r = s ? s : "";
+}
+
+void OpCos(float* r, float a) { *r = OpMathCos(a); }
 
 void OpCross(OpVec3* r, const OpVec3& a, const OpVec3& b) {
     *r = a.Cross(b);
 }
 
+void OpCTransform_st(OpVec3* r, OpStringTy toSpace, const OpVec3& c) {
+    *r = OpColorConvert("rgb", toSpace, c);
+}
+
+void OpCTransform_sst(OpVec3* r, OpStringTy fromSpace, OpStringTy toSpace,
+                      const OpVec3& c) {
+    *r = OpColorConvert(fromSpace, toSpace, c);
+}
+
 #define PI 3.1415926536
 void OpDegrees(float* r, float a) { *r = a * (180.0f / PI); }
 
@@ -306,8 +392,10 @@ void OpEQ_MM(OpBoolTy* r, const OpMatrix4* a, int aLen,
 }
 
 void OpEQ_SS(OpBoolTy* r, OpStringTy* a, int aLen, OpStringTy* b, int bLen) {
-    assert(aLen >= 0 && bLen >= 0 && "No resizable arrays yet");
-    assert(aLen == bLen && "Length mismatch in array assignment");
+    assert(aLen >= 0 && bLen >= 0 && "Invalid array length");
+    *r = false;
+    if (aLen != bLen)
+        return;
     for (int i = 0; i < aLen; ++i)
         if (strcmp(a[i], b[i])) {
             *r = false;
@@ -316,7 +404,7 @@ void OpEQ_SS(OpBoolTy* r, OpStringTy* a, int aLen, OpStringTy* b, int bLen) {
     *r = true;
 }
 
-void OpExp(float* r, float a) { *r = expf(a); }
+void OpExp(float* r, float a) { *r = OpMathExp(a); }
 
 // Note: there is no two-argument overloading with an implicit "Ng" argument.
 void OpFaceForward(OpVec3* r, const OpVec3& a, const OpVec3& b, 
@@ -324,8 +412,64 @@ void OpFaceForward(OpVec3* r, const OpVec3& a, const OpVec3& b,
     *r = Sign(-b * c) * a;
 }
 
+// Less accurate versions of transcendental shadeops, which are used when
+// fast math is enabled (see OpInfo::GetFastOpName).
+
+void OpFastAtan_f(float* r, float a) { *r = OpMathFastAtan(a); }
+
+void OpFastAtan_ff(float* r, float a, float b) { *r = OpMathFastAtan2(a, b); }
+
+void OpFastCos(float* r, float a) { *r = OpMathFastCos(a); }
+
+void OpFastExp(float* r, float a) { *r = OpMathFastExp(a); }
+
+void OpFastInverseSqrt(float* r, float x) { *r = OpMathFastInverseSqrt(x); }
+
+void OpFastLog_f(float* r, float a) { *r = OpMathFastLog(a); }
+
+void OpFastLog_ff(float* r, float a, float b) {
+    *r = OpMathFastLog(a) / OpMathFastLog(b);
+}
+
+void OpFastPow(float* r, float a, float b) { *r = OpMathFastPow(a, b); }
+
+void OpFastSin(float* r, float a) { *r = OpMathFastSin(a); }
+
 void OpFloor(float* r, float a) { *r = floorf(a); }
 
+// Format values (passed by reference) according to an RSL format string.
+// The value types are given by mangled type letters (see OpStringFormat).
+// The result is interned in the arena (or empty if memory is exhausted).
+void OpFormat(OpStringTy* r, OpArena* arena, OpStringTy format,
+              OpStringTy types, const void* const* values, int n) {
+    char local[256];
+    char* buffer = local;
+    int len = OpStringFormat(local, sizeof(local), format, types, values, n);
+    if (len >= int(sizeof(local))) {
+        buffer = static_cast<char*>(OpArenaAlloc(arena, len + 1));
+        if (buffer == NULL) {
+            *r = "";
+            return;
+        }
+        OpStringFormat(buffer, len + 1, format, types, values, n);
+    }
+    const char* s = OpStringIntern(arena, buffer, len);
+    *r = s ? s : "";
+}
+
+// The Fresnel coefficients (and optionally the reflected and refracted
+// directions) are output arguments.
+void OpFresnel_ttfff(const OpVec3& I, const OpVec3& N, float eta,
+                     float* Kr, float* Kt) {
+    OpVec3 R, T;
+    OpFresnel(I, N, eta, Kr, Kt, &R, &T);
+}
+
+void OpFresnel_ttffftt(const OpVec3& I, const OpVec3& N, float eta,
+                       float* Kr, float* Kt, OpVec3* R, OpVec3* T) {
+    OpFresnel(I, N, eta, Kr, Kt, R, T);
+}
+
 void OpGE(OpBoolTy* r, float a, float b) { *r = a >= b; }
 
 void OpGT(OpBoolTy* r, float a, float b) { *r = a > b; }
@@ -337,18 +481,26 @@ void OpGT(OpBoolTy* r, float a, float b) { *r = a > b; }
 // partitioning.
 void OpGeoNormals(OpVec3* Ng) { }
 
-void OpInverseSqrt(float* r, float x) { *r = 1/sqrt(x); } // TODO slow
+void OpInverseSqrt(float* r, float x) { *r = OpMathInverseSqrt(x); }
 
 void OpLE(OpBoolTy* r, float a, float b) { *r = a <= b; }
 
 void OpLength(float* r, const OpVec3& a) { *r = a.Length(); }
 
-void OpLog_f(float* r, float a) { *r = logf(a); }
+void OpLog_f(float* r, float a) { *r = OpMathLog(a); }
 
-void OpLog_ff(float* r, float a, float b) { *r = logf(a) / logf(b); }
+void OpLog_ff(float* r, float a, float b) {
+    *r = OpMathLog(a) / OpMathLog(b);
+}
 
 void OpLT(OpBoolTy* r, float a, float b) { *r = a < b; }
 
+// The compiled pattern is cached in the arena (see OpStringMatchCached).
+void OpMatch(float* r, OpArena* arena, OpStringTy pattern,
+             OpStringTy subject) {
+    *r = OpStringMatchCached(arena, pattern, subject) ? 1.0f : 0.0f;
+}
+
 void OpMatrix(OpMatrix4* r, float a0, float a1, float a2, float a3,
                     float a4, float a5, float a6, float a7,
                     float a8, float a9, float a10, float a11,
@@ -404,6 +556,10 @@ void OpMultiply_tt(OpVec3* r, const OpVec3& a, const OpVec3& b) {
     *r = OpVec3(a[0] * b[0], a[1] * b[1], a[2] * b[2]); 
 }
 
+void OpMultiply_mm(OpMatrix4* r, const OpMatrix4& a, const OpMatrix4& b) {
+    *r = a.Multiply(b);
+}
+
 
 void OpMxComp(float* r, const OpMatrix4& a, float b, float c) {
     *r = a[(int) b][(int) c];
@@ -518,6 +674,15 @@ void OpNormalize(OpVec3* r, const OpVec3& a) {
     *r = a.Normalized();
 }
 
+// Normals are transformed by the inverse transpose of the matrix, without
+// translation.
+void OpNTransformMx_mt(OpVec3* r, const OpMatrix4& m, const OpVec3& n) {
+    OpMatrix4 inv = m.Inverse();
+    *r = OpVec3(n[0] * inv[0][0] + n[1] * inv[0][1] + n[2] * inv[0][2],
+                n[0] * inv[1][0] + n[1] * inv[1][1] + n[2] * inv[1][2],
+                n[0] * inv[2][0] + n[1] * inv[2][1] + n[2] * inv[2][2]);
+}
+
 void OpOr(OpBoolTy* r, OpBoolTy a, OpBoolTy b) { *r = a || b; }
 
 void OpPNoise_fff(float* r, float a, float p) {
@@ -568,7 +733,24 @@ void OpPoint(OpVec3* r, float a, float b, float c) {
     *r = OpVec3(a, b, c); 
 }
 
-void OpPow(float* r, float a, float b) { *r = powf(a, b); }
+// Popping an empty array yields zero (or an empty string).
+void OpPop_Rf(float* r, OpDynArray* a, OpArena* arena) {
+    *r = OpDynArrayPop(a, 0.0f);
+}
+
+void OpPop_Rt(OpVec3* r, OpDynArray* a, OpArena* arena) {
+    *r = OpDynArrayPop(a, OpVec3(0.0f));
+}
+
+void OpPop_Rm(OpMatrix4* r, OpDynArray* a, OpArena* arena) {
+    *r = OpDynArrayPop(a, OpMatrix4(0.0f));
+}
+
+void OpPop_Rs(OpStringTy* r, OpDynArray* a, OpArena* arena) {
+    *r = OpDynArrayPop(a, static_cast<OpStringTy>(""));
+}
+
+void OpPow(float* r, float a, float b) { *r = OpMathPow(a, b); }
 
 void OpPrint_f(float a) { 
     printf("1 value:\n  0:%.6f\n", a);
@@ -598,6 +780,26 @@ void OpPrintf(OpStringTy, ...); // TODO: special format string
 void OpPtLineD(float* r, const OpVec3& p1, const OpVec3& p2,
                 const OpVec3& q); // TODO
 
+void OpPush_Rff(OpDynArray* a, OpArena* arena, float b) {
+    OpDynArrayPush(a, arena, b);
+}
+
+void OpPush_Rtf(OpDynArray* a, OpArena* arena, float b) {
+    OpDynArrayPush(a, arena, OpVec3(b));
+}
+
+void OpPush_Rtt(OpDynArray* a, OpArena* arena, const OpVec3& b) {
+    OpDynArrayPush(a, arena, b);
+}
+
+void OpPush_Rmm(OpDynArray* a, OpArena* arena, const OpMatrix4& b) {
+    OpDynArrayPush(a, arena, b);
+}
+
+void OpPush_Rss(OpDynArray* a, OpArena* arena, OpStringTy b) {
+    OpDynArrayPush(a, arena, b);
+}
+
 void OpRadians(float* r, float a) { *r = a * (PI / 180.0f); }
 
 void OpReflect(OpVec3* r, const OpVec3& I, const OpVec3& N) {
@@ -613,6 +815,44 @@ void OpRefract(OpVec3* r,
 
 // Rotate a point Q by angle radians about the axis that passes through the
 // points P1 and P2.
+// Reserving capacity avoids reallocation when elements are pushed later.
+void OpReserve_Rff(OpDynArray* a, OpArena* arena, float n) {
+    OpDynArrayReserve(a, arena, (int) n, sizeof(float));
+}
+
+void OpReserve_Rtf(OpDynArray* a, OpArena* arena, float n) {
+    OpDynArrayReserve(a, arena, (int) n, sizeof(OpVec3));
+}
+
+void OpReserve_Rmf(OpDynArray* a, OpArena* arena, float n) {
+    OpDynArrayReserve(a, arena, (int) n, sizeof(OpMatrix4));
+}
+
+void OpReserve_Rsf(OpDynArray* a, OpArena* arena, float n) {
+    OpDynArrayReserve(a, arena, (int) n, sizeof(OpStringTy));
+}
+
+// New elements are zero, or empty strings.
+void OpResize_Rff(OpDynArray* a, OpArena* arena, float n) {
+    OpDynArrayResize(a, arena, (int) n, sizeof(float));
+}
+
+void OpResize_Rtf(OpDynArray* a, OpArena* arena, float n) {
+    OpDynArrayResize(a, arena, (int) n, sizeof(OpVec3));
+}
+
+void OpResize_Rmf(OpDynArray* a, OpArena* arena, float n) {
+    OpDynArrayResize(a, arena, (int) n, sizeof(OpMatrix4));
+}
+
+void OpResize_Rsf(OpDynArray* a, OpArena* arena, float n) {
+    int oldLength = a->mLength;
+    OpDynArrayResize(a, arena, (int) n, sizeof(OpStringTy));
+    OpStringTy* elements = static_cast<OpStringTy*>(a->mData);
+    for (int i = oldLength; i < a->mLength; ++i)
+        elements[i] = "";
+}
+
 void OpRotate(OpVec3* r, const OpVec3& q, float angle, const OpVec3& p1,
               const OpVec3& p2) {
     float c = cosf(angle);
@@ -653,14 +893,33 @@ void OpSign(float* r, float a) {
     *r = Sign(a);
 }
 
-void OpSin(float* r, float a) { *r = sinf(a); }
+void OpSin(float* r, float a) { *r = OpMathSin(a); }
 
 void OpSmoothStep(float* r, float min, float max, float value) {
     float t = OpClamp((value - min) / (max - min), 0.0f, 1.0f);
     *r = t * t * (3.0f - 2.0f * t);
 }
 
-// TODO: spline
+// The control points of a spline are passed as an array.  The code
+// generator packs them into a temporary array if they're given individually
+// (see CgInst::GenSpline).
+void OpSpline_fF(float* r, float value, const float* points, int n) {
+    *r = OpSplineEval(kOpSplineCatmullRom, value, points, n);
+}
+
+void OpSpline_fT(OpVec3* r, float value, const OpVec3* points, int n) {
+    *r = OpSplineEval(kOpSplineCatmullRom, value, points, n);
+}
+
+void OpSpline_sfF(float* r, OpStringTy basis, float value,
+                  const float* points, int n) {
+    *r = OpSplineEval(OpSplineGetBasis(basis), value, points, n);
+}
+
+void OpSpline_sfT(OpVec3* r, OpStringTy basis, float value,
+                  const OpVec3* points, int n) {
+    *r = OpSplineEval(OpSplineGetBasis(basis), value, points, n);
+}
 
 void OpSqrt(float* r, float a) { 
     *r = a < 0.0f ? 0.0f : sqrtf(a); 
@@ -688,7 +947,6 @@ void OpSubtract_tt(OpVec3* r, const OpVec3& a, const OpVec3& b) {
 
 void OpTan(float* r, float a) { *r = tanf(a); }
 
-/* XXX The variant with named spaces can't be compiled, so these are disabled.
 void OpTransformMx_mt(OpVec3* r, const OpMatrix4& m, const OpVec3& t) {
     *r = Transform(m, OpVec4(t, 1.0f));
 }
@@ -696,7 +954,6 @@ void OpTransformMx_mt(OpVec3* r, const OpMatrix4& m, const OpVec3& t) {
 void OpVTransformMx_mt(OpVec3* r, const OpMatrix4& m, const OpVec3& t) {
     *r = Transform(m, OpVec4(t, 0.0f));
 }
-*/
 
 void OpXComp(float* r, const OpVec3& a) { *r = a[0]; }
 
@@ -0,0 +1,85 @@
+#include "ops/OpColor.h"
+#include <gtest/gtest.h>
+
+class TestOpColor : public testing::Test { };
+
+static void
+ExpectNear(const OpVec3& expected, const OpVec3& actual, float tolerance)
+{
+    for (int i = 0; i < 3; ++i)
+        EXPECT_NEAR(expected[i], actual[i], tolerance) << "component " << i;
+}
+
+TEST_F(TestOpColor, TestSpaceNames) {
+    EXPECT_EQ(kOpColorRGB, OpColorGetSpace("rgb"));
+    EXPECT_EQ(kOpColorHSV, OpColorGetSpace("hsv"));
+    EXPECT_EQ(kOpColorHSL, OpColorGetSpace("HSL"));
+    EXPECT_EQ(kOpColorXYZ, OpColorGetSpace("XYZ"));
+    EXPECT_EQ(kOpColorxyY, OpColorGetSpace("xyY"));
+    EXPECT_EQ(kOpColorYIQ, OpColorGetSpace("YIQ"));
+    EXPECT_EQ(kOpColorRGB, OpColorGetSpace("unknown"));
+}
+
+TEST_F(TestOpColor, TestHSV) {
+    ExpectNear(OpVec3(0.0f, 1.0f, 1.0f),
+               OpColorRGBToHSV(OpVec3(1.0f, 0.0f, 0.0f)), 1e-6f);
+    ExpectNear(OpVec3(1/3.0f, 1.0f, 0.5f),
+               OpColorRGBToHSV(OpVec3(0.0f, 0.5f, 0.0f)), 1e-6f);
+    ExpectNear(OpVec3(5/6.0f, 0.5f, 1.0f),
+               OpColorRGBToHSV(OpVec3(1.0f, 0.5f, 1.0f)), 1e-6f);
+    ExpectNear(OpVec3(0.0f, 0.0f, 0.25f),
+               OpColorRGBToHSV(OpVec3(0.25f)), 1e-6f);
+    ExpectNear(OpVec3(1.0f, 0.5f, 0.0f),
+               OpColorHSVToRGB(OpVec3(1/12.0f, 1.0f, 1.0f)), 1e-6f);
+}
+
+TEST_F(TestOpColor, TestHSL) {
+    ExpectNear(OpVec3(0.0f, 1.0f, 0.5f),
+               OpColorRGBToHSL(OpVec3(1.0f, 0.0f, 0.0f)), 1e-6f);
+    ExpectNear(OpVec3(2/3.0f, 1.0f, 0.75f),
+               OpColorRGBToHSL(OpVec3(0.5f, 0.5f, 1.0f)), 1e-6f);
+    ExpectNear(OpVec3(0.0f, 0.0f, 0.25f),
+               OpColorRGBToHSL(OpVec3(0.25f)), 1e-6f);
+    ExpectNear(OpVec3(0.0f, 0.5f, 0.5f),
+               OpColorHSLToRGB(OpVec3(0.5f, 1.0f, 0.25f)), 1e-6f);
+}
+
+TEST_F(TestOpColor, TestLinearSpaces) {
+    // The luminance of white is one, and it has no chrominance.
+    OpVec3 white(1.0f);
+    EXPECT_NEAR(1.0f, OpColorRGBToXYZ(white)[1], 1e-5f);
+    ExpectNear(OpVec3(0.3127f, 0.3290f, 1.0f), OpColorRGBToxyY(white), 1e-4f);
+    ExpectNear(OpVec3(1.0f, 0.0f, 0.0f), OpColorRGBToYIQ(white), 1e-5f);
+
+    // Black has zero chromaticity, and vice versa.
+    ExpectNear(OpVec3(0.0f), OpColorRGBToxyY(OpVec3(0.0f)), 0.0f);
+    ExpectNear(OpVec3(0.0f), OpColorxyYToRGB(OpVec3(0.3f, 0.0f, 1.0f)), 0.0f);
+}
+
+TEST_F(TestOpColor, TestRoundTrip) {
+    static const OpColorSpace spaces[] = {
+        kOpColorRGB, kOpColorHSV, kOpColorHSL, kOpColorXYZ, kOpColorxyY,
+        kOpColorYIQ
+    };
+    for (int s = 0; s < 6; ++s) {
+        for (int i = 0; i < 64; ++i) {
+            OpVec3 c((i & 3) / 3.0f, ((i >> 2) & 3) / 3.0f, (i >> 4) / 3.0f);
+            OpVec3 r = OpColorToRGB(spaces[s], OpColorFromRGB(spaces[s], c));
+            ExpectNear(c, r, 1e-4f);
+        }
+    }
+}
+
+TEST_F(TestOpColor, TestConvert) {
+    OpVec3 c(0.2f, 0.4f, 0.6f);
+    ExpectNear(c, OpColorConvert("rgb", "unknown", c), 0.0f);
+    ExpectNear(OpColorRGBToHSV(c), OpColorConvert("rgb", "hsv", c), 1e-6f);
+    ExpectNear(OpColorRGBToHSL(c),
+               OpColorConvert("hsv", "hsl", OpColorRGBToHSV(c)), 1e-6f);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,165 @@
+#include "ops/OpDeriv.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+// A stand-in for a renderer grid, with nu by nv points whose surface
+// parameters span [0,1].
+class TestOpDeriv : public testing::Test {
+public:
+    std::vector<float> mU, mV;
+    OpGrid mGrid;
+
+    void MakeGrid(int nu, int nv)
+    {
+        mU.clear();
+        mV.clear();
+        for (int j = 0; j < nv; ++j) {
+            for (int i = 0; i < nu; ++i) {
+                mU.push_back(float(i) / (nu - 1));
+                mV.push_back(float(j) / (nv - 1));
+            }
+        }
+        EXPECT_TRUE(OpGridInit(&mGrid, nu, nv, &mU[0], &mV[0], nu * nv));
+    }
+
+    // Evaluate a triple-valued function of (u,v) at each point.
+    std::vector<float> MakeTriples(float (*f)(float, float, int))
+    {
+        std::vector<float> values;
+        for (size_t i = 0; i < mU.size(); ++i)
+            for (int k = 0; k < 3; ++k)
+                values.push_back(f(mU[i], mV[i], k));
+        return values;
+    }
+};
+
+static float Plane(float u, float v, int k)
+{
+    return k == 0 ? 2*u : (k == 1 ? 3*v : 0.0f);
+}
+
+static float Saddle(float u, float v, int k)
+{
+    return k == 0 ? u : (k == 1 ? v : u*v);
+}
+
+TEST_F(TestOpDeriv, TestInit) {
+    MakeGrid(5, 4);
+    EXPECT_EQ(5, mGrid.mNumU);
+    EXPECT_EQ(4, mGrid.mNumV);
+    EXPECT_EQ(20, OpGridSize(mGrid));
+    EXPECT_EQ(1, OpGridNeighborU(mGrid, 0));
+    EXPECT_EQ(3, OpGridNeighborU(mGrid, 4));
+    EXPECT_EQ(5, OpGridNeighborV(mGrid, 0));
+    EXPECT_EQ(14, OpGridNeighborV(mGrid, 19));
+
+    // A grid whose points are not all present (i.e. some are inactive) is
+    // rejected, as are empty grids.
+    EXPECT_FALSE(OpGridInit(&mGrid, 5, 4, &mU[0], &mV[0], 18));
+    EXPECT_FALSE(OpGridInit(&mGrid, 0, 4, &mU[0], &mV[0], 0));
+
+    // A single row has no neighbors in v.
+    ASSERT_TRUE(OpGridInit(&mGrid, 18, 1, &mU[0], &mV[0], 18));
+    EXPECT_EQ(0, OpGridNeighborV(mGrid, 0));
+    EXPECT_EQ(1, OpGridNeighborU(mGrid, 0));
+}
+
+TEST_F(TestOpDeriv, TestDuDv) {
+    MakeGrid(5, 4);
+    std::vector<float> x, du(20), dv(20);
+    for (int i = 0; i < 20; ++i)
+        x.push_back(3*mU[i] - 2*mV[i]);
+    OpGridDu(mGrid, &du[0], &x[0], 1, 1);
+    OpGridDv(mGrid, &dv[0], &x[0], 1, 1);
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_FLOAT_EQ(3.0f, du[i]);
+        EXPECT_FLOAT_EQ(-2.0f, dv[i]);
+    }
+
+    // The derivatives of a uniform value are zero.
+    float uniform = 7.0f;
+    OpGridDu(mGrid, &du[0], &uniform, 0, 1);
+    for (int i = 0; i < 20; ++i)
+        EXPECT_EQ(0.0f, du[i]);
+}
+
+TEST_F(TestOpDeriv, TestTriples) {
+    MakeGrid(5, 4);
+    std::vector<float> p = MakeTriples(Saddle), du(60), dv(60);
+    OpGridDu(mGrid, &du[0], &p[0], 3, 3);
+    OpGridDv(mGrid, &dv[0], &p[0], 3, 3);
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_FLOAT_EQ(1.0f, du[i*3 + 0]);
+        EXPECT_FLOAT_EQ(0.0f, du[i*3 + 1]);
+        EXPECT_FLOAT_EQ(mV[i], du[i*3 + 2]);
+        EXPECT_FLOAT_EQ(0.0f, dv[i*3 + 0]);
+        EXPECT_FLOAT_EQ(1.0f, dv[i*3 + 1]);
+        EXPECT_FLOAT_EQ(mU[i], dv[i*3 + 2]);
+    }
+}
+
+TEST_F(TestOpDeriv, TestDeriv) {
+    MakeGrid(5, 4);
+    std::vector<float> x, y, r(20);
+    for (int i = 0; i < 20; ++i) {
+        y.push_back(mU[i]);
+        x.push_back(4*mU[i] + mV[i]);
+    }
+    // y doesn't vary in v, so only the u term contributes.
+    OpGridDeriv(mGrid, &r[0], &x[0], 1, 1, &y[0], 1);
+    for (int i = 0; i < 20; ++i)
+        EXPECT_FLOAT_EQ(4.0f, r[i]);
+}
+
+TEST_F(TestOpDeriv, TestArea) {
+    MakeGrid(5, 4);
+    std::vector<float> p = MakeTriples(Plane), r(20);
+    OpGridArea(mGrid, &r[0], &p[0], 3);
+    float du = 1.0f / 4, dv = 1.0f / 3;
+    for (int i = 0; i < 20; ++i)
+        EXPECT_FLOAT_EQ(6*du*dv, r[i]);
+}
+
+TEST_F(TestOpDeriv, TestCalculateNormal) {
+    MakeGrid(5, 4);
+    std::vector<float> p = MakeTriples(Saddle), r(60);
+    OpGridCalculateNormal(mGrid, &r[0], &p[0], 3);
+    for (int i = 0; i < 20; ++i) {
+        // (1, 0, v) ^ (0, 1, u) = (-v, -u, 1)
+        EXPECT_FLOAT_EQ(-mV[i], r[i*3 + 0]);
+        EXPECT_FLOAT_EQ(-mU[i], r[i*3 + 1]);
+        EXPECT_FLOAT_EQ(1.0f, r[i*3 + 2]);
+    }
+}
+
+TEST_F(TestOpDeriv, TestFilterWidth) {
+    MakeGrid(5, 4);
+    std::vector<float> p = MakeTriples(Plane), r(20);
+    OpGridFilterWidth(mGrid, &r[0], &p[0], 3);
+    for (int i = 0; i < 20; ++i)
+        EXPECT_FLOAT_EQ(0.5f, r[i]);
+    OpGridFilterWidth(mGrid, &r[0], &p[1], 3);
+    for (int i = 0; i < 20; ++i)
+        EXPECT_FLOAT_EQ(1.0f, r[i]);
+}
+
+static float Arc(float u, float v, int k)
+{
+    float a = u * float(M_PI) / 2;
+    return k == 0 ? 2*cosf(a) : (k == 1 ? 2*sinf(a) : 0.0f);
+}
+
+TEST_F(TestOpDeriv, TestAngularWidth) {
+    // The directions sweep a quarter circle in u and are constant in v.
+    MakeGrid(5, 4);
+    std::vector<float> d = MakeTriples(Arc), r(20);
+    OpGridAngularWidth(mGrid, &r[0], &d[0], 3);
+    for (int i = 0; i < 20; ++i)
+        EXPECT_NEAR(float(M_PI) / 8, r[i], 1e-5f);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
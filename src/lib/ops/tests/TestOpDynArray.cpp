@@ -0,0 +1,115 @@
+#include "ops/OpDynArray.h"
+#include "ops/OpVec3.h"
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+class TestOpDynArray : public testing::Test { };
+
+TEST_F(TestOpDynArray, TestArena) {
+    OpArena arena;
+    OpArenaInit(&arena);
+    EXPECT_TRUE(arena.mBlocks == NULL);
+
+    // Allocations are aligned and don't overlap.
+    char* a = static_cast<char*>(OpArenaAlloc(&arena, 3));
+    char* b = static_cast<char*>(OpArenaAlloc(&arena, 5));
+    ASSERT_TRUE(a != NULL && b != NULL);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(a) % kOpArenaAlign);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(b) % kOpArenaAlign);
+    EXPECT_TRUE(b >= a + 3);
+    OpArenaBlock* first = arena.mBlocks;
+
+    // A large allocation gets a block of its own.
+    char* big = static_cast<char*>(OpArenaAlloc(&arena, 3 * kOpArenaBlockSize));
+    ASSERT_TRUE(big != NULL);
+    memset(big, 1, 3 * kOpArenaBlockSize);
+    EXPECT_TRUE(arena.mBlocks != first);
+    EXPECT_EQ(first, arena.mBlocks->mPrev);
+
+    OpArenaFree(&arena);
+    EXPECT_TRUE(arena.mBlocks == NULL);
+    EXPECT_TRUE(arena.mNext == NULL);
+}
+
+TEST_F(TestOpDynArray, TestPushPop) {
+    OpArena arena;
+    OpArenaInit(&arena);
+    OpDynArray array;
+    memset(&array, 0, sizeof(array));
+
+    // Popping an empty array yields the default value.
+    EXPECT_EQ(-1.0f, OpDynArrayPop(&array, -1.0f));
+    EXPECT_EQ(0, array.mLength);
+
+    // Pushing grows the capacity geometrically.
+    for (int i = 0; i < 100; ++i)
+        OpDynArrayPush(&array, &arena, float(i));
+    EXPECT_EQ(100, array.mLength);
+    EXPECT_LE(100, array.mCapacity);
+    EXPECT_GT(200, array.mCapacity);
+    for (int i = 99; i >= 0; --i)
+        EXPECT_EQ(float(i), OpDynArrayPop(&array, -1.0f));
+    EXPECT_EQ(0, array.mLength);
+    OpArenaFree(&arena);
+}
+
+TEST_F(TestOpDynArray, TestResize) {
+    OpArena arena;
+    OpArenaInit(&arena);
+    OpDynArray array;
+    memset(&array, 0, sizeof(array));
+
+    // New elements are zeroed, and existing elements are preserved.
+    OpDynArrayPush(&array, &arena, OpVec3(1.0f, 2.0f, 3.0f));
+    OpDynArrayResize(&array, &arena, 10, sizeof(OpVec3));
+    ASSERT_EQ(10, array.mLength);
+    const OpVec3* elements = static_cast<const OpVec3*>(array.mData);
+    EXPECT_EQ(OpVec3(1.0f, 2.0f, 3.0f), elements[0]);
+    for (int i = 1; i < 10; ++i)
+        EXPECT_EQ(OpVec3(0.0f), elements[i]);
+
+    // Shrinking keeps the capacity, and a negative length is treated as zero.
+    int capacity = array.mCapacity;
+    OpDynArrayResize(&array, &arena, 2, sizeof(OpVec3));
+    EXPECT_EQ(2, array.mLength);
+    EXPECT_EQ(capacity, array.mCapacity);
+    OpDynArrayResize(&array, &arena, -1, sizeof(OpVec3));
+    EXPECT_EQ(0, array.mLength);
+
+    // Reserving capacity doesn't change the length.
+    OpDynArrayReserve(&array, &arena, 1000, sizeof(OpVec3));
+    EXPECT_EQ(0, array.mLength);
+    EXPECT_LE(1000, array.mCapacity);
+    OpArenaFree(&arena);
+}
+
+TEST_F(TestOpDynArray, TestAssign) {
+    OpArena arena;
+    OpArenaInit(&arena);
+    OpDynArray array;
+    memset(&array, 0, sizeof(array));
+
+    const float values[] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f };
+    OpDynArrayAssign(&array, &arena, values, 5);
+    ASSERT_EQ(5, array.mLength);
+    const float* elements = static_cast<const float*>(array.mData);
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ(values[i], elements[i]);
+
+    // Assigning a shorter array shrinks it.
+    OpDynArrayAssign(&array, &arena, values + 3, 2);
+    ASSERT_EQ(2, array.mLength);
+    elements = static_cast<const float*>(array.mData);
+    EXPECT_EQ(4.0f, elements[0]);
+    EXPECT_EQ(5.0f, elements[1]);
+
+    // Assigning an empty array empties it.
+    OpDynArrayAssign(&array, &arena, values, 0);
+    EXPECT_EQ(0, array.mLength);
+    OpArenaFree(&arena);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,73 @@
+#include "ops/OpFresnel.h"
+#include <gtest/gtest.h>
+#include <math.h>
+
+class TestOpFresnel : public testing::Test { };
+
+// Compute the reflection coefficient from the angles of incidence and
+// refraction, for comparison.
+static double
+Reflectance(double incident, double n1, double n2)
+{
+    if (incident == 0.0)
+        return pow((n1 - n2) / (n1 + n2), 2);
+    double refracted = asin(n1 / n2 * sin(incident));
+    double rs = sin(incident - refracted) / sin(incident + refracted);
+    double rp = tan(incident - refracted) / tan(incident + refracted);
+    return 0.5 * (rs*rs + rp*rp);
+}
+
+TEST_F(TestOpFresnel, TestNormalIncidence) {
+    float Kr, Kt;
+    OpVec3 R, T;
+    OpFresnel(OpVec3(0.0f, 0.0f, -2.0f), OpVec3(0.0f, 0.0f, 3.0f), 1/1.5f,
+              &Kr, &Kt, &R, &T);
+    EXPECT_FLOAT_EQ(0.04f, Kr);
+    EXPECT_FLOAT_EQ(0.96f, Kt);
+    EXPECT_EQ(OpVec3(0.0f, 0.0f, 1.0f), R);
+    EXPECT_EQ(OpVec3(0.0f, 0.0f, -1.0f), T);
+}
+
+TEST_F(TestOpFresnel, TestObliqueIncidence) {
+    OpVec3 N(0.0f, 0.0f, 1.0f);
+    for (int i = 1; i < 90; ++i) {
+        float angle = i * float(M_PI) / 180.0f;
+        OpVec3 I(sinf(angle), 0.0f, -cosf(angle));
+        float Kr, Kt;
+        OpVec3 R, T;
+
+        // Entering glass.
+        OpFresnel(I, N, 1/1.5f, &Kr, &Kt, &R, &T);
+        EXPECT_NEAR(Reflectance(angle, 1.0, 1.5), Kr, 1e-5) << i;
+        EXPECT_FLOAT_EQ(1.0f, Kr + Kt);
+        EXPECT_NEAR(I[0], R[0], 1e-6f);
+        EXPECT_NEAR(-I[2], R[2], 1e-6f);
+        EXPECT_NEAR(1.0f, T.Length(), 1e-5f);
+        EXPECT_NEAR(I[0] / 1.5f, T[0], 1e-6f);  // Snell's law
+
+        // Leaving glass, which reflects totally beyond the critical angle.
+        OpFresnel(I, N, 1.5f, &Kr, &Kt, &R, &T);
+        if (sinf(angle) * 1.5f > 1.0f) {
+            EXPECT_EQ(1.0f, Kr);
+            EXPECT_EQ(0.0f, Kt);
+            EXPECT_EQ(OpVec3(0.0f), T);
+        }
+        else
+            EXPECT_NEAR(Reflectance(angle, 1.5, 1.0), Kr, 1e-4) << i;
+    }
+}
+
+TEST_F(TestOpFresnel, TestGrazingIncidence) {
+    float Kr, Kt;
+    OpVec3 R, T;
+    OpFresnel(OpVec3(1.0f, 0.0f, 0.0f), OpVec3(0.0f, 0.0f, 1.0f), 1.0f,
+              &Kr, &Kt, &R, &T);
+    EXPECT_EQ(1.0f, Kr);
+    EXPECT_EQ(0.0f, Kt);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
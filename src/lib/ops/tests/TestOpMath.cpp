@@ -0,0 +1,172 @@
+#include "ops/OpMath.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+class TestOpMath : public testing::Test { };
+
+// Number of points in each sweep.
+static const int kNumPoints = 200000;
+
+// Get the ith of kNumPoints points spaced uniformly in [lo,hi].
+static float
+Uniform(int i, float lo, float hi)
+{
+    return lo + (hi - lo) * i / (kNumPoints - 1);
+}
+
+// Get the ith of kNumPoints points spaced logarithmically in [lo,hi].
+static float
+Logarithmic(int i, float lo, float hi)
+{
+    return static_cast<float>(
+        exp(log(lo) + (log(hi) - log(lo)) * i / (kNumPoints - 1)));
+}
+
+// Get the error of a float result in ULPs of the exact result.
+static double
+UlpError(float result, double exact)
+{
+    int e;
+    frexp(exact, &e);
+    double ulp = ldexp(1.0, (e - 24 < -149 ? -149 : e - 24));
+    return fabs(result - exact) / ulp;
+}
+
+// Get the absolute error of a result.
+static double
+AbsError(float result, double exact)
+{
+    return fabs(result - exact);
+}
+
+// Get the relative error of a result.
+static double
+RelError(float result, double exact)
+{
+    return fabs(result - exact) / fabs(exact);
+}
+
+TEST_F(TestOpMath, TestSinCos) {
+    double exactSin = 0, exactCos = 0, fastSin = 0, fastCos = 0;
+    for (int i = 0; i < kNumPoints; ++i) {
+        float x = Uniform(i, -10000.0f, 10000.0f);
+        double s = sin(double(x)), c = cos(double(x));
+        exactSin = std::max(exactSin, UlpError(OpMathSin(x), s));
+        exactCos = std::max(exactCos, UlpError(OpMathCos(x), c));
+        fastSin = std::max(fastSin, AbsError(OpMathFastSin(x), s));
+        fastCos = std::max(fastCos, AbsError(OpMathFastCos(x), c));
+    }
+    EXPECT_GE(2.0, exactSin);
+    EXPECT_GE(2.0, exactCos);
+    EXPECT_GE(2e-6, fastSin);
+    EXPECT_GE(2e-6, fastCos);
+}
+
+TEST_F(TestOpMath, TestExp) {
+    double exact = 0, fast = 0;
+    for (int i = 0; i < kNumPoints; ++i) {
+        float x = Uniform(i, -87.0f, 88.0f);
+        double r = exp(double(x));
+        exact = std::max(exact, UlpError(OpMathExp(x), r));
+        fast = std::max(fast, RelError(OpMathFastExp(x), r));
+    }
+    EXPECT_GE(1.0, exact);
+    EXPECT_GE(1e-5, fast);
+
+    EXPECT_EQ(HUGE_VALF, OpMathExp(100.0f));
+    EXPECT_EQ(0.0f, OpMathExp(-200.0f));
+    EXPECT_TRUE(isnan(OpMathExp(NAN)));
+    EXPECT_EQ(HUGE_VALF, OpMathFastExp(100.0f));
+    EXPECT_EQ(0.0f, OpMathFastExp(-200.0f));
+}
+
+TEST_F(TestOpMath, TestLog) {
+    double exact = 0, fast = 0;
+    for (int i = 0; i < kNumPoints; ++i) {
+        float x = Logarithmic(i, 1e-44f, 3e38f);
+        double r = log(double(x));
+        exact = std::max(exact, UlpError(OpMathLog(x), r));
+        fast = std::max(fast, AbsError(OpMathFastLog(x), r) /
+                        std::max(1.0, fabs(r)));
+    }
+    EXPECT_GE(1.0, exact);
+    EXPECT_GE(2e-7, fast);
+
+    EXPECT_EQ(-HUGE_VALF, OpMathLog(0.0f));
+    EXPECT_EQ(HUGE_VALF, OpMathLog(HUGE_VALF));
+    EXPECT_TRUE(isnan(OpMathLog(-1.0f)));
+    EXPECT_EQ(-HUGE_VALF, OpMathFastLog(0.0f));
+    EXPECT_TRUE(isnan(OpMathFastLog(-1.0f)));
+}
+
+TEST_F(TestOpMath, TestPow) {
+    double exact = 0, fast = 0;
+    for (int i = 0; i < kNumPoints; ++i) {
+        float a = Logarithmic(i, 1e-3f, 1e3f);
+        float b = Uniform((i * 7919) % kNumPoints, -11.0f, 11.0f);
+        double r = pow(double(a), double(b));
+        exact = std::max(exact, UlpError(OpMathPow(a, b), r));
+        fast = std::max(fast, RelError(OpMathFastPow(a, b), r));
+    }
+    EXPECT_GE(1.0, exact);
+    EXPECT_GE(2e-5, fast);
+
+    EXPECT_EQ(1.0f, OpMathPow(0.0f, 0.0f));
+    EXPECT_EQ(0.0f, OpMathPow(0.0f, 2.0f));
+    EXPECT_EQ(HUGE_VALF, OpMathPow(0.0f, -1.0f));
+    EXPECT_EQ(-8.0f, OpMathPow(-2.0f, 3.0f));
+    EXPECT_EQ(16.0f, OpMathPow(-2.0f, 4.0f));
+    EXPECT_TRUE(isnan(OpMathPow(-2.0f, 0.5f)));
+    EXPECT_EQ(HUGE_VALF, OpMathPow(10.0f, 50.0f));
+    EXPECT_EQ(0.0f, OpMathPow(10.0f, -50.0f));
+    EXPECT_EQ(-8.0f, OpMathFastPow(-2.0f, 3.0f));
+    EXPECT_EQ(1.0f, OpMathFastPow(0.0f, 0.0f));
+}
+
+TEST_F(TestOpMath, TestAtan) {
+    double exact = 0, fast = 0;
+    for (int i = 0; i < kNumPoints; ++i) {
+        float x = Uniform(i, -100.0f, 100.0f);
+        double r = atan(double(x));
+        exact = std::max(exact, UlpError(OpMathAtan(x), r));
+        fast = std::max(fast, AbsError(OpMathFastAtan(x), r));
+    }
+    for (int i = 0; i < kNumPoints; ++i) {
+        float angle = Uniform(i, -3.14159f, 3.14159f);
+        float radius = Logarithmic(i, 1e-3f, 1e3f);
+        float y = radius * sinf(angle), x = radius * cosf(angle);
+        double r = atan2(double(y), double(x));
+        exact = std::max(exact, UlpError(OpMathAtan2(y, x), r));
+        fast = std::max(fast, AbsError(OpMathFastAtan2(y, x), r));
+    }
+    EXPECT_GE(3.0, exact);
+    EXPECT_GE(3e-6, fast);
+
+    EXPECT_EQ(0.0f, OpMathAtan2(0.0f, 0.0f));
+    EXPECT_FLOAT_EQ(atan2f(1.0f, -1.0f), OpMathAtan2(1.0f, -1.0f));
+    EXPECT_FLOAT_EQ(atan2f(-1.0f, -1.0f), OpMathAtan2(-1.0f, -1.0f));
+    EXPECT_FLOAT_EQ(atan2f(0.0f, -1.0f), OpMathAtan2(0.0f, -1.0f));
+    EXPECT_FLOAT_EQ(atan2f(HUGE_VALF, HUGE_VALF),
+                    OpMathAtan2(HUGE_VALF, HUGE_VALF));
+    EXPECT_FLOAT_EQ(atanf(HUGE_VALF), OpMathAtan(HUGE_VALF));
+}
+
+TEST_F(TestOpMath, TestInverseSqrt) {
+    double exact = 0, fast = 0;
+    for (int i = 0; i < kNumPoints; ++i) {
+        float x = Logarithmic(i, FLT_MIN, 3e38f);
+        double r = 1.0 / sqrt(double(x));
+        exact = std::max(exact, UlpError(OpMathInverseSqrt(x), r));
+        fast = std::max(fast, RelError(OpMathFastInverseSqrt(x), r));
+    }
+    EXPECT_GE(2.0, exact);
+    EXPECT_GE(5e-6, fast);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
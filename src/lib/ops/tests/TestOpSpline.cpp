@@ -0,0 +1,95 @@
+#include "ops/OpSpline.h"
+#include "ops/OpVec3.h"
+#include <gtest/gtest.h>
+
+class TestOpSpline : public testing::Test { };
+
+static const float kPoints[] = { 0, 1, 2, 4, 8, 16 };
+
+TEST_F(TestOpSpline, TestBasisNames) {
+    EXPECT_EQ(kOpSplineCatmullRom, OpSplineGetBasis("catmull-rom"));
+    EXPECT_EQ(kOpSplineBezier, OpSplineGetBasis("Bezier"));
+    EXPECT_EQ(kOpSplineBSpline, OpSplineGetBasis("b-spline"));
+    EXPECT_EQ(kOpSplineBSpline, OpSplineGetBasis("bspline"));
+    EXPECT_EQ(kOpSplineHermite, OpSplineGetBasis("hermite"));
+    EXPECT_EQ(kOpSplineLinear, OpSplineGetBasis("linear"));
+    EXPECT_EQ(kOpSplineCatmullRom, OpSplineGetBasis("unknown"));
+}
+
+TEST_F(TestOpSpline, TestCatmullRom) {
+    // A Catmull-Rom spline interpolates the interior control points, which
+    // are evenly spaced in the parameter.
+    OpSplineBasis basis = kOpSplineCatmullRom;
+    EXPECT_FLOAT_EQ(1.0f, OpSplineEval(basis, 0.0f, kPoints, 6));
+    EXPECT_FLOAT_EQ(2.0f, OpSplineEval(basis, 1/3.0f, kPoints, 6));
+    EXPECT_FLOAT_EQ(4.0f, OpSplineEval(basis, 2/3.0f, kPoints, 6));
+    EXPECT_FLOAT_EQ(8.0f, OpSplineEval(basis, 1.0f, kPoints, 6));
+
+    // Midway between the two interior points of a single segment.
+    EXPECT_FLOAT_EQ(1.4375f, OpSplineEval(basis, 0.5f, kPoints, 4));
+
+    // The parameter is clamped.
+    EXPECT_FLOAT_EQ(1.0f, OpSplineEval(basis, -1.0f, kPoints, 6));
+    EXPECT_FLOAT_EQ(8.0f, OpSplineEval(basis, 2.0f, kPoints, 6));
+}
+
+TEST_F(TestOpSpline, TestLinear) {
+    OpSplineBasis basis = kOpSplineLinear;
+    EXPECT_FLOAT_EQ(1.0f, OpSplineEval(basis, 0.0f, kPoints, 6));
+    EXPECT_FLOAT_EQ(1.5f, OpSplineEval(basis, 1/6.0f, kPoints, 6));
+    EXPECT_FLOAT_EQ(3.0f, OpSplineEval(basis, 0.5f, kPoints, 6));
+    EXPECT_FLOAT_EQ(8.0f, OpSplineEval(basis, 1.0f, kPoints, 6));
+}
+
+TEST_F(TestOpSpline, TestBezier) {
+    // A Bezier spline interpolates every third control point.
+    static const float points[] = { 0, 1, 2, 3, 5, 7, 9 };
+    OpSplineBasis basis = kOpSplineBezier;
+    EXPECT_FLOAT_EQ(0.0f, OpSplineEval(basis, 0.0f, points, 7));
+    EXPECT_FLOAT_EQ(1.5f, OpSplineEval(basis, 0.25f, points, 7));
+    EXPECT_FLOAT_EQ(3.0f, OpSplineEval(basis, 0.5f, points, 7));
+    EXPECT_FLOAT_EQ(9.0f, OpSplineEval(basis, 1.0f, points, 7));
+}
+
+TEST_F(TestOpSpline, TestBSpline) {
+    // The B-spline basis functions sum to one.
+    static const float points[] = { 5, 5, 5, 5, 5 };
+    for (int i = 0; i <= 10; ++i)
+        EXPECT_FLOAT_EQ(5.0f, OpSplineEval(kOpSplineBSpline, i / 10.0f,
+                                           points, 5));
+
+    // Evenly spaced control points reproduce a line.
+    static const float line[] = { 0, 1, 2, 3 };
+    EXPECT_FLOAT_EQ(1.0f, OpSplineEval(kOpSplineBSpline, 0.0f, line, 4));
+    EXPECT_FLOAT_EQ(1.5f, OpSplineEval(kOpSplineBSpline, 0.5f, line, 4));
+}
+
+TEST_F(TestOpSpline, TestHermite) {
+    // Points and tangents alternate.
+    static const float points[] = { 0, 0, 1, 0, 2, 3 };
+    OpSplineBasis basis = kOpSplineHermite;
+    EXPECT_FLOAT_EQ(0.0f, OpSplineEval(basis, 0.0f, points, 6));
+    EXPECT_FLOAT_EQ(0.5f, OpSplineEval(basis, 0.25f, points, 6));
+    EXPECT_FLOAT_EQ(1.0f, OpSplineEval(basis, 0.5f, points, 6));
+    EXPECT_FLOAT_EQ(2.0f, OpSplineEval(basis, 1.0f, points, 6));
+}
+
+TEST_F(TestOpSpline, TestTriples) {
+    OpVec3 points[6];
+    for (int i = 0; i < 6; ++i)
+        points[i] = OpVec3(kPoints[i], -kPoints[i], 1.0f);
+    OpVec3 r = OpSplineEval(kOpSplineCatmullRom, 1/3.0f, points, 6);
+    EXPECT_FLOAT_EQ(2.0f, r[0]);
+    EXPECT_FLOAT_EQ(-2.0f, r[1]);
+    EXPECT_FLOAT_EQ(1.0f, r[2]);
+}
+
+TEST_F(TestOpSpline, TestTooFewPoints) {
+    EXPECT_FLOAT_EQ(0.0f, OpSplineEval(kOpSplineCatmullRom, 0.5f, kPoints, 3));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+#include "ops/OpString.h"
+#include "ops/OpVec3.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+class TestOpString : public testing::Test { };
+
+TEST_F(TestOpString, TestIntern) {
+    OpArena arena;
+    OpArenaInit(&arena);
+
+    // Interning equal strings yields the same copy.
+    const char* a = OpStringIntern(&arena, "foo_bar", 3);
+    const char* b = OpStringIntern(&arena, "foo", 3);
+    const char* c = OpStringIntern(&arena, "bar", 3);
+    ASSERT_TRUE(a != NULL && b != NULL && c != NULL);
+    EXPECT_STREQ("foo", a);
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+
+    // The table grows as needed.
+    std::vector<const char*> copies;
+    for (int i = 0; i < 1000; ++i) {
+        char name[16];
+        int len = sprintf(name, "s%d", i);
+        copies.push_back(OpStringIntern(&arena, name, len));
+    }
+    EXPECT_EQ(1002U, arena.mStrings->mCount);
+    for (int i = 0; i < 1000; ++i) {
+        char name[16];
+        int len = sprintf(name, "s%d", i);
+        EXPECT_EQ(copies[i], OpStringIntern(&arena, name, len));
+    }
+    OpArenaFree(&arena);
+    EXPECT_TRUE(arena.mStrings == NULL);
+}
+
+TEST_F(TestOpString, TestPersist) {
+    OpStringPool pool = { { NULL, 0, 0 }, PTHREAD_MUTEX_INITIALIZER };
+    OpArena arena;
+    OpArenaInit(&arena);
+
+    // Only strings interned in the arena are replaced, and equal strings
+    // share a copy.
+    char local[] = "foo";
+    const char* foo = OpStringIntern(&arena, "foo", 3);
+    const char* strings[] = { foo, "bar", local, foo };
+    OpStringPersist(&pool, &arena, strings, 4);
+    EXPECT_NE(foo, strings[0]);
+    EXPECT_STREQ("foo", strings[0]);
+    EXPECT_STREQ("bar", strings[1]);
+    EXPECT_EQ(local, strings[2]);
+    EXPECT_EQ(strings[0], strings[3]);
+    const char* persistent = strings[0];
+    OpArenaFree(&arena);
+    EXPECT_STREQ("foo", persistent);
+
+    // The pool copy is reused by later calls.
+    OpArenaInit(&arena);
+    const char* again[] = { OpStringIntern(&arena, "foo", 3) };
+    OpStringPersist(&pool, &arena, again, 1);
+    EXPECT_EQ(persistent, again[0]);
+    EXPECT_EQ(1U, pool.mTable.mCount);
+    OpArenaFree(&arena);
+
+    // Freeing the pool leaves it empty and reusable.
+    OpStringPoolFree(&pool);
+    EXPECT_EQ(0U, pool.mTable.mCount);
+    EXPECT_EQ(0U, pool.mTable.mCapacity);
+    OpArenaInit(&arena);
+    const char* after[] = { OpStringIntern(&arena, "foo", 3) };
+    OpStringPersist(&pool, &arena, after, 1);
+    EXPECT_STREQ("foo", after[0]);
+    EXPECT_EQ(1U, pool.mTable.mCount);
+    OpArenaFree(&arena);
+    OpStringPoolFree(&pool);
+}
+
+static std::string
+Format(const char* format, const char* types, const void* const* values,
+       int n)
+{
+    char buffer[256];
+    int len = OpStringFormat(buffer, sizeof(buffer), format, types, values, n);
+    EXPECT_EQ(strlen(buffer), size_t(len));
+    return buffer;
+}
+
+TEST_F(TestOpString, TestFormat) {
+    float f = 2.5f;
+    OpVec3 t(1.0f, 2.0f, 3.0f);
+    const char* s = "diffuse";
+    const void* values[] = { &s, &f, &t };
+    EXPECT_EQ("diffuse_2", Format("%s_%d", "sft", values, 2));
+    EXPECT_EQ("100% 2.50", Format("100%% %.2f", "f", values + 1, 1));
+    EXPECT_EQ("[1 2 3]", Format("[%g]", "t", values + 2, 1));
+    EXPECT_EQ("1.0 2.0 3.0", Format("%.1c", "t", values + 2, 1));
+    EXPECT_EQ("  diffuse", Format("%9s", "s", values, 1));
+
+    // Missing values are omitted.
+    EXPECT_EQ("x= y=", Format("x=%f y=%f", "", values, 0));
+
+    // Output is truncated to fit the buffer, but the full length is returned.
+    char buffer[4];
+    EXPECT_EQ(7, OpStringFormat(buffer, sizeof(buffer), "%s", "s", values, 1));
+    EXPECT_STREQ("dif", buffer);
+}
+
+TEST_F(TestOpString, TestMatch) {
+    EXPECT_TRUE(OpStringMatch("^tex_[0-9]+$", "tex_42"));
+    EXPECT_FALSE(OpStringMatch("^tex_[0-9]+$", "tex_"));
+    EXPECT_TRUE(OpStringMatch("spec", "aov_specular"));
+    EXPECT_FALSE(OpStringMatch("(", "("));
+}
+
+TEST_F(TestOpString, TestMatchCached) {
+    OpArena arena;
+    OpArenaInit(&arena);
+
+    // A pattern is compiled once, even if it's passed as a different copy.
+    const char* pattern = "^tex_[0-9]+$";
+    std::string copy(pattern);
+    EXPECT_TRUE(OpStringMatchCached(&arena, pattern, "tex_42"));
+    EXPECT_FALSE(OpStringMatchCached(&arena, pattern, "tex_"));
+    EXPECT_TRUE(OpStringMatchCached(&arena, copy.c_str(), "tex_7"));
+    EXPECT_EQ(1, arena.mNumRegexes);
+
+    // Invalid patterns are cached too, and match nothing.
+    EXPECT_FALSE(OpStringMatchCached(&arena, "(", "("));
+    EXPECT_FALSE(OpStringMatchCached(&arena, "(", "("));
+    EXPECT_EQ(2, arena.mNumRegexes);
+
+    // Patterns beyond the limit are compiled without being cached.
+    std::vector<std::string> patterns;
+    for (int i = 0; i < kOpArenaMaxRegexes + 4; ++i)
+        patterns.push_back(std::string(i + 1, 'a'));
+    for (size_t i = 0; i < patterns.size(); ++i)
+        EXPECT_TRUE(OpStringMatchCached(&arena, patterns[i].c_str(),
+                                        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"));
+    EXPECT_EQ(kOpArenaMaxRegexes, arena.mNumRegexes);
+    EXPECT_FALSE(OpStringMatchCached(&arena, patterns.back().c_str(), "a"));
+    OpArenaFree(&arena);
+    EXPECT_EQ(0, arena.mNumRegexes);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
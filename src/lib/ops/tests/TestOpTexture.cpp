@@ -0,0 +1,91 @@
+#include "ops/OpTexture.h"
+#include <gtest/gtest.h>
+
+// quad.ppm is a 2x2 image: red and green on top, blue and white below.
+class TestOpTexture : public testing::Test {
+public:
+    OpFileTextureSystem mTextures;
+
+    void ExpectColor(float r, float g, float b, const float* c)
+    {
+        EXPECT_FLOAT_EQ(r, c[0]);
+        EXPECT_FLOAT_EQ(g, c[1]);
+        EXPECT_FLOAT_EQ(b, c[2]);
+    }
+};
+
+TEST_F(TestOpTexture, TestTexels) {
+    float s[] = { 0.25f, 0.75f, 0.25f, 0.75f };
+    float t[] = { 0.25f, 0.25f, 0.75f, 0.75f };
+    float result[12];
+    EXPECT_TRUE(mTextures.Texture("quad.ppm", 0, 3, 4, s, t,
+                                  NULL, NULL, result));
+    ExpectColor(1, 0, 0, &result[0]);
+    ExpectColor(0, 1, 0, &result[3]);
+    ExpectColor(0, 0, 1, &result[6]);
+    ExpectColor(1, 1, 1, &result[9]);
+}
+
+TEST_F(TestOpTexture, TestFilter) {
+    // The center of the image is the average of the texels, and lookups
+    // are clamped at the edges.
+    float s[] = { 0.5f, 0.0f, 1.0f };
+    float t[] = { 0.5f, 0.0f, 0.5f };
+    float result[9];
+    EXPECT_TRUE(mTextures.Texture("quad.ppm", 0, 3, 3, s, t,
+                                  NULL, NULL, result));
+    ExpectColor(0.5f, 0.5f, 0.5f, &result[0]);
+    ExpectColor(1, 0, 0, &result[3]);
+    ExpectColor(0.5f, 1, 0.5f, &result[6]);
+}
+
+TEST_F(TestOpTexture, TestWidths) {
+    // A box as wide as the image, centered on the red texel, averages it
+    // (clamped at the edge) with the midpoint of the top row.  Zero widths
+    // are the same as point sampling.
+    float s[] = { 0.25f, 0.5f }, t[] = { 0.25f, 0.5f };
+    float sWidths[] = { 1.0f, 0.0f }, tWidths[] = { 0.0f, 0.0f };
+    float result[6];
+    EXPECT_TRUE(mTextures.Texture("quad.ppm", 0, 3, 2, s, t,
+                                  sWidths, tWidths, result));
+    ExpectColor(0.75f, 0.25f, 0, &result[0]);
+    ExpectColor(0.5f, 0.5f, 0.5f, &result[3]);
+}
+
+TEST_F(TestOpTexture, TestChannels) {
+    float s[] = { 0.75f }, t[] = { 0.75f };
+    float result[3];
+    EXPECT_TRUE(mTextures.Texture("quad.ppm", 1, 1, 1, s, t,
+                                  NULL, NULL, result));
+    EXPECT_FLOAT_EQ(1.0f, result[0]);
+
+    // Missing channels are zero.
+    EXPECT_TRUE(mTextures.Texture("quad.ppm", 2, 3, 1, s, t,
+                                  NULL, NULL, result));
+    ExpectColor(1, 0, 0, result);
+}
+
+TEST_F(TestOpTexture, TestMissing) {
+    float s[] = { 0.5f }, t[] = { 0.5f };
+    float result[3] = { 1, 1, 1 };
+    EXPECT_FALSE(mTextures.Texture("missing.ppm", 0, 3, 1, s, t,
+                                   NULL, NULL, result));
+    ExpectColor(0, 0, 0, result);
+}
+
+TEST_F(TestOpTexture, TestEnvironment) {
+    // Straight up is the middle of the top row; straight down is the middle
+    // of the bottom row.
+    float dirs[] = { 0, 0, 2,  0, 0, -1 };
+    float result[6];
+    EXPECT_TRUE(mTextures.Environment("quad.ppm", 0, 3, 2, dirs, NULL,
+                                      result));
+    ExpectColor(0.5f, 0.5f, 0, &result[0]);
+    ExpectColor(0.5f, 0.5f, 1, &result[3]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
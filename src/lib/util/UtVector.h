@@ -70,6 +70,13 @@ public:
     {
     }
 
+    /// Assignment operator
+    UtVector<T>& operator=(const UtVector<T>& v)
+    {
+        std::vector<T>::operator=(v);
+        return *this;
+    }
+
     /// Construct from varargs.
     UtVector(size_t numArgs, ...)
     {
@@ -77,7 +84,7 @@ public:
         va_list ap;
         va_start(ap, numArgs);
         for (size_t i = 0; i < numArgs; ++i)
-            push_back(va_arg(ap, T));
+            this->push_back(va_arg(ap, T));
         va_end(ap);
     }
 
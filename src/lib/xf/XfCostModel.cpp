@@ -0,0 +1,200 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "xf/XfCostModel.h"
+#include "ir/IRStmts.h"
+#include "ir/IRVarSet.h"
+#include "ops/OpcodeNames.h"
+#include "util/UtCast.h"
+#include "util/UtLog.h"
+#include <stdio.h>
+#include <string.h>
+
+// Default estimates.  Interpreted instructions are costlier, since the
+// operands of each instruction are loaded from and stored to memory.  The
+// difference is less significant for expensive instructions.
+static const float kDefaultInterpCost = 2.0f;
+static const float kDefaultCompiledCost = 0.5f;
+static const float kExpensiveInterpCost = 12.0f;
+static const float kExpensiveCompiledCost = 10.0f;
+static const float kDefaultCallCost = 4.0f;
+static const float kDefaultArgCost = 1.5f;
+static const float kDefaultBranchInterpCost = 4.0f;
+static const float kDefaultBranchCompiledCost = 1.0f;
+
+// Instructions that are expensive regardless of how they're executed.
+static const Opcode kExpensiveOpcodes[] = {
+    kOpcode_Acos, kOpcode_Asin, kOpcode_Atan, kOpcode_CellNoise,
+    kOpcode_Cos, kOpcode_Erf, kOpcode_Erfc, kOpcode_Exp, kOpcode_Fresnel,
+    kOpcode_InverseSqrt, kOpcode_Log, kOpcode_Noise, kOpcode_PNoise,
+    kOpcode_Pow, kOpcode_Sin, kOpcode_Spline, kOpcode_Sqrt, kOpcode_Tan,
+    kOpcode_Transform, kOpcode_WNoise
+};
+
+// Construct a cost model with the default estimates.
+XfCostModel::XfCostModel() :
+    mCallCost(kDefaultCallCost),
+    mArgCost(kDefaultArgCost),
+    mBranchInterpCost(kDefaultBranchInterpCost),
+    mBranchCompiledCost(kDefaultBranchCompiledCost)
+{
+    for (unsigned int i = 0; i < kOpcode_NumInsts; ++i)
+        SetCosts(static_cast<Opcode>(i),
+                 kDefaultInterpCost, kDefaultCompiledCost);
+    size_t numExpensive = sizeof(kExpensiveOpcodes) / sizeof(Opcode);
+    for (size_t i = 0; i < numExpensive; ++i)
+        SetCosts(kExpensiveOpcodes[i],
+                 kExpensiveInterpCost, kExpensiveCompiledCost);
+}
+
+// Load estimates from the specified file.
+bool
+XfCostModel::Load(const char* filename, UtLog* log)
+{
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        log->Write(kUtError, "Unable to open cost model file '%s'", filename);
+        return false;
+    }
+    OpcodeNames opcodeNames;
+    char line[256];
+    int lineNum = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        ++lineNum;
+        char name[128];
+        float cost1, cost2;
+        int numFields = sscanf(line, "%127s %f %f", name, &cost1, &cost2);
+        if (numFields <= 0 || name[0] == '#')
+            continue;
+        if (!strcmp(name, "call") && numFields == 2)
+            mCallCost = cost1;
+        else if (!strcmp(name, "arg") && numFields == 2)
+            mArgCost = cost1;
+        else if (!strcmp(name, "branch") && numFields == 3)
+            SetBranchCosts(cost1, cost2);
+        else if (numFields == 3) {
+            Opcode opcode = opcodeNames.Lookup(name);
+            if (opcode == kOpcode_Unknown)
+                log->WriteWhere(kUtWarning, filename, lineNum,
+                                "Unknown instruction '%s' in cost model",
+                                name);
+            else
+                SetCosts(opcode, cost1, cost2);
+        }
+        else {
+            log->WriteWhere(kUtError, filename, lineNum,
+                            "Malformed cost model entry");
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+// Save the estimates to the specified file.
+bool
+XfCostModel::Save(const char* filename, UtLog* log) const
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        log->Write(kUtError, "Unable to write cost model file '%s'", filename);
+        return false;
+    }
+    fprintf(file, "# PostHaste cost model\n");
+    fprintf(file, "call %g\n", mCallCost);
+    fprintf(file, "arg %g\n", mArgCost);
+    fprintf(file, "branch %g %g\n", mBranchInterpCost, mBranchCompiledCost);
+    for (unsigned int i = 1; i < kOpcode_NumInsts; ++i)
+        fprintf(file, "%s %g %g\n", OpcodeName(static_cast<Opcode>(i)),
+                mInterpCosts[i], mCompiledCosts[i]);
+    bool ok = !ferror(file);
+    fclose(file);
+    if (!ok)
+        log->Write(kUtError, "Error writing cost model file '%s'", filename);
+    return ok;
+}
+
+// Predict the benefit of compiling the given partition.
+float
+XfCostModel::GetBenefit(const IRStmt* stmt) const
+{
+    float interpCost = 0.0f, compiledCost = 0.0f;
+    GetCosts(stmt, &interpCost, &compiledCost);
+    return interpCost - compiledCost - GetCallOverhead(stmt);
+}
+
+// Predict the benefit of compiling the given partition, given its measured
+// interpreted cost.  The estimated compiled cost is scaled by the ratio of
+// the measured and estimated interpreted costs.
+float
+XfCostModel::GetBenefit(const IRStmt* stmt, float measuredCost) const
+{
+    float interpCost = 0.0f, compiledCost = 0.0f;
+    GetCosts(stmt, &interpCost, &compiledCost);
+    if (interpCost > 0.0f)
+        compiledCost *= measuredCost / interpCost;
+    return measuredCost - compiledCost - GetCallOverhead(stmt);
+}
+
+// Get the overhead of calling the given partition as a plugin function.
+float
+XfCostModel::GetCallOverhead(const IRStmt* stmt) const
+{
+    const IRVarSet* freeVars = stmt->GetFreeVars();
+    assert(freeVars && "Partition has no free variable set");
+    IRVars args;
+    freeVars->GetSorted(&args);
+    return mCallCost + mArgCost * args.size();
+}
+
+// Accumulate the estimated interpreted and compiled costs of the given
+// statement, excluding call overhead.
+void
+XfCostModel::GetCosts(const IRStmt* stmt, float* interpCost,
+                      float* compiledCost) const
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock: {
+          const IRInsts& insts = UtStaticCast<const IRBlock*>(stmt)->GetInsts();
+          IRInsts::const_iterator it;
+          for (it = insts.begin(); it != insts.end(); ++it) {
+              Opcode opcode = (*it)->GetOpcode();
+              *interpCost += mInterpCosts[opcode];
+              *compiledCost += mCompiledCosts[opcode];
+          }
+          break;
+      }
+      case kIRSeq: {
+          const IRStmts& stmts = UtStaticCast<const IRSeq*>(stmt)->GetStmts();
+          IRStmts::const_iterator it;
+          for (it = stmts.begin(); it != stmts.end(); ++it)
+              GetCosts(*it, interpCost, compiledCost);
+          break;
+      }
+      case kIRIfStmt: {
+          const IRIfStmt* ifStmt = UtStaticCast<const IRIfStmt*>(stmt);
+          *interpCost += mBranchInterpCost;
+          *compiledCost += mBranchCompiledCost;
+          GetCosts(ifStmt->GetThen(), interpCost, compiledCost);
+          GetCosts(ifStmt->GetElse(), interpCost, compiledCost);
+          break;
+      }
+      case kIRForLoop: {
+          const IRForLoop* loop = UtStaticCast<const IRForLoop*>(stmt);
+          *interpCost += mBranchInterpCost;
+          *compiledCost += mBranchCompiledCost;
+          GetCosts(loop->GetCondStmt(), interpCost, compiledCost);
+          GetCosts(loop->GetIterateStmt(), interpCost, compiledCost);
+          GetCosts(loop->GetBody(), interpCost, compiledCost);
+          break;
+      }
+      case kIRCatchStmt:
+          GetCosts(UtStaticCast<const IRCatchStmt*>(stmt)->GetBody(),
+                   interpCost, compiledCost);
+          break;
+      default:
+          break;
+    }
+}
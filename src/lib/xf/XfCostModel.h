@@ -0,0 +1,103 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_COST_MODEL_H
+#define XF_COST_MODEL_H
+
+#include "ops/Opcode.h"
+class IRStmt;
+class UtLog;
+
+/// Cost model for deciding which partitions to compile.  Each instruction
+/// has an estimated per-point cost when interpreted and when compiled.  A
+/// compiled partition also pays a plugin call overhead, plus an overhead for
+/// each free variable (i.e. each argument that the plugin entry function
+/// iterates over).  A partition is compiled only if the predicted benefit is
+/// positive.
+///
+/// The estimates are in arbitrary units (nominally nanoseconds per point).
+/// The defaults are rough guesses; the phcalibrate tool measures them on the
+/// host machine and writes a file that can be loaded by the model.
+class XfCostModel {
+public:
+    /// Construct a cost model with the default estimates.
+    XfCostModel();
+
+    /// Load estimates from the specified file, which has one entry per line:
+    ///     call <cost>
+    ///     arg <cost>
+    ///     branch <interpreted cost> <compiled cost>
+    ///     <opcode name> <interpreted cost> <compiled cost>
+    /// Blank lines and lines beginning with '#' are ignored.  Instructions
+    /// that are not listed retain their current estimates.  Returns false
+    /// (and reports an error) if the file can't be read or is malformed.
+    bool Load(const char* filename, UtLog* log);
+
+    /// Save the estimates to the specified file (see Load).  Returns false
+    /// (and reports an error) if the file can't be written.
+    bool Save(const char* filename, UtLog* log) const;
+
+    /// Get the estimated per-point cost of an interpreted instruction.
+    float GetInterpCost(Opcode opcode) const { return mInterpCosts[opcode]; }
+
+    /// Get the estimated per-point cost of a compiled instruction.
+    float GetCompiledCost(Opcode opcode) const {
+        return mCompiledCosts[opcode];
+    }
+
+    /// Set the estimated per-point costs of an instruction.
+    void SetCosts(Opcode opcode, float interpCost, float compiledCost) {
+        mInterpCosts[opcode] = interpCost;
+        mCompiledCosts[opcode] = compiledCost;
+    }
+
+    /// Get the overhead of a plugin call.
+    float GetCallCost() const { return mCallCost; }
+
+    /// Set the overhead of a plugin call.
+    void SetCallCost(float cost) { mCallCost = cost; }
+
+    /// Get the per-argument overhead of a plugin call.
+    float GetArgCost() const { return mArgCost; }
+
+    /// Set the per-argument overhead of a plugin call.
+    void SetArgCost(float cost) { mArgCost = cost; }
+
+    /// Set the per-point costs of an interpreted and a compiled branch (for
+    /// "if" statements and loop tests).
+    void SetBranchCosts(float interpCost, float compiledCost) {
+        mBranchInterpCost = interpCost;
+        mBranchCompiledCost = compiledCost;
+    }
+
+    /// Predict the benefit of compiling the given partition, which must have
+    /// a free variable set (see XfFreeVars).  Loop bodies are assumed to
+    /// execute once, since trip counts are not known.
+    float GetBenefit(const IRStmt* stmt) const;
+
+    /// Predict the benefit of compiling the given partition, given its
+    /// measured per-point interpreted cost (e.g. from a profile).  The
+    /// estimated compiled cost is scaled accordingly.
+    float GetBenefit(const IRStmt* stmt, float measuredCost) const;
+
+    /// Check whether the given partition should be compiled, i.e. whether
+    /// the predicted benefit is positive.
+    bool ShouldCompile(const IRStmt* stmt) const {
+        return GetBenefit(stmt) > 0.0f;
+    }
+
+private:
+    float mInterpCosts[kOpcode_NumInsts];
+    float mCompiledCosts[kOpcode_NumInsts];
+    float mCallCost;
+    float mArgCost;
+    float mBranchInterpCost;
+    float mBranchCompiledCost;
+
+    float GetCallOverhead(const IRStmt* stmt) const;
+    void GetCosts(const IRStmt* stmt, float* interpCost,
+                  float* compiledCost) const;
+};
+
+#endif // ndef XF_COST_MODEL_H
@@ -0,0 +1,345 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "xf/XfDataflow.h"
+#include "ir/IRGlobalVar.h"
+#include "ops/OpInfo.h"
+#include "util/UtCast.h"
+#include <string.h>
+
+// Constructor
+XfDataflow::XfDataflow(const IRGlobalVars& globals)
+{
+    IRGlobalVars::const_iterator it;
+    for (it = globals.begin(); it != globals.end(); ++it) {
+        IRGlobalVar* global = *it;
+        if (!strcmp(global->GetFullName(), "L") ||
+            !strcmp(global->GetFullName(), "Cl"))
+            mIllumVars += global;
+    }
+    mIllumEntry.mKill = mIllumVars;
+}
+
+// Destructor
+XfDataflow::~XfDataflow()
+{
+}
+
+// Get the transfer function of the given statement, computing it (and those
+// of its components) if necessary.
+const XfTransfer&
+XfDataflow::GetTransfer(const IRStmt* stmt)
+{
+    TransferMap::iterator it = mTransfers.find(stmt);
+    if (it != mTransfers.end())
+        return it->second;
+    XfTransfer transfer;
+    Dispatch<void>(const_cast<IRStmt*>(stmt), &transfer);
+    return mTransfers.insert(std::make_pair(stmt, transfer)).first->second;
+}
+
+// Compose the transfer function of an instruction with that of the code that
+// follows it: the result and any output arguments that are completely
+// overwritten (i.e. value ignored on input) are killed, and the other
+// arguments are used.
+void
+XfDataflow::PrependInst(Opcode opcode, IRVar* result, const IRValues& args,
+                        XfTransfer* transfer)
+{
+    if (result && CanKill(result)) {
+        transfer->mGen -= result;
+        transfer->mKill += result;
+    }
+
+    // Extra checking is required if the instruction has output arguments.
+    bool noOutputs = !OpInfo::HasOutput(opcode);
+    IRValues::const_iterator it;
+    int i = 0;
+    if (!noOutputs) {
+        for (it = args.begin(); it != args.end(); ++it, ++i) {
+            IRVar* var = UtCast<IRVar*>(*it);
+            if (var && OpInfo::KillsArg(opcode, i) && CanKill(var)) {
+                transfer->mGen -= var;
+                transfer->mKill += var;
+            }
+        }
+    }
+    for (it = args.begin(), i = 0; it != args.end(); ++it, ++i) {
+        if (noOutputs || !OpInfo::KillsArg(opcode, i))
+            transfer->mGen += *it;
+    }
+}
+
+void
+XfDataflow::GetLive(const IRStmt* stmt, IRVarSet* live)
+{
+    GetTransfer(stmt).Apply(live);
+}
+
+void
+XfDataflow::GetLive(const IRInst* inst, IRVarSet* live)
+{
+    XfTransfer transfer;
+    PrependInst(inst->GetOpcode(), inst->GetResult(), inst->GetArgs(),
+                &transfer);
+    transfer.Apply(live);
+}
+
+// Propagate the live variables after the given statement to its components,
+// recording the variables that are live after each.  The worklist holds
+// statements whose live-after sets are known but whose components have not
+// yet been visited.
+void
+XfDataflow::Solve(const IRStmt* stmt, const IRVarSet& liveAfter)
+{
+    mWorklist.push_back(WorkItem(stmt, liveAfter));
+    while (!mWorklist.empty()) {
+        WorkItem item(mWorklist.back());
+        mWorklist.pop_back();
+        IRVarSet& live = mLiveAfter[item.mStmt];
+        live = item.mLive;
+        Dispatch<void>(const_cast<IRStmt*>(item.mStmt),
+                       const_cast<const IRVarSet*>(&live));
+    }
+}
+
+const IRVarSet&
+XfDataflow::GetLiveAfter(const IRStmt* stmt) const
+{
+    LiveMap::const_iterator it = mLiveAfter.find(stmt);
+    assert(it != mLiveAfter.end() && "Statement has not been solved");
+    return it->second;
+}
+
+void
+XfDataflow::GetLiveBefore(const IRStmt* stmt, IRVarSet* live)
+{
+    *live = GetLiveAfter(stmt);
+    GetLive(stmt, live);
+}
+
+// Compute the transfer function of zero or more executions of code with the
+// given transfer function.  Starting with the identity (zero executions),
+// each step adds one more execution:
+//     T' = identity join (iteration followed by T)
+// The sets only grow (and the kill set is always empty), so a fixpoint is
+// reached after a few steps.
+XfTransfer
+XfDataflow::Star(const XfTransfer& iteration)
+{
+    XfTransfer result;
+    while (true) {
+        XfTransfer next(result);
+        next.Prepend(iteration);
+        next.Join(XfTransfer());
+        if (next == result)
+            return result;
+        result = next;
+    }
+}
+
+void
+XfDataflow::Visit(IRBlock* stmt, XfTransfer* transfer)
+{
+    const IRInsts& insts = stmt->GetInsts();
+    IRInsts::const_reverse_iterator it;
+    for (it = insts.rbegin(); it != insts.rend(); ++it) {
+        const IRInst* inst = *it;
+        PrependInst(inst->GetOpcode(), inst->GetResult(), inst->GetArgs(),
+                    transfer);
+    }
+}
+
+void
+XfDataflow::Visit(IRSeq* seq, XfTransfer* transfer)
+{
+    const IRStmts& stmts = seq->GetStmts();
+    IRStmts::const_reverse_iterator it;
+    for (it = stmts.rbegin(); it != stmts.rend(); ++it)
+        transfer->Prepend(GetTransfer(*it));
+}
+
+void
+XfDataflow::Visit(IRIfStmt* stmt, XfTransfer* transfer)
+{
+    *transfer = GetTransfer(stmt->GetThen());
+    transfer->Join(GetTransfer(stmt->GetElse()));
+    transfer->mGen += stmt->GetCond();
+}
+
+// A "for" loop executes the condition statement and tests the condition, then
+// executes the body, iterate statement, and condition statement (and tests
+// the condition again) zero or more times.
+XfTransfer
+XfDataflow::GetIterations(IRForLoop* loop)
+{
+    XfTransfer iteration;
+    iteration.mGen += loop->GetCond();
+    iteration.Prepend(GetTransfer(loop->GetCondStmt()));
+    iteration.Prepend(GetTransfer(loop->GetIterateStmt()));
+    iteration.Prepend(GetTransfer(loop->GetBody()));
+    return Star(iteration);
+}
+
+void
+XfDataflow::Visit(IRForLoop* loop, XfTransfer* transfer)
+{
+    *transfer = GetIterations(loop);
+    transfer->mGen += loop->GetCond();
+    transfer->Prepend(GetTransfer(loop->GetCondStmt()));
+}
+
+void
+XfDataflow::Visit(IRCatchStmt* stmt, XfTransfer* transfer)
+{
+    *transfer = GetTransfer(stmt->GetBody());
+}
+
+void
+XfDataflow::Visit(IRControlStmt* stmt, XfTransfer* transfer)
+{
+    // An accurate answer would include only those variables that are live in
+    // the target of the control statement.  But we don't have that info, so
+    // we conservatively do nothing.
+}
+
+// Each iteration of a gather loop executes either the body or the "else"
+// statement.
+XfTransfer
+XfDataflow::GetIterations(IRGatherLoop* loop)
+{
+    XfTransfer iteration(GetTransfer(loop->GetBody()));
+    iteration.Join(GetTransfer(loop->GetElseStmt()));
+    return Star(iteration);
+}
+
+void
+XfDataflow::Visit(IRGatherLoop* loop, XfTransfer* transfer)
+{
+    // Add the gather arguments.  Some are output arguments (e.g. hit color
+    // might be fetched), but they're conditionally assigned, not
+    // unequivocally killed.
+    *transfer = GetIterations(loop);
+    PrependInst(kOpcode_Gather, NULL, loop->GetArgs(), transfer);
+    transfer->mGen += loop->GetCategory();
+}
+
+// L and Cl are bound on entry to each iteration of an illuminance loop.
+XfTransfer
+XfDataflow::GetIterations(IRIlluminanceLoop* loop)
+{
+    XfTransfer iteration(GetTransfer(loop->GetBody()));
+    iteration.Prepend(mIllumEntry);
+    return Star(iteration);
+}
+
+void
+XfDataflow::Visit(IRIlluminanceLoop* loop, XfTransfer* transfer)
+{
+    // Add the illuminance arguments.  Some are output arguments (e.g. light
+    // parameters might be fetched), but they're conditionally assigned, not
+    // unequivocally killed.
+    *transfer = GetIterations(loop);
+    PrependInst(kOpcode_Illuminance, NULL, loop->GetArgs(), transfer);
+    transfer->mGen += loop->GetCategory();
+}
+
+void
+XfDataflow::Visit(IRIlluminateStmt* stmt, XfTransfer* transfer)
+{
+    *transfer = GetTransfer(stmt->GetBody());
+    transfer->Prepend(mIllumEntry);
+    PrependInst(kOpcode_Illuminate, NULL, stmt->GetArgs(), transfer);
+}
+
+void
+XfDataflow::Visit(IRPluginCall* call, XfTransfer* transfer)
+{
+    PrependInst(kOpcode_CallDSO, call->GetResult(), call->GetArgs(),
+                transfer);
+}
+
+void
+XfDataflow::Visit(IRBlock* stmt, const IRVarSet* liveAfter)
+{
+}
+
+void
+XfDataflow::Visit(IRSeq* seq, const IRVarSet* liveAfter)
+{
+    IRVarSet live(*liveAfter);
+    const IRStmts& stmts = seq->GetStmts();
+    IRStmts::const_reverse_iterator it;
+    for (it = stmts.rbegin(); it != stmts.rend(); ++it) {
+        mWorklist.push_back(WorkItem(*it, live));
+        GetLive(*it, &live);
+    }
+}
+
+void
+XfDataflow::Visit(IRIfStmt* stmt, const IRVarSet* liveAfter)
+{
+    mWorklist.push_back(WorkItem(stmt->GetThen(), *liveAfter));
+    mWorklist.push_back(WorkItem(stmt->GetElse(), *liveAfter));
+}
+
+void
+XfDataflow::Visit(IRForLoop* loop, const IRVarSet* liveAfter)
+{
+    // The variables that are live after the condition statement (whether it
+    // precedes the loop or ends an iteration) are those that are live when
+    // the condition is tested.
+    IRVarSet live(*liveAfter);
+    GetIterations(loop).Apply(&live);
+    live += loop->GetCond();
+    mWorklist.push_back(WorkItem(loop->GetCondStmt(), live));
+
+    // The iterate statement is followed by the condition statement, which is
+    // preceded by the body.
+    GetLive(loop->GetCondStmt(), &live);
+    mWorklist.push_back(WorkItem(loop->GetIterateStmt(), live));
+    GetLive(loop->GetIterateStmt(), &live);
+    mWorklist.push_back(WorkItem(loop->GetBody(), live));
+}
+
+void
+XfDataflow::Visit(IRCatchStmt* stmt, const IRVarSet* liveAfter)
+{
+    mWorklist.push_back(WorkItem(stmt->GetBody(), *liveAfter));
+}
+
+void
+XfDataflow::Visit(IRControlStmt* stmt, const IRVarSet* liveAfter)
+{
+}
+
+void
+XfDataflow::Visit(IRGatherLoop* loop, const IRVarSet* liveAfter)
+{
+    // The body and "else" statement are followed by another iteration or the
+    // end of the loop.
+    IRVarSet live(*liveAfter);
+    GetIterations(loop).Apply(&live);
+    mWorklist.push_back(WorkItem(loop->GetBody(), live));
+    mWorklist.push_back(WorkItem(loop->GetElseStmt(), live));
+}
+
+void
+XfDataflow::Visit(IRIlluminanceLoop* loop, const IRVarSet* liveAfter)
+{
+    IRVarSet live(*liveAfter);
+    GetIterations(loop).Apply(&live);
+    mWorklist.push_back(WorkItem(loop->GetBody(), live));
+}
+
+void
+XfDataflow::Visit(IRIlluminateStmt* stmt, const IRVarSet* liveAfter)
+{
+    mWorklist.push_back(WorkItem(stmt->GetBody(), *liveAfter));
+}
+
+void
+XfDataflow::Visit(IRPluginCall* call, const IRVarSet* liveAfter)
+{
+}
@@ -0,0 +1,173 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_DATAFLOW_H
+#define XF_DATAFLOW_H
+
+#include "ir/IRTypedefs.h"
+#include "ir/IRVarSet.h"
+#include "ir/IRVisitor.h"
+#include "ops/Opcode.h"
+#include <map>
+#include <vector>
+
+/**
+   The effect of a statement on the set of variables that are live after it,
+   expressed as the variables it might use before defining them (gen) and the
+   variables it always defines (kill):
+       liveBefore = gen + (liveAfter - kill)
+*/
+class XfTransfer {
+public:
+    IRVarSet mGen, mKill;
+
+    /// Apply the transfer function to the set of variables that are live
+    /// after the statement, yielding those that are live before it.
+    void Apply(IRVarSet* live) const {
+        *live -= mKill;
+        *live += mGen;
+    }
+
+    /// Compose with the transfer function of a statement that executes
+    /// before this one.
+    void Prepend(const XfTransfer& before) {
+        mGen -= before.mKill;
+        mGen += before.mGen;
+        mKill += before.mKill;
+    }
+
+    /// Join with the transfer function of an alternative path (e.g. the other
+    /// branch of an "if" statement).
+    void Join(const XfTransfer& other) {
+        mGen += other.mGen;
+        mKill.Intersect(other.mKill);
+    }
+
+    /// Check whether two transfer functions are the same.
+    bool operator==(const XfTransfer& other) const {
+        return mGen == other.mGen && mKill == other.mKill;
+    }
+};
+
+/**
+   Backward dataflow analysis of structured IR (e.g. live variables).
+
+   The transfer function of each statement is computed bottom-up from those
+   of its components, and memoized, so each statement is summarized once.
+   The transfer function of a loop is the fixpoint of its iterations, which
+   is reached by iterating the (already summarized) transfer function of the
+   loop body rather than re-analyzing the body, so the cost is linear even
+   for deeply nested loops.
+
+   Solve() then propagates the live variables after a statement down to its
+   components using a worklist, recording the variables that are live after
+   every statement.
+
+   Statements must not be modified while the analysis is in use.  Methods
+   are all public for testing.
+*/
+class XfDataflow : public IRVisitor<XfDataflow> {
+public:
+    /// Construct a dataflow analysis.  The L and Cl variables among the
+    /// given globals are bound on entry to illuminance and illuminate
+    /// bodies.
+    XfDataflow(const IRGlobalVars& globals);
+
+    /// Destructor.
+    virtual ~XfDataflow();
+
+    /// Get the variables bound on entry to illuminance and illuminate bodies.
+    const IRVarSet& GetIllumVars() const { return mIllumVars; }
+
+    /// Get the transfer function of the given statement.
+    const XfTransfer& GetTransfer(const IRStmt* stmt);
+
+    /// Compose the transfer function of an instruction (given its opcode,
+    /// result, and arguments) with a transfer function of the code that
+    /// follows it.
+    void PrependInst(Opcode opcode, IRVar* result, const IRValues& args,
+                     XfTransfer* transfer);
+
+    /// Given the variables that are live after a statement, compute those
+    /// that are live before it.
+    void GetLive(const IRStmt* stmt, IRVarSet* live);
+
+    /// Given the variables that are live after an instruction, compute those
+    /// that are live before it.
+    void GetLive(const IRInst* inst, IRVarSet* live);
+
+    /// Given the variables that are live after a statement, record the
+    /// variables that are live after each of its component statements.
+    void Solve(const IRStmt* stmt, const IRVarSet& liveAfter);
+
+    /// Get the variables that are live after a solved statement.
+    const IRVarSet& GetLiveAfter(const IRStmt* stmt) const;
+
+    /// Get the variables that are live before a solved statement.
+    void GetLiveBefore(const IRStmt* stmt, IRVarSet* live);
+
+    // Summarize statements.
+    void Visit(IRBlock* stmt, XfTransfer* transfer);
+    void Visit(IRSeq* stmt, XfTransfer* transfer);
+    void Visit(IRIfStmt* stmt, XfTransfer* transfer);
+    void Visit(IRForLoop* stmt, XfTransfer* transfer);
+    void Visit(IRCatchStmt* stmt, XfTransfer* transfer);
+    void Visit(IRControlStmt* stmt, XfTransfer* transfer);
+    void Visit(IRGatherLoop* stmt, XfTransfer* transfer);
+    void Visit(IRIlluminanceLoop* stmt, XfTransfer* transfer);
+    void Visit(IRIlluminateStmt* stmt, XfTransfer* transfer);
+    void Visit(IRPluginCall* stmt, XfTransfer* transfer);
+
+    // Propagate the live variables after a statement to its components.
+    void Visit(IRBlock* stmt, const IRVarSet* liveAfter);
+    void Visit(IRSeq* stmt, const IRVarSet* liveAfter);
+    void Visit(IRIfStmt* stmt, const IRVarSet* liveAfter);
+    void Visit(IRForLoop* stmt, const IRVarSet* liveAfter);
+    void Visit(IRCatchStmt* stmt, const IRVarSet* liveAfter);
+    void Visit(IRControlStmt* stmt, const IRVarSet* liveAfter);
+    void Visit(IRGatherLoop* stmt, const IRVarSet* liveAfter);
+    void Visit(IRIlluminanceLoop* stmt, const IRVarSet* liveAfter);
+    void Visit(IRIlluminateStmt* stmt, const IRVarSet* liveAfter);
+    void Visit(IRPluginCall* stmt, const IRVarSet* liveAfter);
+
+    // Get the transfer function of zero or more iterations of a loop.
+    XfTransfer GetIterations(IRForLoop* loop);
+    XfTransfer GetIterations(IRGatherLoop* loop);
+    XfTransfer GetIterations(IRIlluminanceLoop* loop);
+
+    /// Compute the transfer function of zero or more executions of code with
+    /// the given transfer function, iterating to a fixpoint.
+    static XfTransfer Star(const XfTransfer& iteration);
+
+protected:
+    /// Check whether an assignment to the given variable kills it.  The
+    /// default is true; a derived class can override it to keep certain
+    /// variables live (e.g. those that are live after the shader executes).
+    virtual bool CanKill(const IRVar* var) const { return true; }
+
+private:
+    typedef std::map<const IRStmt*, XfTransfer> TransferMap;
+    typedef std::map<const IRStmt*, IRVarSet> LiveMap;
+
+    // A statement awaiting propagation, with the variables live after it.
+    struct WorkItem {
+        const IRStmt* mStmt;
+        IRVarSet mLive;
+
+        WorkItem(const IRStmt* stmt, const IRVarSet& live) :
+            mStmt(stmt),
+            mLive(live)
+        {
+        }
+    };
+    typedef std::vector<WorkItem> Worklist;
+
+    XfTransfer mIllumEntry;     // Kills L and Cl
+    IRVarSet mIllumVars;        // L and Cl
+    TransferMap mTransfers;     // Memoized transfer functions
+    LiveMap mLiveAfter;         // Live variables after solved statements
+    Worklist mWorklist;         // Statements awaiting propagation
+};
+
+#endif // ndef XF_DATAFLOW_H
@@ -0,0 +1,120 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "xf/XfDefUse.h"
+#include "ir/IRInst.h"
+#include "ir/IRStmts.h"
+#include "ops/OpInfo.h"
+
+void
+XfDefUse::GetInstDefs(const IRInst* inst, IRVarSet* defs)
+{
+    if (inst->GetResult())
+        *defs += inst->GetResult();
+    Opcode opcode = inst->GetOpcode();
+    if (OpInfo::HasOutput(opcode)) {
+        const IRValues& args = inst->GetArgs();
+        for (unsigned int i = 0; i < args.size(); ++i)
+            if (OpInfo::IsOutput(opcode, i))
+                *defs += args[i];
+    }
+}
+
+void
+XfDefUse::AddInst(const IRInst* inst)
+{
+    ++mNumInsts;
+    GetInstDefs(inst, &mDefs);
+    mUses += inst->GetArgs();
+}
+
+void
+XfDefUse::Add(const IRStmt* stmt)
+{
+    // The visitor doesn't modify the statement.
+    Dispatch<void>(const_cast<IRStmt*>(stmt), 0);
+}
+
+void
+XfDefUse::Visit(IRBlock* block, int ignored)
+{
+    const IRInsts& insts = block->GetInsts();
+    IRInsts::const_iterator it;
+    for (it = insts.begin(); it != insts.end(); ++it)
+        AddInst(*it);
+}
+
+void
+XfDefUse::Visit(IRSeq* seq, int ignored)
+{
+    const IRStmts& stmts = seq->GetStmts();
+    IRStmts::const_iterator it;
+    for (it = stmts.begin(); it != stmts.end(); ++it)
+        Dispatch<void>(*it, 0);
+}
+
+void
+XfDefUse::Visit(IRIfStmt* stmt, int ignored)
+{
+    mUses += stmt->GetCond();
+    Dispatch<void>(stmt->GetThen(), 0);
+    Dispatch<void>(stmt->GetElse(), 0);
+}
+
+void
+XfDefUse::Visit(IRForLoop* loop, int ignored)
+{
+    mUses += loop->GetCond();
+    Dispatch<void>(loop->GetCondStmt(), 0);
+    Dispatch<void>(loop->GetIterateStmt(), 0);
+    Dispatch<void>(loop->GetBody(), 0);
+}
+
+void
+XfDefUse::Visit(IRCatchStmt* stmt, int ignored)
+{
+    Dispatch<void>(stmt->GetBody(), 0);
+}
+
+void
+XfDefUse::Visit(IRControlStmt* stmt, int ignored)
+{
+    mHasControl = true;
+}
+
+void
+XfDefUse::Visit(IRGatherLoop* loop, int ignored)
+{
+    mHasOpaque = true;
+    mUses += loop->GetCategory();
+    mUses += loop->GetArgs();
+    Dispatch<void>(loop->GetBody(), 0);
+    Dispatch<void>(loop->GetElseStmt(), 0);
+}
+
+void
+XfDefUse::Visit(IRIlluminanceLoop* loop, int ignored)
+{
+    mHasOpaque = true;
+    if (loop->GetCategory())
+        mUses += loop->GetCategory();
+    mUses += loop->GetArgs();
+    Dispatch<void>(loop->GetBody(), 0);
+}
+
+void
+XfDefUse::Visit(IRIlluminateStmt* stmt, int ignored)
+{
+    mHasOpaque = true;
+    mUses += stmt->GetArgs();
+    Dispatch<void>(stmt->GetBody(), 0);
+}
+
+void
+XfDefUse::Visit(IRPluginCall* call, int ignored)
+{
+    mHasOpaque = true;
+    mDefs += call->GetResult();
+    mUses += call->GetArgs();
+}
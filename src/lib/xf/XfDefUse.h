@@ -0,0 +1,83 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_DEF_USE_H
+#define XF_DEF_USE_H
+
+#include "ir/IRTypedefs.h"
+#include "ir/IRVarSet.h"
+#include "ir/IRVisitor.h"
+
+/**
+   Collects the variables that instructions and statements might define and
+   use, which is all that many transformations need to know about a piece
+   of code (a full dataflow analysis is provided by XfDataflow).  The result
+   and output arguments of an instruction are defined.  Output arguments are
+   also used, since they might be partially or conditionally assigned.
+
+   Some statements define variables implicitly: illuminance and illuminate
+   statements bind L and Cl, gather loops bind ray hit values, and the
+   output arguments of plugin calls are unknown.  Their explicit arguments
+   are recorded, and HasOpaque() reports that the definitions are
+   incomplete.  HasControl() reports break, continue and return statements,
+   which change which points execute the code that follows.
+
+   A subclass can override AddInst to examine each instruction (e.g. its
+   side effects), calling the base class method to record its variables.
+*/
+class XfDefUse : public IRVisitor<XfDefUse> {
+public:
+    /// Construct an empty summary.
+    XfDefUse() : mNumInsts(0), mHasControl(false), mHasOpaque(false) { }
+
+    /// Destructor.
+    virtual ~XfDefUse() { }
+
+    /// Add the variables of an instruction.
+    virtual void AddInst(const IRInst* inst);
+
+    /// Add the variables of a statement.
+    void Add(const IRStmt* stmt);
+
+    /// Get the variables that might be defined.
+    const IRVarSet& GetDefs() const { return mDefs; }
+
+    /// Get the variables that might be used.
+    const IRVarSet& GetUses() const { return mUses; }
+
+    /// Get the number of instructions.
+    int GetNumInsts() const { return mNumInsts; }
+
+    /// Check whether a break, continue or return statement was added.
+    bool HasControl() const { return mHasControl; }
+
+    /// Check whether a statement that defines variables implicitly (see
+    /// above) was added.
+    bool HasOpaque() const { return mHasOpaque; }
+
+    /// Collect the variables that an instruction assigns (its result and
+    /// output arguments), without constructing a summary.
+    static void GetInstDefs(const IRInst* inst, IRVarSet* defs);
+
+    // Add the variables of each kind of statement.
+    void Visit(IRBlock* stmt, int ignored);
+    void Visit(IRSeq* stmt, int ignored);
+    void Visit(IRIfStmt* stmt, int ignored);
+    void Visit(IRForLoop* stmt, int ignored);
+    void Visit(IRCatchStmt* stmt, int ignored);
+    void Visit(IRControlStmt* stmt, int ignored);
+    void Visit(IRGatherLoop* stmt, int ignored);
+    void Visit(IRIlluminanceLoop* stmt, int ignored);
+    void Visit(IRIlluminateStmt* stmt, int ignored);
+    void Visit(IRPluginCall* stmt, int ignored);
+
+private:
+    IRVarSet mDefs;
+    IRVarSet mUses;
+    int mNumInsts;
+    bool mHasControl;
+    bool mHasOpaque;
+};
+
+#endif // ndef XF_DEF_USE_H
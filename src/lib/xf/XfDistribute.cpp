@@ -0,0 +1,145 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "xf/XfDistribute.h"
+#include "ir/IRType.h"
+#include "ir/IRVar.h"
+#include <algorithm>
+
+void
+XfDistribute::Add(const IRStmt* stmt, bool isCompiled)
+{
+    mItems.Add(stmt, isCompiled);
+    mIsCompiled.push_back(isCompiled);
+}
+
+// Check whether a variable can be carried from one loop to the other in a
+// temporary array.
+static bool
+IsCarriable(const IRVar* var)
+{
+    const IRType* type = var->GetType();
+    return !type->IsArray() && !type->IsString() && !type->IsStruct();
+}
+
+// Split the items with the compiled loop first or second, returning the
+// number of instructions in the compiled loop, or zero if the split is not
+// profitable.
+int
+XfDistribute::TrySplit(bool compiledFirst, std::vector<bool>* inCompiled,
+                       IRVarSet* startVars, IRVarSet* endVars) const
+{
+    size_t n = mItems.GetSize();
+    std::vector<bool>& compiled = *inCompiled;
+    compiled = mIsCompiled;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        *startVars = IRVarSet();
+        *endVars = IRVarSet();
+
+        // Collect the variables referenced by each loop.
+        IRVarSet compiledDefs, compiledUses, interpDefs, interpUses;
+        for (size_t i = 0; i < n; ++i) {
+            if (compiled[i]) {
+                compiledDefs += mItems.GetDefs(i);
+                compiledUses += mItems.GetUses(i);
+            }
+            else {
+                interpDefs += mItems.GetDefs(i);
+                interpUses += mItems.GetUses(i);
+            }
+        }
+
+        // The second loop must not assign a variable that the first loop
+        // references.  Items only move from the compiled loop to the
+        // interpreted loop, so this terminates.
+        for (size_t i = 0; i < n; ++i) {
+            if (!compiled[i])
+                continue;
+            const IRVarSet& defs = mItems.GetDefs(i);
+            bool conflicts = defs.Intersects(interpDefs) ||
+                (compiledFirst ? mItems.GetUses(i).Intersects(interpDefs)
+                               : defs.Intersects(interpUses));
+            if (conflicts) {
+                compiled[i] = false;
+                changed = true;
+            }
+        }
+        if (changed)
+            continue;
+
+        // Find the variables carried from the first loop to the second, and
+        // check whether their uses precede or follow their assignments.
+        IRVarSet carried(compiledFirst ? interpUses : compiledUses);
+        carried.Intersect(compiledFirst ? compiledDefs : interpDefs);
+        for (IRVarSet::const_iterator it = carried.begin();
+             it != carried.end(); ++it) {
+            IRVar* var = *it;
+            size_t firstDef = n, lastDef = 0, firstUse = n, lastUse = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (compiled[i] == compiledFirst) {
+                    if (mItems.GetDefs(i).Has(var)) {
+                        firstDef = std::min(firstDef, i);
+                        lastDef = i;
+                    }
+                }
+                else if (mItems.GetUses(i).Has(var)) {
+                    firstUse = std::min(firstUse, i);
+                    lastUse = i;
+                }
+            }
+            if (IsCarriable(var) && lastUse < firstDef)
+                *startVars += var;
+            else if (IsCarriable(var) && firstUse > lastDef)
+                *endVars += var;
+            else {
+                // The compiled items that reference the variable are
+                // interpreted instead.
+                for (size_t i = 0; i < n; ++i) {
+                    const IRVarSet& refs = compiledFirst ? mItems.GetDefs(i)
+                                                         : mItems.GetUses(i);
+                    if (compiled[i] && refs.Has(var)) {
+                        compiled[i] = false;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Each carried variable adds an interpreted instruction to each
+    // iteration, which must be outweighed by the compiled instructions.
+    int numInsts = 0, numCarried = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (compiled[i])
+            numInsts += mItems.GetNumInsts(i);
+    IRVarSet carried(*startVars);
+    carried += *endVars;
+    for (IRVarSet::const_iterator it = carried.begin(); it != carried.end();
+         ++it)
+        ++numCarried;
+    return numInsts > numCarried ? numInsts : 0;
+}
+
+bool
+XfDistribute::Split()
+{
+    for (size_t i = 0; i < mItems.GetSize(); ++i)
+        if (mItems.GetEffect(i) == kXfBarrier)
+            return false;
+
+    // Try both orders, preferring the one with the larger compiled loop.
+    std::vector<bool> inCompiled;
+    IRVarSet startVars, endVars;
+    int compiledFirst = TrySplit(true, &mInCompiled, &mStartVars, &mEndVars);
+    int compiledSecond = TrySplit(false, &inCompiled, &startVars, &endVars);
+    mCompiledFirst = compiledFirst >= compiledSecond;
+    if (!mCompiledFirst) {
+        mInCompiled.swap(inCompiled);
+        mStartVars = startVars;
+        mEndVars = endVars;
+    }
+    return std::max(compiledFirst, compiledSecond) > 0;
+}
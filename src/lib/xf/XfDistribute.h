@@ -0,0 +1,78 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_DISTRIBUTE_H
+#define XF_DISTRIBUTE_H
+
+#include "xf/XfSchedule.h"
+#include <vector>
+
+/**
+   Loop distribution (fission) analysis, which splits the body of a loop
+   that is only partially compilable into a compiled loop and an
+   interpreted loop with the same number of iterations.
+
+   The items (i.e. the statements of the loop body, followed by its iterate
+   statement) are added in program order, each marked as compiled or
+   interpreted.  Split() decides which items go in which loop, and which
+   loop executes first.  Compiled items are moved to the interpreted loop
+   as necessary, so that the second loop never assigns a variable that the
+   first loop references.  The variables assigned by the first loop and
+   used by the second are carried: the first loop saves their values in
+   temporary arrays, indexed by iteration, which the second loop reads.
+
+   The second loop must see the value that each carried variable had at
+   the point of its uses in the original loop.  If the uses precede every
+   assignment in program order, that's the value at the start of the
+   iteration (e.g. an amplitude that is halved at the end of each octave);
+   if they follow every assignment, it's the value at the end of the
+   iteration.  Otherwise the items are not split.  Arrays and strings are
+   not carried.
+
+   Items containing barriers (e.g. lighting, or break and continue
+   statements) prevent distribution, as does a compiled loop that would
+   execute no more instructions than the number of carried variables.
+*/
+class XfDistribute {
+public:
+    /// Construct an empty loop distribution.
+    XfDistribute() : mCompiledFirst(true) { }
+
+    /// Add a loop body statement, which is compiled or interpreted.
+    void Add(const IRStmt* stmt, bool isCompiled);
+
+    /// Get the number of items.
+    size_t GetSize() const { return mItems.GetSize(); }
+
+    /// Split the items between a compiled loop and an interpreted loop,
+    /// returning false if that's not possible or not profitable.
+    bool Split();
+
+    /// Check whether the compiled loop executes first (after Split).
+    bool IsCompiledFirst() const { return mCompiledFirst; }
+
+    /// Check whether an item belongs to the compiled loop (after Split).
+    bool InCompiledLoop(size_t i) const { return mInCompiled[i]; }
+
+    /// Get the carried variables whose values at the start of each
+    /// iteration are saved by the first loop (after Split).
+    const IRVarSet& GetStartVars() const { return mStartVars; }
+
+    /// Get the carried variables whose values at the end of each iteration
+    /// are saved by the first loop (after Split).
+    const IRVarSet& GetEndVars() const { return mEndVars; }
+
+private:
+    XfSchedule mItems;
+    std::vector<bool> mIsCompiled;
+    bool mCompiledFirst;
+    std::vector<bool> mInCompiled;
+    IRVarSet mStartVars;
+    IRVarSet mEndVars;
+
+    int TrySplit(bool compiledFirst, std::vector<bool>* inCompiled,
+                 IRVarSet* startVars, IRVarSet* endVars) const;
+};
+
+#endif // ndef XF_DISTRIBUTE_H
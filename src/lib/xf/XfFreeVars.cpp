@@ -6,23 +6,34 @@
 #include "ir/IRGlobalVar.h"
 #include "ir/IRShader.h"
 #include "ir/IRShaderParam.h"
-#include "ir/IRGlobalVar.h"
 #include "ir/IRVarSet.h"
-#include "ops/OpInfo.h"
 #include "util/UtCast.h"
-#include <iostream>
 
 // Given a partitioned shader, attach a free variable set to the root
 // statement of each partition.
 void 
 XfFreeVars(IRShader* shader)
 {
-    XfFreeVarsImpl().Analyze(shader);
+    XfFreeVarsImpl(shader->GetGlobals()).Analyze(shader);
+}
+
+// Assignments don't kill globals or output shader parameters.
+bool
+XfFreeVarsLiveness::CanKill(const IRVar* var) const
+{
+    if (const IRShaderParam* param = UtCast<const IRShaderParam*>(var))
+        return !param->IsOutput();
+    return !UtIsInstance<const IRGlobalVar*>(var);
 }
 
 XfFreeVarsImpl::XfFreeVarsImpl() :
-    mGlobalL(NULL),
-    mGlobalCl(NULL),
+    mLiveness(IRGlobalVars()),
+    mInPartition(false)
+{
+}
+
+XfFreeVarsImpl::XfFreeVarsImpl(const IRGlobalVars& globals) :
+    mLiveness(globals),
     mInPartition(false)
 {
 }
@@ -38,297 +49,162 @@ XfFreeVarsImpl::Analyze(IRShader* shader)
         if ((*param)->IsOutput())
             live += *param;
 
-    // Globals are also live afterwards.  Keep track of the global L and Cl
-    // variables (if present), since they have special lifetimes.
-    const IRGlobalVars& globals = shader->GetGlobals();
-    IRGlobalVars::const_iterator g;
-    for (g = globals.begin(); g != globals.end(); ++g) {
-        IRGlobalVar* global = *g;
-        live += global;
-        if (!strcmp(global->GetFullName(), "L"))
-            mGlobalL = global;
-        else if (!strcmp(global->GetFullName(), "Cl"))
-            mGlobalCl = global;
-    }
+    // Globals are also live afterwards.
+    live += shader->GetGlobals();
+
+    // Shader parameter initializers (if they were partitioned) are followed
+    // by the rest of the initializers and the body, so every parameter is
+    // live afterwards.
+    IRVarSet initLive(live);
+    for (param = params.begin(); param != params.end(); ++param)
+        initLive += *param;
+
+    // Compute the variables that are live after every statement in the body
+    // and the parameter initializers.
+    mLiveness.Solve(shader->GetBody(), live);
+    for (param = params.begin(); param != params.end(); ++param)
+        mLiveness.Solve((*param)->GetInitStmt(), initLive);
 
     // Analyze the body of the shader, attaching free variable set to the root
-    // statement of each partition.
-    Analyze(shader->GetBody(), &live);
+    // statement of each partition.  Then do the same for the parameter
+    // initializers.
+    IRVarSet refs;
+    Analyze(shader->GetBody(), &refs);
+    for (param = params.begin(); param != params.end(); ++param)
+        Analyze((*param)->GetInitStmt(), &refs);
 }
 
-XfFreeVarsImpl::FreeVars 
-XfFreeVarsImpl::Analyze(IRStmt* stmt, IRVarSet* live)
+// Add the variables referenced by the given statement to the given set.  If
+// the statement is the root of a compilable partition, attach the set of its
+// free variables: those it references that are live before it (inputs) or
+// after it (outputs).  The statement must have been solved.
+void
+XfFreeVarsImpl::Analyze(IRStmt* stmt, IRVarSet* refs)
 {
     // Check whether this statement is the root of a compilable partition.
     bool isPartition = !mInPartition && stmt->CanCompile();
     if (isPartition)
         mInPartition = true;
 
-    // Analyze the statement.
-    FreeVars freeVars = Dispatch<FreeVars>(const_cast<IRStmt*>(stmt), live); 
+    // Collect the variables referenced by the statement.
+    IRVarSet stmtRefs;
+    Dispatch<void>(stmt, &stmtRefs);
 
-    // If this is a partition root, attach a set of free variables.  Note loop
-    // bodies are analyzed twice, so any existing free variable set is
-    // discarded.
+    // If this is a partition root, attach a set of free variables, replacing
+    // any existing set (e.g. from an earlier analysis).
     if (isPartition) {
+        IRVarSet* freeSet = new IRVarSet;
+        mLiveness.GetLiveBefore(stmt, freeSet);
+        *freeSet += mLiveness.GetLiveAfter(stmt);
+        freeSet->Intersect(stmtRefs);
         delete stmt->TakeFreeVars();
-        IRVarSet* freeSet = new IRVarSet(freeVars.mInputs);
-        *freeSet += freeVars.mOutputs;
         stmt->SetFreeVars(freeSet);
         mInPartition = false;
     }
-    return freeVars;
+    *refs += stmtRefs;
 }
 
-XfFreeVarsImpl::FreeVars 
-XfFreeVarsImpl::Analyze(const IRInst* inst, IRVarSet* live)
+void
+XfFreeVarsImpl::GetLive(const IRStmt* stmt, IRVarSet* live)
 {
-    return Analyze(inst->GetOpcode(), inst->GetResult(), inst->GetArgs(), live);
+    mLiveness.GetLive(stmt, live);
 }
 
-// Remove the given variable from the live variable set, unless it's a global
-// or a shader output parameter.
-static void
-Kill(const IRVar* var, IRVarSet* live)
-{
-    if (const IRShaderParam* param = UtCast<const IRShaderParam*>(var)) {
-        if (!param->IsOutput())
-            *live -= var;
-    }
-    else if (!UtIsInstance<const IRGlobalVar*>(var))
-        *live -= var;
-}
-
-
-// Add any variables in the argument list to the live variable set, unless
-// they're outputs that are killed (i.e. value ignored on input; completely
-// overwritten on output).  Returns the sets of input and output variables.
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Analyze(Opcode opcode, IRVar* result, const IRValues& args,
-                        IRVarSet* live)
+void
+XfFreeVarsImpl::GetLive(const IRInst* inst, IRVarSet* live)
 {
-    FreeVars freeVars;
-
-    // Kill the result variable (if any).  It might be added back if it's
-    // referenced in the arguments.
-    if (result) {
-        Kill(result, live);
-        freeVars.mOutputs += result;
-    }
-
-    // Extra checking is required if the instruction has output arguments.
-    bool hasOutput = OpInfo::HasOutput(opcode);
-
-    IRValues::const_iterator it;
-    int i = 0;
-    for (it = args.begin(); it != args.end(); ++it, ++i) {
-        if (IRVar* var = UtCast<IRVar*>(*it)) {
-            if (hasOutput && OpInfo::IsOutput(opcode, i)) {
-                freeVars.mOutputs += var;
-                if (OpInfo::KillsArg(opcode, i))
-                    Kill(var, live);
-                else {
-                    *live += var;
-                    freeVars.mInputs += var;
-                }
-            }
-            else {
-                *live += var;
-                freeVars.mInputs += var;
-            }
-        }
-    }
-    return freeVars;
+    mLiveness.GetLive(inst, live);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRBlock* stmt, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRBlock* stmt, IRVarSet* refs)
 {
-    FreeVars freeVars;
-    IRVarSet liveAfter = *live;
     const IRInsts& insts = stmt->GetInsts();
-    IRInsts::const_reverse_iterator it;
-    for (it = insts.rbegin(); it != insts.rend(); ++it) {
-        freeVars += Analyze(*it, live);
+    IRInsts::const_iterator it;
+    for (it = insts.begin(); it != insts.end(); ++it) {
+        const IRInst* inst = *it;
+        if (inst->GetResult())
+            *refs += inst->GetResult();
+        *refs += inst->GetArgs();
     }
-    freeVars.Prune(*live, liveAfter);
-    return freeVars;
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRSeq* seq, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRSeq* seq, IRVarSet* refs)
 {
-    FreeVars freeVars;
-    IRVarSet liveAfter = *live;
     const IRStmts& stmts = seq->GetStmts();
-    IRStmts::const_reverse_iterator it;
-    for (it = stmts.rbegin(); it != stmts.rend(); ++it) {
-        freeVars += Analyze(*it, live);
-    }
-    freeVars.Prune(*live, liveAfter);
-    return freeVars;
+    IRStmts::const_iterator it;
+    for (it = stmts.begin(); it != stmts.end(); ++it)
+        Analyze(*it, refs);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::AnalyzeBranch(IRStmt* thenStmt, IRStmt* elseStmt,
-                              IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRIfStmt* stmt, IRVarSet* refs)
 {
-    // Compute live variables in the "else" branch using a copy of the
-    // variables that are live after the "if" statement.
-    IRVarSet liveElse = *live;
-    FreeVars freeVars = Analyze(elseStmt, &liveElse);
-
-    // Compute the live variables in the "then" branch and union those from
-    // the "else" branch.
-    freeVars += Analyze(thenStmt, live);
-    *live += liveElse;
-    return freeVars;
+    *refs += stmt->GetCond();
+    Analyze(stmt->GetThen(), refs);
+    Analyze(stmt->GetElse(), refs);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRIfStmt* stmt, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRForLoop* loop, IRVarSet* refs)
 {
-    FreeVars freeVars = AnalyzeBranch(stmt->GetThen(), stmt->GetElse(), live);
-    *live += stmt->GetCond();
-    freeVars.mInputs += stmt->GetCond();
-    return freeVars;
+    Analyze(loop->GetCondStmt(), refs);
+    *refs += loop->GetCond();
+    Analyze(loop->GetBody(), refs);
+    Analyze(loop->GetIterateStmt(), refs);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRForLoop* loop, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRCatchStmt* stmt, IRVarSet* refs)
 {
-    IRVarSet liveAfter = *live;
-
-    // The loop might not execute at all, except for the condition statement,
-    // so we compute the live variables of the "iterate" statement and the
-    // loop body in a copy of the set of variables that are live after the
-    // loop.  Note that the loop body might kill variables that are live in
-    // the iterate statement.
-    IRVarSet liveInLoop = *live;
-    Analyze(loop->GetIterateStmt(), &liveInLoop);
-    Analyze(loop->GetBody(), &liveInLoop);
-
-    // Add the condition variable and compute live variables in the condition
-    // statement (which might kill the condition variable).
-    *live += loop->GetCond();
-    Analyze(loop->GetCondStmt(), &liveInLoop);
-
-    // Variables from one iteration (including the loop condition) are live in
-    // the previous iteration, so we must re-analyze the loop.
-    FreeVars freeVars = Analyze(loop->GetIterateStmt(), &liveInLoop);
-    freeVars += Analyze(loop->GetBody(), &liveInLoop);
-
-    // Union the "live after" set with the loop's live variables, since
-    // the loop might not execute at all, and then add the loop condition.
-    *live += liveInLoop;
-    *live += loop->GetCond();
-    freeVars.mInputs += loop->GetCond();
-    freeVars += Analyze(loop->GetCondStmt(), live);
-    freeVars.Prune(*live, liveAfter);
-    return freeVars;
+    Analyze(stmt->GetBody(), refs);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRCatchStmt* stmt, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRControlStmt* stmt, IRVarSet* refs)
 {
-    return Analyze(stmt->GetBody(), live);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRControlStmt* stmt, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRGatherLoop* loop, IRVarSet* refs)
 {
-    // An accurate answer would include only those variables that are live in
-    // the target of the control statement.  But we don't have that info, so
-    // we conservatively do nothing.
-    return FreeVars();
+    *refs += loop->GetCategory();
+    *refs += loop->GetArgs();
+    Analyze(loop->GetBody(), refs);
+    Analyze(loop->GetElseStmt(), refs);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRGatherLoop* loop, IRVarSet* live)
-{
-    IRVarSet liveAfter = *live;
-
-    // The loop body might not execute, so we analyze it with a copy of the
-    // set of variables that are live after the loop and later union them.
-    IRVarSet liveInLoop = *live;
-
-    // Get the union of the live variables in the loop body and the "else"
-    // branch.
-    AnalyzeBranch(loop->GetBody(), loop->GetElseStmt(), &liveInLoop);
-
-    // Variables that are live in one iteration are live in the previous
-    // iteration, so we must re-analyze the loop.
-    FreeVars freeVars = 
-        AnalyzeBranch(loop->GetBody(), loop->GetElseStmt(), &liveInLoop);
-
-    // Union the loop's live variables with those that are live afterwards,
-    // since the loop might not execute at all.
-    *live += liveInLoop;
-
-    // Add the gather arguments.  Some are output arguments (e.g. hit color
-    // might be fetched), but they're conditionally assigned, not
-    // unequivocally killed.
-    freeVars += Analyze(kOpcode_Gather, NULL, loop->GetArgs(), live);
-    *live += loop->GetCategory();
-    freeVars.mInputs += loop->GetCategory();
-    freeVars.Prune(*live, liveAfter);
-    return freeVars;
-}
-
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::VisitIllumBody(IRStmt* body, IRVarSet* live)
+// L and Cl are bound on entry to an illuminance or illuminate body, so
+// references to them aren't free.
+void
+XfFreeVarsImpl::VisitIllumBody(IRStmt* body, IRVarSet* refs)
 {
-    // Compute the live variables in the loop body, then remove L and Cl.
-    FreeVars freeVars = Analyze(body, live);
-    if (mGlobalL) {
-        *live -= mGlobalL;
-        freeVars -= mGlobalL;
-    }
-    if (mGlobalCl) {
-        *live -= mGlobalCl;
-        freeVars -= mGlobalCl;
-    }
-    return freeVars;
+    IRVarSet bodyRefs;
+    Analyze(body, &bodyRefs);
+    bodyRefs -= mLiveness.GetIllumVars();
+    *refs += bodyRefs;
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRIlluminanceLoop* loop, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRIlluminanceLoop* loop, IRVarSet* refs)
 {
-    IRVarSet liveAfter = *live;
-
-    // The loop body might not execute, so we analyze it with a copy of the
-    // set of variables that are live after the loop and later union them.
-    IRVarSet liveInLoop = *live;
-
-    // Variables that are live in one iteration are live in the previous
-    // iteration, so we must analyze the loop body twice.
-    VisitIllumBody(loop->GetBody(), &liveInLoop);
-    FreeVars freeVars = VisitIllumBody(loop->GetBody(), &liveInLoop);
-
-    // Union the loop's live variables with those that are live afterwards,
-    // since the loop might not execute at all.
-    *live += liveInLoop;
-
-    // Add the illuminance arguments.  Some are output arguments (e.g. light
-    // parameters migh be fetched), but they're conditionally assigned, not
-    // unequivocally killed.
-    freeVars += Analyze(kOpcode_Illuminance, NULL, loop->GetArgs(), live);
-    *live += loop->GetCategory();
-    freeVars.mInputs += loop->GetCategory();
-    freeVars.Prune(*live, liveAfter);
-    return freeVars;
+    *refs += loop->GetCategory();
+    *refs += loop->GetArgs();
+    VisitIllumBody(loop->GetBody(), refs);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRIlluminateStmt* stmt, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRIlluminateStmt* stmt, IRVarSet* refs)
 {
-    FreeVars freeVars = VisitIllumBody(stmt->GetBody(), live);
-    freeVars += Analyze(kOpcode_Illuminate, NULL, stmt->GetArgs(), live);
-    return freeVars;
+    *refs += stmt->GetArgs();
+    VisitIllumBody(stmt->GetBody(), refs);
 }
 
-XfFreeVarsImpl::FreeVars
-XfFreeVarsImpl::Visit(IRPluginCall* call, IRVarSet* live)
+void
+XfFreeVarsImpl::Visit(IRPluginCall* call, IRVarSet* refs)
 {
-    return Analyze(kOpcode_CallDSO, NULL, call->GetArgs(), live);
+    if (call->GetResult())
+        *refs += call->GetResult();
+    *refs += call->GetArgs();
 }
@@ -5,78 +5,61 @@
 #ifndef XF_FREE_VARS_H
 #define XF_FREE_VARS_H
 
+#include "xf/XfDataflow.h"
 #include "ir/IRVisitor.h"
 #include "ir/IRTypedefs.h"
 #include "ir/IRVarSet.h"
-#include <iosfwd>
 class IRShader;
 class IRVar;
 class IRVarSet;
 
 /// Given a partitioned shader, attach free variable sets to the root
-/// statement of each partition.
+/// statement of each partition (including partitions of shader parameter
+/// initializers; see XfPartitionParamInits).
 void XfFreeVars(IRShader* shader);
 
-/// Implementation of free variable analysis.  Methods are all public for
-/// testing.
+/// Live variable analysis for free variable analysis.  Globals and output
+/// shader parameters are never killed, since their values are used after the
+/// shader executes.
+class XfFreeVarsLiveness : public XfDataflow {
+public:
+    XfFreeVarsLiveness(const IRGlobalVars& globals) :
+        XfDataflow(globals)
+    {
+    }
+
+protected:
+    virtual bool CanKill(const IRVar* var) const;
+};
+
+/// Implementation of free variable analysis.  The free variables of a
+/// partition are the variables it references that are live before or after
+/// it.  Methods are all public for testing.
 class XfFreeVarsImpl : public IRVisitor<XfFreeVarsImpl> {
 private:
-    IRVar* mGlobalL;
-    IRVar* mGlobalCl;
+    XfFreeVarsLiveness mLiveness;
     bool mInPartition;
 
 public:
-    class FreeVars {
-    public:
-        IRVarSet mInputs, mOutputs;
-
-        // XXX Default ctor shouldn't be necessary
-        FreeVars() { }
-
-        // Not sure if this copy constructor is necessary.
-        FreeVars(const FreeVars& freeVars) :
-            mInputs(freeVars.mInputs),
-            mOutputs(freeVars.mOutputs)
-        {
-        }
-
-        void operator+=(const FreeVars& freeVars) {
-            mInputs += freeVars.mInputs;
-            mOutputs += freeVars.mOutputs;
-        }
-
-        void operator-=(IRVar* var) { 
-            mInputs -= var;
-            mOutputs -= var; 
-        }
-
-        void Prune(const IRVarSet& liveBefore, const IRVarSet& liveAfter) {
-            mInputs.Intersect(liveBefore);
-            mOutputs.Intersect(liveAfter);
-        }
-    };
-
-
     XfFreeVarsImpl();
+    XfFreeVarsImpl(const IRGlobalVars& globals);
     void Analyze(IRShader* shader);
-    FreeVars Analyze(IRStmt* stmt, IRVarSet* live);
-    FreeVars Analyze(const IRInst* inst, IRVarSet* live);
-    FreeVars Analyze(Opcode opcode, IRVar* result, const IRValues& args,
-                     IRVarSet* live);
-    FreeVars AnalyzeBranch(IRStmt* thenStmt, IRStmt* elseStmt, IRVarSet* live);
-
-    FreeVars Visit(IRBlock* stmt, IRVarSet* live);
-    FreeVars Visit(IRSeq* stmt, IRVarSet* live);
-    FreeVars Visit(IRIfStmt* stmt, IRVarSet* live);
-    FreeVars Visit(IRForLoop* stmt, IRVarSet* live);
-    FreeVars Visit(IRCatchStmt* stmt, IRVarSet* live);
-    FreeVars Visit(IRControlStmt* stmt, IRVarSet* live);
-    FreeVars Visit(IRGatherLoop* stmt, IRVarSet* live);
-    FreeVars Visit(IRIlluminanceLoop* stmt, IRVarSet* live);
-    FreeVars Visit(IRIlluminateStmt* stmt, IRVarSet* live);
-    FreeVars VisitIllumBody(IRStmt* body, IRVarSet* live);
-    FreeVars Visit(IRPluginCall* call, IRVarSet* live);
+    void Analyze(IRStmt* stmt, IRVarSet* refs);
+    void GetLive(const IRStmt* stmt, IRVarSet* live);
+    void GetLive(const IRInst* inst, IRVarSet* live);
 
+    // Collect the variables referenced by a statement.
+    void Visit(IRBlock* stmt, IRVarSet* refs);
+    void Visit(IRSeq* stmt, IRVarSet* refs);
+    void Visit(IRIfStmt* stmt, IRVarSet* refs);
+    void Visit(IRForLoop* stmt, IRVarSet* refs);
+    void Visit(IRCatchStmt* stmt, IRVarSet* refs);
+    void Visit(IRControlStmt* stmt, IRVarSet* refs);
+    void Visit(IRGatherLoop* stmt, IRVarSet* refs);
+    void Visit(IRIlluminanceLoop* stmt, IRVarSet* refs);
+    void Visit(IRIlluminateStmt* stmt, IRVarSet* refs);
+    void VisitIllumBody(IRStmt* body, IRVarSet* refs);
+    void Visit(IRPluginCall* call, IRVarSet* refs);
 };
 
 #endif // ndef XF_FREE_VARS_H
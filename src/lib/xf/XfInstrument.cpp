@@ -3,20 +3,30 @@
 // See http://www.opensource.org/licenses/mit-license.php.
 
 #include "xf/XfInstrument.h"
+#include "xf/XfCostModel.h"
+#include "xf/XfFreeVars.h"
 #include "xf/XfPartition.h"
 #include "xf/XfPartitionInfo.h"
+#include "xf/XfProfile.h"
 #include "ir/IRShader.h"
+#include "ir/IRShaderParam.h"
 #include "util/UtLog.h"
 
 void
-XfInstrument(IRShader* shader, UtLog* log, int minPartitionSize)
+XfInstrument(IRShader* shader, UtLog* log, int minPartitionSize,
+             const XfCostModel* costModel, const XfPartitionOptions& options)
 {
-    return XfInstrumentImpl(log, minPartitionSize).Instrument(shader);
+    return XfInstrumentImpl(log, minPartitionSize, costModel,
+                            options).Instrument(shader);
 }
 
 // Constructor. 
-XfInstrumentImpl::XfInstrumentImpl(UtLog* log, int minPartitionSize) :
+XfInstrumentImpl::XfInstrumentImpl(UtLog* log, int minPartitionSize,
+                                   const XfCostModel* costModel,
+                                   const XfPartitionOptions& options) :
     mMinPartitionSize(minPartitionSize),
+    mCostModel(costModel),
+    mOptions(options),
     mShader(NULL)
 {
 }
@@ -27,8 +37,12 @@ XfInstrumentImpl::Instrument(IRShader* shader)
     // Hold onto the shader, so we can construct temporary variables.
     mShader = shader;
 
-    // Partition the shader.
-    XfPartition(shader);
+    // Partition the shader.  The cost model requires free variables.
+    XfPartition(shader, mOptions);
+    if (mOptions.mParamInits)
+        XfPartitionParamInits(shader, mOptions);
+    if (mCostModel)
+        XfFreeVars(shader);
 
     // If a minimum partition size was specified, run partition info analysis
     // to determine partition sizes.
@@ -36,29 +50,44 @@ XfInstrumentImpl::Instrument(IRShader* shader)
         XfPartitionInfo(shader, false);
     
     // Walk the shader body, wrapping partitions in timer calls.
-    // TODO: do the same for the shader parameter initializers.
     shader->SetBody(Walk(shader->GetBody()));
+
+    // Optionally do the same for the shader parameter initializers.
+    if (mOptions.mParamInits) {
+        const IRShaderParams& params = shader->GetParams();
+        IRShaderParams::const_iterator it;
+        for (it = params.begin(); it != params.end(); ++it)
+            (*it)->SetInitStmt(Walk((*it)->TakeInitStmt()));
+    }
 }
 
 IRStmt*
 XfInstrumentImpl::InstrumentPartition(IRStmt* stmt)
 {
-    // Although the timer plugin functions are void, we must nevertheless
-    // provide a result variable.
+    // Although StartTimer is void, we must nevertheless provide a result
+    // variable.  StopTimer has a varying result, which allows the plugin to
+    // count the active points.
     const IRType* resultTy =  mShader->GetTypeFactory()->GetFloatTy();
     IRLocalVar* result = mShader->NewTempVar(resultTy, kIRUniform);
+    IRLocalVar* stopResult = mShader->NewTempVar(resultTy, kIRVarying);
 
     // Function names, plugin names, and prototypes must be IR string constants
     IRStringConst* plugin = mShader->NewStringConst("timers");
     IRStringConst* startFunc = mShader->NewStringConst("StartTimer");
     IRStringConst* stopFunc = mShader->NewStringConst("StopTimer");
-    IRStringConst* startProto = mShader->NewStringConst("void StartTimer()");
-    IRStringConst* stopProto = mShader->NewStringConst("void StopTimer()");
+    IRStringConst* startProto =
+        mShader->NewStringConst("void StartTimer(string)");
+    IRStringConst* stopProto =
+        mShader->NewStringConst("float StopTimer(string)");
+
+    // The timers are keyed by partition identifier.
+    std::string id = XfGetPartitionId(stmt);
+    IRValues args(1, mShader->NewStringConst(id.c_str()));
 
     // Construct start and stop calls.
-    IRStmt* startCall = new IRPluginCall(result, IRValues(), startFunc,
+    IRStmt* startCall = new IRPluginCall(result, args, startFunc,
                                          plugin, startProto, stmt->GetPos());
-    IRStmt* stopCall = new IRPluginCall(result, IRValues(), stopFunc,
+    IRStmt* stopCall = new IRPluginCall(stopResult, args, stopFunc,
                                         plugin, stopProto, stmt->GetPos());
 
     // Return a new sequence with the timer calls surrounding the given
@@ -99,12 +128,16 @@ XfInstrumentImpl::ShouldCompile(IRStmt* stmt)
     if (numInsts == 0)
         return false;
 
+    // If a cost model was given, compile only if that's beneficial.
+    if (mCostModel && !mCostModel->ShouldCompile(stmt))
+        return false;
+
     // If XfPartitionInfo hasn't been run (e.g. in a unit test),
     // compile the partition unconditionally.
     if (numInsts < 0)
         return true;
 
-    // For now use an optional minimum instruction count threshold.
+    // Otherwise use an optional minimum instruction count threshold.
     return numInsts >= mMinPartitionSize;
 }
 
@@ -6,18 +6,34 @@
 #define XF_INSTRUMENT_H
 
 #include "ir/IRVisitor.h"
+#include "xf/XfPartitionOptions.h"
 class IRShader;
 class UtLog;
-
-void XfInstrument(IRShader* shader, UtLog* log, int minPartitionSize);
+class XfCostModel;
+
+/// Partition the shader and wrap the partitions that would be compiled with
+/// timer calls.  If a cost model is given, only partitions with a positive
+/// predicted benefit are instrumented (see XfCostModel).  Each timer call
+/// passes a stable partition identifier (see XfGetPartitionId), which allows
+/// the timings to be used when the shader is compiled (see XfProfile).  The
+/// partitioning options must match the ones used for codegen, otherwise the
+/// identifiers won't match.  If they include parameter initializers, those
+/// are also instrumented (see XfPartitionParamInits).
+void XfInstrument(IRShader* shader, UtLog* log, int minPartitionSize,
+                  const XfCostModel* costModel=NULL,
+                  const XfPartitionOptions& options=XfPartitionOptions());
 
 class XfInstrumentImpl : public IRVisitor<XfInstrumentImpl> {
 private:
     int mMinPartitionSize;
+    const XfCostModel* mCostModel;
+    XfPartitionOptions mOptions;
     IRShader* mShader;
 
 public:
-    XfInstrumentImpl(UtLog* log, int minPartitionSize=1);
+    XfInstrumentImpl(UtLog* log, int minPartitionSize=1,
+                     const XfCostModel* costModel=NULL,
+                     const XfPartitionOptions& options=XfPartitionOptions());
 
     void Instrument(IRShader* shader);
     IRStmt* InstrumentPartition(IRStmt* stmt);
@@ -5,7 +5,7 @@
 #ifndef XF_LIVE_VARS_H
 #define XF_LIVE_VARS_H
 
-#include "ir/IRVisitor.h"
+#include "xf/XfDataflow.h"
 #include "ir/IRTypedefs.h"
 #include "ir/IRVarSet.h"
 class IRShader;
@@ -16,31 +16,15 @@ class IRVarSet;
 /// statement.
 IRVarSet XfLiveVars(const IRStmt* stmt);
 
-/// Implementation of live variable analysis.  Methods are all public for
-/// testing.
-class XfLiveVarsImpl : public IRVisitor<XfLiveVarsImpl> {
-private:
-    IRVar* mGlobalL;
-    IRVar* mGlobalCl;
-
+/// Implementation of live variable analysis, which is a backward dataflow
+/// analysis in which every assignment kills its destination (see
+/// XfDataflow).
+class XfLiveVarsImpl : public XfDataflow {
 public:
-    XfLiveVarsImpl(const IRGlobalVars& globals);
-    void GetLive(const IRStmt* stmt, IRVarSet* live);
-    void GetLive(const IRInst* inst, IRVarSet* live);
-    void GetLiveBranch(const IRStmt* thenStmt, 
-                       const IRStmt* elseStmt, IRVarSet* live);
-
-    void Visit(IRBlock* stmt, IRVarSet* live);
-    void Visit(IRSeq* stmt, IRVarSet* live);
-    void Visit(IRIfStmt* stmt, IRVarSet* live);
-    void Visit(IRForLoop* stmt, IRVarSet* live);
-    void Visit(IRCatchStmt* stmt, IRVarSet* live);
-    void Visit(IRControlStmt* stmt, IRVarSet* live);
-    void Visit(IRGatherLoop* stmt, IRVarSet* live);
-    void Visit(IRIlluminanceLoop* stmt, IRVarSet* live);
-    void Visit(IRIlluminateStmt* stmt, IRVarSet* live);
-    void VisitIllumBody(IRStmt* body, IRVarSet* live);
-    void Visit(IRPluginCall* call, IRVarSet* live);
+    XfLiveVarsImpl(const IRGlobalVars& globals) :
+        XfDataflow(globals)
+    {
+    }
 };
 
 #endif // ndef XF_LIVE_VARS_H
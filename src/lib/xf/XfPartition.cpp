@@ -3,31 +3,288 @@
 // See http://www.opensource.org/licenses/mit-license.php.
 
 #include "xf/XfPartition.h"
+#include "xf/XfDefUse.h"
+#include "xf/XfDistribute.h"
+#include "xf/XfResolveSpaces.h"
+#include "xf/XfSchedule.h"
+#include "ir/IRNumConst.h"
 #include "ir/IRShader.h"
+#include "ir/IRShaderParam.h"
+#include "ir/IRStringConst.h"
+#include "ir/IRVarSet.h"
 #include "ops/OpInfo.h"
+#include <map>
 
 enum Kind { kNone, kCompiled, kInterpreted };
 
 void 
-XfPartition(IRShader* shader)
+XfPartition(IRShader* shader, const XfPartitionOptions& options)
 {
-    XfPartitionImpl().Partition(shader);
+    XfPartitionImpl(options).Partition(shader);
+}
+
+void 
+XfPartitionParamInits(IRShader* shader, const XfPartitionOptions& options)
+{
+    XfPartitionImpl(options).PartitionParamInits(shader);
 }
 
 void 
 XfPartitionImpl::Partition(IRShader* shader)
 {
+    // Hold onto the shader, so we can construct temporary variables.
+    mShader = shader;
     shader->SetBody(Partition(shader->GetBody()));
 }
 
+void
+XfPartitionImpl::PartitionParamInits(IRShader* shader)
+{
+    mShader = shader;
+    const IRShaderParams& params = shader->GetParams();
+    IRShaderParams::const_iterator it;
+    for (it = params.begin(); it != params.end(); ++it) {
+        IRShaderParam* param = *it;
+        param->SetInitStmt(Partition(param->TakeInitStmt()));
+    }
+}
+
+// Check whether an instruction is a compilable uniform computation, i.e. its
+// arguments are uniform, and its result or an output argument is uniform.
+bool
+XfIsUniformInst(const IRInst* inst)
+{
+    Opcode opcode = inst->GetOpcode();
+    if (OpInfo::GetOpName(opcode) == NULL || XfIsNamedSpaceInst(inst))
+        return false;
+    bool hasUniformOutput = 
+        inst->GetResult() && inst->GetResult()->GetDetail() == kIRUniform;
+    const IRValues& args = inst->GetArgs();
+    for (unsigned int i = 0; i < args.size(); ++i) {
+        if (args[i]->GetDetail() != kIRUniform)
+            return false;
+        if (OpInfo::HasOutput(opcode) && OpInfo::IsOutput(opcode, i))
+            hasUniformOutput = true;
+    }
+    return hasUniformOutput;
+}
+
+// Check whether an instruction computes a derivative, which depends on the
+// values of neighboring points.
+bool
+XfIsDerivInst(const IRInst* inst)
+{
+    switch (inst->GetOpcode()) {
+      case kOpcode_Du:
+      case kOpcode_Dv:
+      case kOpcode_Deriv:
+      case kOpcode_Area:
+      case kOpcode_CalculateNormal:
+          return true;
+      default:
+          return false;
+    }
+}
+
+// Check whether a value is a varying float or triple variable, which can be
+// the operand or result of a compiled derivative.
+static bool
+IsGridOperand(const IRValue* value)
+{
+    const IRVar* var = UtCast<const IRVar*>(value);
+    if (var == NULL || var->GetDetail() != kIRVarying)
+        return false;
+    const IRType* type = var->GetType();
+    return type->IsFloat() || type->IsTriple();
+}
+
+// Check whether a derivative instruction can be compiled.  The operands and
+// result must be varying variables, since uniform operands are typically
+// constants that the interpreter handles trivially.  The result must not be
+// an operand, since neighboring operand values are read after the result is
+// stored.  The derivative in Deriv must be taken with respect to a float, and
+// area and calculatenormal require a point.
+static bool
+CanCompileDeriv(const IRInst* inst)
+{
+    if (!IsGridOperand(inst->GetResult()))
+        return false;
+    const IRValues& args = inst->GetArgs();
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (!IsGridOperand(args[i]) || args[i] == inst->GetResult())
+            return false;
+    }
+    switch (inst->GetOpcode()) {
+      case kOpcode_Du:
+      case kOpcode_Dv:
+          return args.size() == 1;
+      case kOpcode_Deriv:
+          return args.size() == 2 && args[1]->GetType()->IsFloat();
+      case kOpcode_Area:
+      case kOpcode_CalculateNormal:
+          return args.size() == 1 && args[0]->GetType()->IsTriple();
+      default:
+          return false;
+    }
+}
+
+// Check whether an instruction is a texture or environment lookup in the
+// form that code generation can batch: a constant texture name and channel,
+// followed by varying float coordinates (s and t) or a varying direction.
+// The result must be a varying float or color.
+bool
+XfIsBatchTextureInst(const IRInst* inst)
+{
+    const IRValues& args = inst->GetArgs();
+    switch (inst->GetOpcode()) {
+      case kOpcode_Texture:
+          if (args.size() != 4 || !args[2]->GetType()->IsFloat() ||
+              !args[3]->GetType()->IsFloat())
+              return false;
+          break;
+      case kOpcode_Environment:
+          if (args.size() != 3 || !args[2]->GetType()->IsTriple())
+              return false;
+          break;
+      default:
+          return false;
+    }
+    const IRNumConst* channel = UtCast<const IRNumConst*>(args[1]);
+    const IRVar* result = inst->GetResult();
+    if (UtCast<const IRStringConst*>(args[0]) == NULL ||
+        channel == NULL || !channel->IsFloat() ||
+        result == NULL || result->GetDetail() != kIRVarying ||
+        !(result->GetType()->IsFloat() || result->GetType()->IsColor()))
+        return false;
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (!IsGridOperand(args[i]) || args[i] == result)
+            return false;
+    }
+    return true;
+}
+
+// Check whether an instruction is applied to the whole grid at once when it's
+// compiled, i.e. a derivative or a texture lookup.
+bool
+XfIsGridInst(const IRInst* inst)
+{
+    switch (inst->GetOpcode()) {
+      case kOpcode_Texture:
+      case kOpcode_Environment:
+          return true;
+      default:
+          return XfIsDerivInst(inst);
+    }
+}
+
+// Collect the variables referenced by an instruction.
+static void
+GetUses(const IRInst* inst, IRVarSet* uses)
+{
+    if (inst->GetResult())
+        *uses += inst->GetResult();
+    *uses += inst->GetArgs();
+}
+
+// Collect the variables assigned by the uniform instructions in a partition.
+// Only blocks that are not nested in control flow can contain them.
+static void
+GetUniformDefs(const IRStmt* stmt, IRVarSet* defs)
+{
+    if (const IRBlock* block = UtCast<const IRBlock*>(stmt)) {
+        const IRInsts& insts = block->GetInsts();
+        IRInsts::const_iterator it;
+        for (it = insts.begin(); it != insts.end(); ++it)
+            if (XfIsUniformInst(*it))
+                XfDefUse::GetInstDefs(*it, defs);
+    }
+    else if (const IRSeq* seq = UtCast<const IRSeq*>(stmt)) {
+        IRStmts::const_iterator it;
+        for (it = seq->GetStmts().begin(); it != seq->GetStmts().end(); ++it)
+            GetUniformDefs(*it, defs);
+    }
+}
+
+// Collect the variables referenced by the code in a partition, excluding
+// uniform instructions.
+void
+XfGetVaryingUses(const IRStmt* stmt, IRVarSet* uses)
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock: {
+          const IRInsts& insts = UtStaticCast<const IRBlock*>(stmt)->GetInsts();
+          IRInsts::const_iterator it;
+          for (it = insts.begin(); it != insts.end(); ++it) {
+              if (!XfIsUniformInst(*it))
+                  GetUses(*it, uses);
+          }
+          break;
+      }
+      case kIRSeq: {
+          const IRStmts& stmts = UtStaticCast<const IRSeq*>(stmt)->GetStmts();
+          IRStmts::const_iterator it;
+          for (it = stmts.begin(); it != stmts.end(); ++it)
+              XfGetVaryingUses(*it, uses);
+          break;
+      }
+      case kIRIfStmt: {
+          const IRIfStmt* ifStmt = UtStaticCast<const IRIfStmt*>(stmt);
+          *uses += ifStmt->GetCond();
+          XfGetVaryingUses(ifStmt->GetThen(), uses);
+          XfGetVaryingUses(ifStmt->GetElse(), uses);
+          break;
+      }
+      case kIRForLoop: {
+          const IRForLoop* loop = UtStaticCast<const IRForLoop*>(stmt);
+          *uses += loop->GetCond();
+          XfGetVaryingUses(loop->GetCondStmt(), uses);
+          XfGetVaryingUses(loop->GetIterateStmt(), uses);
+          XfGetVaryingUses(loop->GetBody(), uses);
+          break;
+      }
+      case kIRCatchStmt:
+          XfGetVaryingUses(UtStaticCast<const IRCatchStmt*>(stmt)->GetBody(),
+                           uses);
+          break;
+      default:
+          break;
+    }
+}
+
+// Check whether a uniform instruction (or statement containing uniform
+// instructions) assigns any of the given variables.
+static bool
+Conflicts(const IRVarSet& defs, const IRVarSet& uses)
+{
+    IRVarSet both(defs);
+    both.Intersect(uses);
+    return !both.IsEmpty();
+}
+
 static Kind
-GetKind(const IRInst* inst)
+GetKind(const IRInst* inst, bool allowUniform, bool allowDerivs,
+        bool allowTextures)
 {
-    // If there's no shadeop implementation, we can't compile it.
+    // Derivatives and texture lookups are optionally compiled (outside of
+    // control flow), since they are applied to the whole grid.
+    if (XfIsDerivInst(inst))
+        return allowDerivs && CanCompileDeriv(inst) ? kCompiled : kInterpreted;
+    if (inst->GetOpcode() == kOpcode_Texture ||
+        inst->GetOpcode() == kOpcode_Environment)
+        return allowTextures && XfIsBatchTextureInst(inst) ? kCompiled
+                                                            : kInterpreted;
+
+    // If there's no shadeop implementation, we can't compile it.  Nor can we
+    // compile transforms by named spaces (see XfResolveSpaces).
     Opcode opcode = inst->GetOpcode();
-    if (OpInfo::GetOpName(opcode) == NULL)
+    if (OpInfo::GetOpName(opcode) == NULL || XfIsNamedSpaceInst(inst))
         return kInterpreted;
 
+    // Uniform computations can optionally be compiled (outside of control
+    // flow), since they are executed once per plugin call.
+    if (allowUniform && XfIsUniformInst(inst))
+        return kCompiled;
+
     // Otherwise if the result is uniform, it should be interpreted.
     if (inst->GetResult() &&
         inst->GetResult()->GetDetail() == kIRUniform)
@@ -88,12 +345,36 @@ XfPartitionImpl::Visit(IRBlock* block, int ignored)
     delete block;
     block = NULL;
 
-    // Partition the instructions by kind into separate blocks.
+    // If scheduling, group the instructions by kind where dependences allow.
+    bool allowUniform = mOptions.mAllowUniform && mDepth == 0;
+    bool allowDerivs = mOptions.mAllowDerivs && mDepth == 0;
+    bool allowTextures = mOptions.mAllowTextures && mDepth == 0;
+    if (mOptions.mSchedule) {
+        XfSchedule schedule;
+        IRInsts::const_iterator it;
+        for (it = insts->begin(); it != insts->end(); ++it)
+            schedule.Add(*it, GetKind(*it, allowUniform, allowDerivs,
+                                      allowTextures));
+        schedule.Reorder(insts);
+    }
+
+    // Partition the instructions by kind into separate blocks.  If uniform
+    // instructions are compiled, keep track of the variables referenced by
+    // varying code in the current block, which uniform instructions must not
+    // assign.
+    IRVarSet varyingUses;
     IRInsts::const_iterator it;
     for (it = insts->begin(); it != insts->end(); ++it) {
         // If this is a different kind of instruction, start a new block.
         IRInst* inst = *it;
-        Kind kind = GetKind(inst);
+        Kind kind = GetKind(inst, allowUniform, allowDerivs, allowTextures);
+        bool isUniform = allowUniform && XfIsUniformInst(inst);
+        if (isUniform && currentKind == kCompiled) {
+            IRVarSet defs;
+            XfDefUse::GetInstDefs(inst, &defs);
+            if (Conflicts(defs, varyingUses))
+                kind = kInterpreted;
+        }
         if (kind != currentKind) {
             // Wrap up the current block, if any
             if (!currentInsts->empty()) {
@@ -102,8 +383,11 @@ XfPartitionImpl::Visit(IRBlock* block, int ignored)
                 currentInsts = new IRInsts;
             }
             currentKind = kind;
+            varyingUses = IRVarSet();
         }
         currentInsts->push_back(inst);
+        if (allowUniform && kind == kCompiled && !isUniform)
+            GetUses(inst, &varyingUses);
     }
 
     // Discard the original instruction list.
@@ -141,15 +425,63 @@ XfPartitionImpl::Visit(IRSeq* seq, int ignored)
     delete seq;
     seq = NULL;
 
-    // Partition the statements by kind into separate sequences.
+    // Recursively partition the statements.  If scheduling, the components
+    // of nested sequences of mixed kind (e.g. partitioned blocks) are
+    // spliced in, except for inlined functions, and the statements are
+    // grouped by kind where dependences allow.  Loops that are only
+    // partially compilable are optionally distributed, which requires the
+    // preceding statement (to find the initial value of the loop counter),
+    // and the resulting loops are also spliced in.
+    IRStmts* partitioned = new IRStmts;
     IRStmts::const_iterator it;
     for (it = stmts->begin(); it != stmts->end(); ++it) {
-        // Recursively partition the statement.
         IRStmt* stmt = Partition(*it);
-        
+        bool splice = mOptions.mSchedule;
+        if (mOptions.mDistribute && mShader &&
+            stmt->GetKind() == kIRForLoop && !stmt->CanCompile()) {
+            const IRStmt* prev =
+                partitioned->empty() ? NULL : partitioned->back();
+            stmt = Distribute(UtStaticCast<IRForLoop*>(stmt), prev);
+            splice = true;
+        }
+        IRSeq* nested = UtCast<IRSeq*>(stmt);
+        if (splice && nested && !nested->CanCompile() &&
+            nested->GetFuncName() == NULL) {
+            IRStmts* nestedStmts = nested->TakeStmts();
+            partitioned->insert(partitioned->end(), nestedStmts->begin(),
+                                nestedStmts->end());
+            delete nestedStmts;
+            delete nested;
+        }
+        else
+            partitioned->push_back(stmt);
+    }
+    delete stmts;
+    stmts = partitioned;
+    if (mOptions.mSchedule) {
+        XfSchedule schedule;
+        for (it = stmts->begin(); it != stmts->end(); ++it)
+            schedule.Add(*it, GetKind(*it));
+        schedule.Reorder(stmts);
+    }
+
+    // Partition the statements by kind into separate sequences.  If uniform
+    // instructions are compiled, a new sequence is started when a statement
+    // contains a uniform instruction that assigns a variable referenced by
+    // varying code in the current sequence.
+    bool allowUniform = mOptions.mAllowUniform && mDepth == 0;
+    IRVarSet varyingUses;
+    for (it = stmts->begin(); it != stmts->end(); ++it) {
         // If this is a different kind of statement, start a new sequence.
+        IRStmt* stmt = *it;
         Kind kind = GetKind(stmt);
-        if (kind != currentKind) {
+        bool conflicts = false;
+        if (allowUniform && kind == kCompiled && currentKind == kCompiled) {
+            IRVarSet defs;
+            GetUniformDefs(stmt, &defs);
+            conflicts = Conflicts(defs, varyingUses);
+        }
+        if (kind != currentKind || conflicts) {
             // Wrap up the current sequence, if any.
             if (!currentStmts->empty()) {
                 resultStmts->push_back(
@@ -157,8 +489,11 @@ XfPartitionImpl::Visit(IRSeq* seq, int ignored)
                 currentStmts = new IRStmts;
             }
             currentKind = kind;
+            varyingUses = IRVarSet();
         }
         currentStmts->push_back(stmt);
+        if (allowUniform && kind == kCompiled)
+            XfGetVaryingUses(stmt, &varyingUses);
     }
 
     // Discard the original statement list.
@@ -180,8 +515,10 @@ XfPartitionImpl::Visit(IRSeq* seq, int ignored)
 IRStmt*
 XfPartitionImpl::Visit(IRIfStmt* stmt, int ignored)
 {
+    ++mDepth;
     stmt->SetThen(Partition(stmt->GetThen()));
     stmt->SetElse(Partition(stmt->GetElse()));
+    --mDepth;
     if (stmt->GetThen()->CanCompile() && stmt->GetElse()->CanCompile())
         stmt->SetCanCompile();
     return stmt;
@@ -190,9 +527,11 @@ XfPartitionImpl::Visit(IRIfStmt* stmt, int ignored)
 IRStmt*
 XfPartitionImpl::Visit(IRForLoop* loop, int ignored)
 {
+    ++mDepth;
     loop->SetCondStmt(Partition(loop->GetCondStmt()));
     loop->SetIterateStmt(Partition(loop->GetIterateStmt()));
     loop->SetBody(Partition(loop->GetBody()));
+    --mDepth;
     if (loop->GetCondStmt()->CanCompile() && 
         loop->GetIterateStmt()->CanCompile() && loop->GetBody()->CanCompile())
         loop->SetCanCompile();
@@ -209,22 +548,28 @@ XfPartitionImpl::Visit(IRControlStmt* stmt, int ignored)
 IRStmt*
 XfPartitionImpl::Visit(IRGatherLoop* loop, int ignored)
 {
+    ++mDepth;
     loop->SetBody(Partition(loop->GetBody()));
     loop->SetElseStmt(Partition(loop->GetElseStmt()));
+    --mDepth;
     return loop;  // cannot compile
 }
 
 IRStmt*
 XfPartitionImpl::Visit(IRIlluminanceLoop* loop, int ignored)
 {
+    ++mDepth;
     loop->SetBody(Partition(loop->GetBody()));
+    --mDepth;
     return loop;  // cannot compile
 }
 
 IRStmt*
 XfPartitionImpl::Visit(IRIlluminateStmt* stmt, int ignored)
 {
+    ++mDepth;
     stmt->SetBody(Partition(stmt->GetBody()));
+    --mDepth;
     // We don't yet support compiling illuminate/solar statements, 
     // but we could.
     return stmt;
@@ -233,7 +578,9 @@ XfPartitionImpl::Visit(IRIlluminateStmt* stmt, int ignored)
 IRStmt*
 XfPartitionImpl::Visit(IRCatchStmt* stmt, int ignored)
 {
+    ++mDepth;
     stmt->SetBody(Partition(stmt->GetBody()));
+    --mDepth;
     if (stmt->GetBody()->CanCompile())
         stmt->SetCanCompile();
     return stmt;
@@ -244,3 +591,452 @@ XfPartitionImpl::Visit(IRPluginCall* call, int ignored)
 {
     return call;
 }
+
+// Loops with more iterations are not distributed, since each carried
+// variable requires an array element per iteration.
+static const int kMaxTripCount = 32;
+
+// Get the instruction of a block containing a single instruction.  Returns
+// NULL if the statement is not such a block.
+static const IRInst*
+GetSingleInst(const IRStmt* stmt)
+{
+    const IRBlock* block = UtCast<const IRBlock*>(stmt);
+    if (block && block->GetInsts().size() == 1)
+        return block->GetInsts().front();
+    return NULL;
+}
+
+// Get the value of a float constant, returning false if it's not one.
+static bool
+GetFloatConst(const IRValue* value, float* result)
+{
+    const IRNumConst* constant = UtCast<const IRNumConst*>(value);
+    if (constant == NULL || !constant->IsFloat())
+        return false;
+    *result = constant->GetFloat();
+    return true;
+}
+
+// Get the constant assigned to a variable by its last assignment in the
+// given statement.  Returns false if the last assignment is not a constant
+// assignment in a block (or if there's no assignment).
+static bool
+GetLastConstAssign(const IRStmt* stmt, const IRVar* var, float* value)
+{
+    if (const IRBlock* block = UtCast<const IRBlock*>(stmt)) {
+        const IRInsts& insts = block->GetInsts();
+        IRInsts::const_reverse_iterator it;
+        for (it = insts.rbegin(); it != insts.rend(); ++it) {
+            const IRInst* inst = *it;
+            IRVarSet defs;
+            XfDefUse::GetInstDefs(inst, &defs);
+            if (defs.Has(var))
+                return inst->GetOpcode() == kOpcode_Assign &&
+                    inst->GetResult() == var &&
+                    GetFloatConst(inst->GetArgs().front(), value);
+        }
+    }
+    else if (const IRSeq* seq = UtCast<const IRSeq*>(stmt)) {
+        const IRStmts& stmts = seq->GetStmts();
+        IRStmts::const_reverse_iterator it;
+        for (it = stmts.rbegin(); it != stmts.rend(); ++it) {
+            XfDefUse summary;
+            summary.Add(*it);
+            if (summary.GetDefs().Has(var))
+                return GetLastConstAssign(*it, var, value);
+        }
+    }
+    return false;
+}
+
+// Get the number of iterations of a loop with a constant trip count, i.e.
+//     i = c; for (; lt(i, k); i = add(i, s)) ...
+// where the comparison can also be le, gt or ge and the increment can be a
+// subtraction.  The initial assignment must be the last assignment of the
+// counter in the preceding statement.  Returns zero if the loop doesn't have
+// this form, or if it has too many iterations.  In particular, a bound that
+// is a variable (e.g. a shader parameter) is not supported, since carried
+// values are stored in fixed-length arrays.
+static int
+GetTripCount(const IRForLoop* loop, const IRStmt* prev, IRVar** counter)
+{
+    const IRInst* test = GetSingleInst(loop->GetCondStmt());
+    const IRInst* iterate = GetSingleInst(loop->GetIterateStmt());
+    if (prev == NULL || test == NULL || iterate == NULL ||
+        test->GetResult() != loop->GetCond() ||
+        test->GetArgs().size() != 2 || iterate->GetArgs().size() != 2)
+        return 0;
+    Opcode opcode = test->GetOpcode();
+    if (opcode != kOpcode_LT && opcode != kOpcode_LE &&
+        opcode != kOpcode_GT && opcode != kOpcode_GE)
+        return 0;
+    IRVar* var = UtCast<IRVar*>(test->GetArgs()[0]);
+    float value, bound, step;
+    if (var == NULL || iterate->GetResult() != var ||
+        iterate->GetArgs()[0] != var ||
+        !GetFloatConst(test->GetArgs()[1], &bound) ||
+        !GetFloatConst(iterate->GetArgs()[1], &step) ||
+        !GetLastConstAssign(prev, var, &value))
+        return 0;
+    if (iterate->GetOpcode() == kOpcode_Subtract)
+        step = -step;
+    else if (iterate->GetOpcode() != kOpcode_Add)
+        return 0;
+
+    // Count the iterations, using float arithmetic like the interpreter.
+    int tripCount = 0;
+    while (tripCount <= kMaxTripCount) {
+        bool more;
+        switch (opcode) {
+          case kOpcode_LT: more = value < bound; break;
+          case kOpcode_LE: more = value <= bound; break;
+          case kOpcode_GT: more = value > bound; break;
+          default:         more = value >= bound; break;
+        }
+        if (!more)
+            break;
+        ++tripCount;
+        value += step;
+    }
+    *counter = var;
+    return tripCount <= kMaxTripCount ? tripCount : 0;
+}
+
+// Get the statements of a partitioned loop body, splicing in the components
+// of nested sequences of mixed kind (except inlined functions).  If take is
+// true, the nested sequences are destroyed.
+static void
+GetLoopItems(IRStmt* stmt, IRStmts* items, bool take)
+{
+    IRSeq* seq = UtCast<IRSeq*>(stmt);
+    if (seq == NULL || seq->CanCompile() || seq->GetFuncName() != NULL) {
+        items->push_back(stmt);
+        return;
+    }
+    const IRStmts& stmts = seq->GetStmts();
+    IRStmts::const_iterator it;
+    for (it = stmts.begin(); it != stmts.end(); ++it)
+        GetLoopItems(*it, items, take);
+    if (take) {
+        delete seq->TakeStmts();
+        delete seq;
+    }
+}
+
+// Check whether a value is one of the given variables.
+static bool
+IsMember(const IRValue* value, const IRVarSet& vars)
+{
+    const IRVar* var = UtCast<const IRVar*>(value);
+    return var && vars.Has(var);
+}
+
+// Check whether the uses of the given variables in a statement can be
+// renamed, i.e. they're arguments of basic instructions, not conditions.
+static bool
+CanRename(const IRStmt* stmt, const IRVarSet& vars)
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock: {
+          const IRInsts& insts = UtStaticCast<const IRBlock*>(stmt)->GetInsts();
+          IRInsts::const_iterator it;
+          for (it = insts.begin(); it != insts.end(); ++it) {
+              if (UtCast<const IRBasicInst*>(*it))
+                  continue;
+              const IRValues& args = (*it)->GetArgs();
+              for (size_t i = 0; i < args.size(); ++i)
+                  if (IsMember(args[i], vars))
+                      return false;
+          }
+          return true;
+      }
+      case kIRSeq: {
+          const IRStmts& stmts = UtStaticCast<const IRSeq*>(stmt)->GetStmts();
+          IRStmts::const_iterator it;
+          for (it = stmts.begin(); it != stmts.end(); ++it)
+              if (!CanRename(*it, vars))
+                  return false;
+          return true;
+      }
+      case kIRIfStmt: {
+          const IRIfStmt* ifStmt = UtStaticCast<const IRIfStmt*>(stmt);
+          return !IsMember(ifStmt->GetCond(), vars) &&
+              CanRename(ifStmt->GetThen(), vars) &&
+              CanRename(ifStmt->GetElse(), vars);
+      }
+      case kIRForLoop: {
+          const IRForLoop* loop = UtStaticCast<const IRForLoop*>(stmt);
+          return !IsMember(loop->GetCond(), vars) &&
+              CanRename(loop->GetCondStmt(), vars) &&
+              CanRename(loop->GetIterateStmt(), vars) &&
+              CanRename(loop->GetBody(), vars);
+      }
+      case kIRCatchStmt:
+          return CanRename(UtStaticCast<const IRCatchStmt*>(stmt)->GetBody(),
+                           vars);
+      default:
+          return false;
+    }
+}
+
+typedef std::map<const IRVar*, IRVar*> VarMap;
+
+// Rename the uses of variables in a statement (see CanRename).
+static void
+Rename(IRStmt* stmt, const VarMap& renamed)
+{
+    switch (stmt->GetKind()) {
+      case kIRBlock: {
+          IRBlock* block = UtStaticCast<IRBlock*>(stmt);
+          IRInsts* insts = block->TakeInsts();
+          for (size_t i = 0; i < insts->size(); ++i) {
+              IRInst* inst = (*insts)[i];
+              IRValues args(inst->GetArgs());
+              bool changed = false;
+              for (size_t j = 0; j < args.size(); ++j) {
+                  VarMap::const_iterator it =
+                      renamed.find(UtCast<const IRVar*>(args[j]));
+                  if (it != renamed.end()) {
+                      args[j] = it->second;
+                      changed = true;
+                  }
+              }
+              if (changed) {
+                  (*insts)[i] = new IRBasicInst(inst->GetOpcode(),
+                                                inst->GetResult(), args,
+                                                inst->GetPos());
+                  delete inst;
+              }
+          }
+          block->SetInsts(insts);
+          break;
+      }
+      case kIRSeq: {
+          IRStmts& stmts = UtStaticCast<IRSeq*>(stmt)->GetStmts();
+          for (size_t i = 0; i < stmts.size(); ++i)
+              Rename(stmts[i], renamed);
+          break;
+      }
+      case kIRIfStmt: {
+          IRIfStmt* ifStmt = UtStaticCast<IRIfStmt*>(stmt);
+          Rename(ifStmt->GetThen(), renamed);
+          Rename(ifStmt->GetElse(), renamed);
+          break;
+      }
+      case kIRForLoop: {
+          IRForLoop* loop = UtStaticCast<IRForLoop*>(stmt);
+          Rename(loop->GetCondStmt(), renamed);
+          Rename(loop->GetIterateStmt(), renamed);
+          Rename(loop->GetBody(), renamed);
+          break;
+      }
+      case kIRCatchStmt:
+          Rename(UtStaticCast<IRCatchStmt*>(stmt)->GetBody(), renamed);
+          break;
+      default:
+          assert(false && "Unexpected statement in renaming");
+          break;
+    }
+}
+
+// Construct a block containing an instruction with one or two arguments.
+static IRBlock*
+NewBlock(const IRPos& pos, Opcode opcode, IRVar* result, IRValue* arg0,
+         IRValue* arg1=NULL)
+{
+    IRValues args(1, arg0);
+    if (arg1)
+        args.push_back(arg1);
+    return new IRBlock(
+        new IRInsts(1, new IRBasicInst(opcode, result, args, pos)));
+}
+
+// Construct a sequence from the given statements, grouping consecutive
+// statements of the same kind.
+static IRStmt*
+GroupByKind(IRStmts* stmts)
+{
+    IRStmts* resultStmts = new IRStmts;
+    IRStmts* currentStmts = new IRStmts;
+    Kind currentKind = kNone;
+    IRStmts::const_iterator it;
+    for (it = stmts->begin(); it != stmts->end(); ++it) {
+        Kind kind = GetKind(*it);
+        if (kind != currentKind && !currentStmts->empty()) {
+            resultStmts->push_back(
+                    MarkWithKind(currentKind, IRSeq::Create(currentStmts)));
+            currentStmts = new IRStmts;
+        }
+        currentKind = kind;
+        currentStmts->push_back(*it);
+    }
+    delete stmts;
+    if (!currentStmts->empty())
+        resultStmts->push_back(
+                MarkWithKind(currentKind, IRSeq::Create(currentStmts)));
+    else
+        delete currentStmts;
+    return MakeSeq(resultStmts);
+}
+
+// Distribute a loop that is only partially compilable (see XfDistribute).
+// The resulting loops have the same number of iterations as the original
+// loop, which must have a constant trip count, and each has a new counter,
+// which is varying in the compiled loop (since uniform instructions in
+// control flow are interpreted).  The original iterate statement becomes the
+// last statement of the body, and the original condition statement follows
+// the loops.  Returns a sequence containing the loops and the initialization
+// of their counters, or the original loop if it can't be distributed.
+IRStmt*
+XfPartitionImpl::Distribute(IRForLoop* loop, const IRStmt* prev)
+{
+    IRVar* counter;
+    int tripCount = GetTripCount(loop, prev, &counter);
+    if (tripCount == 0)
+        return loop;
+
+    // The body must not assign the counter or reference the condition.
+    IRVar* cond = UtStaticCast<IRVar*>(loop->GetCond());
+    XfDefUse body;
+    body.Add(loop->GetBody());
+    if (body.GetDefs().Has(counter) || body.GetDefs().Has(cond) ||
+        body.GetUses().Has(cond))
+        return loop;
+
+    // Split the statements of the body and the iterate statement.
+    IRStmts items;
+    GetLoopItems(loop->GetBody(), &items, false);
+    items.push_back(loop->GetIterateStmt());
+    XfDistribute distribute;
+    for (size_t i = 0; i < items.size(); ++i)
+        distribute.Add(items[i], items[i]->CanCompile());
+    if (!distribute.Split())
+        return loop;
+    bool compiledFirst = distribute.IsCompiledFirst();
+    IRVarSet carried(distribute.GetStartVars());
+    carried += distribute.GetEndVars();
+    for (size_t i = 0; i < items.size(); ++i) {
+        bool isFirst = distribute.InCompiledLoop(i) == compiledFirst;
+        if (!isFirst && !CanRename(items[i], carried))
+            return loop;
+    }
+
+    // Take the statements from the original loop, which is destroyed.
+    IRPos pos = loop->GetPos();
+    IRStmt* condStmt = loop->GetCondStmt();
+    items.clear();
+    GetLoopItems(loop->GetBody(), &items, true);
+    items.push_back(loop->GetIterateStmt());
+    loop->SetCondStmt(new IRBlock);
+    loop->SetBody(new IRBlock);
+    loop->SetIterateStmt(new IRBlock);
+    delete loop;
+    loop = NULL;
+
+    // Construct the counters.
+    IRVar* counters[2];
+    counters[0] = mShader->NewTempVar(IRTypes::GetFloatTy(),
+                                      compiledFirst ? kIRVarying : kIRUniform);
+    counters[1] = mShader->NewTempVar(IRTypes::GetFloatTy(),
+                                      compiledFirst ? kIRUniform : kIRVarying);
+
+    // The first loop stores each carried variable in an array at the start
+    // or end of each iteration, and the second loop loads it into a new
+    // variable, which replaces it in the second loop.  The new variable is
+    // varying in the compiled loop.
+    IRInsts* stores[2] = { new IRInsts, new IRInsts };
+    IRInsts* loads = new IRInsts;
+    VarMap renamed;
+    IRTypes* types = mShader->GetTypeFactory();
+    const IRVarSet* vars[2] = { &distribute.GetStartVars(),
+                                &distribute.GetEndVars() };
+    for (int i = 0; i < 2; ++i) {
+        IRVars sorted;
+        vars[i]->GetSorted(&sorted);
+        for (size_t j = 0; j < sorted.size(); ++j) {
+            IRVar* var = sorted[j];
+            IRVar* array = mShader->NewTempVar(
+                types->GetArrayType(var->GetType(), tripCount),
+                var->GetDetail());
+            IRVar* copy = mShader->NewTempVar(
+                var->GetType(), compiledFirst ? var->GetDetail() : kIRVarying);
+            IRValues args(1, array);
+            args.push_back(counters[0]);
+            args.push_back(var);
+            stores[i]->push_back(
+                new IRBasicInst(kOpcode_ArrayAssign, NULL, args, pos));
+            args.pop_back();
+            args.back() = counters[1];
+            loads->push_back(
+                new IRBasicInst(kOpcode_ArrayRef, copy, args, pos));
+            renamed[var] = copy;
+        }
+    }
+
+    // Construct the bodies of the loops.  The stores and loads have the
+    // kind of their loop.
+    IRStmts* bodies[2] = { new IRStmts, new IRStmts };
+    if (!stores[0]->empty())
+        bodies[0]->push_back(
+            MarkWithKind(compiledFirst ? kCompiled : kNone,
+                         new IRBlock(stores[0])));
+    else
+        delete stores[0];
+    if (!loads->empty())
+        bodies[1]->push_back(
+            MarkWithKind(compiledFirst ? kNone : kCompiled,
+                         new IRBlock(loads)));
+    else
+        delete loads;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (distribute.InCompiledLoop(i) == compiledFirst)
+            bodies[0]->push_back(items[i]);
+        else {
+            Rename(items[i], renamed);
+            bodies[1]->push_back(items[i]);
+        }
+    }
+    if (!stores[1]->empty())
+        bodies[0]->push_back(
+            MarkWithKind(compiledFirst ? kCompiled : kNone,
+                         new IRBlock(stores[1])));
+    else
+        delete stores[1];
+
+    // Construct the loops, each preceded by the initialization of its
+    // counter.  The interpreted loop is omitted if it's empty.
+    float zero = 0.0f, one = 1.0f, count = tripCount;
+    IRValue* zeroConst = mShader->NewNumConst(&zero, IRTypes::GetFloatTy());
+    IRValue* oneConst = mShader->NewNumConst(&one, IRTypes::GetFloatTy());
+    IRValue* countConst = mShader->NewNumConst(&count, IRTypes::GetFloatTy());
+    IRStmts* stmts = new IRStmts;
+    for (int i = 0; i < 2; ++i) {
+        if (bodies[i]->empty()) {
+            delete bodies[i];
+            continue;
+        }
+        IRVar* test = mShader->NewTempVar(cond->GetType(),
+                                          counters[i]->GetDetail());
+        IRStmt* newLoop =
+            new IRForLoop(NewBlock(pos, kOpcode_LT, test, counters[i],
+                                   countConst),
+                          test,
+                          NewBlock(pos, kOpcode_Add, counters[i], counters[i],
+                                   oneConst),
+                          GroupByKind(bodies[i]), pos);
+        IRStmt* init = NewBlock(pos, kOpcode_Assign, counters[i], zeroConst);
+        if ((i == 0) == compiledFirst) {
+            IRForLoop* compiledLoop = UtStaticCast<IRForLoop*>(newLoop);
+            compiledLoop->GetCondStmt()->SetCanCompile();
+            compiledLoop->GetIterateStmt()->SetCanCompile();
+            compiledLoop->GetBody()->SetCanCompile();
+            newLoop->SetCanCompile();
+            init->SetCanCompile();
+        }
+        stmts->push_back(init);
+        stmts->push_back(newLoop);
+    }
+    stmts->push_back(condStmt);
+    return MakeSeq(stmts);
+}
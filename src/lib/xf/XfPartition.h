@@ -6,16 +6,65 @@
 #define XF_PARTITION_H
 
 #include "ir/IRVisitor.h"
+#include "xf/XfPartitionOptions.h"
+class IRInst;
 class IRShader;
+class IRVarSet;
 
 /// Partition the given shader, creating sequences and blocks that can be be
-/// fully compiled.
-void XfPartition(IRShader* shader);
+/// fully compiled.  Uniform instructions, derivatives and texture lookups
+/// are ordinarily interpreted; the options determine which of them are
+/// included in partitions, and whether code is reordered or loops are split
+/// to form larger partitions (see XfPartitionOptions).
+void XfPartition(IRShader* shader,
+                 const XfPartitionOptions& options=XfPartitionOptions());
+
+/// Partition the shader parameter initializers, which XfPartition leaves
+/// alone.  Each initializer is partitioned separately, since the renderer
+/// executes it only when the parameter has no other value.
+void XfPartitionParamInits(IRShader* shader,
+                           const XfPartitionOptions& options=
+                               XfPartitionOptions());
+
+/// Check whether an instruction is a compilable uniform computation, i.e. its
+/// arguments are uniform, and its result or an output argument is uniform.
+bool XfIsUniformInst(const IRInst* inst);
+
+/// Check whether an instruction computes a derivative, which depends on the
+/// values of neighboring points.
+bool XfIsDerivInst(const IRInst* inst);
+
+/// Check whether an instruction is a texture or environment lookup in the
+/// form that code generation can batch: a constant texture name and channel,
+/// followed by varying float coordinates (s and t) or a varying direction.
+/// The result must be a varying float or color.
+bool XfIsBatchTextureInst(const IRInst* inst);
+
+/// Check whether an instruction is applied to the whole grid at once when
+/// it's compiled, i.e. a derivative or a texture lookup.
+bool XfIsGridInst(const IRInst* inst);
+
+/// Collect the variables referenced by the code in a partition, excluding
+/// uniform instructions.
+void XfGetVaryingUses(const IRStmt* stmt, IRVarSet* uses);
 
 /// Implementation of partitioning.  The methods are all public for testing.
 class XfPartitionImpl : public IRVisitor<XfPartitionImpl> {
+private:
+    XfPartitionOptions mOptions;
+    int mDepth;                 // Control flow nesting depth
+    IRShader* mShader;          // For temporaries (see Distribute)
+
 public:
+    XfPartitionImpl(const XfPartitionOptions& options=XfPartitionOptions()) :
+        mOptions(options),
+        mDepth(0),
+        mShader(NULL)
+    {
+    }
+
     void Partition(IRShader* shader);
+    void PartitionParamInits(IRShader* shader);
 
     IRStmt* Partition(IRStmt* stmt) { return Dispatch<IRStmt*>(stmt, 0); }
     IRStmt* Visit(IRBlock* stmt, int ignored);
@@ -28,6 +77,8 @@ public:
     IRStmt* Visit(IRIlluminateStmt* stmt, int ignored);
     IRStmt* Visit(IRCatchStmt* stmt, int ignored);
     IRStmt* Visit(IRPluginCall* stmt, int ignored);
+
+    IRStmt* Distribute(IRForLoop* loop, const IRStmt* prev);
 };
 
 #endif // ndef XF_PARTITION_H
@@ -4,6 +4,7 @@
 
 #include "xf/XfPartitionInfo.h"
 #include "ir/IRShader.h"
+#include "ir/IRShaderParam.h"
 #include "ir/IRStmt.h"
 #include "ir/IRVarSet.h"
 #include "ir/IRVisitor.h"
@@ -29,6 +30,13 @@ public:
         Walk(shader->GetBody(), kWalk);
         if (mPrintReport)
             Report(shader);
+
+        // Record the sizes of any partitions in the shader parameter
+        // initializers (see XfPartitionParamInits).  They're not reported.
+        const IRShaderParams& params = shader->GetParams();
+        IRShaderParams::const_iterator it;
+        for (it = params.begin(); it != params.end(); ++it)
+            Walk((*it)->GetInitStmt(), kWalk);
     }
 
     void Report(const IRShader* shader) {
@@ -0,0 +1,73 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_PARTITION_OPTIONS_H
+#define XF_PARTITION_OPTIONS_H
+
+/// Partitioning options (see XfPartition).  Instrumentation and code
+/// generation must use the same options, otherwise the partition identifiers
+/// won't match (see XfInstrument and XfProfile), so drivers should construct
+/// them once and pass them to both.  The defaults produce the simplest
+/// partitions, which is what the unit tests expect.
+struct XfPartitionOptions {
+    /// Include uniform instructions that are not nested in control flow in
+    /// partitions.  Code generation executes them once per plugin call,
+    /// before the kernel loop, and passes their results to the kernel like
+    /// hoisted uniform arguments.  A partition never contains a uniform
+    /// instruction that assigns a variable referenced by preceding varying
+    /// code in the partition.
+    bool mAllowUniform;
+
+    /// Also partition the shader parameter initializers (see
+    /// XfPartitionParamInits).  Each initializer is partitioned (and
+    /// compiled) separately, since the renderer skips the initializers of
+    /// parameters that have been given values.
+    bool mParamInits;
+
+    /// Include derivative instructions (Du, Dv, Deriv, area and
+    /// calculatenormal) that are not nested in control flow in partitions.
+    /// A partition containing derivatives is compiled into a sequence of
+    /// kernels, each applied to every point of the grid before the
+    /// derivative that follows it (see CgShader::GenGridEntry).  The grid
+    /// topology is obtained from the renderer at run time (see OpGridInfo);
+    /// when it's unavailable, the partition is interpreted instead.
+    bool mAllowDerivs;
+
+    /// Include texture and environment lookups that are not nested in
+    /// control flow in partitions (see XfIsBatchTextureInst).  Like
+    /// derivatives, they split a partition into phases, and each lookup is
+    /// performed for the whole grid in a single request to the texture
+    /// system (see OpTextureSystem), with filter widths computed from the
+    /// neighboring points.  The texture system and the grid topology must
+    /// be installed by the host at run time; otherwise the partition is
+    /// interpreted.
+    bool mAllowTextures;
+
+    /// Reorder independent compiled and interpreted instructions (and
+    /// statements) where dependences allow, so that compiled code is grouped
+    /// into fewer, larger partitions (see XfSchedule).
+    bool mSchedule;
+
+    /// Split loops with constant trip counts that are only partially
+    /// compilable into a compiled loop and an interpreted loop, carrying
+    /// values between them in temporary arrays (see XfDistribute).  The
+    /// initial value, bound and step of the counter must be constants, so
+    /// that the arrays have a fixed length; loops bounded by a shader
+    /// parameter (e.g. a number of octaves) are not split, since resizable
+    /// arrays can't be passed to compiled partitions.
+    bool mDistribute;
+
+    /// Construct default options.
+    XfPartitionOptions() :
+        mAllowUniform(false),
+        mParamInits(false),
+        mAllowDerivs(false),
+        mAllowTextures(false),
+        mSchedule(false),
+        mDistribute(false)
+    {
+    }
+};
+
+#endif // ndef XF_PARTITION_OPTIONS_H
@@ -0,0 +1,89 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "xf/XfProfile.h"
+#include "ir/IRStmt.h"
+#include "util/UtLog.h"
+#include "xf/XfCostModel.h"
+#include <sstream>
+#include <stdio.h>
+
+// Get a stable identifier for a partition, which is an FNV-1a hash of its
+// source position and its printed IR.
+std::string
+XfGetPartitionId(const IRStmt* stmt)
+{
+    std::stringstream text;
+    text << stmt->GetPos() << "\n" << *stmt;
+    const std::string& str = text.str();
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < str.size(); ++i) {
+        hash ^= static_cast<unsigned char>(str[i]);
+        hash *= 16777619u;
+    }
+    char id[16];
+    sprintf(id, "P%08x", hash);
+    return id;
+}
+
+// Load timings from the specified file.
+bool
+XfProfile::Load(const char* filename, UtLog* log)
+{
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        log->Write(kUtError, "Unable to open profile '%s'", filename);
+        return false;
+    }
+    char line[256];
+    int lineNum = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        ++lineNum;
+        char id[128];
+        Entry entry;
+        int numFields = sscanf(line, "%127s %u %lf %lf", id, &entry.mNumCalls,
+                               &entry.mNumPoints, &entry.mSeconds);
+        if (numFields <= 0 || id[0] == '#')
+            continue;
+        if (numFields != 4) {
+            log->WriteWhere(kUtError, filename, lineNum,
+                            "Malformed profile entry");
+            ok = false;
+            continue;
+        }
+        // Accumulate timings, in case several profiles were concatenated.
+        EntryMap::iterator it = mEntries.find(id);
+        if (it == mEntries.end())
+            mEntries[id] = entry;
+        else {
+            it->second.mNumCalls += entry.mNumCalls;
+            it->second.mNumPoints += entry.mNumPoints;
+            it->second.mSeconds += entry.mSeconds;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+// Get the timing of the partition with the given identifier.
+const XfProfile::Entry*
+XfProfile::Find(const std::string& id) const
+{
+    EntryMap::const_iterator it = mEntries.find(id);
+    return it == mEntries.end() ? NULL : &it->second;
+}
+
+// Check whether the given partition should be compiled.
+bool
+XfProfile::ShouldCompile(const IRStmt* stmt, const XfCostModel& model) const
+{
+    const Entry* entry = Find(XfGetPartitionId(stmt));
+    if (entry == NULL || entry->mNumPoints <= 0.0)
+        return false;
+
+    // The cost model is nominally in nanoseconds per point.
+    float measuredCost = entry->mSeconds * 1e9 / entry->mNumPoints;
+    return model.GetBenefit(stmt, measuredCost) > 0.0f;
+}
@@ -0,0 +1,52 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_PROFILE_H
+#define XF_PROFILE_H
+
+#include <map>
+#include <string>
+class IRStmt;
+class UtLog;
+class XfCostModel;
+
+/// Get a stable identifier for a partition, derived from its source position
+/// and contents.  Partitioning is deterministic, so a partition of an
+/// instrumented shader (see XfInstrument) has the same identifier as the
+/// corresponding partition when the shader is later compiled.
+std::string XfGetPartitionId(const IRStmt* stmt);
+
+/// Timings of instrumented partitions, which are recorded by the timer
+/// plugin during a render.  Used to decide which partitions to compile.
+class XfProfile {
+public:
+    /// Timing of a single partition.
+    struct Entry {
+        unsigned int mNumCalls;
+        double mNumPoints;
+        double mSeconds;
+    };
+
+    /// Load timings from the specified file, which has one entry per line:
+    ///     <partition id> <number of calls> <number of points> <seconds>
+    /// Blank lines and lines beginning with '#' are ignored.  Returns false
+    /// (and reports an error) if the file can't be read or is malformed.
+    bool Load(const char* filename, UtLog* log);
+
+    /// Get the timing of the partition with the given identifier, or NULL if
+    /// it was never executed.
+    const Entry* Find(const std::string& id) const;
+
+    /// Check whether the given partition should be compiled.  Partitions that
+    /// weren't executed are not compiled.  Otherwise the measured per-point
+    /// interpreted time is used to predict the benefit of compiling it (see
+    /// XfCostModel::GetBenefit).
+    bool ShouldCompile(const IRStmt* stmt, const XfCostModel& model) const;
+
+private:
+    typedef std::map<std::string, Entry> EntryMap;
+    EntryMap mEntries;
+};
+
+#endif // ndef XF_PROFILE_H
@@ -0,0 +1,276 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "xf/XfResolveSpaces.h"
+#include "ir/IRShader.h"
+#include "ir/IRShaderParam.h"
+#include "ir/IRNumConst.h"
+#include "ir/IRStringConst.h"
+#include "ir/IRValues.h"
+
+void
+XfResolveSpaces(IRShader* shader)
+{
+    XfResolveSpacesImpl().Resolve(shader);
+}
+
+bool
+XfIsNamedSpaceInst(const IRInst* inst)
+{
+    switch (inst->GetOpcode()) {
+      case kOpcode_Transform:
+      case kOpcode_TransformMx:
+      case kOpcode_VTransform:
+      case kOpcode_VTransformMx:
+      case kOpcode_NTransform:
+      case kOpcode_NTransformMx:
+      case kOpcode_MTransform:
+      case kOpcode_MTransformMx: {
+          const IRValues& args = inst->GetArgs();
+          for (size_t i = 0; i < args.size(); ++i) {
+              if (args[i]->GetType()->IsString())
+                  return true;
+          }
+          return false;
+      }
+      default:
+          return false;
+    }
+}
+
+// Constructor.
+XfResolveSpacesImpl::XfResolveSpacesImpl() :
+    mShader(NULL),
+    mIdentity(NULL),
+    mSetup(NULL),
+    mDepth(0)
+{
+}
+
+void
+XfResolveSpacesImpl::Resolve(IRShader* shader)
+{
+    // Hold onto the shader, so we can construct temporaries and constants.
+    mShader = shader;
+    shader->SetBody(ResolveStmt(shader->GetBody()));
+
+    // The renderer skips the initializers of parameters that have been given
+    // values, so each initializer computes its own matrices.
+    const IRShaderParams& params = shader->GetParams();
+    IRShaderParams::const_iterator it;
+    for (it = params.begin(); it != params.end(); ++it)
+        (*it)->SetInitStmt(ResolveStmt((*it)->TakeInitStmt()));
+}
+
+// Resolve the transforms in the given statement, returning a sequence that
+// computes the necessary matrices before executing the statement.
+IRStmt*
+XfResolveSpacesImpl::ResolveStmt(IRStmt* stmt)
+{
+    mMatrices.clear();
+    mBlockMatrices.clear();
+    mSetup = new IRInsts;
+    Dispatch<void>(stmt, 0);
+    if (mSetup->empty()) {
+        delete mSetup;
+        mSetup = NULL;
+        return stmt;
+    }
+    IRStmts* stmts = new IRStmts;
+    stmts->push_back(new IRBlock(mSetup));
+    stmts->push_back(stmt);
+    mSetup = NULL;
+    return new IRSeq(stmts);
+}
+
+// Append the given instruction to a block's instructions.  If it's a
+// transform with constant space names, it's replaced by an equivalent
+// instruction that uses a precomputed matrix, which is preceded by the
+// matrix computation if it's nested in control flow.
+void
+XfResolveSpacesImpl::ResolveInst(IRInst* inst, IRInsts* insts)
+{
+    Opcode opcode = inst->GetOpcode();
+    switch (opcode) {
+      case kOpcode_Transform:
+      case kOpcode_VTransform:
+      case kOpcode_NTransform:
+      case kOpcode_MTransform:
+          break;
+      default:
+          insts->push_back(inst);
+          return;
+    }
+
+    // The space names precede the transformed value.
+    const IRValues& args = inst->GetArgs();
+    IRValues spaces;
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        if (UtCast<const IRStringConst*>(args[i]) == NULL) {
+            insts->push_back(inst);
+            return;
+        }
+        spaces.push_back(args[i]);
+    }
+    if (spaces.empty()) {
+        insts->push_back(inst);
+        return;
+    }
+    IRValue* operand = args.back();
+    IRVar* matrix = GetMatrix(spaces, inst->GetPos(), insts);
+
+    // Points, vectors, and normals are transformed by the matrix variants of
+    // the instructions.  Transforming a matrix is a matrix multiply.
+    IRValues newArgs;
+    switch (opcode) {
+      case kOpcode_Transform: opcode = kOpcode_TransformMx; break;
+      case kOpcode_VTransform: opcode = kOpcode_VTransformMx; break;
+      case kOpcode_NTransform: opcode = kOpcode_NTransformMx; break;
+      default: opcode = kOpcode_Multiply; break;
+    }
+    if (opcode == kOpcode_Multiply) {
+        newArgs.push_back(operand);
+        newArgs.push_back(matrix);
+    }
+    else {
+        newArgs.push_back(matrix);
+        newArgs.push_back(operand);
+    }
+    insts->push_back(
+        new IRBasicInst(opcode, inst->GetResult(), newArgs, inst->GetPos()));
+    delete inst;
+}
+
+// Get a uniform variable holding the matrix for the given space names,
+// generating an instruction to compute it if necessary.  The instruction is
+// added to the setup instructions, unless the current block is nested in
+// control flow, in which case it's appended to the given instructions.
+IRVar*
+XfResolveSpacesImpl::GetMatrix(const IRValues& spaces, const IRPos& pos,
+                               IRInsts* insts)
+{
+    SpaceNames names;
+    IRValues::const_iterator it;
+    for (it = spaces.begin(); it != spaces.end(); ++it)
+        names.push_back(UtStaticCast<const IRStringConst*>(*it)->Get());
+    MatrixMap::const_iterator found = mMatrices.find(names);
+    if (found != mMatrices.end())
+        return found->second;
+    found = mBlockMatrices.find(names);
+    if (found != mBlockMatrices.end())
+        return found->second;
+
+    // Transforming the identity matrix yields the space transformation.
+    if (mIdentity == NULL) {
+        static const float kIdentity[16] = {
+            1, 0, 0, 0,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+            0, 0, 0, 1
+        };
+        mIdentity = mShader->NewNumConst(kIdentity, IRTypes::GetMatrixTy());
+    }
+    IRVar* matrix = mShader->NewTempVar(IRTypes::GetMatrixTy(), kIRUniform);
+    IRValues args(spaces);
+    args.push_back(mIdentity);
+    IRInst* inst = new IRBasicInst(kOpcode_MTransform, matrix, args, pos);
+    if (mDepth == 0) {
+        mSetup->push_back(inst);
+        mMatrices[names] = matrix;
+    }
+    else {
+        insts->push_back(inst);
+        mBlockMatrices[names] = matrix;
+    }
+    return matrix;
+}
+
+void
+XfResolveSpacesImpl::Visit(IRBlock* block, int ignored)
+{
+    mBlockMatrices.clear();
+    IRInsts* insts = block->TakeInsts();
+    IRInsts* newInsts = new IRInsts;
+    newInsts->reserve(insts->size());
+    IRInsts::iterator it;
+    for (it = insts->begin(); it != insts->end(); ++it)
+        ResolveInst(*it, newInsts);
+    delete insts;
+    block->SetInsts(newInsts);
+}
+
+void
+XfResolveSpacesImpl::Visit(IRSeq* seq, int ignored)
+{
+    IRStmts::iterator it;
+    for (it = seq->GetStmts().begin(); it != seq->GetStmts().end(); ++it)
+        Dispatch<void>(*it, 0);
+}
+
+// The statements nested in control flow might not execute, so the matrices
+// of their transforms are not hoisted (see GetMatrix).  This includes the
+// body of a catch statement, which a return might exit early.
+void
+XfResolveSpacesImpl::Visit(IRIfStmt* stmt, int ignored)
+{
+    ++mDepth;
+    Dispatch<void>(stmt->GetThen(), 0);
+    Dispatch<void>(stmt->GetElse(), 0);
+    --mDepth;
+}
+
+void
+XfResolveSpacesImpl::Visit(IRForLoop* loop, int ignored)
+{
+    ++mDepth;
+    Dispatch<void>(loop->GetCondStmt(), 0);
+    Dispatch<void>(loop->GetIterateStmt(), 0);
+    Dispatch<void>(loop->GetBody(), 0);
+    --mDepth;
+}
+
+void
+XfResolveSpacesImpl::Visit(IRCatchStmt* stmt, int ignored)
+{
+    ++mDepth;
+    Dispatch<void>(stmt->GetBody(), 0);
+    --mDepth;
+}
+
+void
+XfResolveSpacesImpl::Visit(IRControlStmt* stmt, int ignored)
+{
+    // No sub-statements, so we're done.
+}
+
+void
+XfResolveSpacesImpl::Visit(IRGatherLoop* loop, int ignored)
+{
+    ++mDepth;
+    Dispatch<void>(loop->GetBody(), 0);
+    Dispatch<void>(loop->GetElseStmt(), 0);
+    --mDepth;
+}
+
+void
+XfResolveSpacesImpl::Visit(IRIlluminanceLoop* loop, int ignored)
+{
+    ++mDepth;
+    Dispatch<void>(loop->GetBody(), 0);
+    --mDepth;
+}
+
+void
+XfResolveSpacesImpl::Visit(IRIlluminateStmt* stmt, int ignored)
+{
+    ++mDepth;
+    Dispatch<void>(stmt->GetBody(), 0);
+    --mDepth;
+}
+
+void
+XfResolveSpacesImpl::Visit(IRPluginCall* stmt, int ignored)
+{
+    // No sub-statements, so we're done.
+}
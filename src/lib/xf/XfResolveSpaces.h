@@ -0,0 +1,69 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_RESOLVE_SPACES_H
+#define XF_RESOLVE_SPACES_H
+
+#include "ir/IRVisitor.h"
+#include <map>
+#include <string>
+#include <vector>
+class IRNumConst;
+class IRShader;
+class IRStringConst;
+
+/// Resolve the named coordinate systems in transform instructions
+/// (transform, vtransform, ntransform and mtransform) to matrices, so the
+/// transforms can be compiled.  The matrix for each distinct combination of
+/// constant space names is computed by a uniform mtransform of the identity
+/// matrix, which the renderer executes once per grid.  The transforms are
+/// rewritten to use the matrix variants (e.g. transform(m, P)).  Transforms
+/// that name spaces with string variables are left alone.
+///
+/// The matrices of transforms that are always executed are computed once,
+/// at the start of the shader body (or parameter initializer).  A transform
+/// that is nested in control flow might never execute (e.g. it's guarded by
+/// a check that the space exists), so its matrix is computed immediately
+/// before it, and shared only by the later transforms in the same block.
+void XfResolveSpaces(IRShader* shader);
+
+/// Check whether an instruction is a transform whose coordinate system is
+/// named by a string, which can't be compiled.  (The matrix variants of the
+/// transform instructions also accept a "from" space name.)
+bool XfIsNamedSpaceInst(const IRInst* inst);
+
+class XfResolveSpacesImpl : public IRVisitor<XfResolveSpacesImpl> {
+private:
+    typedef std::vector<std::string> SpaceNames;
+    typedef std::map<SpaceNames, IRVar*> MatrixMap;
+
+    IRShader* mShader;
+    IRNumConst* mIdentity;      // Created on demand.
+    MatrixMap mMatrices;        // Matrices computed by mSetup.
+    IRInsts* mSetup;            // Instructions that compute the matrices.
+    int mDepth;                 // Nesting depth in control flow.
+    MatrixMap mBlockMatrices;   // Matrices computed in the current block.
+
+public:
+    XfResolveSpacesImpl();
+
+    void Resolve(IRShader* shader);
+    IRStmt* ResolveStmt(IRStmt* stmt);
+    void ResolveInst(IRInst* inst, IRInsts* insts);
+    IRVar* GetMatrix(const IRValues& spaces, const IRPos& pos,
+                     IRInsts* insts);
+
+    void Visit(IRBlock* stmt, int ignored);
+    void Visit(IRSeq* stmt, int ignored);
+    void Visit(IRIfStmt* stmt, int ignored);
+    void Visit(IRForLoop* stmt, int ignored);
+    void Visit(IRCatchStmt* stmt, int ignored);
+    void Visit(IRControlStmt* stmt, int ignored);
+    void Visit(IRGatherLoop* stmt, int ignored);
+    void Visit(IRIlluminanceLoop* stmt, int ignored);
+    void Visit(IRIlluminateStmt* stmt, int ignored);
+    void Visit(IRPluginCall* stmt, int ignored);
+};
+
+#endif // ndef XF_RESOLVE_SPACES_H
@@ -0,0 +1,173 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#include "xf/XfSchedule.h"
+#include "xf/XfDefUse.h"
+#include "xf/XfResolveSpaces.h"
+#include "ir/IRInst.h"
+#include "ops/OpInfo.h"
+#include <algorithm>
+#include <set>
+
+// Get the side effects of an instruction.  Compiled instructions and
+// transforms by named spaces only assign their result and output arguments,
+// as do texture lookups, derivatives, and queries of the renderer and other
+// shaders (message passing).  Other interpreted instructions are barriers,
+// since some of them (e.g. diffuse and specular) run light shaders, which
+// implicitly bind L and Cl.
+XfEffect
+XfGetEffect(const IRInst* inst)
+{
+    Opcode opcode = inst->GetOpcode();
+    switch (opcode) {
+      case kOpcode_Print:
+      case kOpcode_Printf:
+      case kOpcode_Bake3D:
+          return kXfOrdered;
+
+      case kOpcode_Texture:
+      case kOpcode_Texture3D:
+      case kOpcode_Environment:
+      case kOpcode_Shadow:
+      case kOpcode_TextureInfo:
+      case kOpcode_Du:
+      case kOpcode_Dv:
+      case kOpcode_Deriv:
+      case kOpcode_Area:
+      case kOpcode_CalculateNormal:
+      case kOpcode_Attribute:
+      case kOpcode_Option:
+      case kOpcode_RendererInfo:
+      case kOpcode_Surface:
+      case kOpcode_Displacement:
+      case kOpcode_Atmosphere:
+      case kOpcode_LightSource:
+      case kOpcode_Incident:
+      case kOpcode_Opposite:
+          return kXfPure;
+
+      default:
+          break;
+    }
+    if (OpInfo::GetOpName(opcode) != NULL || XfIsNamedSpaceInst(inst))
+        return kXfPure;
+    return kXfBarrier;
+}
+
+// Summarizes an item by the variables it might define and use (see
+// XfDefUse), and the side effects of its instructions.
+class XfScheduleSummary : public XfDefUse {
+public:
+    XfEffect mEffect;
+
+    XfScheduleSummary() : mEffect(kXfPure) { }
+
+    virtual void AddInst(const IRInst* inst)
+    {
+        mEffect = std::max(mEffect, XfGetEffect(inst));
+        XfDefUse::AddInst(inst);
+    }
+};
+
+void
+XfSchedule::Add(const IRInst* inst, int kind)
+{
+    XfScheduleSummary summary;
+    summary.AddInst(inst);
+    AddItem(summary, summary.mEffect, kind);
+}
+
+// Control statements change which points are active in the code that
+// follows, and illuminance, illuminate and gather statements bind L and Cl
+// (or ray hit values), so statements containing them are barriers.
+void
+XfSchedule::Add(const IRStmt* stmt, int kind)
+{
+    XfScheduleSummary summary;
+    summary.Add(stmt);
+    bool isBarrier = summary.HasControl() || summary.HasOpaque();
+    AddItem(summary, isBarrier ? kXfBarrier : summary.mEffect, kind);
+}
+
+void
+XfSchedule::AddItem(const XfDefUse& summary, XfEffect effect, int kind)
+{
+    mItems.push_back(Item());
+    Item& item = mItems.back();
+    item.mKind = kind;
+    item.mEffect = effect;
+    item.mNumInsts = summary.GetNumInsts();
+    item.mDefs = summary.GetDefs();
+    item.mUses = summary.GetUses();
+}
+
+// Check whether an item depends on an earlier item.
+bool
+XfSchedule::DependsOn(size_t later, size_t earlier) const
+{
+    const Item& a = mItems[earlier];
+    const Item& b = mItems[later];
+    if (a.mEffect == kXfBarrier || b.mEffect == kXfBarrier)
+        return true;
+    if (a.mEffect == kXfOrdered && b.mEffect == kXfOrdered)
+        return true;
+    return a.mDefs.Intersects(b.mUses) || a.mDefs.Intersects(b.mDefs) ||
+        a.mUses.Intersects(b.mDefs);
+}
+
+// Get the scheduled order of the items.  Each step takes the first ready item
+// (i.e. whose predecessors have been scheduled) of the current kind,
+// switching to the kind of the first ready item if there is none.
+void
+XfSchedule::GetSchedule(std::vector<size_t>* order) const
+{
+    size_t n = mItems.size();
+    order->reserve(n);
+
+    // There's nothing to do unless the kinds differ.
+    bool sameKind = true;
+    for (size_t i = 1; i < n && sameKind; ++i)
+        sameKind = mItems[i].mKind == mItems[0].mKind;
+    if (sameKind) {
+        for (size_t i = 0; i < n; ++i)
+            order->push_back(i);
+        return;
+    }
+
+    // Construct the dependence graph, counting the predecessors of each item.
+    std::vector<std::vector<size_t> > succs(n);
+    std::vector<size_t> numPreds(n, 0);
+    for (size_t j = 0; j < n; ++j) {
+        for (size_t i = 0; i < j; ++i) {
+            if (DependsOn(j, i)) {
+                succs[i].push_back(j);
+                ++numPreds[j];
+            }
+        }
+    }
+
+    // The ready items are kept in program order.
+    std::set<size_t> ready;
+    for (size_t i = 0; i < n; ++i)
+        if (numPreds[i] == 0)
+            ready.insert(i);
+    int kind = mItems[0].mKind;
+    while (!ready.empty()) {
+        std::set<size_t>::iterator it;
+        for (it = ready.begin(); it != ready.end(); ++it)
+            if (mItems[*it].mKind == kind)
+                break;
+        if (it == ready.end()) {
+            it = ready.begin();
+            kind = mItems[*it].mKind;
+        }
+        size_t i = *it;
+        ready.erase(it);
+        order->push_back(i);
+        for (size_t k = 0; k < succs[i].size(); ++k)
+            if (--numPreds[succs[i][k]] == 0)
+                ready.insert(succs[i][k]);
+    }
+    assert(order->size() == n && "Cyclic dependence graph");
+}
@@ -0,0 +1,107 @@
+// Copyright 2009 Mark Leone (markleone@gmail.com).  All rights reserved.
+// Licensed under the terms of the MIT License.
+// See http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef XF_SCHEDULE_H
+#define XF_SCHEDULE_H
+
+#include "ir/IRTypedefs.h"
+#include "ir/IRVarSet.h"
+#include <vector>
+class IRInst;
+class IRStmt;
+class XfDefUse;
+
+/// The side effects of an instruction or statement, other than assigning its
+/// result and output arguments, which constrain scheduling (see XfSchedule).
+enum XfEffect {
+    kXfPure,            ///< No other effects (e.g. arithmetic, texture)
+    kXfOrdered,         ///< Visible effects (e.g. printf), kept in order
+    kXfBarrier          ///< Unknown effects (e.g. lighting), never reordered
+};
+
+/// Get the side effects of an instruction.  Instructions that implicitly
+/// reference L and Cl (e.g. diffuse) are barriers.
+XfEffect XfGetEffect(const IRInst* inst);
+
+/**
+   Dependence-based scheduling of the instructions in a block or the
+   statements in a sequence.
+
+   Items are added in program order, each with a kind (e.g. compiled vs.
+   interpreted).  Item B depends on an earlier item A if B uses a variable
+   that A defines, or vice versa, or if both define the same variable.
+   Ordered side effects (e.g. printf) depend on each other, and barriers
+   depend on everything.  A statement is summarized by the variables that
+   it might define and use (see XfDefUse); statements containing break,
+   continue or return statements, or illuminance, illuminate and gather
+   statements (which bind L and Cl), are barriers.
+
+   GetSchedule() computes an order that respects the dependences and groups
+   items of the same kind into as few runs as possible, which allows
+   partitioning to construct fewer, larger partitions.  It's a list
+   scheduler that continues with the current kind as long as an item of
+   that kind is ready, taking ready items in program order, so independent
+   items aren't moved unnecessarily.
+*/
+class XfSchedule {
+public:
+    /// Add an instruction with the given kind.
+    void Add(const IRInst* inst, int kind);
+
+    /// Add a statement with the given kind.
+    void Add(const IRStmt* stmt, int kind);
+
+    /// Get the number of items.
+    size_t GetSize() const { return mItems.size(); }
+
+    /// Get the variables that an item might define.
+    const IRVarSet& GetDefs(size_t i) const { return mItems[i].mDefs; }
+
+    /// Get the variables that an item might use.
+    const IRVarSet& GetUses(size_t i) const { return mItems[i].mUses; }
+
+    /// Get the side effects of an item.
+    XfEffect GetEffect(size_t i) const { return mItems[i].mEffect; }
+
+    /// Get the number of instructions in an item.
+    int GetNumInsts(size_t i) const { return mItems[i].mNumInsts; }
+
+    /// Check whether an item depends on an earlier item.
+    bool DependsOn(size_t later, size_t earlier) const;
+
+    /// Get the scheduled order of the items, which is a permutation of their
+    /// indices.
+    void GetSchedule(std::vector<size_t>* order) const;
+
+    /// Reorder instructions or statements in the scheduled order.
+    template<typename T>
+    void Reorder(UtVector<T>* items) const
+    {
+        assert(items->size() == mItems.size() && "Wrong number of items");
+        std::vector<size_t> order;
+        GetSchedule(&order);
+        UtVector<T> scheduled;
+        scheduled.reserve(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            scheduled.push_back((*items)[order[i]]);
+        items->swap(scheduled);
+    }
+
+private:
+    // An instruction or statement, with the variables it might define and
+    // use.
+    struct Item {
+        int mKind;
+        XfEffect mEffect;
+        int mNumInsts;
+        IRVarSet mDefs;
+        IRVarSet mUses;
+    };
+
+    std::vector<Item> mItems;
+
+    void AddItem(const XfDefUse& summary, XfEffect effect, int kind);
+};
+
+#endif // ndef XF_SCHEDULE_H
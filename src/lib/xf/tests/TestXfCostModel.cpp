@@ -0,0 +1,86 @@
+#include "xf/XfCostModel.h"
+#include "ir/IRShader.h"
+#include "slo/SloInputFile.h"
+#include "slo/SloShader.h"
+#include "util/UtLog.h"
+#include "xf/XfInstrument.h"
+#include "xf/XfRaise.h"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+
+class TestXfCostModel : public testing::Test {
+public:
+    UtLog mLog;
+
+    TestXfCostModel() : mLog(stderr) { }
+
+    IRShader* LoadShader(const char* filename) 
+    {
+        SloInputFile in(filename, &mLog);
+        int status = in.Open();
+        assert(status == 0 && "SLO open failed");
+        SloShader slo;
+        status = slo.Read(&in);
+        assert(status == 0 && "SLO read failed");
+        IRShader* shader = XfRaise(slo, &mLog);
+        assert(shader != NULL && "Raising to IR failed");
+        return shader;
+    }
+
+    // Instrument the given shader and return the number of partitions that
+    // the cost model selects for compilation.
+    int CountPartitions(const char* filename, const XfCostModel& model) {
+        IRShader* shader = LoadShader(filename);
+        XfInstrument(shader, &mLog, 1, &model);
+        std::stringstream out;
+        out << *shader;
+        std::string text = out.str();
+        int count = 0;
+        size_t pos = 0;
+        while ((pos = text.find("StartTimer(", pos)) != std::string::npos) {
+            ++count;
+            ++pos;
+        }
+        return count;
+    }
+};
+
+TEST_F(TestXfCostModel, TestLoadSave) {
+    XfCostModel model;
+    model.SetCallCost(100.0f);
+    model.SetArgCost(2.0f);
+    model.SetCosts(kOpcode_Add, 3.0f, 0.25f);
+    EXPECT_TRUE(model.Save("TestXfCostModel.costs", &mLog));
+
+    XfCostModel loaded;
+    EXPECT_TRUE(loaded.Load("TestXfCostModel.costs", &mLog));
+    EXPECT_EQ(100.0f, loaded.GetCallCost());
+    EXPECT_EQ(2.0f, loaded.GetArgCost());
+    EXPECT_EQ(3.0f, loaded.GetInterpCost(kOpcode_Add));
+    EXPECT_EQ(0.25f, loaded.GetCompiledCost(kOpcode_Add));
+    remove("TestXfCostModel.costs");
+}
+
+TEST_F(TestXfCostModel, TestSelection) {
+    // With the default estimates, some partitions are worth compiling.
+    XfCostModel model;
+    int numDefault = CountPartitions("oak.slo", model);
+    std::cout << "Default: " << numDefault << " partitions\n";
+    EXPECT_LT(0, numDefault);
+
+    // Compilation is never worthwhile if it doesn't speed up instructions.
+    for (unsigned int i = 0; i < kOpcode_NumInsts; ++i)
+        model.SetCosts(static_cast<Opcode>(i), 1.0f, 1.0f);
+    model.SetBranchCosts(1.0f, 1.0f);
+    int numNone = CountPartitions("oak.slo", model);
+    std::cout << "No savings: " << numNone << " partitions\n";
+    EXPECT_EQ(0, numNone);
+}
+
+int main(int argc, char **argv) 
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+#include "ir/IRInst.h"
+#include "ir/IRLocalVar.h"
+#include "ir/IRStmts.h"
+#include "ir/IRTypes.h"
+#include "ir/IRValues.h"
+#include "xf/XfDataflow.h"
+#include <gtest/gtest.h>
+#include <iostream>
+
+class TestXfDataflow : public testing::Test {
+public:
+    IRTypes mTypes;
+    IRVarTable mTable;
+    IRLocalVar *x1, *x2, *x3, *x4; // pointers make tests more legible.
+    IRGlobalVars mNoGlobals;
+
+    TestXfDataflow() :
+        // The types of the variables don't matter in this test.
+        x1(new IRLocalVar("x1", mTypes.GetFloatTy(), kIRUniform, "")),
+        x2(new IRLocalVar("x2", mTypes.GetFloatTy(), kIRUniform, "")),
+        x3(new IRLocalVar("x3", mTypes.GetFloatTy(), kIRUniform, "")),
+        x4(new IRLocalVar("x4", mTypes.GetFloatTy(), kIRUniform, ""))
+    {
+        mTable.Add(x1); mTable.Add(x2); mTable.Add(x3); mTable.Add(x4);
+    }
+
+    ~TestXfDataflow()
+    {
+        delete x1; delete x2; delete x3; delete x4;
+    }
+
+    // Construct a block containing "result = assign(arg)".
+    IRBlock* Assign(IRVar* result, IRValue* arg)
+    {
+        return new IRBlock(new IRInsts(1, new IRBasicInst(kOpcode_Assign,
+                                                          result,
+                                                          IRValues(1, arg))));
+    }
+
+    // Construct a loop that tests x4 (computed from x1) and whose iterate
+    // statement assigns x2 to x1.
+    IRForLoop* Loop(IRStmt* body)
+    {
+        return new IRForLoop(Assign(x4, x1), x4, Assign(x1, x2), body,
+                             IRPos());
+    }
+};
+
+TEST_F(TestXfDataflow, TestStar)
+{
+    // Zero or more executions of "x1 = assign(x2)" use x2 and kill nothing.
+    XfTransfer iteration;
+    iteration.mGen += x2;
+    iteration.mKill += x1;
+    XfTransfer star = XfDataflow::Star(iteration);
+    EXPECT_TRUE(star.mGen.Has(x2));
+    EXPECT_TRUE(star.mKill.IsEmpty());
+    std::cout << "TestStar: " << star.mGen << " " << star.mKill << std::endl;
+}
+
+TEST_F(TestXfDataflow, TestLoop)
+{
+    // x3 is used by the body, which assigns x2 for the iterate statement.
+    // x1 is used by the condition statement before it's assigned.
+    IRForLoop* loop = Loop(Assign(x2, x3));
+    IRVarSet live;
+    XfDataflow(mNoGlobals).GetLive(loop, &live);
+    EXPECT_TRUE(live.Has(x1) && live.Has(x3));
+    EXPECT_FALSE(live.Has(x4));
+
+    // x2 is assigned by the body before it's used, unless the loop doesn't
+    // execute.
+    EXPECT_FALSE(live.Has(x2));
+    IRVarSet liveAfter;
+    liveAfter += x2;
+    XfDataflow(mNoGlobals).GetLive(loop, &liveAfter);
+    EXPECT_TRUE(liveAfter.Has(x2));
+    std::cout << "TestLoop: " << live << " " << liveAfter << std::endl;
+    delete loop;
+}
+
+TEST_F(TestXfDataflow, TestSolve)
+{
+    // The iterate statement's use of x2 is live after the body and the
+    // condition statement's use of x1 is live after the iterate statement.
+    IRStmt* body = Assign(x2, x3);
+    IRForLoop* loop = Loop(body);
+    IRSeq seq(new IRStmts(2, loop, Assign(x3, x4)));
+    XfDataflow dataflow(mNoGlobals);
+    dataflow.Solve(&seq, IRVarSet());
+    EXPECT_TRUE(dataflow.GetLiveAfter(loop).Has(x4));
+    EXPECT_TRUE(dataflow.GetLiveAfter(body).Has(x2));
+    EXPECT_TRUE(dataflow.GetLiveAfter(loop->GetIterateStmt()).Has(x1));
+    EXPECT_TRUE(dataflow.GetLiveAfter(loop->GetCondStmt()).Has(x3));
+    std::cout << "TestSolve: "
+              << dataflow.GetLiveAfter(loop) << " "
+              << dataflow.GetLiveAfter(body) << " "
+              << dataflow.GetLiveAfter(loop->GetIterateStmt()) << " "
+              << dataflow.GetLiveAfter(loop->GetCondStmt()) << std::endl;
+}
+
+TEST_F(TestXfDataflow, TestNestedLoops)
+{
+    // Each loop is summarized once, so deeply nested loops are analyzed in
+    // linear time.
+    IRStmt* stmt = Assign(x2, x3);
+    for (int i = 0; i < 64; ++i)
+        stmt = Loop(stmt);
+    IRVarSet live;
+    XfDataflow dataflow(mNoGlobals);
+    dataflow.Solve(stmt, live);
+    dataflow.GetLiveBefore(stmt, &live);
+    EXPECT_TRUE(live.Has(x1) && live.Has(x3));
+    std::cout << "TestNestedLoops: " << live << std::endl;
+    delete stmt;
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
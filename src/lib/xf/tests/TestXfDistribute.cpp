@@ -0,0 +1,415 @@
+#include "ir/IRArrayType.h"
+#include "ir/IRInst.h"
+#include "ir/IRLocalVar.h"
+#include "ir/IRShader.h"
+#include "ir/IRShaderParam.h"
+#include "ir/IRStmts.h"
+#include "ir/IRTypes.h"
+#include "ir/IRValues.h"
+#include "slo/SloInputFile.h"
+#include "slo/SloShader.h"
+#include "util/UtLog.h"
+#include "xf/XfDefUse.h"
+#include "xf/XfDistribute.h"
+#include "xf/XfPartition.h"
+#include "xf/XfRaise.h"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string.h>
+
+class TestXfDistribute : public testing::Test {
+public:
+    IRTypes mTypes;
+    IRVarTable mTable;
+    IRLocalVar *x1, *x2, *x3, *x4; // pointers make tests more legible.
+    IRStmts mStmts;
+    UtLog mLog;
+
+    TestXfDistribute() :
+        // The types of the variables don't matter in this test.
+        x1(new IRLocalVar("x1", mTypes.GetFloatTy(), kIRVarying, "")),
+        x2(new IRLocalVar("x2", mTypes.GetFloatTy(), kIRVarying, "")),
+        x3(new IRLocalVar("x3", mTypes.GetFloatTy(), kIRVarying, "")),
+        x4(new IRLocalVar("x4", mTypes.GetFloatTy(), kIRVarying, "")),
+        mLog(stderr)
+    {
+        mTable.Add(x1); mTable.Add(x2); mTable.Add(x3); mTable.Add(x4);
+    }
+
+    ~TestXfDistribute()
+    {
+        for (size_t i = 0; i < mStmts.size(); ++i)
+            delete mStmts[i];
+        delete x1; delete x2; delete x3; delete x4;
+    }
+
+    // Construct a block containing "result = opcode(arg)", which is deleted
+    // when the test finishes.
+    IRStmt* Block(Opcode opcode, IRVar* result, IRValue* arg)
+    {
+        IRStmt* block = new IRBlock(
+            new IRInsts(1, new IRBasicInst(opcode, result, IRValues(1, arg))));
+        mStmts.push_back(block);
+        return block;
+    }
+
+    // Load a raised shader.  The tests replace its body, since the shader
+    // provides the temporaries that loop distribution requires.
+    IRShader* LoadShader(const char* filename) 
+    {
+        SloInputFile in(filename, &mLog);
+        int status = in.Open();
+        assert(status == 0 && "SLO open failed");
+        SloShader slo;
+        status = slo.Read(&in);
+        assert(status == 0 && "SLO read failed");
+        IRShader* shader = XfRaise(slo, &mLog);
+        assert(shader != NULL && "Raising to IR failed");
+        return shader;
+    }
+
+    // Partition the body of a shader with loop distribution enabled, and
+    // collect the resulting loops and their instructions.
+    void Distribute(IRShader* shader, std::vector<IRForLoop*>* loops,
+                    std::vector<IRInsts>* insts)
+    {
+        XfPartitionOptions options;
+        options.mDistribute = true;
+        XfPartitionImpl(options).Partition(shader);
+        std::cout << *shader->GetBody();
+        GetLoops(shader->GetBody(), loops);
+        insts->resize(loops->size());
+        for (size_t i = 0; i < loops->size(); ++i)
+            GetInsts((*loops)[i]->GetBody(), &(*insts)[i]);
+    }
+
+    // Collect the loops in a sequence.
+    static void GetLoops(IRStmt* stmt, std::vector<IRForLoop*>* loops)
+    {
+        if (IRForLoop* loop = UtCast<IRForLoop*>(stmt))
+            loops->push_back(loop);
+        else if (IRSeq* seq = UtCast<IRSeq*>(stmt))
+            for (size_t i = 0; i < seq->GetStmts().size(); ++i)
+                GetLoops(seq->GetStmts()[i], loops);
+    }
+
+    // Collect the instructions of a statement containing only blocks.
+    static void GetInsts(IRStmt* stmt, IRInsts* insts)
+    {
+        if (IRBlock* block = UtCast<IRBlock*>(stmt))
+            insts->insert(insts->end(), block->GetInsts().begin(),
+                          block->GetInsts().end());
+        else if (IRSeq* seq = UtCast<IRSeq*>(stmt))
+            for (size_t i = 0; i < seq->GetStmts().size(); ++i)
+                GetInsts(seq->GetStmts()[i], insts);
+    }
+
+    // Check that a loop is "for (; lt(counter, n); counter = add(counter,
+    // 1))", and return the counter.
+    static IRVar* GetCounter(const IRForLoop* loop, float n)
+    {
+        IRInsts test, iterate;
+        GetInsts(loop->GetCondStmt(), &test);
+        GetInsts(loop->GetIterateStmt(), &iterate);
+        EXPECT_EQ(1U, test.size());
+        EXPECT_EQ(1U, iterate.size());
+        EXPECT_EQ(kOpcode_LT, test[0]->GetOpcode());
+        EXPECT_EQ(kOpcode_Add, iterate[0]->GetOpcode());
+        IRVar* counter = UtCast<IRVar*>(test[0]->GetArgs()[0]);
+        EXPECT_EQ(counter, iterate[0]->GetResult());
+        EXPECT_EQ(counter, iterate[0]->GetArgs()[0]);
+        EXPECT_EQ(n, UtStaticCast<IRNumConst*>(test[0]->GetArgs()[1])
+                  ->GetFloat());
+        return counter;
+    }
+
+    // Print the loop that each item belongs to, and the carried variables.
+    void Print(const char* name, const XfDistribute& distribute)
+    {
+        std::cout << name << ":";
+        bool compiledFirst = distribute.IsCompiledFirst();
+        for (size_t i = 0; i < distribute.GetSize(); ++i) {
+            bool isFirst = distribute.InCompiledLoop(i) == compiledFirst;
+            std::cout << " " << (isFirst ? 1 : 2);
+        }
+        std::cout << " " << distribute.GetStartVars()
+                  << " " << distribute.GetEndVars() << std::endl;
+    }
+};
+
+TEST_F(TestXfDistribute, TestCompiledFirst)
+{
+    // The texture lookup uses the value of x1 at the end of each iteration,
+    // so the compiled loop is first.
+    XfDistribute distribute;
+    distribute.Add(Block(kOpcode_Sqrt, x1, x2), true);
+    distribute.Add(Block(kOpcode_Texture, x3, x1), false);
+    distribute.Add(Block(kOpcode_Sqrt, x2, x2), true);
+    ASSERT_TRUE(distribute.Split());
+    EXPECT_TRUE(distribute.IsCompiledFirst());
+    EXPECT_TRUE(distribute.InCompiledLoop(0));
+    EXPECT_FALSE(distribute.InCompiledLoop(1));
+    EXPECT_TRUE(distribute.InCompiledLoop(2));
+    EXPECT_TRUE(distribute.GetEndVars().Has(x1));
+    EXPECT_TRUE(distribute.GetStartVars().IsEmpty());
+    Print("TestCompiledFirst", distribute);
+}
+
+TEST_F(TestXfDistribute, TestInterpretedFirst)
+{
+    // An interpreted amplitude update ends each iteration, and the compiled
+    // code uses the amplitude at the start of each iteration, so the
+    // interpreted loop is first.
+    XfDistribute distribute;
+    distribute.Add(Block(kOpcode_Sqrt, x2, x3), true);
+    distribute.Add(Block(kOpcode_Multiply, x4, x1), true);
+    distribute.Add(Block(kOpcode_Assign, x1, x1), false);
+    ASSERT_TRUE(distribute.Split());
+    EXPECT_FALSE(distribute.IsCompiledFirst());
+    EXPECT_TRUE(distribute.InCompiledLoop(0));
+    EXPECT_TRUE(distribute.InCompiledLoop(1));
+    EXPECT_FALSE(distribute.InCompiledLoop(2));
+    EXPECT_TRUE(distribute.GetStartVars().Has(x1));
+    EXPECT_TRUE(distribute.GetEndVars().IsEmpty());
+    Print("TestInterpretedFirst", distribute);
+}
+
+TEST_F(TestXfDistribute, TestCycle)
+{
+    // The compiled code depends on the interpreted code and vice versa, so
+    // the compiled items that are involved are interpreted.
+    XfDistribute distribute;
+    distribute.Add(Block(kOpcode_Sqrt, x2, x1), true);
+    distribute.Add(Block(kOpcode_Texture, x1, x2), false);
+    distribute.Add(Block(kOpcode_Sqrt, x3, x4), true);
+    distribute.Add(Block(kOpcode_Sqrt, x4, x4), true);
+    ASSERT_TRUE(distribute.Split());
+    EXPECT_FALSE(distribute.InCompiledLoop(0));
+    EXPECT_TRUE(distribute.InCompiledLoop(2));
+    EXPECT_TRUE(distribute.InCompiledLoop(3));
+    Print("TestCycle", distribute);
+
+    // Without the independent items, there's nothing to compile.
+    XfDistribute cycle;
+    cycle.Add(Block(kOpcode_Sqrt, x2, x1), true);
+    cycle.Add(Block(kOpcode_Texture, x1, x2), false);
+    EXPECT_FALSE(cycle.Split());
+}
+
+TEST_F(TestXfDistribute, TestMixedUses)
+{
+    // x1 is used before and after it's assigned by the texture lookup, so
+    // it can't be carried.
+    XfDistribute distribute;
+    distribute.Add(Block(kOpcode_Sqrt, x2, x1), true);
+    distribute.Add(Block(kOpcode_Texture, x1, x3), false);
+    distribute.Add(Block(kOpcode_Sqrt, x4, x1), true);
+    EXPECT_FALSE(distribute.Split());
+}
+
+TEST_F(TestXfDistribute, TestBarrier)
+{
+    // Lighting instructions are barriers.
+    XfDistribute distribute;
+    distribute.Add(Block(kOpcode_Sqrt, x1, x2), true);
+    distribute.Add(Block(kOpcode_Diffuse, x3, x4), false);
+    EXPECT_FALSE(distribute.Split());
+}
+
+// Construct a block containing "result = opcode(arg0, arg1)".
+static IRStmt*
+NewBlock(Opcode opcode, IRVar* result, IRValue* arg0, IRValue* arg1=NULL)
+{
+    IRValues args(1, arg0);
+    if (arg1)
+        args.push_back(arg1);
+    return new IRBlock(
+        new IRInsts(1, new IRBasicInst(opcode, result, args)));
+}
+
+// Construct "counter = init; for (; cond; iterate) body" in a shader.
+static void
+SetLoop(IRShader* shader, IRVar* counter, float init, IRStmt* condStmt,
+        IRVar* cond, IRStmt* iterate, IRStmts* body)
+{
+    IRStmts* stmts = new IRStmts;
+    stmts->push_back(NewBlock(kOpcode_Assign, counter,
+                              shader->NewNumConst(&init,
+                                                  IRTypes::GetFloatTy())));
+    stmts->push_back(new IRForLoop(condStmt, cond, iterate, new IRSeq(body),
+                                   IRPos()));
+    delete shader->GetBody();
+    shader->SetBody(new IRSeq(stmts));
+}
+
+TEST_F(TestXfDistribute, TestLoopCompiledFirst)
+{
+    // Distribute "for (i = 0; i < 4; i += 1) { x1 = sqrt(x2);
+    // x3 = texture(x1); x2 = sqrt(x2); }".  The compiled loop saves x1 at
+    // the end of each iteration, and the interpreted loop loads it.
+    IRShader* shader = LoadShader("areacam.slo");
+    IRVar* i = shader->NewTempVar(IRTypes::GetFloatTy(), kIRUniform);
+    IRVar* c = shader->NewTempVar(IRTypes::GetBoolTy(), kIRUniform);
+    IRVar* v1 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    IRVar* v2 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    IRVar* v3 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    float four = 4.0f, one = 1.0f;
+    IRStmts* body = new IRStmts;
+    body->push_back(NewBlock(kOpcode_Sqrt, v1, v2));
+    body->push_back(NewBlock(kOpcode_Texture, v3, v1));
+    body->push_back(NewBlock(kOpcode_Sqrt, v2, v2));
+    SetLoop(shader, i, 0.0f,
+            NewBlock(kOpcode_LT, c, i,
+                     shader->NewNumConst(&four, IRTypes::GetFloatTy())),
+            c,
+            NewBlock(kOpcode_Add, i, i,
+                     shader->NewNumConst(&one, IRTypes::GetFloatTy())),
+            body);
+
+    std::vector<IRForLoop*> loops;
+    std::vector<IRInsts> insts;
+    Distribute(shader, &loops, &insts);
+    ASSERT_EQ(2U, loops.size());
+    EXPECT_TRUE(loops[0]->CanCompile());
+    EXPECT_FALSE(loops[1]->CanCompile());
+    IRVar* counter0 = GetCounter(loops[0], 4.0f);
+    IRVar* counter1 = GetCounter(loops[1], 4.0f);
+    EXPECT_EQ(kIRVarying, counter0->GetDetail());
+    EXPECT_EQ(kIRUniform, counter1->GetDetail());
+
+    // The compiled loop ends with the store, and the interpreted loop
+    // starts with the load and ends with the original iterate statement.
+    ASSERT_EQ(3U, insts[0].size());
+    ASSERT_EQ(3U, insts[1].size());
+    EXPECT_EQ(kOpcode_Sqrt, insts[0][0]->GetOpcode());
+    EXPECT_EQ(kOpcode_Sqrt, insts[0][1]->GetOpcode());
+    const IRInst* store = insts[0][2];
+    const IRInst* load = insts[1][0];
+    ASSERT_EQ(kOpcode_ArrayAssign, store->GetOpcode());
+    ASSERT_EQ(kOpcode_ArrayRef, load->GetOpcode());
+    const IRValue* array = store->GetArgs()[0];
+    EXPECT_EQ(4, UtStaticCast<const IRArrayType*>(array->GetType())
+              ->GetLength());
+    EXPECT_EQ(counter0, store->GetArgs()[1]);
+    EXPECT_EQ(v1, store->GetArgs()[2]);
+    EXPECT_EQ(array, load->GetArgs()[0]);
+    EXPECT_EQ(counter1, load->GetArgs()[1]);
+    EXPECT_EQ(kOpcode_Texture, insts[1][1]->GetOpcode());
+    EXPECT_EQ(load->GetResult(), insts[1][1]->GetArgs()[0]);
+    EXPECT_EQ(kOpcode_Add, insts[1][2]->GetOpcode());
+    EXPECT_EQ(i, insts[1][2]->GetResult());
+
+    // The interpreted loop doesn't reference x1.
+    XfDefUse second;
+    second.Add(loops[1]);
+    EXPECT_FALSE(second.GetUses().Has(v1));
+    EXPECT_FALSE(second.GetDefs().Has(v1));
+    delete shader;
+}
+
+TEST_F(TestXfDistribute, TestLoopInterpretedFirst)
+{
+    // Distribute "for (i = 4; i >= 0; i -= 2) { x1 = sqrt(x2);
+    // x3 = x1 * amp; amp *= 0.5; }", which has three iterations.  The
+    // interpreted loop saves the amplitude at the start of each iteration,
+    // and the compiled loop loads it into a varying variable.
+    IRShader* shader = LoadShader("areacam.slo");
+    IRVar* i = shader->NewTempVar(IRTypes::GetFloatTy(), kIRUniform);
+    IRVar* c = shader->NewTempVar(IRTypes::GetBoolTy(), kIRUniform);
+    IRVar* amp = shader->NewTempVar(IRTypes::GetFloatTy(), kIRUniform);
+    IRVar* v1 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    IRVar* v2 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    IRVar* v3 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    float zero = 0.0f, two = 2.0f, half = 0.5f;
+    IRStmts* body = new IRStmts;
+    body->push_back(NewBlock(kOpcode_Sqrt, v1, v2));
+    body->push_back(NewBlock(kOpcode_Multiply, v3, v1, amp));
+    body->push_back(NewBlock(kOpcode_Multiply, amp, amp,
+                             shader->NewNumConst(&half,
+                                                 IRTypes::GetFloatTy())));
+    SetLoop(shader, i, 4.0f,
+            NewBlock(kOpcode_GE, c, i,
+                     shader->NewNumConst(&zero, IRTypes::GetFloatTy())),
+            c,
+            NewBlock(kOpcode_Subtract, i, i,
+                     shader->NewNumConst(&two, IRTypes::GetFloatTy())),
+            body);
+
+    std::vector<IRForLoop*> loops;
+    std::vector<IRInsts> insts;
+    Distribute(shader, &loops, &insts);
+    ASSERT_EQ(2U, loops.size());
+    EXPECT_FALSE(loops[0]->CanCompile());
+    EXPECT_TRUE(loops[1]->CanCompile());
+    IRVar* counter0 = GetCounter(loops[0], 3.0f);
+    IRVar* counter1 = GetCounter(loops[1], 3.0f);
+    EXPECT_EQ(kIRUniform, counter0->GetDetail());
+    EXPECT_EQ(kIRVarying, counter1->GetDetail());
+
+    // The interpreted loop starts with the store, followed by the
+    // amplitude update and the original iterate statement.  The compiled
+    // loop starts with the load.
+    ASSERT_EQ(3U, insts[0].size());
+    ASSERT_EQ(3U, insts[1].size());
+    const IRInst* store = insts[0][0];
+    const IRInst* load = insts[1][0];
+    ASSERT_EQ(kOpcode_ArrayAssign, store->GetOpcode());
+    ASSERT_EQ(kOpcode_ArrayRef, load->GetOpcode());
+    EXPECT_EQ(counter0, store->GetArgs()[1]);
+    EXPECT_EQ(amp, store->GetArgs()[2]);
+    EXPECT_EQ(store->GetArgs()[0], load->GetArgs()[0]);
+    EXPECT_EQ(counter1, load->GetArgs()[1]);
+    EXPECT_EQ(kIRVarying, load->GetResult()->GetDetail());
+    EXPECT_EQ(amp, insts[0][1]->GetResult());
+    EXPECT_EQ(i, insts[0][2]->GetResult());
+    EXPECT_EQ(kOpcode_Sqrt, insts[1][1]->GetOpcode());
+    EXPECT_EQ(kOpcode_Multiply, insts[1][2]->GetOpcode());
+    EXPECT_EQ(load->GetResult(), insts[1][2]->GetArgs()[1]);
+
+    // The compiled loop doesn't reference the amplitude.
+    XfDefUse second;
+    second.Add(loops[1]);
+    EXPECT_FALSE(second.GetUses().Has(amp));
+    EXPECT_FALSE(second.GetDefs().Has(amp));
+    delete shader;
+}
+
+TEST_F(TestXfDistribute, TestLoopParamBound)
+{
+    // A loop bounded by a shader parameter has no constant trip count, so
+    // it's not distributed (see XfPartitionOptions::mDistribute).
+    IRShader* shader = LoadShader("areacam.slo");
+    IRVar* bound = NULL;
+    const IRShaderParams& params = shader->GetParams();
+    for (size_t j = 0; j < params.size(); ++j)
+        if (strcmp(params[j]->GetFullName(), "use_Eref") == 0)
+            bound = params[j];
+    ASSERT_TRUE(bound != NULL);
+    IRVar* i = shader->NewTempVar(IRTypes::GetFloatTy(), kIRUniform);
+    IRVar* c = shader->NewTempVar(IRTypes::GetBoolTy(), kIRUniform);
+    IRVar* v1 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    IRVar* v2 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    IRVar* v3 = shader->NewTempVar(IRTypes::GetFloatTy(), kIRVarying);
+    float one = 1.0f;
+    IRStmts* body = new IRStmts;
+    body->push_back(NewBlock(kOpcode_Sqrt, v1, v2));
+    body->push_back(NewBlock(kOpcode_Texture, v3, v1));
+    body->push_back(NewBlock(kOpcode_Sqrt, v2, v2));
+    SetLoop(shader, i, 0.0f, NewBlock(kOpcode_LT, c, i, bound), c,
+            NewBlock(kOpcode_Add, i, i,
+                     shader->NewNumConst(&one, IRTypes::GetFloatTy())),
+            body);
+
+    std::vector<IRForLoop*> loops;
+    std::vector<IRInsts> insts;
+    Distribute(shader, &loops, &insts);
+    ASSERT_EQ(1U, loops.size());
+    EXPECT_FALSE(loops[0]->CanCompile());
+    EXPECT_EQ(3U, insts[0].size());
+    delete shader;
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -18,6 +18,7 @@ class TestXfFreeVars : public testing::Test {
 public:
     UtLog mLog;
     IRTypes mTypes;
+    IRVarTable mTable;
     IRLocalVar *x1, *x2, *x3, *x4; // pointers make tests more legible.
 
     TestXfFreeVars() :
@@ -28,6 +29,7 @@ public:
         x3(new IRLocalVar("x3", mTypes.GetFloatTy(), kIRVarying, "")),
         x4(new IRLocalVar("x4", mTypes.GetFloatTy(), kIRVarying, ""))
     {
+        mTable.Add(x1); mTable.Add(x2); mTable.Add(x3); mTable.Add(x4);
     }
 
     ~TestXfFreeVars() 
@@ -64,7 +66,7 @@ TEST_F(TestXfFreeVars, TestAssign)
 {
     IRBasicInst inst(kOpcode_Assign, x1, IRValues(2, x2, x3));
     IRVarSet live;
-    XfFreeVarsImpl().Analyze(&inst, &live);
+    XfFreeVarsImpl().GetLive(&inst, &live);
     EXPECT_TRUE(live.Has(x2) && live.Has(x3));
     EXPECT_FALSE(live.Has(x1));
     std::cout << "TestAssign: " << live << std::endl;
@@ -75,7 +77,7 @@ TEST_F(TestXfFreeVars, TestArrayAssign)
     // Types of arguments don't matter, so we play it loose.
     IRBasicInst inst(kOpcode_ArrayAssign, NULL, IRValues(3, x1, x2, x3));
     IRVarSet live;
-    XfFreeVarsImpl().Analyze(&inst, &live);
+    XfFreeVarsImpl().GetLive(&inst, &live);
     EXPECT_TRUE(live.Has(x1));
     std::cout << "TestArrayAssign: " << live << std::endl;
 }
@@ -87,7 +89,7 @@ TEST_F(TestXfFreeVars, TestArgKill)
     // kill its output because the specified name might not exit.
     IRBasicInst inst(kOpcode_LightSource, x1, IRValues(2, x2, x3));
     IRVarSet live;
-    XfFreeVarsImpl().Analyze(&inst, &live);
+    XfFreeVarsImpl().GetLive(&inst, &live);
     EXPECT_FALSE(live.Has(x1));
     EXPECT_TRUE(live.Has(x2));
     EXPECT_TRUE(live.Has(x3));  // note: the output, x3, is not killed!
@@ -100,8 +102,8 @@ TEST_F(TestXfFreeVars, TestAssignKill)
     IRBasicInst inst1(kOpcode_Assign, x1, IRValues(1, x2));
     IRBasicInst inst2(kOpcode_Assign, x3, IRValues(1, x1));
     IRVarSet live;
-    XfFreeVarsImpl().Analyze(&inst2, &live);
-    XfFreeVarsImpl().Analyze(&inst1, &live);
+    XfFreeVarsImpl().GetLive(&inst2, &live);
+    XfFreeVarsImpl().GetLive(&inst1, &live);
     EXPECT_FALSE(live.Has(x1));
     EXPECT_TRUE(live.Has(x2));
     EXPECT_FALSE(live.Has(x3));
@@ -115,7 +117,7 @@ TEST_F(TestXfFreeVars, TestBlock)
     IRInst* inst2 = new IRBasicInst(kOpcode_Assign, x3, IRValues(1, x1));
     IRBlock block(new IRInsts(2, inst1, inst2));
     IRVarSet live;
-    XfFreeVarsImpl().Visit(&block, &live);
+    XfFreeVarsImpl().GetLive(&block, &live);
     EXPECT_FALSE(live.Has(x1));
     EXPECT_TRUE(live.Has(x2));
     EXPECT_FALSE(live.Has(x3));
@@ -130,7 +132,7 @@ TEST_F(TestXfFreeVars, TestSeq)
     IRBlock* block2 = new IRBlock(new IRInsts(1, inst2));
     IRSeq seq(new IRStmts(2, block1, block2));
     IRVarSet live;
-    XfFreeVarsImpl().Visit(&seq, &live);
+    XfFreeVarsImpl().GetLive(&seq, &live);
     EXPECT_FALSE(live.Has(x1));
     EXPECT_TRUE(live.Has(x2));
     EXPECT_FALSE(live.Has(x3));
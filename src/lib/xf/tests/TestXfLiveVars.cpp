@@ -16,6 +16,7 @@ class TestXfLiveVars : public testing::Test {
 public:
     UtLog mLog;
     IRTypes mTypes;
+    IRVarTable mTable;
     IRLocalVar *x1, *x2, *x3, *x4; // pointers make tests more legible.
     IRGlobalVars mNoGlobals;
 
@@ -27,6 +28,7 @@ public:
         x3(new IRLocalVar("x3", mTypes.GetFloatTy(), kIRUniform, "")),
         x4(new IRLocalVar("x4", mTypes.GetFloatTy(), kIRUniform, ""))
     {
+        mTable.Add(x1); mTable.Add(x2); mTable.Add(x3); mTable.Add(x4);
     }
 
     ~TestXfLiveVars() 
@@ -116,7 +118,7 @@ TEST_F(TestXfLiveVars, TestBlock)
     IRInst* inst2 = new IRBasicInst(kOpcode_Assign, x3, IRValues(1, x1));
     IRBlock block(new IRInsts(2, inst1, inst2));
     IRVarSet live;
-    XfLiveVarsImpl(mNoGlobals).Visit(&block, &live);
+    XfLiveVarsImpl(mNoGlobals).GetLive(&block, &live);
     EXPECT_FALSE(live.Has(x1));
     EXPECT_TRUE(live.Has(x2));
     EXPECT_FALSE(live.Has(x3));
@@ -131,7 +133,7 @@ TEST_F(TestXfLiveVars, TestSeq)
     IRBlock* block2 = new IRBlock(new IRInsts(1, inst2));
     IRSeq seq(new IRStmts(2, block1, block2));
     IRVarSet live;
-    XfLiveVarsImpl(mNoGlobals).Visit(&seq, &live);
+    XfLiveVarsImpl(mNoGlobals).GetLive(&seq, &live);
     EXPECT_FALSE(live.Has(x1));
     EXPECT_TRUE(live.Has(x2));
     EXPECT_FALSE(live.Has(x3));
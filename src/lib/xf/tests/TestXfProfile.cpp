@@ -0,0 +1,124 @@
+#include "xf/XfProfile.h"
+#include "ir/IRShader.h"
+#include "ir/IRStmts.h"
+#include "slo/SloInputFile.h"
+#include "slo/SloShader.h"
+#include "util/UtCast.h"
+#include "util/UtLog.h"
+#include "xf/XfCostModel.h"
+#include "xf/XfFreeVars.h"
+#include "xf/XfPartition.h"
+#include "xf/XfRaise.h"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <stdio.h>
+
+class TestXfProfile : public testing::Test {
+public:
+    UtLog mLog;
+
+    TestXfProfile() : mLog(stderr) { }
+
+    IRShader* LoadShader(const char* filename) 
+    {
+        SloInputFile in(filename, &mLog);
+        int status = in.Open();
+        assert(status == 0 && "SLO open failed");
+        SloShader slo;
+        status = slo.Read(&in);
+        assert(status == 0 && "SLO read failed");
+        IRShader* shader = XfRaise(slo, &mLog);
+        assert(shader != NULL && "Raising to IR failed");
+        XfPartition(shader);
+        XfFreeVars(shader);
+        return shader;
+    }
+
+    // Collect the non-empty partitions of the given statement.
+    void GetPartitions(IRStmt* stmt, IRStmts* partitions) {
+        if (stmt->CanCompile()) {
+            if (stmt->GetNumInsts() != 0)
+                partitions->push_back(stmt);
+            return;
+        }
+        switch (stmt->GetKind()) {
+          case kIRSeq: {
+              const IRStmts& stmts = UtStaticCast<IRSeq*>(stmt)->GetStmts();
+              IRStmts::const_iterator it;
+              for (it = stmts.begin(); it != stmts.end(); ++it)
+                  GetPartitions(*it, partitions);
+              break;
+          }
+          case kIRIfStmt: {
+              IRIfStmt* ifStmt = UtStaticCast<IRIfStmt*>(stmt);
+              GetPartitions(ifStmt->GetThen(), partitions);
+              GetPartitions(ifStmt->GetElse(), partitions);
+              break;
+          }
+          case kIRForLoop:
+              GetPartitions(UtStaticCast<IRForLoop*>(stmt)->GetBody(),
+                            partitions);
+              break;
+          default:
+              break;
+        }
+    }
+};
+
+TEST_F(TestXfProfile, TestPartitionIds) {
+    // Partition identifiers are stable and distinct.
+    IRShader* shader1 = LoadShader("oak.slo");
+    IRShader* shader2 = LoadShader("oak.slo");
+    IRStmts partitions1, partitions2;
+    GetPartitions(shader1->GetBody(), &partitions1);
+    GetPartitions(shader2->GetBody(), &partitions2);
+    ASSERT_EQ(partitions1.size(), partitions2.size());
+    ASSERT_LT(1U, partitions1.size());
+    for (size_t i = 0; i < partitions1.size(); ++i) {
+        std::string id = XfGetPartitionId(partitions1[i]);
+        EXPECT_EQ(id, XfGetPartitionId(partitions2[i]));
+        if (i > 0)
+            EXPECT_NE(id, XfGetPartitionId(partitions1[i-1]));
+    }
+}
+
+TEST_F(TestXfProfile, TestShouldCompile) {
+    IRShader* shader = LoadShader("oak.slo");
+    IRStmts partitions;
+    GetPartitions(shader->GetBody(), &partitions);
+    ASSERT_LT(1U, partitions.size());
+
+    // Profile the first partition as expensive and the second as cheap,
+    // splitting the latter across two entries.
+    std::string id0 = XfGetPartitionId(partitions[0]);
+    std::string id1 = XfGetPartitionId(partitions[1]);
+    FILE* file = fopen("TestXfProfile.prof", "w");
+    ASSERT_TRUE(file != NULL);
+    fprintf(file, "# Test profile\n");
+    fprintf(file, "%s 10 1000 0.01\n", id0.c_str());
+    fprintf(file, "%s 10 1000 0.000000001\n", id1.c_str());
+    fprintf(file, "%s 10 1000 0.000000001\n", id1.c_str());
+    fclose(file);
+
+    XfProfile profile;
+    EXPECT_TRUE(profile.Load("TestXfProfile.prof", &mLog));
+    remove("TestXfProfile.prof");
+    const XfProfile::Entry* entry = profile.Find(id1);
+    ASSERT_TRUE(entry != NULL);
+    EXPECT_EQ(20U, entry->mNumCalls);
+    EXPECT_EQ(2000.0, entry->mNumPoints);
+
+    XfCostModel model;
+    EXPECT_TRUE(profile.ShouldCompile(partitions[0], model));
+    EXPECT_FALSE(profile.ShouldCompile(partitions[1], model));
+
+    // Partitions that weren't profiled are not compiled.
+    for (size_t i = 2; i < partitions.size(); ++i)
+        EXPECT_FALSE(profile.ShouldCompile(partitions[i], model));
+}
+
+int main(int argc, char **argv) 
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
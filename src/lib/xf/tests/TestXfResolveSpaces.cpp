@@ -0,0 +1,104 @@
+#include "xf/XfResolveSpaces.h"
+#include "ir/IRShader.h"
+#include "ir/IRStmts.h"
+#include "ir/IRStringConst.h"
+#include "ir/IRTypes.h"
+#include "ir/IRValues.h"
+#include "slo/SloInputFile.h"
+#include "slo/SloShader.h"
+#include "util/UtLog.h"
+#include "xf/XfRaise.h"
+#include <gtest/gtest.h>
+#include <iostream>
+
+class TestXfResolveSpaces : public testing::Test {
+public:
+    UtLog mLog;
+
+    TestXfResolveSpaces() : mLog(stderr) { }
+
+    IRShader* LoadShader(const char* filename) 
+    {
+        SloInputFile in(filename, &mLog);
+        int status = in.Open();
+        assert(status == 0 && "SLO open failed");
+        SloShader slo;
+        status = slo.Read(&in);
+        assert(status == 0 && "SLO read failed");
+        IRShader* shader = XfRaise(slo, &mLog);
+        assert(shader != NULL && "Raising to IR failed");
+        return shader;
+    }
+
+    void TestResolve(const char* filename) {
+        std::cout << "---------- " << filename << " ----------\n";
+        IRShader* shader = LoadShader(filename);
+        XfResolveSpaces(shader);
+        std::cout << *shader;
+        delete shader;
+    }
+};
+
+TEST_F(TestXfResolveSpaces, TestAreaCam) {
+    TestResolve("areacam.slo");
+}
+
+// Construct "result = op(space, operand)".
+static IRInst*
+Transform(Opcode op, IRVar* result, IRValue* space, IRValue* operand)
+{
+    IRValues args;
+    args.push_back(space);
+    args.push_back(operand);
+    return new IRBasicInst(op, result, args);
+}
+
+TEST_F(TestXfResolveSpaces, TestConditional) {
+    // The "world" matrix is hoisted to the start of the body.  The "camera"
+    // matrix is only needed if the condition holds, so it's computed in the
+    // "then" block, once for both transforms.  The body of a raised shader
+    // is replaced, since the shader provides the temporaries.
+    IRShader* shader = LoadShader("areacam.slo");
+    delete shader->GetBody();
+    IRVar* p = shader->NewTempVar(IRTypes::GetPointTy(), kIRVarying);
+    IRVar* q = shader->NewTempVar(IRTypes::GetPointTy(), kIRVarying);
+    IRVar* b = shader->NewTempVar(IRTypes::GetBoolTy(), kIRUniform);
+    IRStringConst* world = shader->NewStringConst("world");
+    IRStringConst* camera = shader->NewStringConst("camera");
+
+    IRInsts* thenInsts = new IRInsts;
+    thenInsts->push_back(Transform(kOpcode_Transform, q, camera, p));
+    thenInsts->push_back(Transform(kOpcode_VTransform, q, camera, q));
+    IRStmts* stmts = new IRStmts;
+    stmts->push_back(new IRBlock(
+        new IRInsts(1, Transform(kOpcode_Transform, p, world, p))));
+    stmts->push_back(new IRIfStmt(b, new IRBlock(thenInsts), new IRSeq,
+                                  IRPos()));
+    shader->SetBody(new IRSeq(stmts));
+    XfResolveSpaces(shader);
+    std::cout << *shader->GetBody();
+
+    const IRStmts& body = UtStaticCast<IRSeq*>(shader->GetBody())->GetStmts();
+    ASSERT_EQ(2U, body.size());
+    const IRInsts& setup = UtStaticCast<IRBlock*>(body[0])->GetInsts();
+    ASSERT_EQ(1U, setup.size());
+    EXPECT_EQ(world, setup[0]->GetArgs()[0]);
+    const IRStmts& rest = UtStaticCast<IRSeq*>(body[1])->GetStmts();
+    const IRIfStmt* ifStmt = UtStaticCast<const IRIfStmt*>(rest[1]);
+    const IRInsts& insts =
+        UtStaticCast<const IRBlock*>(ifStmt->GetThen())->GetInsts();
+    ASSERT_EQ(3U, insts.size());
+    EXPECT_EQ(kOpcode_MTransform, insts[0]->GetOpcode());
+    EXPECT_EQ(camera, insts[0]->GetArgs()[0]);
+    EXPECT_EQ(kOpcode_TransformMx, insts[1]->GetOpcode());
+    EXPECT_EQ(kOpcode_VTransformMx, insts[2]->GetOpcode());
+    EXPECT_EQ(insts[0]->GetResult(), insts[1]->GetArgs()[0]);
+    EXPECT_EQ(insts[0]->GetResult(), insts[2]->GetArgs()[0]);
+    delete shader;
+}
+
+int main(int argc, char **argv) 
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
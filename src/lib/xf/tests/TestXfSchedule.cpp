@@ -0,0 +1,170 @@
+#include "ir/IRInst.h"
+#include "ir/IRLocalVar.h"
+#include "ir/IRStmts.h"
+#include "ir/IRTypes.h"
+#include "ir/IRValues.h"
+#include "xf/XfSchedule.h"
+#include <gtest/gtest.h>
+#include <iostream>
+
+class TestXfSchedule : public testing::Test {
+public:
+    IRTypes mTypes;
+    IRVarTable mTable;
+    IRLocalVar *x1, *x2, *x3, *x4; // pointers make tests more legible.
+    IRInsts mInsts;
+
+    enum { kCompiled, kInterpreted };
+
+    TestXfSchedule() :
+        // The types of the variables don't matter in this test.
+        x1(new IRLocalVar("x1", mTypes.GetFloatTy(), kIRVarying, "")),
+        x2(new IRLocalVar("x2", mTypes.GetFloatTy(), kIRVarying, "")),
+        x3(new IRLocalVar("x3", mTypes.GetFloatTy(), kIRVarying, "")),
+        x4(new IRLocalVar("x4", mTypes.GetFloatTy(), kIRVarying, ""))
+    {
+        mTable.Add(x1); mTable.Add(x2); mTable.Add(x3); mTable.Add(x4);
+    }
+
+    ~TestXfSchedule()
+    {
+        for (size_t i = 0; i < mInsts.size(); ++i)
+            delete mInsts[i];
+        delete x1; delete x2; delete x3; delete x4;
+    }
+
+    // Construct an instruction "result = opcode(arg)", which is deleted when
+    // the test finishes.
+    IRInst* Inst(Opcode opcode, IRVar* result, IRValue* arg)
+    {
+        IRInst* inst = new IRBasicInst(opcode, result, IRValues(1, arg));
+        mInsts.push_back(inst);
+        return inst;
+    }
+
+    // Construct a block containing "result = assign(arg)".
+    IRBlock* Block(IRVar* result, IRValue* arg)
+    {
+        return new IRBlock(new IRInsts(1, new IRBasicInst(kOpcode_Assign,
+                                                          result,
+                                                          IRValues(1, arg))));
+    }
+
+    // Print the scheduled order.
+    void Print(const char* name, const XfSchedule& schedule)
+    {
+        std::vector<size_t> order;
+        schedule.GetSchedule(&order);
+        std::cout << name << ":";
+        for (size_t i = 0; i < order.size(); ++i)
+            std::cout << " " << order[i];
+        std::cout << std::endl;
+    }
+};
+
+TEST_F(TestXfSchedule, TestIndependent)
+{
+    // The texture lookup is moved after the compiled instructions, which
+    // don't depend on it.
+    XfSchedule schedule;
+    schedule.Add(Inst(kOpcode_Assign, x1, x2), kCompiled);
+    schedule.Add(Inst(kOpcode_Texture, x3, x2), kInterpreted);
+    schedule.Add(Inst(kOpcode_Assign, x4, x1), kCompiled);
+    EXPECT_FALSE(schedule.DependsOn(1, 0));
+    EXPECT_FALSE(schedule.DependsOn(2, 1));
+    EXPECT_TRUE(schedule.DependsOn(2, 0));
+    std::vector<size_t> order;
+    schedule.GetSchedule(&order);
+    ASSERT_EQ(3U, order.size());
+    EXPECT_EQ(0U, order[0]);
+    EXPECT_EQ(2U, order[1]);
+    EXPECT_EQ(1U, order[2]);
+    Print("TestIndependent", schedule);
+}
+
+TEST_F(TestXfSchedule, TestDependent)
+{
+    // The last instruction uses the texture result, and the texture lookup
+    // must not be moved before the assignment of its coordinate.
+    XfSchedule schedule;
+    schedule.Add(Inst(kOpcode_Assign, x1, x2), kCompiled);
+    schedule.Add(Inst(kOpcode_Texture, x3, x1), kInterpreted);
+    schedule.Add(Inst(kOpcode_Assign, x4, x3), kCompiled);
+    std::vector<size_t> order;
+    schedule.GetSchedule(&order);
+    ASSERT_EQ(3U, order.size());
+    EXPECT_EQ(0U, order[0]);
+    EXPECT_EQ(1U, order[1]);
+    EXPECT_EQ(2U, order[2]);
+    Print("TestDependent", schedule);
+
+    // Likewise, a variable that the texture lookup uses must not be
+    // reassigned before it.
+    XfSchedule antiSchedule;
+    antiSchedule.Add(Inst(kOpcode_Texture, x3, x1), kInterpreted);
+    antiSchedule.Add(Inst(kOpcode_Assign, x1, x2), kCompiled);
+    EXPECT_TRUE(antiSchedule.DependsOn(1, 0));
+}
+
+TEST_F(TestXfSchedule, TestPrintf)
+{
+    // Print statements remain in order, but compiled code can move past
+    // them.
+    XfSchedule schedule;
+    schedule.Add(Inst(kOpcode_Printf, NULL, x1), kInterpreted);
+    schedule.Add(Inst(kOpcode_Assign, x2, x3), kCompiled);
+    schedule.Add(Inst(kOpcode_Printf, NULL, x4), kInterpreted);
+    EXPECT_TRUE(schedule.DependsOn(2, 0));
+    EXPECT_FALSE(schedule.DependsOn(1, 0));
+    std::vector<size_t> order;
+    schedule.GetSchedule(&order);
+    ASSERT_EQ(3U, order.size());
+    EXPECT_EQ(0U, order[0]);
+    EXPECT_EQ(2U, order[1]);
+    EXPECT_EQ(1U, order[2]);
+    Print("TestPrintf", schedule);
+}
+
+TEST_F(TestXfSchedule, TestBarrier)
+{
+    // Lighting instructions implicitly bind L and Cl, so nothing moves past
+    // them.
+    XfSchedule schedule;
+    schedule.Add(Inst(kOpcode_Assign, x1, x2), kCompiled);
+    schedule.Add(Inst(kOpcode_Diffuse, x3, x4), kInterpreted);
+    schedule.Add(Inst(kOpcode_Assign, x2, x4), kCompiled);
+    EXPECT_TRUE(schedule.DependsOn(2, 1));
+    EXPECT_EQ(kXfBarrier, XfGetEffect(mInsts[1]));
+    std::vector<size_t> order;
+    schedule.GetSchedule(&order);
+    ASSERT_EQ(3U, order.size());
+    EXPECT_EQ(1U, order[1]);
+    Print("TestBarrier", schedule);
+}
+
+TEST_F(TestXfSchedule, TestStmts)
+{
+    // A statement is summarized by the variables it might define and use,
+    // and one containing a control statement is a barrier.
+    IRIfStmt ifStmt(x4, Block(x1, x2), new IRBlock, IRPos());
+    IRCatchStmt catchStmt(NULL, IRPos());
+    catchStmt.SetBody(
+        new IRSeq(new IRStmts(2, Block(x3, x1),
+                              new IRControlStmt(kOpcode_Return, &catchStmt,
+                                                IRPos()))));
+    XfSchedule schedule;
+    schedule.Add(&ifStmt, kInterpreted);
+    schedule.Add(Inst(kOpcode_Texture, x2, x3), kCompiled);
+    schedule.Add(Inst(kOpcode_Assign, x4, x3), kCompiled);
+    schedule.Add(&catchStmt, kInterpreted);
+    EXPECT_TRUE(schedule.DependsOn(1, 0));
+    EXPECT_FALSE(schedule.DependsOn(2, 1));
+    EXPECT_TRUE(schedule.DependsOn(3, 1));
+    EXPECT_TRUE(schedule.DependsOn(3, 2));
+    Print("TestStmts", schedule);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}